@@ -0,0 +1,60 @@
+/*
+ * arena.h
+ * for tasknc
+ * by mjheagle
+ */
+
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <stddef.h>
+
+/**
+ * arena block struct - one contiguous chunk of arena memory
+ * next - the previously filled block
+ * size - the number of bytes available in data
+ * used - the number of bytes handed out from data
+ * data - the memory itself
+ */
+struct arena_block {
+    struct arena_block* next;
+    size_t size;
+    size_t used;
+    char data[];
+};
+
+/**
+ * arena struct - a region that is only ever freed as a whole
+ * blocks    - the block currently being filled (linked to older blocks)
+ * blocksize - the size of newly created blocks
+ * allocated - the total number of bytes handed out
+ * dead      - the number of bytes handed out that are no longer used
+ * parent    - the arena that owns this arena, if it has been adopted
+ * children  - the first arena adopted by this arena
+ * sibling   - the next arena adopted by the same parent
+ */
+struct arena {
+    struct arena_block* blocks;
+    size_t blocksize;
+    size_t allocated;
+    size_t dead;
+    struct arena* parent;
+    struct arena* children;
+    struct arena* sibling;
+};
+
+void arena_adopt(struct arena* parent, struct arena* child);
+void* arena_alloc(struct arena* arena, const size_t size);
+void* arena_calloc(struct arena* arena, const size_t size);
+struct arena* arena_create(const size_t blocksize);
+void arena_free(struct arena* arena);
+void arena_release(struct arena* arena, const size_t size);
+struct arena* arena_root(struct arena* arena);
+size_t arena_size(const struct arena* arena);
+char* arena_strdup(struct arena* arena, const char* str);
+char* arena_strndup(struct arena* arena, const char* str, const size_t len);
+size_t arena_used(const struct arena* arena);
+
+#endif
+
+// vim: et ts=4 sw=4 sts=4
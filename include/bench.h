@@ -0,0 +1,20 @@
+/*
+ * bench.h
+ * for tasknc
+ * by mjheagle
+ */
+
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#include "common.h"
+
+void bench(const char* args);
+
+extern struct config cfg;
+extern int cols;
+extern struct task* head;
+
+#endif
+
+// vim: et ts=4 sw=4 sts=4
@@ -0,0 +1,42 @@
+/*
+ * colstats.h
+ * for tasknc
+ * by mjheagle
+ */
+
+#ifndef _COLSTATS_H
+#define _COLSTATS_H
+
+#include <stdio.h>
+#include "common.h"
+#include "config.h"
+
+/* the task fields whose widths are tracked */
+enum column {
+    COLUMN_PROJECT,
+    COLUMN_DESCRIPTION,
+    COLUMN_COUNT
+};
+
+/**
+ * column stats struct - the display widths of a field over the task list
+ * histogram - the number of tasks of each width, wider fields are counted
+ *             in the last bucket
+ * max       - the widest field, in screen columns
+ */
+struct column_stats {
+    int histogram[COLSTATSMAXWIDTH + 1];
+    int max;
+};
+
+void colstats_add(const struct task* this);
+void colstats_clear(void);
+int colstats_max(const enum column column);
+void colstats_remove(const struct task* this);
+int colstats_tag_count(const int tag);
+
+extern FILE* logfp;
+
+#endif
+
+// vim: et ts=4 sw=4 sts=4
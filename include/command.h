@@ -10,6 +10,7 @@
 #include <stdbool.h>
 #include "common.h"
 
+void free_sourced(void);
 void handle_command(char* cmdstr);
 void run_command_bind(char* args);
 void run_command_color(char* args);
@@ -7,8 +7,13 @@
 #ifndef _COMMON_H
 #define _COMMON_H
 
+#include <regex.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <time.h>
+#include "config.h"
+
+struct arena;
 
 /* ncurses settings */
 enum ncurses_mode {
@@ -46,32 +51,91 @@ struct var {
     void* ptr;
 };
 
+/**
+ * annotation struct - a note attached to a task
+ * entry       - when the annotation was added
+ * description - the text of the annotation
+ * next        - the next annotation on the same task
+ */
+struct annotation {
+    time_t entry;
+    char* description;
+    struct annotation* next;
+};
+
+/**
+ * uda struct - a taskwarrior attribute that tasknc has no field for
+ * name  - the name of the attribute
+ * value - the value of the attribute, as exported (json unescaped)
+ * next  - the next uda on the same task
+ */
+struct uda {
+    char* name;
+    char* value;
+    struct uda* next;
+};
+
 /**
  * task struct - the main structure in this program!
- * the fields thru description are data from the taskwarrior json
+ * the fields thru priority are data from the taskwarrior json
+ * tagbits    - the set of the task's tags, bit n is set if it has the tag
+ *              numbered n by the tag dictionary (allocated in the arena)
+ * tagwords   - the number of words in tagbits
+ * project    - the project, interned so tasks share one copy of each name
+ * uuid       - the uuid in binary, formatted with uuid_format when it is
+ *              printed or passed to task (all zero if it was missing)
+ * arena      - the arena the task and all of its fields are allocated from
+ * position   - the index of this task in the task table
+ * generation - the last incremental reload that found this task
+ * marked     - whether the task is marked for a batch command
+ * line       - the cached output of the task format (allocated in the arena)
+ * linesize   - the size of the buffer line points to
+ * linegen    - the render generation line was evaluated in, 0 if never
+ * duestr     - the formatted due date (allocated in the arena, NULL if never)
+ * duegen     - the date generation duestr was formatted in
  * selpair - the cached color pair to be used when this task is selected
  * pair    - the cached color pair to be used when this task is not selected
  * prev    - the previous task struct
  * next    - the next task struct
+ * fields are ordered by size so that the struct packs without holes
  */
 struct task {
     /* taskwarrior data */
-    unsigned short index;
-    char* uuid;
     char* tags;
+    uint64_t* tagbits;
+    const char* project;
+    char* description;
+    struct annotation* annotations;
+    struct uda* udas;
     time_t start;
     time_t end;
     time_t entry;
     time_t due;
-    char* project;
+    time_t modified;
+    unsigned char uuid[UUIDBYTES];
+    unsigned int index;
     char priority;
-    char* description;
-    /* color caching */
-    int selpair;
-    int pair;
+    /* batch commands */
+    bool marked;
+    /* tag set */
+    unsigned short tagwords;
+    /* memory */
+    struct arena* arena;
     /* linked list pointers */
     struct task* prev;
     struct task* next;
+    /* render caching */
+    char* line;
+    char* duestr;
+    size_t linesize;
+    unsigned int linegen;
+    unsigned int duegen;
+    /* task table */
+    int position;
+    unsigned int generation;
+    /* color caching */
+    int selpair;
+    int pair;
 };
 
 /* program modes */
@@ -164,8 +228,20 @@ enum log_mode {
  * statusbar_timeout - the time a statusbar message will display before timing out
  * loglvl            - which log messages should be printed
  * version           - the task warrior version being wrapped
+ * version_cache     - whether the version is remembered across runs
  * sortmode          - the active sort mode
  * follow_task       - whether a task will be followed when it moves in the list
+ * group_view        - whether the task list is grouped by project
+ * incremental_reload - whether reloads only export tasks that changed
+ * incremental_search - whether the selection follows a search as it is typed
+ * snapshot          - whether the task list is saved to show on the next launch
+ * task_source       - the name of the source tasks are read with
+ * timing            - whether the hot code paths are timed
+ * parse_threads     - the most threads a large export is parsed on (0 for one per cpu)
+ * view_prefetch     - how many tasks either side of the selected one have their
+ *                     info fetched while waiting for a key (0 for none)
+ * watch             - whether changes to the task data reload the list
+ * watch_debounce    - how long changes settle before the list is reloaded (ms)
  * formats           - string and compiled printing formats
  * fieldlengths      - width of some task data fields
  */
@@ -175,9 +251,22 @@ struct config {
     int statusbar_timeout;
     enum log_mode loglvl;
     char* version;
+    int version_cache;
     char* sortmode;
     bool follow_task;
+    int group_view;
+    int incremental_reload;
+    int incremental_search;
+    int snapshot;
+    char* task_source;
+    int timing;
+    int parse_threads;
+    int view_prefetch;
+    int watch;
+    int watch_debounce;
     struct {
+        char* group;
+        struct fmt_field* group_compiled;
         char* task;
         struct fmt_field* task_compiled;
         char* title;
@@ -207,9 +296,21 @@ struct config {
 #define MIN(x, y)                       (x < y ? x : y)
 
 /* functions */
+void format_date(char* buffer, const time_t timeint);
 bool match_string(const char* haystack, const char* needle);
+bool parse_timestamp(const char* str, const size_t length, time_t* timeint);
+bool pattern_literal(const char* pattern);
+void refresh_today(void);
+const regex_t* regex_cached(const char* pattern, const int flags);
+void regex_cache_free(void);
+bool str_casefind(const char* haystack, const char* needle, const size_t length);
+size_t str_prefix(const char* str, const int width, int* used);
+unsigned int today_generation(void);
 char* utc_date(const time_t timeint);
 char* utc_time(const time_t timeint);
+bool uuid_empty(const unsigned char* uuid);
+char* uuid_format(const unsigned char* uuid, char* str);
+bool uuid_parse(const char* str, const size_t length, unsigned char* uuid);
 char* var_value_message(struct var* v, bool printname);
 
 #endif
@@ -13,10 +13,33 @@
 #define PROJECTLENGTH           64
 #define DESCRIPTIONLENGTH       512
 #define TIMELENGTH              32
+#define EXPORTBLOCKLENGTH       65536
+#define TASKARENABLOCKLENGTH    65536
+#define REGEXCACHESIZE          32
+#define INFOCACHESIZE           16
+#define INCREMENTALMAXNEW       256
+#define INCREMENTALMAXMOVES     64      /* tasks put in place one at a time before indexing all */
+#define RELOADMAXWASTE          50      /* percent of the list's memory reloads may leave unused */
+#define RELOADMINWASTE          262144  /* bytes reloads may leave unused regardless */
+#define BATCHMAXTASKS           256
+#define PARSEMAXTHREADS         16
+#define PARSECHUNKLENGTH        262144
+#define SEARCHINDEXSLOTS        4096    /* must be a power of two */
+#define SEARCHINDEXMAXKEYS      64
+#define FILTERMAXTOKENS         64
+#define COLSTATSMAXWIDTH        256
+#define COLSTATSSLOTS           64      /* must be a power of two */
+#define INTERNSLOTS             64      /* must be a power of two */
+#define TAGSLOTS                64      /* must be a power of two */
+#define DISPATCHSLOTS           256     /* a power of two, twice the functions or variables */
+#define VERSIONLENGTH           64
 #define LOGFILE                 "/tmp/.tasknc_runlog_%s"
+#define LOGRINGSIZE             1024    /* must be a power of two */
+#define LOGLINELENGTH           512
 
 /* static field lengths */
 #define UUIDLENGTH                      38
+#define UUIDBYTES                       16
 #define DATELENGTH                      7
 
 /* compile in test suite */
@@ -0,0 +1,66 @@
+/*
+ * filter.h
+ * for tasknc
+ * by mjheagle
+ */
+
+#ifndef _FILTER_H
+#define _FILTER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <time.h>
+#include "common.h"
+
+/* the instructions of a compiled filter */
+enum filter_opcode {
+    FILTER_PROJECT,
+    FILTER_TAG,
+    FILTER_NOT_TAG,
+    FILTER_PRIORITY,
+    FILTER_STATUS,
+    FILTER_DUE_BEFORE,
+    FILTER_DUE_AFTER,
+    FILTER_AND,
+    FILTER_OR
+};
+
+/**
+ * filter op struct - an instruction of a compiled filter
+ * code   - what the instruction does
+ * value  - the project, tag, priority or status compared with (NULL for dates
+ *          and operators)
+ * length - the length of value
+ * when   - the date compared with
+ * tag    - the number of the tag compared with (-1 for other instructions)
+ */
+struct filter_op {
+    enum filter_opcode code;
+    char* value;
+    size_t length;
+    time_t when;
+    int tag;
+};
+
+/**
+ * filter struct - a filter compiled to a postfix program
+ * ops  - the instructions, each term pushes whether a task matches it and
+ *        each operator combines the two results on top of the stack
+ * nops - the number of instructions
+ */
+struct filter {
+    struct filter_op* ops;
+    int nops;
+};
+
+struct filter* filter_compile(const char* str);
+bool filter_covers(const char* wide, const char* narrow);
+void filter_free(struct filter* this);
+bool filter_match(const struct filter* this, const struct task* tsk);
+
+extern FILE* logfp;
+
+#endif
+
+// vim: et ts=4 sw=4 sts=4
@@ -11,8 +11,10 @@
 
 struct fmt_field* compile_format_string(char* fmt);
 char* eval_format(struct fmt_field* fmts, struct task* tsks);
+const char* eval_task_format(struct task* tsk);
 void compile_formats(void);
 void free_formats(void);
+void invalidate_formats(void);
 
 #endif
 
@@ -0,0 +1,54 @@
+/*
+ * groups.h
+ * for tasknc
+ * by mjheagle
+ */
+
+#ifndef _GROUPS_H
+#define _GROUPS_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "common.h"
+
+/**
+ * group struct - the tasks of one project, listed under a header row
+ * project   - a copy of the project (NULL for the tasks without one)
+ * members   - the tasks in the group, in display order once sorted
+ * count     - the number of tasks in the group
+ * capacity  - the number of tasks that fit in members before it must grow
+ * collapsed - whether only the header row is shown
+ * sorted    - whether members is in display order
+ */
+struct group {
+    char* project;
+    struct task** members;
+    int count;
+    int capacity;
+    bool collapsed;
+    bool sorted;
+};
+
+bool groups_active(void);
+void groups_add(struct task* this);
+void groups_clear(void);
+int groups_count(void);
+struct task* groups_get(const int row);
+const struct task* groups_header(const int row);
+int groups_position(const struct task* this);
+void groups_remove(const struct task* this);
+void groups_reorder(void);
+void groups_replace(const struct task* old, struct task* new);
+void groups_reset(void);
+int groups_toggle(const int row);
+
+/* the header row being printed, for the group format */
+extern int group_count;
+extern char* group_marker;
+
+extern struct config cfg;
+extern FILE* logfp;
+
+#endif
+
+// vim: et ts=4 sw=4 sts=4
@@ -0,0 +1,48 @@
+/*
+ * infocache.h
+ * for tasknc
+ * by mjheagle
+ */
+
+#ifndef _INFOCACHE_H
+#define _INFOCACHE_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <time.h>
+#include "common.h"
+
+/**
+ * info struct - the output of `task info` for a task
+ * uuid     - the task the info is for (all zero for an unused entry)
+ * width    - the width the info was printed at
+ * modified - when the task was last modified as the info was printed
+ * output   - everything the command printed (null terminated)
+ * length   - the number of characters in output
+ * used     - when this entry was last looked up
+ */
+struct info {
+    unsigned char uuid[UUIDBYTES];
+    int width;
+    time_t modified;
+    char* output;
+    size_t length;
+    unsigned long used;
+};
+
+void infocache_clear(void);
+char* infocache_command(const struct task* this, const int width);
+const struct info* infocache_find(const struct task* this, const int width);
+void infocache_forget(const unsigned char* uuid);
+void infocache_prefetch(void);
+void infocache_request(const struct task* this, const int width, struct info* request);
+void infocache_store(const struct info* request, char* output, const size_t length);
+
+extern struct config cfg;
+extern FILE* logfp;
+extern int cols;
+extern int selline;
+
+#endif
+
+// vim: et ts=4 sw=4 sts=4
@@ -0,0 +1,20 @@
+/*
+ * intern.h
+ * for tasknc
+ * by mjheagle
+ */
+
+#ifndef _INTERN_H
+#define _INTERN_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+void intern_free(void);
+const char* intern_string(const char* str, const size_t length);
+
+extern FILE* logfp;
+
+#endif
+
+// vim: et ts=4 sw=4 sts=4
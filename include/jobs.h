@@ -0,0 +1,68 @@
+/*
+ * jobs.h
+ * for tasknc
+ * by mjheagle
+ */
+
+#ifndef _JOBS_H
+#define _JOBS_H
+
+#include <curses.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include "common.h"
+
+struct job;
+
+/* function run on the ui when a job finishes */
+typedef void (*job_callback)(const struct job* job);
+
+/**
+ * job struct - a shell command run in the background
+ * cmdstr   - the command being run (NULL for a job that only runs its callback)
+ * output   - everything the command printed to stdout (null terminated)
+ * length   - the number of characters in output
+ * size     - the size of the output buffer
+ * ret      - the exit status of the command, -1 if it could not be run
+ * pid      - the process running the command, 0 until it is started
+ * fd       - the pipe the command's output is read from
+ * started  - when the command was started, for its timer
+ * callback - the function to run once the command finishes (may be NULL)
+ * data     - passed to the callback, freed along with the job
+ * idle     - whether the job is not counted as pending, its result is
+ *            dropped once another job is submitted
+ * next     - the job queued after this one
+ */
+struct job {
+    char* cmdstr;
+    char* output;
+    size_t length;
+    size_t size;
+    int ret;
+    pid_t pid;
+    int fd;
+    long long started;
+    job_callback callback;
+    void* data;
+    bool idle;
+    struct job* next;
+};
+
+void jobs_discard(const pid_t pid, const int fd);
+int jobs_getch(WINDOW* win);
+int jobs_getch_fd(WINDOW* win, const int fd);
+int jobs_getch_timeout(WINDOW* win, const int fd, int timeout);
+int jobs_pending(void);
+void jobs_prefetch(const char* cmdstr);
+bool jobs_spawn(const char* cmdstr, pid_t* pid, int* fd);
+bool jobs_submit(const char* cmdstr, job_callback callback, void* data);
+bool jobs_submit_idle(const char* cmdstr, job_callback callback, void* data);
+void jobs_wait(void);
+
+extern struct config cfg;
+extern FILE* logfp;
+
+#endif
+
+// vim: et ts=4 sw=4 sts=4
@@ -0,0 +1,60 @@
+/*
+ * json.h
+ * for tasknc
+ * by mjheagle
+ */
+
+#ifndef _JSON_H
+#define _JSON_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* token types returned by the scanner */
+enum json_token_type {
+    JSON_END,
+    JSON_ERROR,
+    JSON_OBJECT_START,
+    JSON_OBJECT_END,
+    JSON_ARRAY_START,
+    JSON_ARRAY_END,
+    JSON_STRING,
+    JSON_NUMBER,
+    JSON_TRUE,
+    JSON_FALSE,
+    JSON_NULL
+};
+
+/**
+ * json token struct - a view into the scanned buffer, nothing is copied
+ * type    - the kind of token found
+ * start   - the first character of the token (inside the quotes for strings)
+ * length  - the number of raw characters in the token
+ * escaped - whether a string token contains escapes that need decoding
+ */
+struct json_token {
+    enum json_token_type type;
+    const char* start;
+    size_t length;
+    bool escaped;
+};
+
+/**
+ * json scanner struct - the state of a single pass over a buffer
+ * pos - the next character to be scanned
+ * end - one past the last character of the buffer
+ */
+struct json_scanner {
+    const char* pos;
+    const char* end;
+};
+
+void json_init(struct json_scanner* scanner, const char* buffer, const size_t length);
+enum json_token_type json_next(struct json_scanner* scanner, struct json_token* token);
+bool json_skip_value(struct json_scanner* scanner, const struct json_token* first);
+void json_skip_line(struct json_scanner* scanner);
+size_t json_unescape(const struct json_token* token, char* out);
+
+#endif
+
+// vim: et ts=4 sw=4 sts=4
@@ -34,6 +34,8 @@ void add_keybind(const int key,
                  char* arg,
                  const enum prog_mode mode);
 
+void free_keybinds(void);
+
 void handle_keypress(const int c, const enum prog_mode mode);
 
 char* name_key(const int val);
@@ -7,14 +7,37 @@
 #ifndef _LOG_H
 #define _LOG_H
 
+#include <stdbool.h>
 #include <stdio.h>
 #include "common.h"
 
+/* messages logged above this level are compiled out, for example
+ * CFLAGS="-O2 -DLOG_LEVEL_MAX=LOG_INFO" make
+ */
+#ifndef LOG_LEVEL_MAX
+#define LOG_LEVEL_MAX                   LOG_DEBUG_VERBOSE
+#endif
+
+/* log a message if cfg.loglvl is at least minloglvl
+ * the level is checked before the message's arguments are evaluated
+ */
+#define tnc_fprintf(fp, minloglvl, ...) \
+    do { \
+        if ((minloglvl) <= LOG_LEVEL_MAX && (minloglvl) <= cfg.loglvl) { \
+            tnc_log(fp, minloglvl, __VA_ARGS__); \
+        } \
+    } while (0)
+
+void log_close(void);
+void log_flush(void);
+bool log_open(const char* path);
+void tnc_log(FILE* fp,
+             const enum log_mode minloglvl,
+             const char* format,
+             ...) __attribute__((format(printf, 3, 4)));
+
 extern struct config cfg;
-void tnc_fprintf(FILE* fp,
-                 const enum log_mode monloglvl,
-                 const char* format,
-                 ...) __attribute__((format(printf, 3, 4)));
+extern FILE* logfp;
 
 #endif
 
@@ -11,17 +11,6 @@
 #include <stdbool.h>
 #include "common.h"
 
-/**
- * line struct (basic string vector struct)
- * str  - the string contained
- * next - the next line struct
- */
-struct line {
-    char* str;
-    struct line* next;
-};
-
-void free_lines(struct line* head);
 void help_window(void);
 void key_pager_close(void);
 void key_pager_scroll_down(void);
@@ -34,6 +23,8 @@ void pager_command(const char* cmdstr,
                    const int head_skip,
                    const int tail_skip);
 void view_stats(void);
+void view_tags(void);
+void view_timing(void);
 void view_task(struct task* this);
 
 extern bool redraw;
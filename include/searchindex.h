@@ -0,0 +1,39 @@
+/*
+ * searchindex.h
+ * for tasknc
+ * by mjheagle
+ */
+
+#ifndef _SEARCHINDEX_H
+#define _SEARCHINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "common.h"
+
+/**
+ * posting struct - the tasks containing a trigram
+ * key      - the trigram, three lowercased characters (0 for an empty slot)
+ * count    - the number of tasks in tasks
+ * capacity - the number of tasks that fit in tasks before it must grow
+ * tasks    - the tasks whose description, project or tags contain the trigram
+ */
+struct posting {
+    uint32_t key;
+    int count;
+    int capacity;
+    const struct task** tasks;
+};
+
+void searchindex_add(const struct task* this);
+void searchindex_clear(void);
+int searchindex_query(const char* pattern, const struct task*** candidates);
+void searchindex_remove(const struct task* this);
+void searchindex_reorder(void);
+
+extern FILE* logfp;
+
+#endif
+
+// vim: et ts=4 sw=4 sts=4
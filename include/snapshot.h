@@ -0,0 +1,24 @@
+/*
+ * snapshot.h
+ * for tasknc
+ * by mjheagle
+ */
+
+#ifndef _SNAPSHOT_H
+#define _SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+#include "common.h"
+
+char* snapshot_path(void);
+struct task* snapshot_read(const char* path, const char* key, time_t* modified);
+bool snapshot_write(const char* path, const char* key, const struct task* first,
+                    const time_t modified);
+
+extern FILE* logfp;
+
+#endif
+
+// vim: et ts=4 sw=4 sts=4
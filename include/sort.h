@@ -4,10 +4,16 @@
  * by mjheagle
  */
 
+#include <stddef.h>
 #include <stdio.h>
 #include "common.h"
 
-void sort_wrapper(struct task* first);
+int sort_compare(const struct task* a, const struct task* b);
+int sort_compare_projects(const char* a, const char* b);
+struct task* sort_merge(struct task* sorted, struct task* unsorted);
+struct task* sort_merge_lists(struct task* first, struct task* second);
+void sort_tasks(struct task** tasks, const size_t n);
+struct task* sort_wrapper(struct task* first);
 
 extern struct config cfg;
 extern FILE* logfp;
@@ -10,17 +10,26 @@
 #include <stdio.h>
 #include "common.h"
 
+/* called with the string being entered at a prompt as it changes */
+typedef void (*prompt_callback)(const char* str);
+
 void free_prompts(void);
 
 int statusbar_getstr(char** str,
                      const char* msg);
 
+int statusbar_getstr_live(char** str,
+                          const char* msg,
+                          prompt_callback changed);
+
 void statusbar_message(const int dtmout,
                        const char* format,
                        ...) __attribute__((format(printf, 2, 3)));
 
+void statusbar_pending(const int pending);
 void statusbar_timeout(void);
 
+extern int cols;
 extern struct config cfg;
 extern FILE* logfp;
 extern WINDOW* statusbar;
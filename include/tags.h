@@ -0,0 +1,30 @@
+/*
+ * tags.h
+ * for tasknc
+ * by mjheagle
+ */
+
+#ifndef _TAGS_H
+#define _TAGS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "common.h"
+
+/* the number of tag ids held by each word of a task's tag set */
+#define TAGWORDBITS             64
+
+int tag_count(void);
+int tag_id(const char* name, const size_t length, const bool create);
+bool tag_literal(const char* pattern, const size_t length);
+const char* tag_name(const int id);
+bool tag_test(const struct task* tsk, const int id);
+void tags_free(void);
+void tags_index(struct task* tsk);
+
+extern FILE* logfp;
+
+#endif
+
+// vim: et ts=4 sw=4 sts=4
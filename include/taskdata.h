@@ -0,0 +1,25 @@
+/*
+ * taskdata.h
+ * for tasknc
+ * by mjheagle
+ */
+
+#ifndef _TASKDATA_H
+#define _TASKDATA_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "arena.h"
+#include "common.h"
+#include "tasks.h"
+
+struct task* taskdata_load(const char* filter, const char* uuid, struct arena* arena);
+char* taskdata_location(void);
+bool taskdata_usable(const char* filter);
+
+extern const struct task_source taskdata_source;
+extern FILE* logfp;
+
+#endif
+
+// vim: et ts=4 sw=4 sts=4
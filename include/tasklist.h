@@ -15,6 +15,10 @@ void key_tasklist_complete(void);
 void key_tasklist_delete(void);
 void key_tasklist_edit(void);
 void key_tasklist_filter(const char* arg);
+void key_tasklist_fold(void);
+void key_tasklist_group(void);
+void key_tasklist_mark(void);
+void key_tasklist_mark_search(const char* arg);
 void key_tasklist_modify(const char* arg);
 void key_tasklist_reload(void);
 void key_tasklist_scroll(const int direction);
@@ -28,12 +32,14 @@ void key_tasklist_sort(const char* arg);
 void key_tasklist_sync(void);
 void key_tasklist_toggle_started(void);
 void key_tasklist_undo(void);
+void key_tasklist_unmark(void);
 void key_tasklist_view(void);
 void tasklist_check_curs_pos(void);
 void tasklist_print_task(const int tasknum, const struct task* this, const int count);
 void tasklist_print_task_list(void);
 void tasklist_remove_task(struct task* this);
 void tasklist_task_add(void);
+void tasklist_update(const int oldsel, const int oldoffset);
 void tasklist_window(void);
 
 extern bool reload;
@@ -47,7 +53,7 @@ extern int cols;
 extern int rows;
 extern int selline;
 extern int taskcount;
-extern short pageoffset;
+extern int pageoffset;
 extern struct task* head;
 extern time_t sb_timeout;
 extern WINDOW* tasklist;
@@ -15,7 +15,6 @@
 #define wipe_tasklist()                 wipe_screen(tasklist, 0, rows-2)
 #define wipe_statusbar()                wipe_screen(statusbar, 0, 0)
 
-#define NVARS                           (int)(sizeof(vars)/sizeof(struct var))
 #define NFUNCS                          (int)(sizeof(funcmaps)/sizeof(struct funcmap))
 
 /* default settings */
@@ -29,7 +28,7 @@ void check_screen_size(void);
 void cleanup(void);
 void configure(void);
 struct funcmap* find_function(const char* name, const enum prog_mode mode);
-void find_next_search_result(struct task* head, struct task* pos);
+void find_next_search_result(struct task* pos);
 struct var* find_var(const char* name);
 void force_redraw(void);
 void handle_resize(void);
@@ -38,7 +37,8 @@ void key_command(const char* arg);
 void key_task_background_command(const char* arg);
 void key_task_interactive_command(const char* arg);
 void key_done(void);
-char max_project_length(void);
+int max_description_length(void);
+int max_project_length(void);
 const char* name_function(void*);
 void ncurses_end(int);
 void ncurses_init(void);
@@ -8,24 +8,55 @@
 #define _TASKS_H
 
 #include <stdbool.h>
+#include "arena.h"
 #include "common.h"
+#include "jobs.h"
+#include "json.h"
 
-char free_task(struct task* tsk);
+/**
+ * task source struct - a way of reading tasks from taskwarrior
+ * name    - the value of the task_source variable that selects it
+ * usable  - whether the source can read the tasks matching a filter
+ * command - build a shell command that exports the tasks matching a filter
+ *           (or only the task with a uuid, if it is not NULL) as json,
+ *           NULL if the source reads tasks itself
+ * load    - read the tasks matching a filter (or only the task with a uuid)
+ *           into an arena, returning the sorted list or NULL if there were
+ *           none, NULL if the source runs a command
+ */
+struct task_source {
+    const char* name;
+    bool (*usable)(const char* filter);
+    char* (*command)(const char* filter, const char* uuid);
+    struct task* (*load)(const char* filter, const char* uuid, struct arena* arena);
+};
+
+bool apply_filter(void);
+void free_task_list(void);
 void free_tasks(struct task* head);
 struct task* get_task_by_position(int n);
-int get_task_position_by_uuid(const char* uuid);
+int get_task_position_by_uuid(const unsigned char* uuid);
 struct task* get_tasks(char* uuid);
-unsigned short get_task_id(char* uuid);
-struct task* malloc_task(void);
-struct task* parse_task(char* line);
+unsigned int get_task_id(char* uuid);
+int hidden_task_count(void);
+void invalidate_task_list(void);
+bool load_task_snapshot(void);
+struct task* malloc_task(struct arena* arena);
+struct task* parse_task(struct json_scanner* scanner, struct arena* arena);
+struct task* parse_tasks(const char* buffer, const size_t length, struct arena* arena);
+void prefetch_tasks(void);
+void release_task(struct task* this);
 void reload_task(struct task* this);
 void reload_tasks(void);
-void remove_char(char* str, char remove);
+void reload_tasks_background(void (*done)(void));
+void save_task_snapshot(void);
 void set_position_by_uuid(const char* uuid);
-int task_background_command(const char* cmdfmt);
+void task_background_command(const char* cmdfmt, job_callback callback);
+int task_batch_command(const char* action, job_callback callback);
 void task_count(void);
 int task_interactive_command(const char* cmdfmt);
 bool task_match(const struct task* cur, const char* str);
+struct task* task_search(const struct task* pos, const char* str, bool* wrapped);
 void task_modify(const char* argstr);
 
 extern FILE* logfp;
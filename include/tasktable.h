@@ -0,0 +1,51 @@
+/*
+ * tasktable.h
+ * for tasknc
+ * by mjheagle
+ */
+
+#ifndef _TASKTABLE_H
+#define _TASKTABLE_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include "common.h"
+
+/**
+ * task table struct - indexes on the task list
+ * tasks    - every task in display order
+ * count    - the number of tasks in the table
+ * capacity - the number of tasks that fit in tasks before it must grow
+ * slots    - open addressed hash of tasks by uuid (NULL for an empty slot)
+ * nslots   - the size of slots, always a power of two
+ * changed  - the first position changed since tasktable_changed was called
+ */
+struct task_table {
+    struct task** tasks;
+    int count;
+    int capacity;
+    struct task** slots;
+    size_t nslots;
+    int changed;
+};
+
+void tasktable_build(struct task* first);
+int tasktable_changed(void);
+void tasktable_clear(void);
+int tasktable_count(void);
+struct task* tasktable_find(const unsigned char* uuid);
+struct task* tasktable_find_hidden(const unsigned char* uuid);
+struct task* tasktable_get(const int position);
+bool tasktable_hide(struct task* this);
+bool tasktable_insert(struct task* this);
+void tasktable_remove(struct task* this);
+void tasktable_reorder(struct task* first);
+void tasktable_replace(struct task* old, struct task* new);
+void tasktable_unhide(const struct task* this);
+void tasktable_unhide_all(void);
+
+extern FILE* logfp;
+
+#endif
+
+// vim: et ts=4 sw=4 sts=4
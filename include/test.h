@@ -13,6 +13,7 @@ void test(const char* args);
 
 extern char* searchstring;
 extern struct config cfg;
+extern int cols;
 extern int selline;
 extern struct task* head;
 
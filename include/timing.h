@@ -0,0 +1,89 @@
+/*
+ * timing.h
+ * for tasknc
+ * by mjheagle
+ */
+
+#ifndef _TIMING_H
+#define _TIMING_H
+
+#include <stdbool.h>
+#include "common.h"
+
+/* the number of histogram buckets, each a decade of time from 1us up */
+#define TIMER_BUCKETS                   8
+
+/* the length of a timer's summary */
+#define TIMER_SUMMARYLENGTH             96
+
+/* the timed code paths */
+enum timer_id {
+    TIMER_GET_TASKS,
+    TIMER_PARSE_TASK,
+    TIMER_SORT,
+    TIMER_PRINT_LIST,
+    TIMER_COMMAND,
+    TIMER_PAGER_COMMAND,
+    TIMER_COUNT
+};
+
+/* the phases of startup, they are timed whether or not timing is enabled */
+enum phase_id {
+    PHASE_VERSION,
+    PHASE_CONFIG,
+    PHASE_TASKS,
+    PHASE_FIRST_FRAME,
+    PHASE_COUNT
+};
+
+/**
+ * timer struct - the durations of a timed code path
+ * name      - the name of the timer
+ * count     - the number of times the path ran
+ * total     - the total time spent in it (ns)
+ * max       - the longest it took (ns)
+ * histogram - the number of runs that took under 1us, 10us, ... 1s, and over
+ * value     - the summary shown by the timer's read-only variable
+ * summary   - the storage for value
+ */
+struct timer {
+    const char* name;
+    unsigned long count;
+    long long total;
+    long long max;
+    unsigned long histogram[TIMER_BUCKETS];
+    char* value;
+    char summary[TIMER_SUMMARYLENGTH];
+};
+
+/**
+ * phase struct - when a phase of startup ran
+ * name    - the name of the phase
+ * start   - when the phase started (ns), 0 if it has not
+ * stop    - when the phase finished (ns), 0 if it has not
+ * value   - the summary shown by the phase's read-only variable
+ * summary - the storage for value
+ */
+struct phase {
+    const char* name;
+    long long start;
+    long long stop;
+    char* value;
+    char summary[TIMER_SUMMARYLENGTH];
+};
+
+void phase_start(const enum phase_id id);
+void phase_stop(const enum phase_id id);
+char* timer_histogram(const enum timer_id id);
+long long timer_start(void);
+void timer_stop(const enum timer_id id, const long long start);
+void timing_refresh(void);
+void timing_reset(void);
+
+extern struct config cfg;
+extern struct phase phases[];
+extern struct timer timers[];
+
+#endif
+
+// vim: et ts=4 sw=4 sts=4
@@ -0,0 +1,21 @@
+/*
+ * version.h
+ * for tasknc
+ * by mjheagle
+ */
+
+#ifndef _VERSION_H
+#define _VERSION_H
+
+#include <stdio.h>
+#include "common.h"
+
+void version_finish(void);
+void version_start(void);
+
+extern struct config cfg;
+extern FILE* logfp;
+
+#endif
+
+// vim: et ts=4 sw=4 sts=4
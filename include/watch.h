@@ -0,0 +1,27 @@
+/*
+ * watch.h
+ * for tasknc
+ * by mjheagle
+ */
+
+#ifndef _WATCH_H
+#define _WATCH_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "common.h"
+
+bool watch_changed(void);
+int watch_fd(void);
+void watch_ignore(void);
+void watch_poke(void);
+bool watch_start(void);
+void watch_stop(void);
+int watch_timeout(const int timeout);
+
+extern struct config cfg;
+extern FILE* logfp;
+
+#endif
+
+// vim: et ts=4 sw=4 sts=4
@@ -0,0 +1,227 @@
+/*
+ * arena.c - region allocator for data with a shared lifetime
+ * for tasknc
+ * by mjheagle
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+/* allocations are aligned for any basic type */
+#define ARENA_ALIGN                     16
+#define ARENA_ROUND(x)                  (((x) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+/* local functions */
+static struct arena_block* arena_new_block(struct arena* arena, const size_t size);
+
+void arena_adopt(struct arena* parent, struct arena* child) { /* {{{ */
+    /**
+     * hand ownership of an arena to another arena
+     * the child will be freed along with its parent
+     * parent - the arena taking ownership
+     * child  - the arena being adopted
+     */
+    if (parent == NULL || child == NULL || parent == child) {
+        return;
+    }
+
+    child->parent = parent;
+    child->sibling = parent->children;
+    parent->children = child;
+} /* }}} */
+
+void* arena_alloc(struct arena* arena, const size_t size) { /* {{{ */
+    /**
+     * allocate memory from an arena
+     * arena - the arena to allocate from
+     * size  - the number of bytes requested
+     * return is the memory, which is only released by arena_free
+     */
+    const size_t        rounded = ARENA_ROUND(size);
+    struct arena_block* block = arena->blocks;
+    void*               ret;
+
+    if (block == NULL || block->size - block->used < rounded) {
+        block = arena_new_block(arena, rounded);
+
+        if (block == NULL) {
+            return NULL;
+        }
+    }
+
+    ret = block->data + block->used;
+    block->used += rounded;
+    arena->allocated += rounded;
+
+    return ret;
+} /* }}} */
+
+void* arena_calloc(struct arena* arena, const size_t size) { /* {{{ */
+    /* allocate zeroed memory from an arena */
+    void* ret = arena_alloc(arena, size);
+
+    if (ret != NULL) {
+        memset(ret, 0, size);
+    }
+
+    return ret;
+} /* }}} */
+
+struct arena* arena_create(const size_t blocksize) { /* {{{ */
+    /**
+     * create an empty arena
+     * blocksize - the size of each chunk of memory the arena requests
+     * return is the new arena, or NULL on failure
+     */
+    struct arena* arena = calloc(1, sizeof(struct arena));
+
+    if (arena == NULL) {
+        return NULL;
+    }
+
+    arena->blocksize = ARENA_ROUND(blocksize);
+
+    return arena;
+} /* }}} */
+
+void arena_free(struct arena* arena) { /* {{{ */
+    /**
+     * free an arena, every allocation made from it and every arena it adopted
+     * arena - the arena to free
+     */
+    struct arena_block* block;
+    struct arena*       child;
+
+    if (arena == NULL) {
+        return;
+    }
+
+    while (arena->children != NULL) {
+        child = arena->children;
+        arena->children = child->sibling;
+        child->parent = NULL;
+        arena_free(child);
+    }
+
+    while (arena->blocks != NULL) {
+        block = arena->blocks;
+        arena->blocks = block->next;
+        free(block);
+    }
+
+    free(arena);
+} /* }}} */
+
+struct arena_block* arena_new_block(struct arena* arena, const size_t size) { /* {{{ */
+    /**
+     * add a block to an arena
+     * arena - the arena to grow
+     * size  - the minimum number of bytes the block must hold
+     * return is the new block, or NULL on failure
+     */
+    struct arena_block* block;
+    const size_t        blocksize = size > arena->blocksize ? size : arena->blocksize;
+
+    block = malloc(sizeof(struct arena_block) + blocksize);
+
+    if (block == NULL) {
+        return NULL;
+    }
+
+    block->size = blocksize;
+    block->used = 0;
+
+    /* an oversized allocation gets a block of its own behind the current one
+     * so the space left in the current block is not wasted
+     */
+    if (blocksize > arena->blocksize && arena->blocks != NULL) {
+        block->next = arena->blocks->next;
+        arena->blocks->next = block;
+    } else {
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+
+    return block;
+} /* }}} */
+
+void arena_release(struct arena* arena, const size_t size) { /* {{{ */
+    /**
+     * note that memory allocated from an arena is no longer used
+     * it is still only released by arena_free, see arena_used
+     * arena - the arena the memory was allocated from
+     * size  - the number of bytes no longer used
+     */
+    if (arena == NULL) {
+        return;
+    }
+
+    arena->dead = arena->allocated - arena->dead > size ?
+                  arena->dead + size : arena->allocated;
+} /* }}} */
+
+struct arena* arena_root(struct arena* arena) { /* {{{ */
+    /* find the arena that ultimately owns an arena */
+    while (arena != NULL && arena->parent != NULL) {
+        arena = arena->parent;
+    }
+
+    return arena;
+} /* }}} */
+
+size_t arena_size(const struct arena* arena) { /* {{{ */
+    /* count the memory held by an arena and every arena it adopted */
+    const struct arena_block*   block;
+    const struct arena*         child;
+    size_t                      size = 0;
+
+    for (block = arena->blocks; block != NULL; block = block->next) {
+        size += sizeof(struct arena_block) + block->size;
+    }
+
+    for (child = arena->children; child != NULL; child = child->sibling) {
+        size += arena_size(child);
+    }
+
+    return size;
+} /* }}} */
+
+char* arena_strdup(struct arena* arena, const char* str) { /* {{{ */
+    /* copy a string into an arena */
+    if (str == NULL) {
+        return NULL;
+    }
+
+    return arena_strndup(arena, str, strlen(str));
+} /* }}} */
+
+char* arena_strndup(struct arena* arena, const char* str, const size_t len) { /* {{{ */
+    /* copy at most len characters of a string into an arena, like strndup */
+    const size_t    n = strnlen(str, len);
+    char*           ret = arena_alloc(arena, n + 1);
+
+    if (ret != NULL) {
+        memcpy(ret, str, n);
+        ret[n] = 0;
+    }
+
+    return ret;
+} /* }}} */
+
+size_t arena_used(const struct arena* arena) { /* {{{ */
+    /* count the bytes handed out by an arena and every arena it adopted that
+     * have not been released
+     */
+    const struct arena* child;
+    size_t              used = arena->allocated - arena->dead;
+
+    for (child = arena->children; child != NULL; child = child->sibling) {
+        used += arena_used(child);
+    }
+
+    return used;
+} /* }}} */
+
+// vim: et ts=4 sw=4 sts=4
@@ -0,0 +1,589 @@
+/*
+ * bench.c - micro-benchmarks for tasknc
+ * for tasknc
+ * by mjheagle
+ */
+
+#define _GNU_SOURCE
+#include <curses.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "arena.h"
+#include "bench.h"
+#include "color.h"
+#include "common.h"
+#include "config.h"
+#include "formats.h"
+#include "sort.h"
+#include "tasknc.h"
+#include "tasks.h"
+#include "tasktable.h"
+
+#ifdef TASKNC_INCLUDE_TESTS
+/* the number of tasks generated when no size or export is given */
+#define BENCH_DEFAULT_TASKS             2000
+
+/* each benchmark is repeated until it has run this long (ns) and this often */
+#define BENCH_MIN_TIME                  250000000LL
+#define BENCH_MIN_RUNS                  5
+#define BENCH_MAX_RUNS                  10000
+
+/**
+ * bench data struct - the task list the benchmarks run over
+ * export  - the export the list was parsed from
+ * length  - the length of the export
+ * tasks   - the tasks, in the order they were parsed
+ * ntasks  - the number of tasks
+ * order   - a shuffled order of positions, used to unsort and look up tasks
+ * term    - the file the color benchmark's terminal is opened on
+ * screen  - the terminal color rules are set up for (NULL without colors)
+ * bytes   - the bytes kept by the last run of a benchmark
+ */
+struct bench_data {
+    char* export;
+    size_t length;
+    struct task** tasks;
+    int ntasks;
+    int* order;
+    FILE* term;
+    SCREEN* screen;
+    size_t bytes;
+};
+
+/**
+ * bench struct - a single benchmark
+ * name     - the name printed with its results
+ * sortmode - the sort mode set while it runs (NULL to keep the current one)
+ * prepare  - run before each run, outside of the timing (may be NULL)
+ * run      - a run of the benchmark, returning the number of operations
+ */
+struct bench {
+    const char* name;
+    const char* sortmode;
+    void (*prepare)(struct bench_data* data);
+    int (*run)(struct bench_data* data);
+};
+
+/* color rules evaluated by the color benchmark, one of each kind of condition */
+static const char* bench_color_rules[] = {
+    "~p 'home'",
+    "~t 'next'",
+    "~d 'alpha'",
+    "~r '[HM]'",
+    "~P 'work' ~d 'beta'",
+    "~s",
+    NULL
+};
+
+/* words used to generate task fields */
+static const char* bench_words[] = {
+    "alpha", "beta", "gamma", "delta", "review", "write", "fix", "call",
+    "email", "plan", "release", "notes", "build", "test", "meeting", "report"
+};
+static const char* bench_projects[] = {
+    NULL, "home", "work", "work.reports", "tasknc", "garden"
+};
+static const char* bench_tags[] = {
+    NULL, "next", "bug", "waiting", "next\",\"bug"
+};
+
+/* local functions */
+static int bench_colors(struct bench_data* data);
+static int bench_compare_times(const void* a, const void* b);
+static int bench_format(struct bench_data* data);
+static char* bench_generate(const int ntasks, size_t* length);
+static bool bench_load(struct bench_data* data, const char* args);
+static int bench_lookup(struct bench_data* data);
+static int bench_lookup_uuid(struct bench_data* data);
+static int bench_parse(struct bench_data* data);
+static unsigned int bench_random(void);
+static void bench_report(const struct bench* b, struct bench_data* data);
+static int bench_search(struct bench_data* data);
+static int bench_search_next(struct bench_data* data);
+static bool bench_setup_colors(struct bench_data* data);
+static void bench_shuffle(struct bench_data* data);
+static int bench_sort(struct bench_data* data);
+static long long bench_time(void);
+
+/* state of the random number generator, fixed so every run sees the same tasks */
+static uint32_t bench_seed = 2463534242u;
+
+void bench(const char* args) { /* {{{ */
+    /**
+     * run the benchmarks and print their results
+     * args - the debug mode argument, bench=<number of tasks> sets the size of
+     *        the generated task list, bench=<file> parses a captured export
+     *        instead
+     * results are printed one benchmark per line, tab separated:
+     * name, operations per run, runs, operations per second, the median and
+     * 99th percentile time of a run (ns), and bytes kept by a run
+     */
+    struct bench benches[] = {
+        {"parse",       NULL,   NULL,           bench_parse},
+        {"sort_n",      "n",    bench_shuffle,  bench_sort},
+        {"sort_d",      "d",    bench_shuffle,  bench_sort},
+        {"sort_p",      "p",    bench_shuffle,  bench_sort},
+        {"sort_r",      "r",    bench_shuffle,  bench_sort},
+        {"sort_u",      "u",    bench_shuffle,  bench_sort},
+        {"sort_drpu",   "drpu", bench_shuffle,  bench_sort},
+        {"search",      NULL,   NULL,           bench_search},
+        {"search_next", NULL,   NULL,           bench_search_next},
+        {"format",      NULL,   NULL,           bench_format},
+        {"colors",      NULL,   NULL,           bench_colors},
+        {"lookup",      NULL,   NULL,           bench_lookup},
+        {"lookup_uuid", NULL,   NULL,           bench_lookup_uuid},
+    };
+    const int           nbenches = sizeof(benches) / sizeof(struct bench);
+    struct bench_data   data;
+    struct task*        oldhead = head;
+    char*               oldsort = cfg.sortmode;
+    const int           oldcols = cols;
+    const int           oldproject = cfg.fieldlengths.project;
+    const int           olddescription = cfg.fieldlengths.description;
+    const int           olddate = cfg.fieldlengths.date;
+    int                 i;
+
+    memset(&data, 0, sizeof(data));
+
+    if (!bench_load(&data, args)) {
+        puts("# bench: no tasks to run the benchmarks on");
+        return;
+    }
+
+    /* the benchmarks run on their own list, indexed like the real one */
+    head = data.tasks[0];
+    tasktable_build(head);
+    cols = cols > 0 ? cols : 80;
+    cfg.fieldlengths.project = max_project_length();
+    cfg.fieldlengths.date = DATELENGTH;
+    cfg.fieldlengths.description = max_description_length();
+    bench_setup_colors(&data);
+
+    printf("# tasks %d, export %zu bytes\n", data.ntasks, data.length);
+    puts("# name\tops\truns\tops_per_sec\tp50_ns\tp99_ns\tbytes");
+
+    for (i = 0; i < nbenches; i++) {
+        if (str_eq(benches[i].name, "colors") && data.screen == NULL) {
+            puts("# colors: skipped, no terminal with colors");
+            continue;
+        }
+
+        bench_report(&(benches[i]), &data);
+    }
+
+    if (data.screen != NULL) {
+        endwin();
+        delscreen(data.screen);
+    }
+
+    if (data.term != NULL) {
+        fclose(data.term);
+    }
+
+    /* put the real list back */
+    cfg.sortmode = oldsort;
+    cols = oldcols;
+    cfg.fieldlengths.project = oldproject;
+    cfg.fieldlengths.description = olddescription;
+    cfg.fieldlengths.date = olddate;
+    free_tasks(head);
+    head = oldhead;
+    tasktable_build(head);
+    free(data.export);
+    free(data.tasks);
+    free(data.order);
+} /* }}} */
+
+int bench_colors(struct bench_data* data) { /* {{{ */
+    /* evaluate the color rules for every task, bypassing the color cache */
+    int i;
+
+    for (i = 0; i < data->ntasks; i++) {
+        data->tasks[i]->pair = -1;
+        get_colors(OBJECT_TASK, data->tasks[i], false);
+    }
+
+    data->bytes = 0;
+
+    return data->ntasks;
+} /* }}} */
+
+int bench_compare_times(const void* a, const void* b) { /* {{{ */
+    /* order run times for the percentiles */
+    const long long x = *(const long long*)a;
+    const long long y = *(const long long*)b;
+
+    return (x > y) - (x < y);
+} /* }}} */
+
+int bench_format(struct bench_data* data) { /* {{{ */
+    /* evaluate the task format for every task */
+    char*   line;
+    int     i;
+
+    data->bytes = 0;
+
+    for (i = 0; i < data->ntasks; i++) {
+        line = eval_format(cfg.formats.task_compiled, data->tasks[i]);
+        data->bytes += strlen(line) + 1;
+        free(line);
+    }
+
+    return data->ntasks;
+} /* }}} */
+
+char* bench_generate(const int ntasks, size_t* length) { /* {{{ */
+    /**
+     * generate an export of a synthetic task list
+     * ntasks - the number of tasks to generate
+     * length - set to the length of the export
+     * return is the export, which must be freed
+     */
+    const int   nwords = sizeof(bench_words) / sizeof(char*);
+    const int   nprojects = sizeof(bench_projects) / sizeof(char*);
+    const int   ntags = sizeof(bench_tags) / sizeof(char*);
+    const char* project;
+    const char* tags;
+    char*       buffer = NULL;
+    FILE*       fp;
+    time_t      stamp;
+    char        date[TIMELENGTH];
+    int         i;
+    int         w;
+
+    fp = open_memstream(&buffer, length);
+
+    if (fp == NULL) {
+        return NULL;
+    }
+
+    fputc('[', fp);
+
+    for (i = 0; i < ntasks; i++) {
+        project = bench_projects[bench_random() % nprojects];
+        tags = bench_tags[bench_random() % ntags];
+
+        fprintf(fp, "%s{\"id\":%d,\"description\":\"task %d", i > 0 ? ",\n" : "", i + 1, i);
+
+        for (w = bench_random() % 6; w >= 0; w--) {
+            fprintf(fp, " %s", bench_words[bench_random() % nwords]);
+        }
+
+        stamp = 1600000000 + bench_random() % 100000000;
+        strftime(date, sizeof(date), "%Y%m%dT%H%M%SZ", gmtime(&stamp));
+        fprintf(fp, "\",\"entry\":\"%s\",\"modified\":\"%s\",\"status\":\"pending\","
+                "\"uuid\":\"%08x-%04x-%04x-%04x-%08x%04x\"", date, date, bench_random(),
+                bench_random() & 0xffff, bench_random() & 0xffff, bench_random() & 0xffff,
+                bench_random(), bench_random() & 0xffff);
+
+        if (project != NULL) {
+            fprintf(fp, ",\"project\":\"%s\"", project);
+        }
+
+        if (bench_random() % 4 == 0) {
+            fprintf(fp, ",\"priority\":\"%c\"", "HML"[bench_random() % 3]);
+        }
+
+        if (bench_random() % 3 == 0) {
+            stamp += bench_random() % 10000000;
+            strftime(date, sizeof(date), "%Y%m%dT%H%M%SZ", gmtime(&stamp));
+            fprintf(fp, ",\"due\":\"%s\"", date);
+        }
+
+        if (tags != NULL) {
+            fprintf(fp, ",\"tags\":[\"%s\"]", tags);
+        }
+
+        if (bench_random() % 8 == 0) {
+            fprintf(fp, ",\"annotations\":[{\"entry\":\"%s\",\"description\":\"%s\"}]",
+                    date, bench_words[bench_random() % nwords]);
+        }
+
+        fputc('}', fp);
+    }
+
+    fputs("]\n", fp);
+    fclose(fp);
+
+    return buffer;
+} /* }}} */
+
+bool bench_load(struct bench_data* data, const char* args) { /* {{{ */
+    /**
+     * get the export the benchmarks run on, and parse it once
+     * data - the benchmark data to fill in
+     * args - the debug mode argument
+     * return is whether there were any tasks
+     */
+    const char*     opt = strstr(args, "bench=");
+    struct arena*   arena;
+    struct task*    cur;
+    char*           path = NULL;
+    FILE*           fp;
+    int             ntasks = BENCH_DEFAULT_TASKS;
+    int             swap;
+    int             i;
+    int             j;
+
+    /* an argument that is not a number is a captured export */
+    if (opt != NULL) {
+        opt += 6;
+
+        if (sscanf(opt, "%d", &ntasks) != 1 || ntasks <= 0) {
+            path = strndup(opt, strcspn(opt, " ,"));
+        }
+    }
+
+    if (path != NULL) {
+        fp = fopen(path, "r");
+
+        if (fp == NULL) {
+            printf("# bench: could not open %s\n", path);
+            free(path);
+            return false;
+        }
+
+        fseek(fp, 0, SEEK_END);
+        data->length = ftell(fp);
+        rewind(fp);
+        data->export = malloc(data->length + 1);
+        data->length = fread(data->export, 1, data->length, fp);
+        data->export[data->length] = 0;
+        fclose(fp);
+        free(path);
+    } else {
+        data->export = bench_generate(ntasks, &(data->length));
+    }
+
+    if (data->export == NULL) {
+        return false;
+    }
+
+    arena = arena_create(TASKARENABLOCKLENGTH);
+    cur = arena != NULL ? parse_tasks(data->export, data->length, arena) : NULL;
+
+    if (cur == NULL) {
+        arena_free(arena);
+        free(data->export);
+        data->export = NULL;
+        return false;
+    }
+
+    /* keep the tasks and a shuffled order of them */
+    for (data->ntasks = 0; cur->next != NULL; cur = cur->next, data->ntasks++);
+
+    data->ntasks++;
+    data->tasks = malloc(data->ntasks * sizeof(struct task*));
+    data->order = malloc(data->ntasks * sizeof(int));
+
+    for (i = data->ntasks - 1; cur != NULL; cur = cur->prev, i--) {
+        data->tasks[i] = cur;
+        data->order[i] = i;
+    }
+
+    for (i = data->ntasks - 1; i > 0; i--) {
+        j = bench_random() % (i + 1);
+        swap = data->order[i];
+        data->order[i] = data->order[j];
+        data->order[j] = swap;
+    }
+
+    return true;
+} /* }}} */
+
+int bench_lookup(struct bench_data* data) { /* {{{ */
+    /* look up every task by its position, in a random order */
+    int i;
+
+    for (i = 0; i < data->ntasks; i++) {
+        get_task_by_position(data->order[i]);
+    }
+
+    data->bytes = 0;
+
+    return data->ntasks;
+} /* }}} */
+
+int bench_lookup_uuid(struct bench_data* data) { /* {{{ */
+    /* look up every task by its uuid, in a random order */
+    int i;
+
+    for (i = 0; i < data->ntasks; i++) {
+        get_task_position_by_uuid(data->tasks[data->order[i]]->uuid);
+    }
+
+    data->bytes = 0;
+
+    return data->ntasks;
+} /* }}} */
+
+int bench_parse(struct bench_data* data) { /* {{{ */
+    /* parse the export into a new arena, as a reload does */
+    struct arena* arena = arena_create(TASKARENABLOCKLENGTH);
+    struct arena* child;
+
+    parse_tasks(data->export, data->length, arena);
+    data->bytes = arena->allocated;
+
+    /* large exports are parsed into an arena per thread */
+    for (child = arena->children; child != NULL; child = child->sibling) {
+        data->bytes += child->allocated;
+    }
+
+    arena_free(arena);
+
+    return data->ntasks;
+} /* }}} */
+
+unsigned int bench_random(void) { /* {{{ */
+    /* a small xorshift generator, so results do not depend on the libc */
+    bench_seed ^= bench_seed << 13;
+    bench_seed ^= bench_seed >> 17;
+    bench_seed ^= bench_seed << 5;
+
+    return bench_seed;
+} /* }}} */
+
+void bench_report(const struct bench* b, struct bench_data* data) { /* {{{ */
+    /**
+     * time a benchmark and print its results
+     * b    - the benchmark to run
+     * data - the task list it runs over
+     */
+    long long*  times = malloc(BENCH_MAX_RUNS * sizeof(long long));
+    long long   total = 0;
+    long long   start;
+    double      ops = 0;
+    int         runs;
+
+    if (times == NULL) {
+        return;
+    }
+
+    if (b->sortmode != NULL) {
+        cfg.sortmode = (char*)b->sortmode;
+    }
+
+    for (runs = 0; runs < BENCH_MAX_RUNS &&
+         (runs < BENCH_MIN_RUNS || total < BENCH_MIN_TIME); runs++) {
+        if (b->prepare != NULL) {
+            b->prepare(data);
+        }
+
+        start = bench_time();
+        ops += b->run(data);
+        times[runs] = bench_time() - start;
+        total += times[runs];
+    }
+
+    qsort(times, runs, sizeof(long long), bench_compare_times);
+    printf("%s\t%.0f\t%d\t%.0f\t%lld\t%lld\t%zu\n", b->name, ops / runs, runs,
+           total > 0 ? ops * 1e9 / total : 0, times[runs / 2],
+           times[(runs * 99) / 100], data->bytes);
+
+    free(times);
+} /* }}} */
+
+int bench_search(struct bench_data* data) { /* {{{ */
+    /* search every task for a word that often matches, and one that never does */
+    int i;
+
+    for (i = 0; i < data->ntasks; i++) {
+        task_match(data->tasks[i], "review");
+        task_match(data->tasks[i], "nomatch");
+    }
+
+    data->bytes = 0;
+
+    return 2 * data->ntasks;
+} /* }}} */
+
+int bench_search_next(struct bench_data* data) { /* {{{ */
+    /* find the next result after every task, in a random order, for a word
+     * that often matches and one that never does
+     */
+    bool    wrapped;
+    int     i;
+
+    for (i = 0; i < data->ntasks; i++) {
+        task_search(data->tasks[data->order[i]], "review", &wrapped);
+        task_search(data->tasks[data->order[i]], "nomatch", &wrapped);
+    }
+
+    data->bytes = 0;
+
+    return 2 * data->ntasks;
+} /* }}} */
+
+bool bench_setup_colors(struct bench_data* data) { /* {{{ */
+    /**
+     * start curses on a terminal that is never drawn to, so color rules work
+     * data   - the benchmark data to store the terminal in
+     * return is whether color rules could be added
+     */
+    int i;
+
+    data->term = fopen("/dev/null", "r+");
+
+    if (data->term == NULL ||
+        (data->screen = newterm("xterm", data->term, data->term)) == NULL) {
+        return false;
+    }
+
+    if (init_colors() != 0) {
+        endwin();
+        delscreen(data->screen);
+        data->screen = NULL;
+        return false;
+    }
+
+    for (i = 0; bench_color_rules[i] != NULL; i++) {
+        add_color_rule(OBJECT_TASK, bench_color_rules[i], i + 1, -1);
+    }
+
+    return true;
+} /* }}} */
+
+void bench_shuffle(struct bench_data* data) { /* {{{ */
+    /* relink the list in a random order, so every sort starts unsorted */
+    int i;
+
+    for (i = 0; i < data->ntasks; i++) {
+        data->tasks[data->order[i]]->prev = i > 0 ? data->tasks[data->order[i - 1]] : NULL;
+        data->tasks[data->order[i]]->next = i < data->ntasks - 1 ?
+                                            data->tasks[data->order[i + 1]] : NULL;
+    }
+
+    head = data->tasks[data->order[0]];
+} /* }}} */
+
+int bench_sort(struct bench_data* data) { /* {{{ */
+    /* sort the list under the benchmark's sort mode */
+    head = sort_wrapper(head);
+    data->bytes = 0;
+
+    return data->ntasks;
+} /* }}} */
+
+long long bench_time(void) { /* {{{ */
+    /* return a monotonic time in ns */
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+} /* }}} */
+
+#else
+void bench(const char* args) { /* {{{ */
+    strcmp(args, "bench");
+    puts("benchmarks not included at compile time");
+} /* }}} */
+
+#endif
+
+// vim: et ts=4 sw=4 sts=4
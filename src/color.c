@@ -13,6 +13,7 @@
 #include "color.h"
 #include "common.h"
 #include "log.h"
+#include "tags.h"
 #include "tasks.h"
 
 /**
@@ -27,16 +28,52 @@ struct color {
     short bg;
 };
 
+/* the conditions a color rule can test */
+enum rule_type {
+    RULE_SELECTED,
+    RULE_STARTED,
+    RULE_MARKED,
+    RULE_TAG,
+    RULE_PROJECT,
+    RULE_DESCRIPTION,
+    RULE_TAGS,
+    RULE_PRIORITY,
+    RULE_MALFORMED
+};
+
+/**
+ * rule node structure - one compiled condition of a color rule
+ * type     - the condition tested
+ * invert   - whether the result of the condition is inverted
+ * compiled - whether regex holds a compiled pattern
+ * regex    - the pattern matched by regex conditions
+ * literal  - the pattern, if it has no metacharacters and is matched as
+ *            text instead of compiled (NULL otherwise)
+ * tag      - the number of the tag a tag condition looks for
+ * next     - the next condition, all conditions must pass
+ */
+struct rule_node {
+    enum rule_type type;
+    bool invert;
+    bool compiled;
+    regex_t regex;
+    char* literal;
+    int tag;
+    struct rule_node* next;
+};
+
 /**
  * color rule structure
  * pair   - the color pair number to be passed to COLOR_PAIR
  * rule   - the string containing the rule to be evaluated
+ * nodes  - the rule compiled into a list of conditions
  * object - the type of item that is being colored
  * next   - the next color_rule struct
  */
 struct color_rule {
     short pair;
     char* rule;
+    struct rule_node* nodes;
     enum color_object object;
     struct color_rule* next;
 };
@@ -54,13 +91,17 @@ static short add_color_pair(const short askpair,
 
 int check_color(int color);
 
-static bool eval_rules(char* rule,
+static struct rule_node* compile_rule(const char* rule);
+
+static bool eval_rules(const struct rule_node* node,
                        const struct task*,
                        const bool selected);
 
 static short find_add_pair(const short fg,
                            const short bg);
 
+static void free_rule(struct rule_node* node);
+
 static int set_default_colors(void);
 
 short add_color_pair(short askpair, short fg, short bg) { /* {{{ */
@@ -167,8 +208,10 @@ short add_color_rule(const enum color_object object,
 
     if (rule != NULL) {
         this->rule = strdup(rule);
+        this->nodes = compile_rule(rule);
     } else {
         this->rule = NULL;
+        this->nodes = NULL;
     }
 
     this->object = object;
@@ -195,128 +238,195 @@ int check_color(int color) { /* {{{ */
     }
 } /* }}} */
 
-bool eval_rules(char* rule, const struct task* tsk, const bool selected) { /* {{{ */
+struct rule_node* compile_rule(const char* rule) { /* {{{ */
     /**
-     * evaluate a rule set for a task
-     * rule     - the rule to be evaluated
-     * tsk      - the task the rule will be evaluated on
-     * selected - whether the task is selected
+     * compile a rule string into a list of conditions
+     * rule   - the rule to be compiled
+     * return is the first condition, or NULL for a rule that always passes
      */
-    char*   regex = NULL;
-    char    pattern;
-    char*   tmp;
-    int     ret;
-    int     move;
-    bool    go = false;
-    bool    invert = false;
-
-    /* success if rules are done */
-    if (rule == NULL || *rule == 0) {
-        return true;
-    }
+    struct rule_node*   head = NULL;
+    struct rule_node*   last = NULL;
+    struct rule_node*   this;
+    const char*         pattern;
+    const char*         end;
+    char*               regex;
+    char                c;
+
+    while (*rule != 0) {
+        /* skip non-patterns */
+        if (*rule != '~') {
+            rule++;
+            continue;
+        }
 
-    /* skip non-patterns */
-    if (*rule != '~') {
-        return eval_rules(rule + 1, tsk, selected);
-    }
+        this = calloc(1, sizeof(struct rule_node));
+
+        if (last == NULL) {
+            head = this;
+        } else {
+            last->next = this;
+        }
 
-    /* regex match */
-    ret = sscanf(rule, "~%c '%m[^\']'", &pattern, &regex);
+        last = this;
 
-    if (ret > 0 && pattern >= 'A' && pattern <= 'Z') {
-        pattern += 32;
-        invert = true;
-    }
+        /* check for inverted order */
+        c = rule[1];
 
-    if (ret == 1) {
-        switch (pattern) {
-        case 's':
-            if (!XOR(invert, selected)) {
-                return false;
-            } else {
-                return eval_rules(rule + 2, tsk, selected);
+        if (c >= 'A' && c <= 'Z') {
+            c += 32;
+            this->invert = true;
+        }
+
+        /* find a quoted pattern */
+        pattern = c != 0 ? rule + 2 : rule + 1;
+
+        while (*pattern == ' ' || *pattern == '\t') {
+            pattern++;
+        }
+
+        if (*pattern == '\'' && pattern[1] != '\'') {
+            pattern++;
+            end = strchr(pattern, '\'');
+
+            if (end == NULL) {
+                end = pattern + strlen(pattern);
             }
+        } else {
+            pattern = NULL;
+            end = NULL;
+        }
+
+        /* conditions without a pattern */
+        if (pattern == NULL && (c == 's' || c == 't' || c == 'm')) {
+            this->type = c == 's' ? RULE_SELECTED : c == 't' ? RULE_STARTED : RULE_MARKED;
+            rule += 2;
+            continue;
+        }
 
+        switch (pattern != NULL ? c : 0) {
+        case 'p':
+            this->type = RULE_PROJECT;
+            break;
+
+        case 'd':
+            this->type = RULE_DESCRIPTION;
             break;
 
         case 't':
-            if (!XOR(invert, tsk->start > 0)) {
-                return false;
-            } else {
-                return eval_rules(rule + 2, tsk, selected);
-            }
+            this->type = tag_literal(pattern, end - pattern) ? RULE_TAG : RULE_TAGS;
+            break;
 
+        case 'r':
+            this->type = RULE_PRIORITY;
             break;
 
         default:
+            tnc_fprintf(logfp, LOG_ERROR, "malformed rules - \"%s\"", rule);
+            this->type = RULE_MALFORMED;
+            break;
+        }
+
+        if (this->type == RULE_MALFORMED) {
             break;
         }
+
+        /* a single tag is looked up in the task's tag set, not matched as text */
+        if (this->type == RULE_TAG) {
+            this->tag = tag_id(pattern, end - pattern, true);
+            rule = *end != 0 ? end + 1 : end;
+            continue;
+        }
+
+        /* plain text is matched as it is, anything else is compiled once and
+         * a pattern that does not compile never matches */
+        regex = strndup(pattern, end - pattern);
+        rule = *end != 0 ? end + 1 : end;
+
+        if (pattern_literal(regex)) {
+            this->literal = regex;
+            continue;
+        }
+
+        this->compiled = regcomp(&(this->regex), regex, REGEX_OPTS) == 0;
+
+        if (!this->compiled) {
+            tnc_fprintf(logfp, LOG_ERROR, "invalid regex in color rule - '%s'", regex);
+        }
+
+        free(regex);
     }
 
-    if (ret == 2) {
-        move = strlen(regex) + 3;
-        go = true;
+    return head;
+} /* }}} */
 
-        switch (pattern) {
-        case 'p':
-            if (!XOR(invert, match_string(tsk->project, regex))) {
-                return false;
-            } else {
-                tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "eval_rules: project match - '%s' '%s'",
-                            tsk->project, regex);
-            }
+bool eval_rules(const struct rule_node* node, const struct task* tsk,
+                const bool selected) { /* {{{ */
+    /**
+     * evaluate a rule set for a task
+     * node     - the first condition of the rule to be evaluated
+     * tsk      - the task the rule will be evaluated on
+     * selected - whether the task is selected
+     */
+    const char* field;
+    char        priority[2];
+    bool        match;
 
+    for (; node != NULL; node = node->next) {
+        field = NULL;
+
+        switch (node->type) {
+        case RULE_SELECTED:
+            match = selected;
             break;
 
-        case 'd':
-            if (!XOR(invert, match_string(tsk->description, regex))) {
-                return false;
-            } else {
-                tnc_fprintf(logfp, LOG_DEBUG_VERBOSE,
-                            "eval_rules: description match - '%s' '%s'", tsk->description, regex);
-            }
+        case RULE_STARTED:
+            match = tsk->start > 0;
+            break;
 
+        case RULE_MARKED:
+            match = tsk->marked;
             break;
 
-        case 't':
-            if (!XOR(invert, match_string(tsk->tags, regex))) {
-                return false;
-            } else {
-                tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "eval_rules: tag match - '%s' '%s'",
-                            tsk->tags, regex);
-            }
+        case RULE_TAG:
+            match = tag_test(tsk, node->tag);
+            break;
 
+        case RULE_PROJECT:
+            field = tsk->project;
             break;
 
-        case 'r':
-            tmp = calloc(2, sizeof(char));
-            *tmp = tsk->priority;
-
-            if (!XOR(invert, match_string(tmp, regex))) {
-                return false;
-            } else {
-                tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "eval_rules: priority match - '%s' '%s'",
-                            tmp, regex);
-            }
+        case RULE_DESCRIPTION:
+            field = tsk->description;
+            break;
 
-            free(tmp);
+        case RULE_TAGS:
+            field = tsk->tags;
             break;
 
-        default:
-            go = false;
+        case RULE_PRIORITY:
+            priority[0] = tsk->priority;
+            priority[1] = 0;
+            field = priority;
             break;
+
+        case RULE_MALFORMED:
+        default:
+            return false;
         }
 
-        free(regex);
+        if (node->type >= RULE_PROJECT && node->literal != NULL) {
+            match = field != NULL && str_casefind(field, node->literal, strlen(node->literal));
+        } else if (node->type >= RULE_PROJECT) {
+            match = field != NULL && node->compiled &&
+                    regexec(&(node->regex), field, 0, 0, 0) != REG_NOMATCH;
+        }
 
-        if (go) {
-            return eval_rules(rule + move, tsk, selected);
+        if (!XOR(node->invert, match)) {
+            return false;
         }
     }
 
-    /* should never get here */
-    tnc_fprintf(logfp, LOG_ERROR, "malformed rules - \"%s\"", rule);
-    return false;
+    return true;
 } /* }}} */
 
 short find_add_pair(const short fg, const short bg) { /* {{{ */
@@ -365,10 +475,28 @@ void free_colors(void) { /* {{{ */
         last = this;
         this = this->next;
         check_free(last->rule);
+        free_rule(last->nodes);
         free(last);
     }
 } /* }}} */
 
+void free_rule(struct rule_node* node) { /* {{{ */
+    /* free a compiled color rule */
+    struct rule_node* next;
+
+    while (node != NULL) {
+        next = node->next;
+
+        if (node->compiled) {
+            regfree(&(node->regex));
+        }
+
+        check_free(node->literal);
+        free(node);
+        node = next;
+    }
+} /* }}} */
+
 int get_colors(const enum color_object object,
                struct task* tsk,
                const bool selected) { /* {{{ */
@@ -409,7 +537,7 @@ int get_colors(const enum color_object object,
                 break;
 
             case OBJECT_TASK:
-                if (eval_rules(rule->rule, tsk, selected)) {
+                if (eval_rules(rule->nodes, tsk, selected)) {
                     pair = rule->pair;
                 }
 
@@ -545,7 +673,9 @@ int set_default_colors(void) { /* {{{ */
     /* create initial color rules */
     add_color_rule(OBJECT_HEADER, NULL, COLOR_BLUE, COLOR_BLACK);
     add_color_rule(OBJECT_TASK, NULL, -1, -1);
+    add_color_rule(OBJECT_TASK, "~m", COLOR_YELLOW, -1);
     add_color_rule(OBJECT_TASK, "~s", COLOR_CYAN, COLOR_BLACK);
+    add_color_rule(OBJECT_TASK, "~s ~m", COLOR_YELLOW, COLOR_BLACK);
     add_color_rule(OBJECT_ERROR, NULL, COLOR_RED, -1);
 
     return 0;
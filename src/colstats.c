@@ -0,0 +1,135 @@
+/*
+ * colstats.c - display widths of the task list's columns
+ * for tasknc
+ * by mjheagle
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include "colstats.h"
+#include "common.h"
+#include "config.h"
+#include "log.h"
+#include "tags.h"
+
+/* local functions */
+static void count_tags(const struct task* this, const int delta);
+static void count_width(const enum column column, const char* field, const int delta);
+
+/* the statistics, they are updated by the task table as tasks are indexed,
+ * replaced and removed
+ */
+static struct column_stats      columns[COLUMN_COUNT];
+static int*                     tagcounts = NULL;
+static int                      ntagcounts = 0;
+
+void colstats_add(const struct task* this) { /* {{{ */
+    /* count a task added to the task list */
+    count_width(COLUMN_PROJECT, this->project, 1);
+    count_width(COLUMN_DESCRIPTION, this->description, 1);
+    count_tags(this, 1);
+} /* }}} */
+
+void colstats_clear(void) { /* {{{ */
+    /* forget every task counted */
+    free(tagcounts);
+    tagcounts = NULL;
+    ntagcounts = 0;
+    memset(columns, 0, sizeof(columns));
+} /* }}} */
+
+int colstats_max(const enum column column) { /* {{{ */
+    /* get the width of the widest field in a column, in screen columns */
+    return columns[column].max;
+} /* }}} */
+
+void colstats_remove(const struct task* this) { /* {{{ */
+    /* uncount a task removed from the task list */
+    count_width(COLUMN_PROJECT, this->project, -1);
+    count_width(COLUMN_DESCRIPTION, this->description, -1);
+    count_tags(this, -1);
+} /* }}} */
+
+int colstats_tag_count(const int tag) { /* {{{ */
+    /* get the number of tasks with a numbered tag */
+    return tag >= 0 && tag < ntagcounts ? tagcounts[tag] : 0;
+} /* }}} */
+
+void count_tags(const struct task* this, const int delta) { /* {{{ */
+    /**
+     * change the number of tasks with each of a task's tags
+     * this  - the task
+     * delta - the number of tasks added, negative when they are removed
+     */
+    int*    grown;
+    int     size;
+    int     word;
+    int     bit;
+    int     tag;
+
+    for (word = 0; word < this->tagwords; word++) {
+        for (bit = 0; bit < TAGWORDBITS && this->tagbits[word] >> bit != 0; bit++) {
+            if (((this->tagbits[word] >> bit) & 1) == 0) {
+                continue;
+            }
+
+            tag = word * TAGWORDBITS + bit;
+
+            if (tag >= ntagcounts && delta > 0) {
+                for (size = ntagcounts > 0 ? ntagcounts : COLSTATSSLOTS; size <= tag; size *= 2);
+
+                grown = realloc(tagcounts, size * sizeof(int));
+
+                if (grown == NULL) {
+                    tnc_fprintf(logfp, LOG_ERROR, "could not grow tag counts (%d tags)", size);
+                    return;
+                }
+
+                memset(grown + ntagcounts, 0, (size - ntagcounts) * sizeof(int));
+                tagcounts = grown;
+                ntagcounts = size;
+            }
+
+            if (tag >= ntagcounts || tagcounts[tag] < -delta) {
+                tnc_fprintf(logfp, LOG_ERROR, "tag counts out of date");
+                continue;
+            }
+
+            tagcounts[tag] += delta;
+        }
+    }
+} /* }}} */
+
+void count_width(const enum column column, const char* field, const int delta) { /* {{{ */
+    /**
+     * change the number of fields of a width in a column
+     * column - the column the field is in
+     * field  - the field's text (may be NULL)
+     * delta  - the number of fields added, negative when they are removed
+     */
+    struct column_stats*    stats = &columns[column];
+    int                     width = 0;
+
+    if (field != NULL) {
+        str_prefix(field, COLSTATSMAXWIDTH, &width);
+    }
+
+    if (delta < 0 && stats->histogram[width] < -delta) {
+        tnc_fprintf(logfp, LOG_ERROR, "column stats out of date");
+        return;
+    }
+
+    stats->histogram[width] += delta;
+
+    if (width > stats->max && delta > 0) {
+        stats->max = width;
+    }
+
+    /* the widest fields were removed, find the next widest */
+    while (stats->max > 0 && stats->histogram[stats->max] == 0) {
+        stats->max--;
+    }
+} /* }}} */
+
+// vim: et ts=4 sw=4 sts=4
@@ -11,6 +11,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include "color.h"
 #include "command.h"
 #include "common.h"
@@ -19,19 +20,74 @@
 #include "log.h"
 #include "statusbar.h"
 #include "tasknc.h"
+#include "timing.h"
+
+/**
+ * parsed command struct - a command line split into the command and its args
+ * command - the first word of the line
+ * args    - the rest of the line (NULL if there is none)
+ */
+struct parsed_command {
+    char* command;
+    char* args;
+};
+
+/**
+ * sourced file struct - the commands of a config file, parsed once and kept
+ * so that sourcing the file again need not read it
+ * path      - the path the file was sourced from
+ * mtime     - when the file was last modified
+ * ino       - the file's inode
+ * size      - the size of the file
+ * commands  - the commands, in the order they are run
+ * ncommands - the number of commands
+ * running   - the number of times the commands are being run, a file is not
+ *             parsed again over commands that are running
+ * next      - the next file sourced
+ */
+struct sourced_file {
+    char* path;
+    struct timespec mtime;
+    ino_t ino;
+    off_t size;
+    struct parsed_command* commands;
+    int ncommands;
+    int running;
+    struct sourced_file* next;
+};
 
 /* local functions */
-static void source_fp(const FILE* fp);
+static bool parse_command(const char* cmdstr, char** command, char** args);
+static void run_command(const char* command, char* args);
+static struct sourced_file* source_compile(FILE* fp);
+static void source_free(struct sourced_file* this);
+static void source_run(struct sourced_file* this);
+
+/* the files sourced so far */
+static struct sourced_file* sourced = NULL;
+
+void free_sourced(void) { /* {{{ */
+    /* forget the commands of every file sourced */
+    struct sourced_file* next;
+
+    while (sourced != NULL) {
+        next = sourced->next;
+        source_free(sourced);
+        sourced = next;
+    }
+} /* }}} */
 
 void handle_command(char* cmdstr) { /* {{{ */
     /* accept a command string, determine what action to take, and execute */
-    char*           command;
-    char*           args;
-    char*           modestr;
-    char*           pos;
-    struct funcmap* fmap;
-    enum prog_mode  mode;
-    int             ret = 0;
+    char* command;
+    char* args;
+    char* pos;
+
+    if (cmdstr == NULL) {
+        statusbar_message(cfg.statusbar_timeout, "failed to parse command");
+        tnc_fprintf(logfp, LOG_ERROR, "failed to parse command: no command given");
+        return;
+    }
 
     /* parse args */
     pos = strchr(cmdstr, '\n');
@@ -42,17 +98,47 @@ void handle_command(char* cmdstr) { /* {{{ */
 
     tnc_fprintf(logfp, LOG_DEBUG, "command received: %s", cmdstr);
 
-    if (cmdstr != NULL) {
-        ret = sscanf(cmdstr, "%ms %m[^\n]", &command, &args);
-    }
-
-    if (ret < 1) {
+    if (!parse_command(cmdstr, &command, &args)) {
         statusbar_message(cfg.statusbar_timeout, "failed to parse command");
-        tnc_fprintf(logfp, LOG_ERROR, "failed to parse command: [%d] (%s)", ret,
-                    cmdstr);
+        tnc_fprintf(logfp, LOG_ERROR, "failed to parse command: (%s)", cmdstr);
         return;
     }
 
+    run_command(command, args);
+    free(command);
+    free(args);
+} /* }}} */
+
+bool parse_command(const char* cmdstr, char** command, char** args) { /* {{{ */
+    /**
+     * split a command line into the command and its arguments
+     * cmdstr  - the line, which ends at its first newline
+     * command - set to the first word of the line
+     * args    - set to the rest of the line, or NULL if there is none
+     * return is whether the line held a command
+     */
+    int ret = 0;
+
+    *command = NULL;
+    *args = NULL;
+
+    if (cmdstr != NULL) {
+        ret = sscanf(cmdstr, "%ms %m[^\n]", command, args);
+    }
+
+    return ret >= 1;
+} /* }}} */
+
+void run_command(const char* command, char* args) { /* {{{ */
+    /**
+     * run a parsed command
+     * command - the command
+     * args    - its arguments (may be NULL), which the command may modify
+     */
+    char*           modestr;
+    struct funcmap* fmap;
+    enum prog_mode  mode;
+
     /* determine mode */
     if (pager != NULL) {
         modestr = "pager";
@@ -75,7 +161,7 @@ void handle_command(char* cmdstr) { /* {{{ */
 
     if (fmap != NULL) {
         (fmap->function)(str_trim(args));
-        goto cleanup;
+        return;
     }
 
     /* version: print version string */
@@ -100,9 +186,10 @@ void handle_command(char* cmdstr) { /* {{{ */
     else if (str_eq(command, "dump")) {
         struct task*    this = head;
         int             counter = 0;
+        char            uuid[UUIDLENGTH];
 
         while (this != NULL) {
-            tnc_fprintf(logfp, 0, "uuid: %s", this->uuid);
+            tnc_fprintf(logfp, 0, "uuid: %s", uuid_format(this->uuid, uuid));
             tnc_fprintf(logfp, 0, "description: %s", this->description);
             tnc_fprintf(logfp, 0, "project: %s", this->project);
             tnc_fprintf(logfp, 0, "tags: %s", this->tags);
@@ -122,13 +209,6 @@ void handle_command(char* cmdstr) { /* {{{ */
                           command);
         tnc_fprintf(logfp, LOG_ERROR, "error: command %s not found", command);
     }
-
-    goto cleanup;
-
-cleanup:
-    /* clean up */
-    free(command);
-    free(args);
 } /* }}} */
 
 void run_command_bind(char* args) { /* {{{ */
@@ -394,7 +474,8 @@ void run_command_set(char* args) { /* {{{ */
                     varname, value);
     }
 
-    /* acquire the value string and print it */
+    /* acquire the value string and print it, with the timers up to date */
+    timing_refresh();
     message = var_value_message(this_var, 1);
     statusbar_message(cfg.statusbar_timeout, message);
 
@@ -439,7 +520,8 @@ void run_command_show(const char* arg) { /* {{{ */
         goto cleanup;
     }
 
-    /* acquire the value string and print it */
+    /* acquire the value string and print it, with the timers up to date */
+    timing_refresh();
     message = var_value_message(this_var, 1);
     statusbar_message(cfg.statusbar_timeout, message);
 
@@ -449,12 +531,34 @@ cleanup:
 } /* }}} */
 
 void run_command_source(const char* filepath) { /* {{{ */
-    /* run the commands contained in a config file */
-    FILE* config = NULL;
+    /**
+     * run the commands contained in a config file
+     * a file sourced before is only read again if it has changed since
+     */
+    struct sourced_file*    this;
+    struct sourced_file**   link;
+    struct stat             st;
+    FILE*                   config = NULL;
 
-    config = fopen(filepath, "r");
     tnc_fprintf(logfp, LOG_DEBUG, "source: file \"%s\"", filepath);
 
+    /* look for the commands parsed when the file was last sourced */
+    for (link = &sourced; *link != NULL && !str_eq((*link)->path, filepath);
+         link = &((*link)->next));
+
+    this = *link;
+
+    if (this != NULL && stat(filepath, &st) == 0 && this->size == st.st_size &&
+        this->ino == st.st_ino && this->mtime.tv_sec == st.st_mtim.tv_sec &&
+        this->mtime.tv_nsec == st.st_mtim.tv_nsec) {
+        tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "source: %d commands already parsed",
+                    this->ncommands);
+        source_run(this);
+        goto done;
+    }
+
+    config = fopen(filepath, "r");
+
     /* check for a valid fd */
     if (config == NULL) {
         tnc_fprintf(logfp, LOG_ERROR, "source: file \"%s\" could not be opened",
@@ -464,37 +568,75 @@ void run_command_source(const char* filepath) { /* {{{ */
         return;
     }
 
+    /* forget what the file held before, unless those commands are running */
+    if (this != NULL && this->running == 0) {
+        *link = this->next;
+        source_free(this);
+    }
+
     /* read config file */
-    source_fp(config);
+    this = source_compile(config);
+
+    if (this != NULL && fstat(fileno(config), &st) == 0 &&
+        (this->path = strdup(filepath)) != NULL) {
+        this->mtime = st.st_mtim;
+        this->ino = st.st_ino;
+        this->size = st.st_size;
+        this->next = sourced;
+        sourced = this;
+    }
 
     /* close config file */
     fclose(config);
+
+    if (this != NULL) {
+        source_run(this);
+
+        if (this->path == NULL) {
+            source_free(this);
+        }
+    }
+
+done:
     tnc_fprintf(logfp, LOG_DEBUG, "source complete: \"%s\"", filepath);
     statusbar_message(cfg.statusbar_timeout, "source complete: \"%s\"", filepath);
 } /* }}} */
 
 void run_command_source_cmd(const char* cmdstr) { /* {{{ */
-    /* run commands generated by a command */
-    FILE* cmd = popen(cmdstr, "r");
+    /* run commands generated by a command, which are read every time */
+    struct sourced_file*    commands;
+    FILE*                   cmd;
+
+    if (cmdstr == NULL) {
+        tnc_fprintf(logfp, LOG_ERROR, "source: no command given");
+        statusbar_message(cfg.statusbar_timeout, "source: no command given");
+        return;
+    }
 
     tnc_fprintf(logfp, LOG_DEBUG, "source: command \"%s\"", cmdstr);
 
     /* check for a valid fd */
-    if (cmdstr == NULL) {
-        tnc_fprintf(logfp, LOG_ERROR, "source: file \"%s\" could not be opened",
+    cmd = popen(cmdstr, "r");
+
+    if (cmd == NULL) {
+        tnc_fprintf(logfp, LOG_ERROR, "source: command \"%s\" could not be opened",
                     cmdstr);
         statusbar_message(cfg.statusbar_timeout,
                           "source: command \"%s\" could not be opened", cmdstr);
         return;
     }
 
-
     /* exit window */
     def_prog_mode();
     endwin();
 
     /* read command file */
-    source_fp(cmd);
+    commands = source_compile(cmd);
+
+    if (commands != NULL) {
+        source_run(commands);
+        source_free(commands);
+    }
 
     /* force redraw */
     reset_prog_mode();
@@ -506,37 +648,96 @@ void run_command_source_cmd(const char* cmdstr) { /* {{{ */
     statusbar_message(cfg.statusbar_timeout, "source complete: \"%s\"", cmdstr);
 } /* }}} */
 
-void source_fp(const FILE* fp) { /* {{{ */
-    /* given an open file handle, run the commands read from it */
-    char* line;
+struct sourced_file* source_compile(FILE* fp) { /* {{{ */
+    /**
+     * parse the commands read from an open file handle
+     * fp     - the file to read
+     * return is the commands, or NULL if they could not be stored
+     */
+    struct sourced_file*    this = calloc(1, sizeof(struct sourced_file));
+    struct parsed_command*  grown;
+    int                     capacity = 0;
+    char*                   line;
+
+    if (this == NULL) {
+        return NULL;
+    }
 
     /* read file */
     line = calloc(TOTALLENGTH, sizeof(char));
 
-    while (fgets(line, TOTALLENGTH, (FILE*)fp)) {
-        char* val;
-
+    while (line != NULL && fgets(line, TOTALLENGTH, fp)) {
         /* discard comment lines or blank lines */
         if (line[0] == '#' || line[0] == '\n') {
             continue;
         }
 
-        /* handle comments that are mid-line */
-        if ((val = strchr(line, '#'))) {
-            * val = '\0';
+        /* lines with a comment after the command are not run */
+        if (strchr(line, '#') != NULL) {
+            continue;
+        }
+
+        tnc_fprintf(logfp, LOG_DEBUG, "command received: %s", line);
+
+        if (this->ncommands == capacity) {
+            capacity = capacity > 0 ? 2 * capacity : 16;
+            grown = realloc(this->commands, capacity * sizeof(struct parsed_command));
+
+            if (grown == NULL) {
+                tnc_fprintf(logfp, LOG_ERROR, "source: could not store %d commands", capacity);
+                break;
+            }
+
+            this->commands = grown;
         }
 
         /* handle commands */
-        else {
-            handle_command(line);
+        if (!parse_command(line, &(this->commands[this->ncommands].command),
+                           &(this->commands[this->ncommands].args))) {
+            statusbar_message(cfg.statusbar_timeout, "failed to parse command");
+            tnc_fprintf(logfp, LOG_ERROR, "failed to parse command: (%s)", line);
+            continue;
         }
 
-        /* get memory for a new line */
-        free(line);
-        line = calloc(TOTALLENGTH, sizeof(char));
+        this->ncommands++;
     }
 
     free(line);
+
+    return this;
+} /* }}} */
+
+void source_free(struct sourced_file* this) { /* {{{ */
+    /* free the commands parsed from a file */
+    int i;
+
+    for (i = 0; i < this->ncommands; i++) {
+        free(this->commands[i].command);
+        free(this->commands[i].args);
+    }
+
+    free(this->commands);
+    free(this->path);
+    free(this);
+} /* }}} */
+
+void source_run(struct sourced_file* this) { /* {{{ */
+    /**
+     * run the commands parsed from a file
+     * each command is given a copy of its arguments, which it may modify
+     */
+    char*   args;
+    int     i;
+
+    this->running++;
+
+    for (i = 0; i < this->ncommands; i++) {
+        args = this->commands[i].args != NULL ? strdup(this->commands[i].args) : NULL;
+        run_command(this->commands[i].command, args);
+        free(args);
+    }
+
+    this->running--;
 } /* }}} */
 
 void strip_quotes(char** strptr, bool needsfree) { /* {{{ */
@@ -10,61 +10,423 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <wchar.h>
 #include "common.h"
 #include "config.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * regex cache entry struct - a compiled pattern
+ * pattern - the pattern that was compiled (NULL for an unused entry)
+ * flags   - the flags the pattern was compiled with
+ * valid   - whether the pattern compiled successfully
+ * used    - when this entry was last looked up
+ * regex   - the compiled pattern
+ */
+struct regex_cache_entry {
+    char* pattern;
+    int flags;
+    bool valid;
+    unsigned long used;
+    regex_t regex;
+};
+
+/**
+ * today struct - the current local date, refreshed once per frame
+ * year       - the current year, as counted in struct tm
+ * date       - today formatted as by format_date
+ * rollover   - the next local midnight, when the above go stale
+ * generation - bumped every time the above change, 0 before they are set
+ */
+static struct {
+    int year;
+    char date[TIMELENGTH];
+    time_t rollover;
+    unsigned int generation;
+} today;
+
 /* externs */
 extern int selline;
 
+/* local functions */
+static inline char fold_char(const char c);
+#ifdef __SSE2__
+static inline __m128i fold_block(const __m128i block);
+#endif
+
+/* compiled patterns, least recently used are replaced first */
+static struct regex_cache_entry regex_cache[REGEXCACHESIZE];
+static unsigned long regex_clock = 0;
+static int regex_last = 0;
+
+char fold_char(const char c) { /* {{{ */
+    /* lowercase an ascii letter, leaving every other byte alone */
+    return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+} /* }}} */
+
+#ifdef __SSE2__
+__m128i fold_block(const __m128i block) { /* {{{ */
+    /* lowercase the ascii letters in 16 bytes
+     * bytes past 0x7f compare as negative, so they are never taken as letters
+     */
+    const __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8('A' - 1)),
+                                        _mm_cmplt_epi8(block, _mm_set1_epi8('Z' + 1)));
+
+    return _mm_or_si128(block, _mm_and_si128(upper, _mm_set1_epi8('a' - 'A')));
+} /* }}} */
+#endif
+
+void format_date(char* buffer, const time_t timeint) { /* {{{ */
+    /* format a date, leaving out the year when it is the current one
+     * buffer  - the string to write the date to, TIMELENGTH long
+     * timeint - the time to format (0 for today)
+     */
+    struct tm tmr;
+
+    if (today.generation == 0) {
+        refresh_today();
+    }
+
+    if (timeint == 0) {
+        memcpy(buffer, today.date, TIMELENGTH);
+        return;
+    }
+
+    localtime_r(&timeint, &tmr);
+
+    if (tmr.tm_year != today.year) {
+        strftime(buffer, TIMELENGTH, "%F", &tmr);
+    } else {
+        strftime(buffer, TIMELENGTH, "%b %d", &tmr);
+    }
+} /* }}} */
+
 bool match_string(const char* haystack, const char* needle) { /* {{{ */
     /* find the regex needle in a haystack */
-    regex_t regex;
-    bool    ret;
+    const regex_t* regex;
 
     /* check for NULL haystack or needle */
     if (haystack == NULL || needle == NULL) {
         return false;
     }
 
+    /* a plain word needs no regex */
+    if (pattern_literal(needle)) {
+        return str_casefind(haystack, needle, strlen(needle));
+    }
+
     /* compile regex */
-    if (regcomp(&regex, needle, REGEX_OPTS) != 0) {
+    regex = regex_cached(needle, REGEX_OPTS);
+
+    if (regex == NULL) {
         return false;
     }
 
     /* run regex */
-    if (regexec(&regex, haystack, 0, 0, 0) != REG_NOMATCH) {
-        ret = true;
-    } else {
-        ret = false;
+    return regexec(regex, haystack, 0, 0, 0) != REG_NOMATCH;
+} /* }}} */
+
+bool parse_timestamp(const char* str, const size_t length, time_t* timeint) { /* {{{ */
+    /* parse a taskwarrior timestamp (YYYYMMDDTHHMMSSZ) without going through
+     * the timezone database
+     * str     - the timestamp, it need not be terminated
+     * length  - the length of the timestamp
+     * timeint - where the time parsed is stored
+     * return is whether str was in the expected format
+     */
+    int         fields[6];
+    const int   offsets[] = {0, 4, 6, 9, 11, 13, 15};
+    int         f, i, year, month, era, yoe, doy;
+    long        days;
+
+    if (length != 16 || str[8] != 'T' || str[15] != 'Z') {
+        return false;
+    }
+
+    /* the fields are fixed width, the 'T' sits between day and hour */
+    for (f = 0; f < 6; f++) {
+        fields[f] = 0;
+
+        for (i = offsets[f]; i < offsets[f + 1] - (f == 2 ? 1 : 0); i++) {
+            if (str[i] < '0' || str[i] > '9') {
+                return false;
+            }
+
+            fields[f] = fields[f] * 10 + str[i] - '0';
+        }
     }
 
-    regfree(&regex);
-    return ret;
+    if (fields[1] < 1 || fields[1] > 12 || fields[2] < 1 || fields[2] > 31 ||
+            fields[3] > 23 || fields[4] > 59 || fields[5] > 60) {
+        return false;
+    }
+
+    /* days since the epoch of the civil date, with march as the first month
+     * so that the leap day falls at the end of the year */
+    year = fields[0] - (fields[1] <= 2 ? 1 : 0);
+    month = fields[1] + (fields[1] > 2 ? -3 : 9);
+    era = year / 400;
+    yoe = year - era * 400;
+    doy = (153 * month + 2) / 5 + fields[2] - 1;
+    days = (long)era * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy - 719468;
+
+    *timeint = (time_t)days * 86400 + fields[3] * 3600 + fields[4] * 60 + fields[5];
+
+    return true;
 } /* }}} */
 
-char* utc_date(const time_t timeint) { /* {{{ */
-    /* convert a utc time uint to a string */
-    struct tm*  tmr;
-    struct tm*  now;
-    time_t      cur;
-    char*       timestr;
+bool pattern_literal(const char* pattern) { /* {{{ */
+    /**
+     * check whether a pattern has no regex metacharacters, so that it matches
+     * the same as plain text compared ignoring case
+     * only ascii is folded by str_casefind, other patterns are left to regex
+     */
+    const unsigned char* pos;
 
-    /* get current time */
-    time(&cur);
-    now = localtime(&cur);
+    for (pos = (const unsigned char*)pattern; *pos != 0; pos++) {
+        if (*pos < ' ' || *pos > '~' || strchr(".[]()*+?{}|^$\\", *pos) != NULL) {
+            return false;
+        }
+    }
 
-    /* set time to either now or the specified time */
-    tmr = timeint == 0  ?  now : localtime(&timeint);
+    return true;
+} /* }}} */
 
-    /* convert thte time to a formatted string */
-    timestr = malloc(TIMELENGTH * sizeof(char));
+void refresh_today(void) { /* {{{ */
+    /* recompute the current date if the day has changed since it was last
+     * computed, this is called once per frame rather than per date printed
+     */
+    struct tm   tmr;
+    time_t      now = time(NULL);
 
-    if (now->tm_year != tmr->tm_year) {
-        strftime(timestr, TIMELENGTH, "%F", tmr);
-    } else {
-        strftime(timestr, TIMELENGTH, "%b %d", tmr);
+    if (today.generation != 0 && now < today.rollover) {
+        return;
+    }
+
+    localtime_r(&now, &tmr);
+    today.year = tmr.tm_year;
+    strftime(today.date, TIMELENGTH, "%b %d", &tmr);
+
+    /* find the next midnight */
+    tmr.tm_sec = 0;
+    tmr.tm_min = 0;
+    tmr.tm_hour = 0;
+    tmr.tm_mday++;
+    tmr.tm_isdst = -1;
+    today.rollover = mktime(&tmr);
+
+    /* 0 is reserved for a date that was never computed */
+    today.generation++;
+
+    if (today.generation == 0) {
+        today.generation = 1;
+    }
+} /* }}} */
+
+const regex_t* regex_cached(const char* pattern, const int flags) { /* {{{ */
+    /**
+     * get a compiled regex from the cache, compiling it if necessary
+     * pattern - the pattern to compile
+     * flags   - the flags to pass to regcomp
+     * return is the compiled pattern, which is owned by the cache and is
+     * only valid until the next lookup, or NULL if it does not compile
+     */
+    struct regex_cache_entry*   entry = &(regex_cache[regex_last]);
+    int                         i;
+
+    regex_clock++;
+
+    /* the same pattern is usually looked up many times in a row */
+    if (entry->pattern == NULL || entry->flags != flags ||
+        !str_eq(entry->pattern, pattern)) {
+        entry = NULL;
+
+        for (i = 0; i < REGEXCACHESIZE; i++) {
+            if (regex_cache[i].pattern != NULL && regex_cache[i].flags == flags &&
+                str_eq(regex_cache[i].pattern, pattern)) {
+                entry = &(regex_cache[i]);
+                break;
+            }
+        }
+    }
+
+    /* replace the least recently used entry */
+    if (entry == NULL) {
+        entry = &(regex_cache[0]);
+
+        for (i = 0; i < REGEXCACHESIZE && entry->pattern != NULL; i++) {
+            if (regex_cache[i].pattern == NULL || regex_cache[i].used < entry->used) {
+                entry = &(regex_cache[i]);
+            }
+        }
+
+        if (entry->pattern != NULL) {
+            free(entry->pattern);
+
+            if (entry->valid) {
+                regfree(&(entry->regex));
+            }
+        }
+
+        entry->pattern = strdup(pattern);
+        entry->flags = flags;
+        entry->valid = regcomp(&(entry->regex), pattern, flags) == 0;
+    }
+
+    entry->used = regex_clock;
+    regex_last = entry - regex_cache;
+
+    return entry->valid ? &(entry->regex) : NULL;
+} /* }}} */
+
+void regex_cache_free(void) { /* {{{ */
+    /* free every pattern in the regex cache */
+    int i;
+
+    for (i = 0; i < REGEXCACHESIZE; i++) {
+        if (regex_cache[i].pattern != NULL) {
+            free(regex_cache[i].pattern);
+
+            if (regex_cache[i].valid) {
+                regfree(&(regex_cache[i].regex));
+            }
+
+            regex_cache[i].pattern = NULL;
+        }
+    }
+} /* }}} */
+
+bool str_casefind(const char* haystack, const char* needle, const size_t length) { /* {{{ */
+    /**
+     * find a string in another, ignoring the case of ascii letters
+     * haystack - the string searched
+     * needle   - the string to find
+     * length   - the length of needle
+     * return is whether needle was found
+     * the places where needle's first and last characters both appear are
+     * found 16 at a time where sse2 is available, only those are compared
+     */
+    const size_t    hlength = strlen(haystack);
+    const char      first = fold_char(needle[0]);
+    const char      last = length > 0 ? fold_char(needle[length - 1]) : 0;
+    const char*     candidate;
+    size_t          i = 0;
+    size_t          j;
+#ifdef __SSE2__
+    const __m128i   firsts = _mm_set1_epi8(first);
+    const __m128i   lasts = _mm_set1_epi8(last);
+    __m128i         starts;
+    __m128i         ends;
+    unsigned int    mask;
+#endif
+
+    if (length == 0) {
+        return true;
     }
 
+    if (length > hlength) {
+        return false;
+    }
+
+#ifdef __SSE2__
+    for (; i + length - 1 + 16 <= hlength; i += 16) {
+        starts = fold_block(_mm_loadu_si128((const __m128i*)(haystack + i)));
+        ends = fold_block(_mm_loadu_si128((const __m128i*)(haystack + i + length - 1)));
+        mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(starts, firsts),
+                                               _mm_cmpeq_epi8(ends, lasts)));
+
+        for (; mask != 0; mask &= mask - 1) {
+            candidate = haystack + i + __builtin_ctz(mask);
+
+            for (j = 1; j + 1 < length && fold_char(candidate[j]) == fold_char(needle[j]); j++);
+
+            if (j + 1 >= length) {
+                return true;
+            }
+        }
+    }
+#endif
+
+    /* the rest of the haystack, or all of it without sse2 */
+    for (; i + length <= hlength; i++) {
+        candidate = haystack + i;
+
+        if (fold_char(candidate[0]) != first || fold_char(candidate[length - 1]) != last) {
+            continue;
+        }
+
+        for (j = 1; j + 1 < length && fold_char(candidate[j]) == fold_char(needle[j]); j++);
+
+        if (j + 1 >= length) {
+            return true;
+        }
+    }
+
+    return false;
+} /* }}} */
+
+size_t str_prefix(const char* str, const int width, int* used) { /* {{{ */
+    /* find the longest prefix of a string that fits in a number of screen
+     * columns, measuring wide characters as the terminal draws them
+     * str   - the string to measure
+     * width - the number of columns available
+     * used  - where the width of the prefix is stored
+     * return is the length of the prefix in bytes
+     */
+    mbstate_t   state;
+    wchar_t     wc;
+    size_t      len = strlen(str);
+    size_t      pos = 0;
+    size_t      n;
+    int         w;
+
+    memset(&state, 0, sizeof(state));
+    *used = 0;
+
+    while (pos < len) {
+        n = mbrtowc(&wc, str + pos, len - pos, &state);
+
+        /* a byte that is not valid in the locale takes a column */
+        if (n == (size_t) -1 || n == (size_t) -2 || n == 0) {
+            memset(&state, 0, sizeof(state));
+            n = 1;
+            w = 1;
+        } else {
+            w = wcwidth(wc);
+            w = w < 0 ? 1 : w;
+        }
+
+        if (*used + w > width) {
+            break;
+        }
+
+        *used += w;
+        pos += n;
+    }
+
+    return pos;
+} /* }}} */
+
+unsigned int today_generation(void) { /* {{{ */
+    /* get the generation of the current date, dates formatted in an older
+     * generation may have gone stale
+     */
+    if (today.generation == 0) {
+        refresh_today();
+    }
+
+    return today.generation;
+} /* }}} */
+
+char* utc_date(const time_t timeint) { /* {{{ */
+    /* convert a utc time uint to a string */
+    char* timestr = malloc(TIMELENGTH * sizeof(char));
+
+    format_date(timestr, timeint);
+
     return timestr;
 } /* }}} */
 
@@ -89,6 +451,92 @@ char* utc_time(const time_t timeint) { /* {{{ */
     return timestr;
 } /* }}} */
 
+bool uuid_empty(const unsigned char* uuid) { /* {{{ */
+    /* check whether a uuid was never set (taskwarrior never uses the nil uuid) */
+    int i;
+
+    for (i = 0; i < UUIDBYTES; i++) {
+        if (uuid[i] != 0) {
+            return false;
+        }
+    }
+
+    return true;
+} /* }}} */
+
+char* uuid_format(const unsigned char* uuid, char* str) { /* {{{ */
+    /* format a uuid as taskwarrior writes it
+     * uuid - the uuid to format, UUIDBYTES long
+     * str  - the string to write the uuid to, UUIDLENGTH long
+     * return is str
+     */
+    const char* hex = "0123456789abcdef";
+    char*       pos = str;
+    int         i;
+
+    for (i = 0; i < UUIDBYTES; i++) {
+        if (i == 4 || i == 6 || i == 8 || i == 10) {
+            *(pos++) = '-';
+        }
+
+        *(pos++) = hex[uuid[i] >> 4];
+        *(pos++) = hex[uuid[i] & 0xf];
+    }
+
+    *pos = 0;
+
+    return str;
+} /* }}} */
+
+bool uuid_parse(const char* str, const size_t length, unsigned char* uuid) { /* {{{ */
+    /* parse a uuid in its canonical form (8-4-4-4-12 hex digits)
+     * str    - the uuid, it need not be terminated
+     * length - the length of the uuid
+     * uuid   - where the uuid parsed is stored, UUIDBYTES long
+     * return is whether str was a uuid, uuid is unchanged if it was not
+     */
+    unsigned char   bytes[UUIDBYTES];
+    int             nibbles = 0;
+    int             digit;
+    size_t          i;
+
+    if (length != 36) {
+        return false;
+    }
+
+    for (i = 0; i < length; i++) {
+        if (i == 8 || i == 13 || i == 18 || i == 23) {
+            if (str[i] != '-') {
+                return false;
+            }
+
+            continue;
+        }
+
+        if (str[i] >= '0' && str[i] <= '9') {
+            digit = str[i] - '0';
+        } else if (str[i] >= 'a' && str[i] <= 'f') {
+            digit = str[i] - 'a' + 10;
+        } else if (str[i] >= 'A' && str[i] <= 'F') {
+            digit = str[i] - 'A' + 10;
+        } else {
+            return false;
+        }
+
+        if (nibbles % 2 == 0) {
+            bytes[nibbles / 2] = digit << 4;
+        } else {
+            bytes[nibbles / 2] |= digit;
+        }
+
+        nibbles++;
+    }
+
+    memcpy(uuid, bytes, UUIDBYTES);
+
+    return true;
+} /* }}} */
+
 char* var_value_message(struct var* v, bool printname) { /* {{{ */
     /* format a message containing the name and value of a variable */
     char* message;
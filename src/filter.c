@@ -0,0 +1,626 @@
+/*
+ * filter.c - evaluate common taskwarrior filters on the loaded tasks
+ * for tasknc
+ * by mjheagle
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "common.h"
+#include "config.h"
+#include "filter.h"
+#include "log.h"
+#include "tags.h"
+
+/**
+ * filter token struct - a word of a filter, parentheses are words of their own
+ * start  - the first character of the word
+ * length - the number of characters in the word
+ */
+struct filter_token {
+    const char* start;
+    size_t length;
+};
+
+/**
+ * filter parser struct - the state of a filter being compiled
+ * tokens  - the words of the filter
+ * ntokens - the number of words
+ * next    - the word to parse next
+ * filter  - the filter the program is written to
+ * depth   - the depth of the evaluation stack after the program so far
+ * failed  - whether part of the filter could not be compiled
+ */
+struct filter_parser {
+    const struct filter_token* tokens;
+    int ntokens;
+    int next;
+    struct filter* filter;
+    int depth;
+    bool failed;
+};
+
+/* compare a token with a literal */
+#define TOKEN_IS(token, lit)            ((token)->length == sizeof(lit) - 1 && \
+                                         memcmp((token)->start, (lit), (token)->length) == 0)
+
+/* local functions */
+static bool attribute_is(const char* name, const size_t length, const char* attribute);
+static int filter_conjuncts(const struct filter_token* tokens, const int ntokens, int* groups);
+static bool filter_date(const char* value, const size_t length, time_t* when);
+static void filter_emit(struct filter_parser* parser, const enum filter_opcode code,
+                        const char* value, const size_t length, const time_t when);
+static bool filter_has_conjunct(const struct filter_token* tokens, const int* groups,
+                                const int ngroups, const struct filter_token* group,
+                                const int length);
+static const char* filter_status(const struct task* tsk);
+static int filter_tokenize(const char* str, struct filter_token* tokens);
+static void parse_and(struct filter_parser* parser);
+static void parse_factor(struct filter_parser* parser);
+static void parse_or(struct filter_parser* parser);
+static void parse_term(struct filter_parser* parser, const struct filter_token* token);
+
+bool attribute_is(const char* name, const size_t length, const char* attribute) { /* {{{ */
+    /**
+     * check whether a name is an attribute, or an abbreviation of it
+     * name      - the name, as written in the filter
+     * length    - the length of the name
+     * attribute - the full name of the attribute
+     * return is whether they match, abbreviations need three characters
+     */
+    return length >= 3 && length <= strlen(attribute) && memcmp(name, attribute, length) == 0;
+} /* }}} */
+
+struct filter* filter_compile(const char* str) { /* {{{ */
+    /**
+     * compile a filter to a program that can be run on loaded tasks
+     * str    - the filter, as it would be passed to task
+     * return is the compiled filter, or NULL if it uses anything that is not
+     *        understood, the tasks must then be filtered by task
+     * understood are project:, priority:, status:, due.before: and
+     * due.after: attributes (project: matches subprojects too), +tag and
+     * -tag, and terms joined with and, or and parentheses
+     */
+    struct filter_token     tokens[FILTERMAXTOKENS];
+    struct filter_parser    parser;
+    struct filter*          this;
+    const int               ntokens = str != NULL ? filter_tokenize(str, tokens) : -1;
+
+    if (ntokens < 0) {
+        return NULL;
+    }
+
+    this = calloc(1, sizeof(struct filter));
+
+    if (this == NULL) {
+        return NULL;
+    }
+
+    /* each term is one instruction, and each operator joins two terms */
+    this->ops = calloc(2 * ntokens + 1, sizeof(struct filter_op));
+
+    if (this->ops == NULL) {
+        free(this);
+        return NULL;
+    }
+
+    parser.tokens   = tokens;
+    parser.ntokens  = ntokens;
+    parser.next     = 0;
+    parser.filter   = this;
+    parser.depth    = 0;
+    parser.failed   = false;
+
+    if (ntokens > 0) {
+        parse_or(&parser);
+    }
+
+    if (parser.failed || parser.next != ntokens) {
+        tnc_fprintf(logfp, LOG_DEBUG, "filter not understood locally: %s", str);
+        filter_free(this);
+        return NULL;
+    }
+
+    return this;
+} /* }}} */
+
+int filter_conjuncts(const struct filter_token* tokens, const int ntokens, int* groups) { /* {{{ */
+    /**
+     * split a filter into the terms that must all match
+     * tokens  - the words of the filter
+     * ntokens - the number of words
+     * groups  - filled with the first word of each term and the word after it
+     * return is the number of terms, or -1 if the parentheses do not match
+     * a parenthesized group is one term, and a filter joined by or at its top
+     * level is a single term
+     */
+    int ngroups = 0;
+    int depth = 0;
+    int start;
+    int i;
+
+    for (i = 0; i < ntokens; i++) {
+        if (TOKEN_IS(&(tokens[i]), "(")) {
+            depth++;
+        } else if (TOKEN_IS(&(tokens[i]), ")") && --depth < 0) {
+            return -1;
+        } else if (depth == 0 && TOKEN_IS(&(tokens[i]), "or")) {
+            groups[0] = 0;
+            groups[1] = ntokens;
+            return ntokens > 0 ? 1 : 0;
+        }
+    }
+
+    if (depth != 0) {
+        return -1;
+    }
+
+    for (i = 0; i < ntokens; i++) {
+        if (TOKEN_IS(&(tokens[i]), "and")) {
+            continue;
+        }
+
+        start = i;
+
+        if (TOKEN_IS(&(tokens[i]), "(")) {
+            for (depth = 1; depth > 0 && ++i < ntokens;) {
+                depth += TOKEN_IS(&(tokens[i]), "(") ? 1 : TOKEN_IS(&(tokens[i]), ")") ? -1 : 0;
+            }
+        }
+
+        groups[2 * ngroups] = start;
+        groups[2 * ngroups + 1] = i + 1;
+        ngroups++;
+    }
+
+    return ngroups;
+} /* }}} */
+
+bool filter_covers(const char* wide, const char* narrow) { /* {{{ */
+    /**
+     * check whether the tasks matching a filter include every task matching
+     * another, because each term of the first is also a term of the second
+     * wide   - the filter whose tasks are loaded
+     * narrow - the filter that would be applied to them
+     * return is whether narrow only matches tasks that wide matches
+     * this compares the words of the filters and does not evaluate them, so
+     * some filters that are narrower are missed
+     */
+    struct filter_token wtokens[FILTERMAXTOKENS];
+    struct filter_token ntokens[FILTERMAXTOKENS];
+    int                 wgroups[2 * FILTERMAXTOKENS];
+    int                 ngroups[2 * FILTERMAXTOKENS];
+    int                 nwide;
+    int                 nnarrow;
+    int                 i;
+
+    if (wide == NULL || narrow == NULL ||
+        (nwide = filter_tokenize(wide, wtokens)) < 0 ||
+        (nnarrow = filter_tokenize(narrow, ntokens)) < 0 ||
+        (nwide = filter_conjuncts(wtokens, nwide, wgroups)) < 0 ||
+        (nnarrow = filter_conjuncts(ntokens, nnarrow, ngroups)) < 0) {
+        return false;
+    }
+
+    for (i = 0; i < nwide; i++) {
+        if (!filter_has_conjunct(ntokens, ngroups, nnarrow, wtokens + wgroups[2 * i],
+                                 wgroups[2 * i + 1] - wgroups[2 * i])) {
+            return false;
+        }
+    }
+
+    return true;
+} /* }}} */
+
+bool filter_date(const char* value, const size_t length, time_t* when) { /* {{{ */
+    /**
+     * read a date in a filter
+     * value  - the date, which is now, today, tomorrow, yesterday, an epoch,
+     *          YYYYMMDD or YYYY-MM-DD with an optional THH:MM[:SS]
+     * length - the length of the date
+     * when   - set to the date
+     * return is whether the date was understood
+     * dates without a time are midnight, local time
+     */
+    const time_t    now = time(NULL);
+    struct tm       tm;
+    char            str[32];
+    int             len;
+    int             n = 0;
+
+    if (length == 0 || length >= sizeof(str)) {
+        return false;
+    }
+
+    memcpy(str, value, length);
+    str[length] = 0;
+    localtime_r(&now, &tm);
+
+    if (str_eq(str, "now")) {
+        *when = now;
+        return true;
+    } else if (str_eq(str, "today") || str_eq(str, "tomorrow") || str_eq(str, "yesterday")) {
+        tm.tm_mday += str[0] == 't' && str[2] == 'm' ? 1 : str[0] == 'y' ? -1 : 0;
+        tm.tm_hour = tm.tm_min = tm.tm_sec = 0;
+    } else if (length != 8 && strspn(str, "0123456789") == length) {
+        *when = strtoll(str, NULL, 10);
+        return true;
+    } else {
+        tm.tm_hour = tm.tm_min = tm.tm_sec = 0;
+
+        if ((length == 8 && sscanf(str, "%4d%2d%2d%n", &tm.tm_year, &tm.tm_mon,
+                                   &tm.tm_mday, &n) != 3) ||
+            (length != 8 && sscanf(str, "%4d-%2d-%2d%n", &tm.tm_year, &tm.tm_mon,
+                                   &tm.tm_mday, &n) != 3)) {
+            return false;
+        }
+
+        if (str[n] == 'T' && sscanf(str + n, "T%2d:%2d%n", &tm.tm_hour, &tm.tm_min,
+                                    &len) == 2) {
+            n += len;
+
+            if (str[n] == ':' && sscanf(str + n, ":%2d%n", &tm.tm_sec, &len) == 1) {
+                n += len;
+            }
+        }
+
+        if ((size_t)n != length) {
+            return false;
+        }
+
+        tm.tm_year -= 1900;
+        tm.tm_mon--;
+    }
+
+    tm.tm_isdst = -1;
+    *when = mktime(&tm);
+
+    return *when != -1;
+} /* }}} */
+
+void filter_emit(struct filter_parser* parser, const enum filter_opcode code,
+                 const char* value, const size_t length, const time_t when) { /* {{{ */
+    /**
+     * add an instruction to the program of a filter
+     * parser - the filter being compiled
+     * code   - what the instruction does
+     * value  - the value compared with (NULL if there is none)
+     * length - the length of value
+     * when   - the date compared with
+     * the program is run on a stack of bits, so it may not grow too deep
+     */
+    struct filter_op* op = &(parser->filter->ops[parser->filter->nops++]);
+
+    op->code    = code;
+    op->length  = length;
+    op->when    = when;
+    op->value   = value != NULL ? strndup(value, length) : NULL;
+    op->tag     = code == FILTER_TAG || code == FILTER_NOT_TAG ? tag_id(value, length, true) : -1;
+
+    if ((value != NULL && op->value == NULL) ||
+        ((code == FILTER_TAG || code == FILTER_NOT_TAG) && op->tag < 0)) {
+        parser->failed = true;
+    }
+
+    parser->depth += code == FILTER_AND || code == FILTER_OR ? -1 : 1;
+
+    if (parser->depth > 64) {
+        parser->failed = true;
+    }
+} /* }}} */
+
+void filter_free(struct filter* this) { /* {{{ */
+    /* free a compiled filter */
+    int i;
+
+    if (this == NULL) {
+        return;
+    }
+
+    for (i = 0; i < this->nops; i++) {
+        free(this->ops[i].value);
+    }
+
+    free(this->ops);
+    free(this);
+} /* }}} */
+
+bool filter_has_conjunct(const struct filter_token* tokens, const int* groups,
+                         const int ngroups, const struct filter_token* group,
+                         const int length) { /* {{{ */
+    /**
+     * check whether a filter has a term
+     * tokens  - the words of the filter
+     * groups  - the terms of the filter, from filter_conjuncts
+     * ngroups - the number of terms
+     * group   - the words of the term to look for
+     * length  - the number of words in the term
+     * return is whether the filter has the term, word for word
+     */
+    int i;
+    int j;
+
+    for (i = 0; i < ngroups; i++) {
+        if (groups[2 * i + 1] - groups[2 * i] != length) {
+            continue;
+        }
+
+        for (j = 0; j < length; j++) {
+            if (tokens[groups[2 * i] + j].length != group[j].length ||
+                memcmp(tokens[groups[2 * i] + j].start, group[j].start, group[j].length) != 0) {
+                break;
+            }
+        }
+
+        if (j == length) {
+            return true;
+        }
+    }
+
+    return false;
+} /* }}} */
+
+bool filter_match(const struct filter* this, const struct task* tsk) { /* {{{ */
+    /**
+     * run a compiled filter on a task
+     * this   - the compiled filter
+     * tsk    - the task to check
+     * return is whether the task matches the filter
+     * the stack of results is kept in the bits of an integer, the top of the
+     * stack being the lowest bit
+     */
+    const struct filter_op* op;
+    unsigned long long      stack = 0;
+    unsigned long long      top;
+    bool                    matched;
+    int                     i;
+
+    for (i = 0; i < this->nops; i++) {
+        op = &(this->ops[i]);
+
+        switch (op->code) {
+        case FILTER_AND:
+        case FILTER_OR:
+            top = stack & 1;
+            stack >>= 1;
+            top = op->code == FILTER_AND ? (stack & top) : ((stack | top) & 1);
+            stack = (stack & ~1ULL) | top;
+            continue;
+
+        case FILTER_PROJECT:
+            matched = op->length == 0 ? tsk->project == NULL :
+                      tsk->project != NULL && strncmp(tsk->project, op->value, op->length) == 0 &&
+                      (tsk->project[op->length] == 0 || tsk->project[op->length] == '.');
+            break;
+
+        case FILTER_TAG:
+            matched = tag_test(tsk, op->tag);
+            break;
+
+        case FILTER_NOT_TAG:
+            matched = !tag_test(tsk, op->tag);
+            break;
+
+        case FILTER_PRIORITY:
+            matched = op->length == 0 ? tsk->priority == 0 : tsk->priority == op->value[0];
+            break;
+
+        case FILTER_STATUS:
+            matched = str_eq(filter_status(tsk), op->value);
+            break;
+
+        case FILTER_DUE_BEFORE:
+            matched = tsk->due != 0 && tsk->due < op->when;
+            break;
+
+        case FILTER_DUE_AFTER:
+            matched = tsk->due != 0 && tsk->due > op->when;
+            break;
+
+        default:
+            matched = false;
+            break;
+        }
+
+        stack = (stack << 1) | matched;
+    }
+
+    return this->nops == 0 || (stack & 1) != 0;
+} /* }}} */
+
+const char* filter_status(const struct task* tsk) { /* {{{ */
+    /**
+     * get the status of a task, which is kept with its udas
+     * tsk    - the task
+     * return is the status, a task without one is pending
+     */
+    const struct uda* uda;
+
+    for (uda = tsk->udas; uda != NULL; uda = uda->next) {
+        if (uda->value != NULL && str_eq(uda->name, "status")) {
+            return uda->value;
+        }
+    }
+
+    return "pending";
+} /* }}} */
+
+int filter_tokenize(const char* str, struct filter_token* tokens) { /* {{{ */
+    /**
+     * split a filter into words
+     * str    - the filter
+     * tokens - filled with the words, FILTERMAXTOKENS long
+     * return is the number of words, or -1 if there are too many
+     * parentheses are words whether or not they are escaped for the shell
+     */
+    const char* pos = str;
+    int         n = 0;
+
+    while (1) {
+        for (; *pos == ' ' || *pos == '\t'; pos++);
+
+        if (*pos == 0) {
+            return n;
+        }
+
+        if (n == FILTERMAXTOKENS) {
+            return -1;
+        }
+
+        if (*pos == '\\' && (pos[1] == '(' || pos[1] == ')')) {
+            pos++;
+        }
+
+        tokens[n].start = pos;
+
+        if (*pos == '(' || *pos == ')') {
+            pos++;
+        } else {
+            while (*pos != 0 && *pos != ' ' && *pos != '\t' && *pos != '(' && *pos != ')' &&
+                   !(*pos == '\\' && (pos[1] == '(' || pos[1] == ')'))) {
+                pos++;
+            }
+        }
+
+        tokens[n].length = pos - tokens[n].start;
+        n++;
+    }
+} /* }}} */
+
+void parse_and(struct filter_parser* parser) { /* {{{ */
+    /* compile terms that must all match, joined by and (which may be left out) */
+    const struct filter_token* token;
+
+    parse_factor(parser);
+
+    while (!parser->failed && parser->next < parser->ntokens) {
+        token = &(parser->tokens[parser->next]);
+
+        if (TOKEN_IS(token, "or") || TOKEN_IS(token, ")")) {
+            break;
+        }
+
+        if (TOKEN_IS(token, "and")) {
+            parser->next++;
+        }
+
+        parse_factor(parser);
+        filter_emit(parser, FILTER_AND, NULL, 0, 0);
+    }
+} /* }}} */
+
+void parse_factor(struct filter_parser* parser) { /* {{{ */
+    /* compile a term, or a parenthesized filter */
+    const struct filter_token* token;
+
+    if (parser->failed || parser->next >= parser->ntokens) {
+        parser->failed = true;
+        return;
+    }
+
+    token = &(parser->tokens[parser->next++]);
+
+    if (!TOKEN_IS(token, "(")) {
+        parse_term(parser, token);
+        return;
+    }
+
+    parse_or(parser);
+
+    if (parser->next >= parser->ntokens || !TOKEN_IS(&(parser->tokens[parser->next]), ")")) {
+        parser->failed = true;
+        return;
+    }
+
+    parser->next++;
+} /* }}} */
+
+void parse_or(struct filter_parser* parser) { /* {{{ */
+    /* compile alternatives joined by or, which binds looser than and */
+    parse_and(parser);
+
+    while (!parser->failed && parser->next < parser->ntokens &&
+           TOKEN_IS(&(parser->tokens[parser->next]), "or")) {
+        parser->next++;
+        parse_and(parser);
+        filter_emit(parser, FILTER_OR, NULL, 0, 0);
+    }
+} /* }}} */
+
+void parse_term(struct filter_parser* parser, const struct filter_token* token) { /* {{{ */
+    /**
+     * compile a single term of a filter
+     * parser - the filter being compiled
+     * token  - the term
+     */
+    const char* str = token->start;
+    const char* colon = memchr(str, ':', token->length);
+    const char* dot;
+    const char* value;
+    size_t      namelen;
+    size_t      length;
+    size_t      i;
+    time_t      when;
+
+    /* quoting is left to the shell and task */
+    if (memchr(str, '"', token->length) != NULL || memchr(str, '\'', token->length) != NULL ||
+        memchr(str, '\\', token->length) != NULL) {
+        parser->failed = true;
+        return;
+    }
+
+    /* tags, those in capitals are virtual tags task works out */
+    if ((str[0] == '+' || str[0] == '-') && token->length > 1 && colon == NULL) {
+        for (i = 1; i < token->length && str[i] >= 'A' && str[i] <= 'Z'; i++);
+
+        if (i == token->length) {
+            parser->failed = true;
+            return;
+        }
+
+        filter_emit(parser, str[0] == '+' ? FILTER_TAG : FILTER_NOT_TAG, str + 1,
+                    token->length - 1, 0);
+        return;
+    }
+
+    /* attributes, words on their own search descriptions */
+    if (colon == NULL || colon == str) {
+        parser->failed = true;
+        return;
+    }
+
+    value = colon + 1;
+    length = token->length - (value - str);
+    dot = memchr(str, '.', colon - str);
+    namelen = (dot != NULL ? dot : colon) - str;
+
+    if (dot == NULL && attribute_is(str, namelen, "project")) {
+        filter_emit(parser, FILTER_PROJECT, value, length, 0);
+    } else if (dot == NULL && attribute_is(str, namelen, "priority") &&
+               (length == 0 || (length == 1 && strchr("HML", *value) != NULL))) {
+        filter_emit(parser, FILTER_PRIORITY, value, length, 0);
+    } else if (dot == NULL && attribute_is(str, namelen, "status") &&
+               ((length == 7 && memcmp(value, "pending", 7) == 0) ||
+                (length == 7 && memcmp(value, "waiting", 7) == 0) ||
+                (length == 7 && memcmp(value, "deleted", 7) == 0) ||
+                (length == 9 && memcmp(value, "completed", 9) == 0) ||
+                (length == 9 && memcmp(value, "recurring", 9) == 0))) {
+        filter_emit(parser, FILTER_STATUS, value, length, 0);
+    } else if (dot != NULL && namelen == 3 && memcmp(str, "due", 3) == 0 &&
+               filter_date(value, length, &when)) {
+        if (colon - dot == 7 && memcmp(dot, ".before", 7) == 0) {
+            filter_emit(parser, FILTER_DUE_BEFORE, NULL, 0, when);
+        } else if (colon - dot == 6 && memcmp(dot, ".after", 6) == 0) {
+            filter_emit(parser, FILTER_DUE_AFTER, NULL, 0, when);
+        } else {
+            parser->failed = true;
+        }
+    } else {
+        parser->failed = true;
+    }
+} /* }}} */
+
+// vim: et ts=4 sw=4 sts=4
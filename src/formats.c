@@ -5,22 +5,54 @@
  */
 
 #define _GNU_SOURCE
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include "arena.h"
 #include "common.h"
+#include "config.h"
 #include "formats.h"
 
 /* externs */
 extern struct var vars[];
 extern struct config cfg;
+extern int cols;
+
+/**
+ * render key struct - everything a cached task line depends on
+ * besides the task itself
+ * cols        - the width of the screen
+ * project     - the width of the project field
+ * description - the width of the description field
+ * date        - the width of the date field
+ * today       - the date generation, changed at midnight when rendered
+ *               dates go stale
+ */
+static struct {
+    int cols;
+    int project;
+    int description;
+    int date;
+    unsigned int today;
+} render_key;
+
+/* the generation of cached task lines, bumped whenever they go stale */
+static unsigned int render_generation = 1;
+
+/* whether the task format only depends on the task and the render key */
+static bool task_format_cacheable = false;
 
 /* local functions */
 static char* append_buffer(char* buffer, const char append, int* bufferlen);
 static void append_field(struct fmt_field** head, struct fmt_field** last, struct fmt_field* this);
 static struct fmt_field* buffer_field(char* buffer, int bufferlen);
+static void check_render_key(void);
+static char* due_to_str(struct task* tsk);
 static char* eval_conditional(struct conditional_fmt_field* this, struct task* tsk);
 static char* field_to_str(struct fmt_field* this, bool* free_field, struct task* tsk);
+static bool format_is_volatile(struct fmt_field* this);
 static void free_format(struct fmt_field* this);
 static struct conditional_fmt_field* parse_conditional(char** str);
 
@@ -69,11 +101,36 @@ struct fmt_field* buffer_field(char* buffer, int bufferlen) { /* {{{ */
     return this;
 } /* }}} */
 
+void check_render_key(void) { /* {{{ */
+    /* invalidate cached task lines if the screen, the field widths or the
+     * day have changed since they were evaluated
+     */
+    const unsigned int today = today_generation();
+
+    if (render_key.cols == cols && render_key.project == cfg.fieldlengths.project &&
+            render_key.description == cfg.fieldlengths.description &&
+            render_key.date == cfg.fieldlengths.date && render_key.today == today) {
+        return;
+    }
+
+    render_key.cols         = cols;
+    render_key.project      = cfg.fieldlengths.project;
+    render_key.description  = cfg.fieldlengths.description;
+    render_key.date         = cfg.fieldlengths.date;
+    render_key.today        = today;
+
+    invalidate_formats();
+} /* }}} */
+
 void compile_formats() { /* {{{ */
     /* compile all the format strings */
+    cfg.formats.group_compiled = compile_format_string(cfg.formats.group);
     cfg.formats.task_compiled = compile_format_string(cfg.formats.task);
     cfg.formats.title_compiled = compile_format_string(cfg.formats.title);
     cfg.formats.view_compiled = compile_format_string(cfg.formats.view);
+
+    task_format_cacheable = !format_is_volatile(cfg.formats.task_compiled);
+    invalidate_formats();
 } /* }}} */
 
 struct fmt_field* compile_format_string(char* fmt) { /* {{{ */
@@ -241,8 +298,8 @@ static char* eval_conditional(struct conditional_fmt_field* this,
     /* evaluate conditional */
     tmp = eval_format(this->condition, tsk);
 
-    /* check if conditional was "(null)" */
-    if (str_eq(tmp, "(null)")) {
+    /* check if conditional was "(null)", or had no fields to print */
+    if (tmp != NULL && str_eq(tmp, "(null)")) {
         *tmp = 0;
     }
 
@@ -250,7 +307,7 @@ static char* eval_conditional(struct conditional_fmt_field* this,
      * whether the positive or negative condition should
      * be returned
      */
-    switch (*tmp) {
+    switch (tmp != NULL ? *tmp : 0) {
     case 0:
     case '0':
     case ' ':
@@ -262,11 +319,43 @@ static char* eval_conditional(struct conditional_fmt_field* this,
         break;
     }
 
-    free(tmp);
+    check_free(tmp);
 
     return ret;
 } /* }}} */
 
+char* due_to_str(struct task* tsk) { /* {{{ */
+    /**
+     * format the due date of a task, reusing the string cached in the task
+     * until the day changes
+     * tsk    - the task to format the due date of
+     * return is the date, owned by the task (NULL if it couldn't be allocated)
+     */
+    const unsigned int today = today_generation();
+
+    if (tsk->duestr != NULL && tsk->duegen == today) {
+        return tsk->duestr;
+    }
+
+    if (tsk->duestr == NULL) {
+        tsk->duestr = arena_alloc(tsk->arena, TIMELENGTH);
+
+        if (tsk->duestr == NULL) {
+            return NULL;
+        }
+    }
+
+    if (tsk->due) {
+        format_date(tsk->duestr, tsk->due);
+    } else {
+        strcpy(tsk->duestr, " ");
+    }
+
+    tsk->duegen = today;
+
+    return tsk->duestr;
+} /* }}} */
+
 char* eval_format(struct fmt_field* fmts, struct task* tsk) { /* {{{ */
     /**
      * evaluate a linked list of format fields
@@ -274,7 +363,8 @@ char* eval_format(struct fmt_field* fmts, struct task* tsk) { /* {{{ */
      * tsk  - the task to evaluate the format on
      */
     int totallen = 1, pos = 0;
-    unsigned int fieldwidth, fieldlen, p;
+    int fieldwidth, textwidth, pad;
+    size_t fieldlen;
     char* str = NULL, *tmp;
     struct fmt_field* this;
     bool free_tmp;
@@ -291,31 +381,37 @@ char* eval_format(struct fmt_field* fmts, struct task* tsk) { /* {{{ */
             continue;
         }
 
-        /* get string data */
-        fieldlen = strlen(tmp);
-
+        /* get string data, widths are in screen columns rather than bytes */
         if (this->type == FIELD_PROJECT && this->width == 0) {
             fieldwidth = cfg.fieldlengths.project;
+        } else if (this->type == FIELD_DESCRIPTION && this->width == 0) {
+            fieldwidth = cfg.fieldlengths.description;
         } else {
-            fieldwidth = this->width > 0 ? this->width : fieldlen;
+            fieldwidth = this->width > 0 ? (int)this->width : INT_MAX;
         }
 
+        fieldlen = str_prefix(tmp, fieldwidth, &textwidth);
+
+        if (fieldwidth == INT_MAX) {
+            fieldwidth = textwidth;
+        }
+
+        pad = fieldwidth - textwidth;
+
         /* realloc string */
-        totallen += fieldwidth;
+        totallen += fieldlen + pad;
         str = realloc(str, totallen * sizeof(char));
         str[totallen - 1] = 0;
 
         /* buffer right-aligned string */
         if (this->right_align) {
-            for (p = 0; p < fieldwidth - fieldlen; p++) {
-                *(str + pos + p) = ' ';
-            }
-
-            pos += fieldwidth - fieldlen;
+            memset(str + pos, ' ', pad);
+            pos += pad;
         }
 
         /* copy string */
-        strncpy(str + pos, tmp, MIN(fieldwidth, fieldlen));
+        memcpy(str + pos, tmp, fieldlen);
+        pos += fieldlen;
 
         if (free_tmp) {
             free(tmp);
@@ -323,18 +419,57 @@ char* eval_format(struct fmt_field* fmts, struct task* tsk) { /* {{{ */
 
         /* buffer left-aligned string */
         if (!(this->right_align)) {
-            for (p = fieldlen; p < fieldwidth; p++) {
-                *(str + pos + p) = ' ';
-            }
+            memset(str + pos, ' ', pad);
+            pos += pad;
         }
-
-        /* move current position */
-        pos += this->right_align ? fieldlen : fieldwidth;
     }
 
     return str;
 } /* }}} */
 
+const char* eval_task_format(struct task* tsk) { /* {{{ */
+    /**
+     * evaluate the task format for a task, reusing the line cached in the
+     * task while nothing it depends on has changed
+     * tsk    - the task to evaluate the format on
+     * return is the line, owned by the task (NULL for an empty format)
+     *        it is valid until the task is freed or evaluated again
+     */
+    char*   str;
+    size_t  len;
+
+    check_render_key();
+
+    if (task_format_cacheable && tsk->linegen == render_generation) {
+        return tsk->line;
+    }
+
+    str = eval_format(cfg.formats.task_compiled, tsk);
+
+    if (str == NULL) {
+        return NULL;
+    }
+
+    /* the buffer is reused while the line fits, the arena is freed with the task */
+    len = strlen(str) + 1;
+
+    if (tsk->linesize < len) {
+        tsk->line = arena_alloc(tsk->arena, len);
+        tsk->linesize = tsk->line != NULL ? len : 0;
+    }
+
+    if (tsk->line == NULL) {
+        free(str);
+        return NULL;
+    }
+
+    memcpy(tsk->line, str, len);
+    free(str);
+    tsk->linegen = task_format_cacheable ? render_generation : 0;
+
+    return tsk->line;
+} /* }}} */
+
 static char* field_to_str(struct fmt_field* this, bool* free_field,
                           struct task* tsk) { /* {{{ */
     /**
@@ -343,7 +478,8 @@ static char* field_to_str(struct fmt_field* this, bool* free_field,
      * free_field - whether the field needs to be free'd after use
      * tsk        - the task to evaluate the format on
      */
-    char* ret = NULL;
+    static char today[TIMELENGTH];
+    char*       ret = NULL;
     *free_field = true;
 
     switch (this->type) {
@@ -353,7 +489,9 @@ static char* field_to_str(struct fmt_field* this, bool* free_field,
         break;
 
     case FIELD_DATE:
-        ret = utc_date(0);
+        format_date(today, 0);
+        ret = today;
+        *free_field = false;
         break;
 
     case FIELD_TIME:
@@ -365,7 +503,7 @@ static char* field_to_str(struct fmt_field* this, bool* free_field,
         break;
 
     case FIELD_PROJECT:
-        ret = tsk->project;
+        ret = (char*)tsk->project;
         *free_field = false;
         break;
 
@@ -375,12 +513,8 @@ static char* field_to_str(struct fmt_field* this, bool* free_field,
         break;
 
     case FIELD_DUE:
-        if (tsk->due) {
-            ret = utc_date(tsk->due);
-        } else {
-            ret = strdup(" ");
-        }
-
+        ret = due_to_str(tsk);
+        *free_field = false;
         break;
 
     case FIELD_PRIORITY:
@@ -392,8 +526,12 @@ static char* field_to_str(struct fmt_field* this, bool* free_field,
         break;
 
     case FIELD_UUID:
-        ret = tsk->uuid;
-        *free_field = false;
+        ret = malloc(UUIDLENGTH * sizeof(char));
+
+        if (ret != NULL) {
+            uuid_format(tsk->uuid, ret);
+        }
+
         break;
 
     case FIELD_INDEX:
@@ -411,6 +549,28 @@ static char* field_to_str(struct fmt_field* this, bool* free_field,
     return ret;
 } /* }}} */
 
+bool format_is_volatile(struct fmt_field* this) { /* {{{ */
+    /**
+     * check whether a format can evaluate differently for the same task
+     * between changes to the render key (the time, or the value of a variable)
+     * this   - the first element in the linked list of format fields
+     */
+    for (; this != NULL; this = this->next) {
+        if (this->type == FIELD_TIME || this->type == FIELD_VAR) {
+            return true;
+        }
+
+        if (this->type == FIELD_CONDITIONAL && this->conditional != NULL &&
+                (format_is_volatile(this->conditional->condition) ||
+                 format_is_volatile(this->conditional->positive) ||
+                 format_is_volatile(this->conditional->negative))) {
+            return true;
+        }
+    }
+
+    return false;
+} /* }}} */
+
 void free_format(struct fmt_field* this) { /* {{{ */
     /* walk through a format list and free its elements */
     struct fmt_field* last;
@@ -439,6 +599,17 @@ void free_formats() { /* {{{ */
     free_format(cfg.formats.view_compiled);
     free_format(cfg.formats.title_compiled);
     free_format(cfg.formats.task_compiled);
+    free_format(cfg.formats.group_compiled);
+} /* }}} */
+
+void invalidate_formats(void) { /* {{{ */
+    /* mark every cached task line as stale */
+    render_generation++;
+
+    /* 0 is reserved for tasks that were never evaluated */
+    if (render_generation == 0) {
+        render_generation = 1;
+    }
 } /* }}} */
 
 struct conditional_fmt_field* parse_conditional(char** str) { /* {{{ */
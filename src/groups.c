@@ -0,0 +1,451 @@
+/*
+ * groups.c - the task list grouped by project
+ * for tasknc
+ * by mjheagle
+ */
+
+#define _GNU_SOURCE
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "groups.h"
+#include "log.h"
+#include "sort.h"
+#include "tasktable.h"
+
+/* local functions */
+static bool group_add(struct task* this);
+static int group_at(const int row);
+static int group_compare(const void* a, const void* b);
+static int group_find(const char* project, const bool create);
+static void group_free(const int g);
+static void group_sort(struct group* this);
+static void groups_build(void);
+static void groups_layout(void);
+
+/* the groups, in the order the project sort key puts them
+ * they are only kept up to date with the task table while the list is
+ * grouped, a group with no tasks keeps whether it was collapsed until the
+ * groups are built again
+ */
+static struct group*    groups = NULL;
+static int              ngroups = 0;
+static int              capacity = 0;
+static bool             built = false;
+
+/* the row of each group's header, and the number of rows after the last */
+static int*             rowstart = NULL;
+static bool             laidout = false;
+
+/* the header row being printed */
+int                     group_count = 0;
+char*                   group_marker = "";
+
+bool group_add(struct task* this) { /* {{{ */
+    /**
+     * add a task to the group for its project, creating the group if needed
+     * this   - the task to add
+     * return is whether the task was added
+     */
+    struct group*   group;
+    struct task**   members;
+    int             g = group_find(this->project, true);
+
+    if (g < 0) {
+        return false;
+    }
+
+    group = &(groups[g]);
+
+    if (group->count == group->capacity) {
+        members = realloc(group->members, (2 * group->capacity + 8) * sizeof(struct task*));
+
+        if (members == NULL) {
+            tnc_fprintf(logfp, LOG_ERROR, "could not allocate group (%d tasks)",
+                        group->count);
+            return false;
+        }
+
+        group->members = members;
+        group->capacity = 2 * group->capacity + 8;
+    }
+
+    group->members[group->count++] = this;
+    group->sorted = group->count == 1;
+    laidout = laidout && group->collapsed;
+
+    return true;
+} /* }}} */
+
+int group_at(const int row) { /* {{{ */
+    /* find the group a row belongs to, the group's header or one of its tasks
+     * return is the index of the group, or -1 if the row is past the end
+     */
+    int first = 0;
+    int last = ngroups - 1;
+    int g;
+
+    groups_layout();
+
+    if (!built || row < 0 || ngroups == 0 || row >= rowstart[ngroups]) {
+        return -1;
+    }
+
+    /* find the last group whose header is at or above the row */
+    while (first < last) {
+        g = first + (last - first + 1) / 2;
+
+        if (rowstart[g] <= row) {
+            first = g;
+        } else {
+            last = g - 1;
+        }
+    }
+
+    return first;
+} /* }}} */
+
+int group_compare(const void* a, const void* b) { /* {{{ */
+    /* compare groups for qsort, in the order their headers are listed */
+    return sort_compare_projects(((const struct group*)a)->project,
+                                 ((const struct group*)b)->project);
+} /* }}} */
+
+int group_find(const char* project, const bool create) { /* {{{ */
+    /**
+     * look up the group for a project
+     * project - the project to find (NULL for the tasks without one)
+     * create  - whether to add the group if there is none
+     * return is the index of the group, or -1 if there is none
+     */
+    struct group*   grown;
+    int*            rows;
+    int             first = 0;
+    int             last = ngroups;
+    int             g;
+    int             cmp;
+
+    while (first < last) {
+        g = first + (last - first) / 2;
+        cmp = sort_compare_projects(project, groups[g].project);
+
+        if (cmp == 0) {
+            return g;
+        } else if (cmp > 0) {
+            first = g + 1;
+        } else {
+            last = g;
+        }
+    }
+
+    if (!create) {
+        return -1;
+    }
+
+    if (ngroups == capacity) {
+        grown = realloc(groups, (2 * capacity + 8) * sizeof(struct group));
+        groups = grown != NULL ? grown : groups;
+        rows = grown != NULL ? realloc(rowstart, (2 * capacity + 9) * sizeof(int)) : NULL;
+        rowstart = rows != NULL ? rows : rowstart;
+
+        if (rows == NULL) {
+            tnc_fprintf(logfp, LOG_ERROR, "could not allocate groups (%d groups)", ngroups);
+            return -1;
+        }
+
+        capacity = 2 * capacity + 8;
+    }
+
+    /* new groups start collapsed so only the projects asked for are laid out */
+    memmove(groups + first + 1, groups + first, (ngroups - first) * sizeof(struct group));
+    groups[first].project = project != NULL ? strdup(project) : NULL;
+    groups[first].members = NULL;
+    groups[first].count = 0;
+    groups[first].capacity = 0;
+    groups[first].collapsed = true;
+    groups[first].sorted = true;
+    ngroups++;
+    laidout = false;
+
+    return first;
+} /* }}} */
+
+void group_free(const int g) { /* {{{ */
+    /* remove a group from the list of groups */
+    check_free(groups[g].project);
+    check_free(groups[g].members);
+    ngroups--;
+    memmove(groups + g, groups + g + 1, (ngroups - g) * sizeof(struct group));
+    laidout = false;
+} /* }}} */
+
+void group_sort(struct group* this) { /* {{{ */
+    /* put a group's tasks in display order, if they are not already */
+    if (!this->sorted) {
+        sort_tasks(this->members, this->count);
+        this->sorted = true;
+    }
+} /* }}} */
+
+bool groups_active(void) { /* {{{ */
+    /**
+     * check whether the task list is grouped by project
+     * the groups are built the first time they are needed, and are only kept
+     * up to date with the task table while they are shown
+     */
+    if (!cfg.group_view) {
+        if (built) {
+            groups_reset();
+        }
+
+        return false;
+    }
+
+    if (!built) {
+        groups_build();
+    }
+
+    return true;
+} /* }}} */
+
+void groups_add(struct task* this) { /* {{{ */
+    /* add a task added to the task table to its group */
+    if (built) {
+        group_add(this);
+    }
+} /* }}} */
+
+void groups_build(void) { /* {{{ */
+    /* group every task in the table, which is already in display order */
+    struct task*    this;
+    int             i;
+
+    built = true;
+
+    for (i = 0; (this = tasktable_get(i)) != NULL; i++) {
+        group_add(this);
+    }
+
+    for (i = ngroups - 1; i >= 0; i--) {
+        if (groups[i].count == 0) {
+            group_free(i);
+        } else {
+            groups[i].sorted = true;
+        }
+    }
+
+    laidout = false;
+    tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "groups: %d tasks in %d groups",
+                tasktable_count(), ngroups);
+} /* }}} */
+
+void groups_clear(void) { /* {{{ */
+    /* release the groups' memory */
+    while (ngroups > 0) {
+        group_free(ngroups - 1);
+    }
+
+    free(groups);
+    free(rowstart);
+    groups = NULL;
+    rowstart = NULL;
+    capacity = 0;
+    built = false;
+} /* }}} */
+
+int groups_count(void) { /* {{{ */
+    /* get the number of rows in the grouped list, headers included */
+    groups_layout();
+
+    return built && ngroups > 0 ? rowstart[ngroups] : 0;
+} /* }}} */
+
+struct task* groups_get(const int row) { /* {{{ */
+    /**
+     * get the task at a row of the grouped list
+     * the group's tasks are sorted the first time one of them is shown
+     * return is the task, or NULL for a header or a row past the end
+     */
+    const int g = group_at(row);
+
+    if (g < 0 || row == rowstart[g]) {
+        return NULL;
+    }
+
+    group_sort(&(groups[g]));
+
+    return groups[g].members[row - rowstart[g] - 1];
+} /* }}} */
+
+const struct task* groups_header(const int row) { /* {{{ */
+    /**
+     * look up the header at a row of the grouped list
+     * group_count and group_marker are set for the header's format
+     * return is a task of the group, its project is the group's, or NULL if
+     *        the row is not a header
+     */
+    const int g = group_at(row);
+
+    if (g < 0 || row != rowstart[g]) {
+        return NULL;
+    }
+
+    group_count = groups[g].count;
+    group_marker = groups[g].collapsed ? "+" : "-";
+
+    return groups[g].members[0];
+} /* }}} */
+
+void groups_layout(void) { /* {{{ */
+    /* find the row of each group's header once groups have changed */
+    int g;
+
+    if (laidout || rowstart == NULL) {
+        return;
+    }
+
+    rowstart[0] = 0;
+
+    for (g = 0; g < ngroups; g++) {
+        rowstart[g + 1] = rowstart[g] + 1 + (groups[g].collapsed ? 0 : groups[g].count);
+    }
+
+    laidout = true;
+} /* }}} */
+
+int groups_position(const struct task* this) { /* {{{ */
+    /**
+     * find the row of a task in the grouped list, expanding its group
+     * this   - the task to find
+     * return is the row, or -1 if the task is not grouped
+     */
+    const int   g = built ? group_find(this->project, false) : -1;
+    int         i;
+
+    if (g < 0) {
+        return -1;
+    }
+
+    if (groups[g].collapsed) {
+        groups[g].collapsed = false;
+        laidout = false;
+    }
+
+    group_sort(&(groups[g]));
+    groups_layout();
+
+    for (i = 0; i < groups[g].count; i++) {
+        if (groups[g].members[i] == this) {
+            return rowstart[g] + 1 + i;
+        }
+    }
+
+    return -1;
+} /* }}} */
+
+void groups_remove(const struct task* this) { /* {{{ */
+    /* remove a task removed from the task table from its group */
+    const int   g = built ? group_find(this->project, false) : -1;
+    int         i;
+
+    if (g < 0) {
+        return;
+    }
+
+    for (i = 0; i < groups[g].count && groups[g].members[i] != this; i++);
+
+    if (i == groups[g].count) {
+        return;
+    }
+
+    groups[g].count--;
+    memmove(groups[g].members + i, groups[g].members + i + 1,
+            (groups[g].count - i) * sizeof(struct task*));
+    laidout = laidout && groups[g].collapsed;
+
+    if (groups[g].count == 0) {
+        group_free(g);
+    }
+} /* }}} */
+
+void groups_reorder(void) { /* {{{ */
+    /* put the groups and their tasks in order again once the sort mode
+     * or the tasks have changed, groups are sorted again as they are shown
+     */
+    int g;
+
+    if (!built) {
+        return;
+    }
+
+    qsort(groups, ngroups, sizeof(struct group), group_compare);
+
+    for (g = 0; g < ngroups; g++) {
+        groups[g].sorted = groups[g].count < 2;
+    }
+
+    laidout = false;
+} /* }}} */
+
+void groups_replace(const struct task* old, struct task* new) { /* {{{ */
+    /**
+     * put a task in the place of one replaced in the task table
+     * old - the task being replaced
+     * new - the task taking its place, which may belong to another group
+     */
+    const int   g = built ? group_find(old->project, false) : -1;
+    int         i;
+
+    if (g < 0) {
+        return;
+    }
+
+    if (sort_compare_projects(old->project, new->project) != 0) {
+        groups_remove(old);
+        group_add(new);
+        return;
+    }
+
+    for (i = 0; i < groups[g].count; i++) {
+        if (groups[g].members[i] == old) {
+            groups[g].members[i] = new;
+            groups[g].sorted = groups[g].count < 2;
+            break;
+        }
+    }
+} /* }}} */
+
+void groups_reset(void) { /* {{{ */
+    /* forget the tasks grouped, which are built again when next needed
+     * each project's group remembers whether it was collapsed meanwhile
+     */
+    int g;
+
+    for (g = 0; g < ngroups; g++) {
+        groups[g].count = 0;
+    }
+
+    built = false;
+    laidout = false;
+} /* }}} */
+
+int groups_toggle(const int row) { /* {{{ */
+    /**
+     * collapse or expand a group
+     * row    - the group's header or one of its tasks
+     * return is the row of the group's header, or row if there is no group
+     */
+    const int g = group_at(row);
+
+    if (g < 0) {
+        return row;
+    }
+
+    groups[g].collapsed = !groups[g].collapsed;
+    laidout = false;
+
+    return rowstart[g];
+} /* }}} */
+
+// vim: et ts=4 sw=4 sts=4
@@ -0,0 +1,204 @@
+/*
+ * infocache.c - task info kept for the view pager
+ * for tasknc
+ * by mjheagle
+ */
+
+#define _GNU_SOURCE
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "config.h"
+#include "infocache.h"
+#include "jobs.h"
+#include "log.h"
+#include "tasks.h"
+#include "tasktable.h"
+
+/* local functions */
+static void info_done(const struct job* job);
+
+/* the info of recently viewed and prefetched tasks, least recently used are
+ * replaced first, an entry only matches while the task is unmodified
+ */
+static struct info      cache[INFOCACHESIZE];
+static unsigned long    info_clock = 0;
+
+/* the last task whose info could not be fetched, it is not tried again
+ * until another fails
+ */
+static unsigned char    failed[UUIDBYTES];
+
+void info_done(const struct job* job) { /* {{{ */
+    /* keep the info fetched for a task, if the task has not changed since
+     * job - the finished `task info`, its data is the info asked for
+     */
+    const struct info*  request = job->data;
+    char*               output;
+
+    if (job->ret != 0 || job->output == NULL) {
+        memcpy(failed, request->uuid, UUIDBYTES);
+        return;
+    }
+
+    if ((output = strndup(job->output, job->length)) != NULL) {
+        infocache_store(request, output, job->length);
+    }
+} /* }}} */
+
+void infocache_clear(void) { /* {{{ */
+    /* free every entry in the info cache */
+    int i;
+
+    for (i = 0; i < INFOCACHESIZE; i++) {
+        check_free(cache[i].output);
+        memset(&(cache[i]), 0, sizeof(struct info));
+    }
+} /* }}} */
+
+char* infocache_command(const struct task* this, const int width) { /* {{{ */
+    /**
+     * build the command printing a task's info
+     * this   - the task to print
+     * width  - the width to print at
+     * return is the command, which must be freed
+     */
+    char* cmdstr;
+    char  uuid[UUIDLENGTH];
+
+    asprintf(&cmdstr, "task %s info rc._forcecolor=no rc.defaultwidth=%d 2>&1",
+             uuid_format(this->uuid, uuid), width);
+
+    return cmdstr;
+} /* }}} */
+
+const struct info* infocache_find(const struct task* this, const int width) { /* {{{ */
+    /**
+     * look up the info of a task
+     * this   - the task to find
+     * width  - the width the info must be printed at
+     * return is the info, owned by the cache until the next store, or NULL
+     *        if there is none for the task as it is now
+     */
+    int i;
+
+    for (i = 0; i < INFOCACHESIZE; i++) {
+        if (cache[i].output != NULL && cache[i].width == width &&
+            cache[i].modified == this->modified &&
+            memcmp(cache[i].uuid, this->uuid, UUIDBYTES) == 0) {
+            cache[i].used = ++info_clock;
+            return &(cache[i]);
+        }
+    }
+
+    return NULL;
+} /* }}} */
+
+void infocache_forget(const unsigned char* uuid) { /* {{{ */
+    /* drop the info of a task that is being reloaded */
+    int i;
+
+    for (i = 0; i < INFOCACHESIZE; i++) {
+        if (cache[i].output != NULL && memcmp(cache[i].uuid, uuid, UUIDBYTES) == 0) {
+            free(cache[i].output);
+            memset(&(cache[i]), 0, sizeof(struct info));
+        }
+    }
+} /* }}} */
+
+void infocache_prefetch(void) { /* {{{ */
+    /* fetch the info of the selected task, then of the tasks around it, so
+     * viewing them needs no wait
+     * this is called before waiting for a key, one task is fetched at a time
+     * and only while no other command runs, a command submitted meanwhile
+     * waits for the fetch to finish and the info fetched is thrown away
+     */
+    const int       width = cols - 4;
+    struct task*    this;
+    struct info*    request;
+    char*           cmdstr;
+    int             i;
+
+    if (cfg.view_prefetch <= 0 || jobs_pending() > 0) {
+        return;
+    }
+
+    /* the selected task first, then outwards, below before above */
+    for (i = 0; i <= 2 * cfg.view_prefetch; i++) {
+        this = get_task_by_position(selline + (i % 2 == 1 ? 1 : -1) * ((i + 1) / 2));
+
+        if (this == NULL || infocache_find(this, width) != NULL ||
+            memcmp(this->uuid, failed, UUIDBYTES) == 0) {
+            continue;
+        }
+
+        request = calloc(1, sizeof(struct info));
+
+        if (request == NULL) {
+            return;
+        }
+
+        infocache_request(this, width, request);
+        cmdstr = infocache_command(this, width);
+        jobs_submit_idle(cmdstr, info_done, request);
+        free(cmdstr);
+
+        return;
+    }
+} /* }}} */
+
+void infocache_request(const struct task* this, const int width, struct info* request) { /* {{{ */
+    /**
+     * note which info is being printed, for infocache_store once it has been
+     * this    - the task printed
+     * width   - the width it is printed at
+     * request - set to the task as it is now, with no output
+     */
+    memset(request, 0, sizeof(struct info));
+    memcpy(request->uuid, this->uuid, UUIDBYTES);
+    request->width = width;
+    request->modified = this->modified;
+} /* }}} */
+
+void infocache_store(const struct info* request, char* output, const size_t length) { /* {{{ */
+    /**
+     * keep the info printed for a task
+     * request - the info that was printed, from infocache_request
+     * output  - the info, which the cache takes ownership of
+     * length  - the number of characters in output
+     * the info is dropped if the task has left the list or changed meanwhile
+     */
+    const struct task*  this = tasktable_find(request->uuid);
+    struct info*        entry = &(cache[0]);
+    int                 i;
+
+    if (this == NULL || this->modified != request->modified) {
+        free(output);
+        return;
+    }
+
+    /* a task's old info is replaced, otherwise the least recently used */
+    for (i = 0; i < INFOCACHESIZE; i++) {
+        if (cache[i].output != NULL && memcmp(cache[i].uuid, this->uuid, UUIDBYTES) == 0) {
+            entry = &(cache[i]);
+            break;
+        }
+
+        if (cache[i].output == NULL || cache[i].used < entry->used) {
+            entry = &(cache[i]);
+        }
+    }
+
+    check_free(entry->output);
+    memcpy(entry->uuid, this->uuid, UUIDBYTES);
+    entry->width = request->width;
+    entry->modified = this->modified;
+    entry->output = output;
+    entry->length = length;
+    entry->used = ++info_clock;
+    tnc_fprintf(logfp, LOG_DEBUG, "info cache: kept %zu bytes", length);
+} /* }}} */
+
+// vim: et ts=4 sw=4 sts=4
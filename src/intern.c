@@ -0,0 +1,141 @@
+/*
+ * intern.c - a pool of strings shared between tasks
+ * for tasknc
+ * by mjheagle
+ */
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "intern.h"
+#include "log.h"
+
+/* local functions */
+static bool pool_grow(void);
+static size_t string_hash(const char* str, const size_t length);
+
+/* the pool, an open addressed hash of strings that are kept until exit so
+ * that tasks from any load can point at them
+ * tasks are parsed on several threads, which all intern their projects
+ */
+static char**           slots = NULL;
+static size_t           nslots = 0;
+static size_t           nused = 0;
+static pthread_mutex_t  lock = PTHREAD_MUTEX_INITIALIZER;
+
+void intern_free(void) { /* {{{ */
+    /* free every string in the pool */
+    size_t i;
+
+    pthread_mutex_lock(&lock);
+
+    for (i = 0; i < nslots; i++) {
+        free(slots[i]);
+    }
+
+    free(slots);
+    slots = NULL;
+    nslots = 0;
+    nused = 0;
+
+    pthread_mutex_unlock(&lock);
+} /* }}} */
+
+const char* intern_string(const char* str, const size_t length) { /* {{{ */
+    /**
+     * find the pooled copy of a string, adding it if it is new
+     * equal strings always give the same pointer, so they can be compared
+     * as pointers
+     * str    - the string, it need not be terminated
+     * length - the length of the string
+     * return is the pooled string, or NULL if it could not be added
+     */
+    const char* ret = NULL;
+    size_t      mask;
+    size_t      i;
+
+    pthread_mutex_lock(&lock);
+
+    /* keep the pool at most half full */
+    if (2 * (nused + 1) > nslots && !pool_grow()) {
+        goto done;
+    }
+
+    mask = nslots - 1;
+
+    for (i = string_hash(str, length) & mask; slots[i] != NULL; i = (i + 1) & mask) {
+        if (strncmp(slots[i], str, length) == 0 && slots[i][length] == 0) {
+            ret = slots[i];
+            goto done;
+        }
+    }
+
+    slots[i] = strndup(str, length);
+
+    if (slots[i] != NULL) {
+        nused++;
+    }
+
+    ret = slots[i];
+
+done:
+    pthread_mutex_unlock(&lock);
+
+    return ret;
+} /* }}} */
+
+bool pool_grow(void) { /* {{{ */
+    /**
+     * double the number of slots in the pool, the lock must be held
+     * return is whether the pool could be grown
+     */
+    char**          old = slots;
+    const size_t    oldslots = nslots;
+    size_t          mask;
+    size_t          i;
+    size_t          j;
+
+    nslots = nslots > 0 ? 2 * nslots : INTERNSLOTS;
+    slots = calloc(nslots, sizeof(char*));
+
+    if (slots == NULL) {
+        tnc_fprintf(logfp, LOG_ERROR, "could not grow string pool (%zu slots)", nslots);
+        slots = old;
+        nslots = oldslots;
+        return false;
+    }
+
+    mask = nslots - 1;
+
+    for (i = 0; i < oldslots; i++) {
+        if (old[i] == NULL) {
+            continue;
+        }
+
+        for (j = string_hash(old[i], strlen(old[i])) & mask; slots[j] != NULL; j = (j + 1) & mask);
+
+        slots[j] = old[i];
+    }
+
+    free(old);
+
+    return true;
+} /* }}} */
+
+size_t string_hash(const char* str, const size_t length) { /* {{{ */
+    /* fnv-1a hash of a string */
+    size_t hash = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < length; i++) {
+        hash ^= (unsigned char)str[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+} /* }}} */
+
+// vim: et ts=4 sw=4 sts=4
@@ -0,0 +1,562 @@
+/*
+ * jobs.c - run task commands in the background
+ * for tasknc
+ * by mjheagle
+ */
+
+#define _GNU_SOURCE
+#include <curses.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "common.h"
+#include "config.h"
+#include "jobs.h"
+#include "log.h"
+#include "statusbar.h"
+#include "timing.h"
+#include "watch.h"
+
+/* the queue of jobs, only the first job is running
+ * jobs run one at a time in the order they were submitted, as a command
+ * usually depends on the ones before it (and taskwarrior locks its data)
+ * an idle job is only queued on its own, and is not counted as pending
+ * a command is never stopped once it has started, as taskwarrior may be
+ * writing its data, a command whose result is no longer wanted is instead
+ * left to finish with its output thrown away
+ */
+static struct job*  queue = NULL;
+static struct job*  queue_tail = NULL;
+static int          npending = 0;
+
+/* a command started before it was submitted, see jobs_prefetch */
+static struct job*  prefetched = NULL;
+
+/* local functions */
+static struct job* job_claim(const char* cmdstr);
+static void job_discard(struct job* job);
+static void job_drop_idle(void);
+static void job_finish(struct job* job);
+static bool job_queue(const char* cmdstr, job_callback callback, void* data,
+                      const bool idle);
+static bool job_read(struct job* job);
+static bool job_start(struct job* job);
+static void jobs_run(void);
+
+struct job* job_claim(const char* cmdstr) { /* {{{ */
+    /**
+     * take the prefetched command for a job being submitted
+     * a prefetched command that is not the job's is left to finish first
+     * cmdstr - the command of the job (NULL if it has none)
+     * return is the prefetched job if it runs the same command, otherwise NULL
+     */
+    struct job* job = prefetched;
+
+    if (job == NULL) {
+        return NULL;
+    }
+
+    prefetched = NULL;
+
+    if (cmdstr != NULL && str_eq(cmdstr, job->cmdstr)) {
+        tnc_fprintf(logfp, LOG_DEBUG, "using prefetched command: %s", job->cmdstr);
+        return job;
+    }
+
+    tnc_fprintf(logfp, LOG_DEBUG, "discarding prefetched command: %s", job->cmdstr);
+    job_discard(job);
+
+    return NULL;
+} /* }}} */
+
+void job_discard(struct job* job) { /* {{{ */
+    /**
+     * queue a running command whose result is not wanted, it finishes before
+     * any job that has not started, with its output thrown away
+     * job - the job running the command, not yet in the queue
+     */
+    job->callback   = NULL;
+    job->data       = NULL;
+    job->idle       = true;
+
+    if (queue == NULL || queue->pid == 0) {
+        job->next = queue;
+        queue = job;
+        queue_tail = queue_tail != NULL ? queue_tail : job;
+        return;
+    }
+
+    /* only the head of the queue is read, the job is read once it finishes */
+    job->next = queue->next;
+    queue->next = job;
+
+    if (queue_tail == queue) {
+        queue_tail = job;
+    }
+} /* }}} */
+
+void job_drop_idle(void) { /* {{{ */
+    /* throw away the result of a running idle job, so the next job does not
+     * wait on its callback, the command itself is left to finish
+     */
+    struct job* job = queue;
+
+    if (job == NULL || !job->idle || job->callback == NULL) {
+        return;
+    }
+
+    tnc_fprintf(logfp, LOG_DEBUG, "dropping idle command: %s", job->cmdstr);
+    job->callback = NULL;
+    check_free(job->data);
+    job->data = NULL;
+} /* }}} */
+
+void job_finish(struct job* job) { /* {{{ */
+    /**
+     * remove a finished job from the head of the queue and report it
+     * job - the job that finished
+     */
+    const char* line;
+    const char* eol;
+
+    queue = job->next;
+
+    if (queue == NULL) {
+        queue_tail = NULL;
+    }
+
+    if (!job->idle) {
+        npending--;
+        statusbar_pending(npending);
+    }
+
+    /* whatever the command changed in the task data is not an outside change */
+    if (job->cmdstr != NULL) {
+        watch_ignore();
+        timer_stop(TIMER_COMMAND, job->started);
+        tnc_fprintf(logfp, LOG_DEBUG, "command returned: %d (%s)", job->ret, job->cmdstr);
+    }
+
+    if (cfg.loglvl >= LOG_DEBUG_VERBOSE && job->output != NULL) {
+        for (line = job->output; line < job->output + job->length; line = eol + 1) {
+            eol = memchr(line, '\n', job->output + job->length - line);
+            eol = eol != NULL ? eol : job->output + job->length;
+            tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "%.*s", (int)(eol - line), line);
+        }
+    }
+
+    /* the callback may queue more jobs, which start once it returns or
+     * waits for them
+     */
+    if (job->callback != NULL) {
+        job->callback(job);
+    }
+
+    check_free(job->cmdstr);
+    check_free(job->output);
+    check_free(job->data);
+    free(job);
+
+    jobs_run();
+} /* }}} */
+
+bool job_queue(const char* cmdstr, job_callback callback, void* data,
+               const bool idle) { /* {{{ */
+    /**
+     * add a job to the end of the queue, starting it if nothing is running
+     * cmdstr   - the shell command to run (NULL to only run the callback)
+     * callback - the function run on the ui when the command finishes
+     * data     - passed to the callback, freed along with the job
+     * idle     - whether the job's result is dropped once another is submitted
+     * return is whether the job was queued
+     */
+    struct job* job;
+
+    job_drop_idle();
+    job = job_claim(cmdstr);
+
+    if (job == NULL && (job = calloc(1, sizeof(struct job))) != NULL) {
+        job->cmdstr = cmdstr != NULL ? strdup(cmdstr) : NULL;
+        job->fd     = -1;
+    }
+
+    if (job == NULL) {
+        tnc_fprintf(logfp, LOG_ERROR, "could not allocate job: (%s)",
+                    cmdstr != NULL ? cmdstr : "callback");
+        check_free(data);
+        return false;
+    }
+
+    job->callback   = callback;
+    job->data       = data;
+    job->idle       = idle;
+
+    if (queue_tail == NULL) {
+        queue = job;
+    } else {
+        queue_tail->next = job;
+    }
+
+    queue_tail = job;
+
+    if (!idle) {
+        npending++;
+        statusbar_pending(npending);
+    }
+
+    jobs_run();
+
+    return true;
+} /* }}} */
+
+bool job_read(struct job* job) { /* {{{ */
+    /**
+     * read whatever output a job has available without blocking
+     * job    - the running job to read from
+     * return is whether the job has finished
+     */
+    ssize_t ret;
+    int     status;
+
+    while (1) {
+        if (job->size - job->length < 2) {
+            job->size = job->size > 0 ? 2 * job->size : EXPORTBLOCKLENGTH;
+            job->output = realloc(job->output, job->size);
+        }
+
+        ret = read(job->fd, job->output + job->length, job->size - job->length - 1);
+
+        if (ret > 0) {
+            job->length += ret;
+            job->output[job->length] = 0;
+        } else if (ret < 0 && errno == EINTR) {
+            continue;
+        } else if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return false;
+        } else {
+            break;
+        }
+    }
+
+    /* end of output, collect the exit status */
+    job->output[job->length] = 0;
+    close(job->fd);
+    job->fd = -1;
+
+    while (waitpid(job->pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            status = -1;
+            break;
+        }
+    }
+
+    job->ret = status >= 0 && WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+
+    return true;
+} /* }}} */
+
+bool job_start(struct job* job) { /* {{{ */
+    /**
+     * start running a job's command, its output is read from a pipe
+     * job    - the job to run
+     * return is whether the command was started
+     */
+    tnc_fprintf(logfp, LOG_DEBUG, "running command: %s", job->cmdstr);
+    job->started = timer_start();
+
+    if (!jobs_spawn(job->cmdstr, &(job->pid), &(job->fd))) {
+        job->pid = 0;
+        return false;
+    }
+
+    return true;
+} /* }}} */
+
+int jobs_getch(WINDOW* win) { /* {{{ */
+    /**
+     * wait for a key, handling background jobs while waiting
+     * this replaces wgetch in the main loops, with no jobs running it is wgetch
+     * win    - the window to read the key from
+     * return is the key read, or ERR if the timeout expired or a job finished
+     *        (so the caller can show the result)
+     */
+    return jobs_getch_fd(win, -1);
+} /* }}} */
+
+int jobs_getch_fd(WINDOW* win, const int fd) { /* {{{ */
+    /**
+     * wait for a key, handling background jobs while waiting, and also
+     * watching a descriptor the caller reads itself
+     * win    - the window to read the key from
+     * fd     - the descriptor to watch (-1 for none)
+     * return is the key read, or ERR if the timeout expired, a job finished
+     *        or fd can be read
+     */
+    return jobs_getch_timeout(win, fd, cfg.nc_timeout);
+} /* }}} */
+
+int jobs_getch_timeout(WINDOW* win, const int fd, int timeout) { /* {{{ */
+    /**
+     * wait for a key as jobs_getch_fd does, for at most a given time
+     * win     - the window to read the key from
+     * fd      - the descriptor to watch (-1 for none)
+     * timeout - the longest to wait (ms, -1 for ever), with no jobs running
+     *           and no descriptor to watch the window's own timeout is used
+     * return is the key read, or ERR if the timeout expired, a job finished
+     *        or fd can be read
+     */
+    struct pollfd   fds[3];
+    struct timespec now;
+    long long       deadline = 0;
+    int             c;
+
+    if (queue == NULL && fd < 0) {
+        return wgetch(win);
+    }
+
+    /* keys curses has already read from the terminal are not seen by poll */
+    wtimeout(win, 0);
+    c = wgetch(win);
+
+    if (timeout >= 0) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        deadline = now.tv_sec * 1000LL + now.tv_nsec / 1000000 + timeout;
+    }
+
+    while (c == ERR && (queue != NULL || fd >= 0)) {
+        fds[0].fd       = STDIN_FILENO;
+        fds[0].events   = POLLIN;
+        fds[0].revents  = 0;
+        fds[1].fd       = queue != NULL ? queue->fd : -1;
+        fds[1].events   = POLLIN;
+        fds[1].revents  = 0;
+        fds[2].fd       = fd;
+        fds[2].events   = POLLIN;
+        fds[2].revents  = 0;
+
+        /* a signal (such as a resize) or the timeout returns to the caller */
+        if (poll(fds, 3, timeout) <= 0) {
+            break;
+        }
+
+        if (fds[1].revents != 0 && job_read(queue)) {
+            job_finish(queue);
+            break;
+        }
+
+        if (fds[2].revents != 0) {
+            break;
+        }
+
+        if (fds[0].revents != 0) {
+            c = wgetch(win);
+        } else if (timeout >= 0) {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            timeout = deadline - (now.tv_sec * 1000LL + now.tv_nsec / 1000000);
+
+            if (timeout < 0) {
+                timeout = 0;
+            }
+        }
+    }
+
+    wtimeout(win, cfg.nc_timeout);
+
+    return c;
+} /* }}} */
+
+int jobs_pending(void) { /* {{{ */
+    /* return the number of jobs queued or running */
+    return npending;
+} /* }}} */
+
+void jobs_discard(const pid_t pid, const int fd) { /* {{{ */
+    /**
+     * let a command started with jobs_spawn finish in the background, its
+     * output is read and thrown away
+     * pid - the process running the command
+     * fd  - the pipe the command's output is read from, owned by the job
+     */
+    struct job* job = calloc(1, sizeof(struct job));
+
+    if (job == NULL) {
+        tnc_fprintf(logfp, LOG_ERROR, "could not allocate job to discard output");
+        close(fd);
+        while (waitpid(pid, NULL, 0) < 0 && errno == EINTR);
+        return;
+    }
+
+    job->pid    = pid;
+    job->fd     = fd;
+    job_discard(job);
+} /* }}} */
+
+bool jobs_spawn(const char* cmdstr, pid_t* pid, int* fd) { /* {{{ */
+    /**
+     * start a shell command with its output on a non-blocking pipe
+     * the command's input is /dev/null so a prompt can never wait on the
+     * terminal tasknc is drawing on
+     * cmdstr - the command to run
+     * pid    - set to the process running the command
+     * fd     - set to the pipe the command's output is read from
+     * return is whether the command was started
+     */
+    int fds[2];
+    int devnull;
+
+    if (pipe(fds) != 0) {
+        tnc_fprintf(logfp, LOG_ERROR, "could not create pipe for command: (%s)", cmdstr);
+        return false;
+    }
+
+    *pid = fork();
+
+    if (*pid < 0) {
+        tnc_fprintf(logfp, LOG_ERROR, "could not execute command: (%s)", cmdstr);
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+
+    /* child */
+    if (*pid == 0) {
+        devnull = open("/dev/null", O_RDONLY);
+
+        if (devnull >= 0) {
+            dup2(devnull, STDIN_FILENO);
+            close(devnull);
+        }
+
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        execl("/bin/sh", "sh", "-c", cmdstr, (char*)NULL);
+        _exit(127);
+    }
+
+    /* parent */
+    close(fds[1]);
+    *fd = fds[0];
+    fcntl(*fd, F_SETFD, FD_CLOEXEC);
+    fcntl(*fd, F_SETFL, fcntl(*fd, F_GETFL) | O_NONBLOCK);
+
+    return true;
+} /* }}} */
+
+void jobs_prefetch(const char* cmdstr) { /* {{{ */
+    /**
+     * start a command that is expected to be submitted soon, so it runs
+     * alongside whatever happens until then
+     * the next job submitted takes over the command if it runs the same one,
+     * any other job runs once it has finished
+     * cmdstr - the shell command to start
+     */
+    struct job* job;
+
+    job_claim(NULL);
+    job = calloc(1, sizeof(struct job));
+
+    if (job == NULL || (job->cmdstr = strdup(cmdstr)) == NULL) {
+        check_free(job);
+        return;
+    }
+
+    if (!job_start(job)) {
+        free(job->cmdstr);
+        free(job);
+        return;
+    }
+
+    prefetched = job;
+} /* }}} */
+
+void jobs_run(void) { /* {{{ */
+    /* start the job at the head of the queue if nothing is running
+     * jobs without a command, and jobs that cannot be started, are finished
+     * right away
+     */
+    while (queue != NULL && queue->pid == 0) {
+        if (queue->cmdstr == NULL) {
+            queue->ret = 0;
+        } else if (job_start(queue)) {
+            return;
+        } else {
+            queue->ret = -1;
+        }
+
+        job_finish(queue);
+    }
+} /* }}} */
+
+bool jobs_submit(const char* cmdstr, job_callback callback, void* data) { /* {{{ */
+    /**
+     * queue a command to be run in the background
+     * cmdstr   - the shell command to run, or NULL to only run the callback
+     *            once the jobs queued before it have finished
+     * callback - the function run on the ui when the command finishes
+     *            (may be NULL)
+     * data     - passed to the callback, must be allocated with malloc
+     *            and is freed once the callback returns (may be NULL)
+     * return is whether the job was queued
+     * the result of an idle job that is running is dropped first
+     */
+    return job_queue(cmdstr, callback, data, false);
+} /* }}} */
+
+bool jobs_submit_idle(const char* cmdstr, job_callback callback, void* data) { /* {{{ */
+    /**
+     * run a command in the background only while nothing else is, for work
+     * that can be thrown away, such as fetching what may be shown next
+     * the callback is not run if another job is submitted before the command
+     * finishes, the command is left to finish first
+     * the arguments are those of jobs_submit
+     * return is whether the job was queued, it is not if any job is queued
+     */
+    if (queue != NULL) {
+        check_free(data);
+        return false;
+    }
+
+    return job_queue(cmdstr, callback, data, true);
+} /* }}} */
+
+void jobs_wait(void) { /* {{{ */
+    /* block until every queued job (including any they queue) has finished
+     * the result of an idle job is dropped
+     */
+    struct pollfd fd;
+
+    job_drop_idle();
+
+    while (queue != NULL) {
+        /* a callback waiting on the jobs queued behind its own runs before
+         * the next one has been started
+         */
+        if (queue->pid == 0) {
+            jobs_run();
+            continue;
+        }
+
+        fd.fd       = queue->fd;
+        fd.events   = POLLIN;
+        fd.revents  = 0;
+
+        if (poll(&fd, 1, -1) < 0 && errno != EINTR) {
+            tnc_fprintf(logfp, LOG_ERROR, "waiting for command failed: (%s)",
+                        queue->cmdstr != NULL ? queue->cmdstr : "discarded");
+            break;
+        }
+
+        if (job_read(queue)) {
+            job_finish(queue);
+        }
+    }
+} /* }}} */
+
+// vim: et ts=4 sw=4 sts=4
@@ -0,0 +1,355 @@
+/*
+ * json.c - single pass json tokenizer
+ * for tasknc
+ * by mjheagle
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "json.h"
+
+/* local functions */
+static int hex_value(const char c);
+static size_t put_utf8(char* out, unsigned long cp);
+static unsigned long read_hex4(const char* str);
+
+int hex_value(const char c) { /* {{{ */
+    /* convert a hex digit to its value, or -1 if it is not a hex digit */
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+
+    return -1;
+} /* }}} */
+
+void json_init(struct json_scanner* scanner, const char* buffer,
+               const size_t length) { /* {{{ */
+    /**
+     * prepare a scanner to walk a buffer
+     * scanner - the scanner to initialize
+     * buffer  - the json text (not copied, must outlive the scanner)
+     * length  - the number of characters in the buffer
+     */
+    scanner->pos = buffer;
+    scanner->end = buffer + length;
+} /* }}} */
+
+enum json_token_type json_next(struct json_scanner* scanner,
+                               struct json_token* token) { /* {{{ */
+    /**
+     * scan the next token from the buffer
+     * separators (',' and ':') are treated like whitespace, the caller
+     * tracks keys and values by position within an object
+     * scanner - the scanner to advance
+     * token   - where the token found will be stored
+     * return is the type of the token found
+     */
+    const char* pos = scanner->pos;
+    const char* end = scanner->end;
+
+    /* skip whitespace and separators */
+    while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\n' ||
+                         *pos == '\r' || *pos == ',' || *pos == ':')) {
+        pos++;
+    }
+
+    token->start   = pos;
+    token->length  = 0;
+    token->escaped = false;
+
+    if (pos >= end || *pos == 0) {
+        scanner->pos = end;
+        token->type = JSON_END;
+        return token->type;
+    }
+
+    switch (*pos) {
+    case '{':
+        token->type = JSON_OBJECT_START;
+        pos++;
+        break;
+
+    case '}':
+        token->type = JSON_OBJECT_END;
+        pos++;
+        break;
+
+    case '[':
+        token->type = JSON_ARRAY_START;
+        pos++;
+        break;
+
+    case ']':
+        token->type = JSON_ARRAY_END;
+        pos++;
+        break;
+
+    case '"':
+        pos++;
+        token->start = pos;
+
+        while (pos < end && *pos != '"') {
+            if (*pos == '\\') {
+                token->escaped = true;
+                pos++;
+            }
+
+            pos++;
+        }
+
+        if (pos >= end) {
+            token->type = JSON_ERROR;
+            break;
+        }
+
+        token->type = JSON_STRING;
+        token->length = pos - token->start;
+        pos++;
+        break;
+
+    case '-':
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    case '8':
+    case '9':
+        while (pos < end && ((*pos >= '0' && *pos <= '9') || *pos == '-' ||
+                             *pos == '+' || *pos == '.' || *pos == 'e' || *pos == 'E')) {
+            pos++;
+        }
+
+        token->type = JSON_NUMBER;
+        token->length = pos - token->start;
+        break;
+
+    case 't':
+    case 'f':
+    case 'n':
+        if (end - pos >= 4 && strncmp(pos, "true", 4) == 0) {
+            token->type = JSON_TRUE;
+            pos += 4;
+        } else if (end - pos >= 5 && strncmp(pos, "false", 5) == 0) {
+            token->type = JSON_FALSE;
+            pos += 5;
+        } else if (end - pos >= 4 && strncmp(pos, "null", 4) == 0) {
+            token->type = JSON_NULL;
+            pos += 4;
+        } else {
+            token->type = JSON_ERROR;
+            pos++;
+        }
+
+        token->length = pos - token->start;
+        break;
+
+    default:
+        token->type = JSON_ERROR;
+        pos++;
+        break;
+    }
+
+    scanner->pos = pos;
+
+    return token->type;
+} /* }}} */
+
+void json_skip_line(struct json_scanner* scanner) { /* {{{ */
+    /* move the scanner past the end of the current line (used to recover
+     * from text that is not json, such as taskwarrior messages)
+     */
+    const char* eol = memchr(scanner->pos, '\n', scanner->end - scanner->pos);
+
+    scanner->pos = eol != NULL ? eol + 1 : scanner->end;
+} /* }}} */
+
+bool json_skip_value(struct json_scanner* scanner,
+                     const struct json_token* first) { /* {{{ */
+    /**
+     * skip over a value whose first token has already been scanned
+     * scanner - the scanner positioned after the first token
+     * first   - the first token of the value
+     * return is whether a complete value was skipped
+     */
+    struct json_token   token;
+    int                 depth;
+
+    switch (first->type) {
+    case JSON_OBJECT_START:
+    case JSON_ARRAY_START:
+        depth = 1;
+        break;
+
+    case JSON_END:
+    case JSON_ERROR:
+    case JSON_OBJECT_END:
+    case JSON_ARRAY_END:
+        return false;
+
+    default:
+        return true;
+    }
+
+    while (depth > 0) {
+        switch (json_next(scanner, &token)) {
+        case JSON_OBJECT_START:
+        case JSON_ARRAY_START:
+            depth++;
+            break;
+
+        case JSON_OBJECT_END:
+        case JSON_ARRAY_END:
+            depth--;
+            break;
+
+        case JSON_END:
+        case JSON_ERROR:
+            return false;
+
+        default:
+            break;
+        }
+    }
+
+    return true;
+} /* }}} */
+
+size_t json_unescape(const struct json_token* token, char* out) { /* {{{ */
+    /**
+     * copy the contents of a string token, decoding escapes
+     * token - the string token to be decoded
+     * out   - destination, must hold at least token->length + 1 characters
+     *         (decoded strings are never longer than their escaped form)
+     * return is the length of the decoded string
+     */
+    const char*     pos = token->start;
+    const char*     end = token->start + token->length;
+    char*           dst = out;
+    unsigned long   cp;
+    unsigned long   low;
+
+    if (!token->escaped) {
+        memcpy(out, token->start, token->length);
+        out[token->length] = 0;
+        return token->length;
+    }
+
+    while (pos < end) {
+        if (*pos != '\\' || pos + 1 >= end) {
+            *(dst++) = *(pos++);
+            continue;
+        }
+
+        pos++;
+
+        switch (*pos) {
+        case 'b':
+            *(dst++) = '\b';
+            break;
+
+        case 'f':
+            *(dst++) = '\f';
+            break;
+
+        case 'n':
+            *(dst++) = '\n';
+            break;
+
+        case 'r':
+            *(dst++) = '\r';
+            break;
+
+        case 't':
+            *(dst++) = '\t';
+            break;
+
+        case 'u':
+            if (end - pos < 5 || (cp = read_hex4(pos + 1)) > 0xffff) {
+                *(dst++) = *pos;
+                break;
+            }
+
+            pos += 4;
+
+            /* combine utf-16 surrogate pairs */
+            if (cp >= 0xd800 && cp <= 0xdbff) {
+                if (end - pos >= 7 && pos[1] == '\\' && pos[2] == 'u' &&
+                    (low = read_hex4(pos + 3)) >= 0xdc00 && low <= 0xdfff) {
+                    cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                    pos += 6;
+                } else {
+                    cp = 0xfffd;
+                }
+            } else if (cp >= 0xdc00 && cp <= 0xdfff) {
+                cp = 0xfffd;
+            }
+
+            dst += put_utf8(dst, cp);
+            break;
+
+        default:
+            /* \" \\ \/ and anything unknown map to the character itself */
+            *(dst++) = *pos;
+            break;
+        }
+
+        pos++;
+    }
+
+    *dst = 0;
+
+    return dst - out;
+} /* }}} */
+
+size_t put_utf8(char* out, unsigned long cp) { /* {{{ */
+    /* encode a code point as utf-8, return is the number of bytes written */
+    if (cp < 0x80) {
+        out[0] = cp;
+        return 1;
+    } else if (cp < 0x800) {
+        out[0] = 0xc0 | (cp >> 6);
+        out[1] = 0x80 | (cp & 0x3f);
+        return 2;
+    } else if (cp < 0x10000) {
+        out[0] = 0xe0 | (cp >> 12);
+        out[1] = 0x80 | ((cp >> 6) & 0x3f);
+        out[2] = 0x80 | (cp & 0x3f);
+        return 3;
+    }
+
+    out[0] = 0xf0 | (cp >> 18);
+    out[1] = 0x80 | ((cp >> 12) & 0x3f);
+    out[2] = 0x80 | ((cp >> 6) & 0x3f);
+    out[3] = 0x80 | (cp & 0x3f);
+    return 4;
+} /* }}} */
+
+unsigned long read_hex4(const char* str) { /* {{{ */
+    /* read four hex digits, return is > 0xffff if they are not valid */
+    unsigned long   ret = 0;
+    int             i;
+    int             v;
+
+    for (i = 0; i < 4; i++) {
+        v = hex_value(str[i]);
+
+        if (v < 0) {
+            return 0x10000;
+        }
+
+        ret = (ret << 4) | v;
+    }
+
+    return ret;
+} /* }}} */
+
+// vim: et ts=4 sw=4 sts=4
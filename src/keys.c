@@ -17,6 +17,11 @@
 #include "tasklist.h"
 #include "tasknc.h"
 
+/* the number of keys with a table of binds, binds to keys past the last
+ * curses key are found in the list of binds
+ */
+#define KEYTABLESIZE                    (KEY_MAX + 1)
+
 /**
  * keymap struct to map between key values and names
  * value - the number of the key
@@ -151,6 +156,24 @@ struct keymap keymaps[] = {
 const int nkeys = sizeof(keymaps) / sizeof(struct keymap);
 /* }}} */
 
+/* local functions */
+static void keytable_build(void);
+static void run_keybind(const struct keybind* this_bind);
+
+/* the binds of each key in the tasklist and pager modes, in the order they
+ * were added, so a key press need not walk the list of binds
+ * the binds of key k in mode m are keytable[keystart[m][k]] up to
+ * keytable[keystart[m][k + 1]]
+ * the table is built again when it is next used after binds change
+ */
+static struct keybind** keytable = NULL;
+static int              keystart[MODE_ANY][KEYTABLESIZE + 1];
+static bool             keytable_valid = false;
+
+/* the last bind in the list, and the number of binds */
+static struct keybind*  lastbind = NULL;
+static int              nbinds = 0;
+
 void add_int_keybind(const int key,
                      void* function,
                      const int argint,
@@ -180,9 +203,7 @@ void add_keybind(const int key,
      * arg      - the argument to the function
      * mode     - the mode the bind applies in
      */
-    struct keybind* this_bind;
     struct keybind* new;
-    int             n = 0;
     char*           modestr;
     char*           name;
 
@@ -198,17 +219,14 @@ void add_keybind(const int key,
     /* append it to the list */
     if (keybinds == NULL) {
         keybinds = new;
+        nbinds = 0;
     } else {
-        this_bind = keybinds;
-
-        for (n = 0; this_bind->next != NULL; n++) {
-            this_bind = this_bind->next;
-        }
-
-        this_bind->next = new;
-        n++;
+        lastbind->next = new;
     }
 
+    lastbind = new;
+    keytable_valid = false;
+
     /* write log */
     if (mode == MODE_PAGER) {
         modestr = "pager - ";
@@ -220,58 +238,80 @@ void add_keybind(const int key,
 
     name = name_key(key);
     tnc_fprintf(logfp, LOG_DEBUG,
-                "bind #%d: key %s (%d) bound to @%p %s%s(args: %d/%s)", n, name,
+                "bind #%d: key %s (%d) bound to @%p %s%s(args: %d/%s)", nbinds++, name,
                 key, function, modestr, name_function(function), new->argint,
                 new->argstr);
     free(name);
 } /* }}} */
 
+void free_keybinds(void) { /* {{{ */
+    /* free every keybind */
+    struct keybind* this_bind;
+
+    while (keybinds != NULL) {
+        this_bind = keybinds;
+        keybinds = keybinds->next;
+        check_free(this_bind->argstr);
+        free(this_bind);
+    }
+
+    free(keytable);
+    keytable = NULL;
+    keytable_valid = false;
+    lastbind = NULL;
+    nbinds = 0;
+} /* }}} */
+
 void handle_keypress(const int c,
                      const enum prog_mode mode) { /* {{{ */
-    /* handle a key press on the main screen */
     /**
      * handle a key pressed
      * c    - the key pressed
      * mode - the mode the key was pressed during
      */
     struct keybind* this_bind;
-    char*           modestr;
     char*           keyname;
     bool            match = false;
+    int             i;
 
     /* exit if timeout occurred */
     if (c == ERR) {
         return;
     }
 
-    /* iterate through keybinds */
-    this_bind = keybinds;
-
-    while (this_bind != NULL) {
-        if ((this_bind->mode == mode || this_bind->mode == MODE_ANY) &&
-            c == this_bind->key) {
-            if (this_bind->function != NULL) {
-                if (this_bind->mode == MODE_PAGER) {
-                    modestr = "pager - ";
-                } else if (this_bind->mode == MODE_TASKLIST) {
-                    modestr = "tasklist - ";
-                } else {
-                    modestr = "any - ";
-                }
-
-                tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "calling function @%p %s%s(%s)",
-                            this_bind->function, modestr, name_function(this_bind->function),
-                            this_bind->argstr);
-                (*(this_bind->function))(this_bind->argstr);
-            }
+    if (!keytable_valid) {
+        keytable_build();
+    }
 
+    /* look the key up in the mode's table */
+    if (keytable_valid && mode != MODE_ANY && c >= 0 && c < KEYTABLESIZE) {
+        for (i = keystart[mode][c]; i < keystart[mode][c + 1]; i++) {
+            run_keybind(keytable[i]);
             match = true;
-#ifndef ENABLE_MACROS
+
+            /* a bind that changed the binds leaves the table out of date */
+#ifdef ENABLE_MACROS
+            if (!keytable_valid) {
+                break;
+            }
+#else
             break;
 #endif
         }
+    }
 
-        this_bind = this_bind->next;
+    /* or iterate through keybinds */
+    else {
+        for (this_bind = keybinds; this_bind != NULL; this_bind = this_bind->next) {
+            if ((this_bind->mode == mode || this_bind->mode == MODE_ANY) &&
+                c == this_bind->key) {
+                run_keybind(this_bind);
+                match = true;
+#ifndef ENABLE_MACROS
+                break;
+#endif
+            }
+        }
     }
 
     /* no match found */
@@ -282,6 +322,59 @@ void handle_keypress(const int c,
     }
 } /* }}} */
 
+void keytable_build(void) { /* {{{ */
+    /* build the table of binds of each key from the list of binds */
+    struct keybind*         this_bind;
+    static int              next[MODE_ANY][KEYTABLESIZE];
+    enum prog_mode          mode;
+    int                     n = 0;
+    int                     k;
+
+    memset(keystart, 0, sizeof(keystart));
+
+    /* count the binds of each key, a bind in any mode is in both tables */
+    for (this_bind = keybinds; this_bind != NULL; this_bind = this_bind->next) {
+        for (mode = 0; mode < MODE_ANY; mode++) {
+            if (this_bind->key >= 0 && this_bind->key < KEYTABLESIZE &&
+                (this_bind->mode == mode || this_bind->mode == MODE_ANY)) {
+                keystart[mode][this_bind->key + 1]++;
+                n++;
+            }
+        }
+    }
+
+    free(keytable);
+    keytable = malloc((n + 1) * sizeof(struct keybind*));
+
+    if (keytable == NULL) {
+        tnc_fprintf(logfp, LOG_ERROR, "could not allocate key table (%d binds)", n);
+        return;
+    }
+
+    /* the binds of each key start where those of the key before end */
+    for (mode = 0, n = 0; mode < MODE_ANY; mode++) {
+        for (k = 0; k <= KEYTABLESIZE; k++) {
+            n += keystart[mode][k];
+            keystart[mode][k] = n;
+
+            if (k < KEYTABLESIZE) {
+                next[mode][k] = n;
+            }
+        }
+    }
+
+    for (this_bind = keybinds; this_bind != NULL; this_bind = this_bind->next) {
+        for (mode = 0; mode < MODE_ANY; mode++) {
+            if (this_bind->key >= 0 && this_bind->key < KEYTABLESIZE &&
+                (this_bind->mode == mode || this_bind->mode == MODE_ANY)) {
+                keytable[next[mode][this_bind->key]++] = this_bind;
+            }
+        }
+    }
+
+    keytable_valid = true;
+} /* }}} */
+
 char* name_key(const int val) { /* {{{ */
     /* return a string naming the key */
     char*   name = NULL;
@@ -368,7 +461,32 @@ int remove_keybinds(const int key, const enum prog_mode mode) { /* {{{ */
         this = next;
     }
 
+    lastbind = last;
+    keytable_valid = false;
+
     return counter;
 } /* }}} */
 
+void run_keybind(const struct keybind* this_bind) { /* {{{ */
+    /* run the function of a keybind */
+    char* modestr;
+
+    if (this_bind->function == NULL) {
+        return;
+    }
+
+    if (this_bind->mode == MODE_PAGER) {
+        modestr = "pager - ";
+    } else if (this_bind->mode == MODE_TASKLIST) {
+        modestr = "tasklist - ";
+    } else {
+        modestr = "any - ";
+    }
+
+    tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "calling function @%p %s%s(%s)",
+                this_bind->function, modestr, name_function(this_bind->function),
+                this_bind->argstr);
+    (*(this_bind->function))(this_bind->argstr);
+} /* }}} */
+
 // vim: et ts=4 sw=4 sts=4
@@ -4,78 +4,337 @@
  * by mjheagle
  */
 
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
 #include <stdarg.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <time.h>
 #include "common.h"
+#include "config.h"
 #include "log.h"
 
-void tnc_fprintf(FILE* fp,
-                 const enum log_mode minloglvl,
-                 const char* format,
-                 ...) { /* {{{ */
-    /**
-     * log a message to a file
-     * fp        - the file handle to write the log to
-     * minloglvl - what cfg.loglvl must be above for this log to be written
-     * format    - printf format string for log
+/**
+ * log entry struct - a message waiting in the ring for the writer
+ * seq   - the ring position the slot is ready for: a producer may fill
+ *         the slot when seq is its position, the writer may write it out
+ *         when seq is one past it
+ * fp    - the file the message is written to
+ * time  - when the message was logged
+ * level - the level the message was logged at
+ * msg   - the formatted message
+ * big   - the formatted message when it does not fit in msg, free'd once
+ *         written (NULL otherwise)
+ */
+struct log_entry {
+    unsigned long seq;
+    FILE* fp;
+    time_t time;
+    enum log_mode level;
+    char msg[LOGLINELENGTH];
+    char* big;
+};
+
+/* the ring of messages, filled by any thread and drained by the writer
+ * producers claim a position by advancing ring_head, the writer alone
+ * advances ring_tail
+ */
+static struct log_entry*    ring = NULL;
+static unsigned long        ring_head = 0;
+static unsigned long        ring_tail = 0;
+static pthread_t            writer;
+static sem_t                wakeup;
+static int                  closing = 0;
+static pthread_mutex_t      direct = PTHREAD_MUTEX_INITIALIZER;
+
+/* local functions */
+static const char* log_header(const enum log_mode level);
+static void log_write(FILE* fp, const time_t lt, const enum log_mode level, const char* msg);
+static void* log_writer(void* arg);
+
+void log_close(void) { /* {{{ */
+    /* write out every message logged so far, stop the writer and close the log
+     * safe to call more than once
      */
-    time_t      lt;
-    struct tm*  t;
-    va_list     args;
-    int         ret;
-    const int   timesize = 32;
-    char        timestr[timesize];
-
-    /* determine if msg should be logged */
-    if (minloglvl > cfg.loglvl) {
-        return;
+    if (ring != NULL) {
+        __atomic_store_n(&closing, 1, __ATOMIC_RELEASE);
+        sem_post(&wakeup);
+        pthread_join(writer, NULL);
+        sem_destroy(&wakeup);
+        free(ring);
+        ring = NULL;
+    }
+
+    if (logfp != NULL) {
+        fclose(logfp);
+        logfp = NULL;
     }
+} /* }}} */
+
+void log_flush(void) { /* {{{ */
+    /* wait until every message logged so far has been written out */
+    const unsigned long target = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
 
-    /* get time */
-    lt = time(NULL);
-    t = localtime(&lt);
-    ret = strftime(timestr, timesize, "%F %H:%M:%S", t);
+    if (ring == NULL) {
+        if (logfp != NULL) {
+            fflush(logfp);
+        }
 
-    if (ret == 0) {
         return;
     }
 
-    /* timestamp */
-    if (fp != stdout) {
-        fprintf(fp, "[%s] ", timestr);
+    sem_post(&wakeup);
+
+    while ((long)(__atomic_load_n(&ring_tail, __ATOMIC_ACQUIRE) - target) < 0) {
+        sched_yield();
     }
+} /* }}} */
 
-    /* log type header */
-    switch (minloglvl) {
+const char* log_header(const enum log_mode level) { /* {{{ */
+    /**
+     * get the header a log entry starts with
+     * level  - the level the entry was logged at
+     * return is the header
+     */
+    switch (level) {
     case LOG_WARN:
-        fputs("WARNING: ", fp);
-        break;
+        return "WARNING: ";
 
     case LOG_ERROR:
-        fputs("ERROR: ", fp);
-        break;
+        return "ERROR: ";
 
     case LOG_DEBUG:
     case LOG_DEBUG_VERBOSE:
-        fputs("DEBUG: ", fp);
+        return "DEBUG: ";
 
     default:
-        break;
+        return "";
+    }
+} /* }}} */
+
+bool log_open(const char* path) { /* {{{ */
+    /**
+     * open the log file and start the thread writing to it
+     * if the thread cannot be started, messages are written as they are logged
+     * path   - the path of the log file
+     * return is whether the log file was opened
+     */
+    unsigned long i;
+
+    logfp = fopen(path, "a");
+
+    if (logfp == NULL) {
+        return false;
+    }
+
+    ring = calloc(LOGRINGSIZE, sizeof(struct log_entry));
+
+    if (ring != NULL) {
+        for (i = 0; i < LOGRINGSIZE; i++) {
+            ring[i].seq = i;
+        }
+
+        ring_head = 0;
+        ring_tail = 0;
+        closing = 0;
+
+        if (sem_init(&wakeup, 0, 0) != 0) {
+            check_free(ring);
+            ring = NULL;
+        } else if (pthread_create(&writer, NULL, log_writer, NULL) != 0) {
+            sem_destroy(&wakeup);
+            check_free(ring);
+            ring = NULL;
+        }
+    }
+
+    atexit(log_close);
+
+    return true;
+} /* }}} */
+
+void log_write(FILE* fp, const time_t lt, const enum log_mode level, const char* msg) { /* {{{ */
+    /**
+     * write a log entry to a file
+     * fp     - the file to write to
+     * lt     - when the entry was logged
+     * level  - the level the entry was logged at
+     * msg    - the message
+     * the timestamp is only formatted when the second changes, this is only
+     * called by one thread at a time (the writer, or the logging thread when
+     * there is no writer)
+     */
+    static time_t   stamped = -1;
+    static char     timestr[TIMELENGTH];
+    struct tm       t;
+
+    if (fp == stdout) {
+        fprintf(fp, "%s%s\n", log_header(level), msg);
+        return;
+    }
+
+    if (lt != stamped) {
+        localtime_r(&lt, &t);
+
+        if (strftime(timestr, TIMELENGTH, "%F %H:%M:%S", &t) == 0) {
+            return;
+        }
+
+        stamped = lt;
     }
 
-    /* write log entry */
+    fprintf(fp, "[%s] %s%s\n", timestr, log_header(level), msg);
+} /* }}} */
+
+void* log_writer(void* arg) { /* {{{ */
+    /**
+     * drain the ring to the log file, flushing after each batch of messages
+     * arg    - unused
+     * return is unused
+     */
+    struct log_entry*   entry;
+    FILE*               last;
+    unsigned long       pos;
+
+    (void)arg;
+
+    while (1) {
+        while (sem_wait(&wakeup) != 0 && errno == EINTR);
+
+        pos = ring_tail;
+        last = NULL;
+
+        /* an entry that is claimed but not yet filled ends the batch */
+        while (1) {
+            entry = &(ring[pos & (LOGRINGSIZE - 1)]);
+
+            if (__atomic_load_n(&(entry->seq), __ATOMIC_ACQUIRE) != pos + 1) {
+                break;
+            }
+
+            if (last != NULL && entry->fp != last) {
+                fflush(last);
+            }
+
+            log_write(entry->fp, entry->time, entry->level,
+                      entry->big != NULL ? entry->big : entry->msg);
+            last = entry->fp;
+            check_free(entry->big);
+            entry->big = NULL;
+
+            /* hand the slot back to the producers for the next lap */
+            __atomic_store_n(&(entry->seq), pos + LOGRINGSIZE, __ATOMIC_RELEASE);
+            pos++;
+        }
+
+        if (last != NULL) {
+            fflush(last);
+        }
+
+        __atomic_store_n(&ring_tail, pos, __ATOMIC_RELEASE);
+
+        /* nothing is logged once the log is closing, so the batch was the last */
+        if (__atomic_load_n(&closing, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+    }
+
+    return NULL;
+} /* }}} */
+
+void tnc_log(FILE* fp,
+             const enum log_mode minloglvl,
+             const char* format,
+             ...) { /* {{{ */
+    /**
+     * log a message to a file, called through tnc_fprintf once the level
+     * has been checked
+     * fp        - the file handle to write the log to
+     * minloglvl - what cfg.loglvl must be above for this log to be written
+     * format    - printf format string for log
+     * messages to stdout are written right away, so they stay in order with
+     * the rest of stdout, others are queued for the writer
+     */
+    struct log_entry*   entry;
+    unsigned long       pos;
+    long                diff;
+    va_list             args;
+    char*               msg;
+    int                 ret;
+
+    if (fp == NULL) {
+        return;
+    }
+
+    if (ring == NULL || fp == stdout) {
+        va_start(args, format);
+        ret = vasprintf(&msg, format, args);
+        va_end(args);
+
+        if (ret < 0) {
+            return;
+        }
+
+        /* the timestamp is shared, and messages may come from the parse threads */
+        pthread_mutex_lock(&direct);
+        log_write(fp, time(NULL), minloglvl, msg);
+
+        /* fflush if in debug mode */
+        if (minloglvl > LOG_DEBUG) {
+            fflush(fp);
+        }
+
+        pthread_mutex_unlock(&direct);
+        free(msg);
+
+        return;
+    }
+
+    /* claim the next position, waiting for the writer if the ring is full */
+    pos = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+
+    while (1) {
+        entry = &(ring[pos & (LOGRINGSIZE - 1)]);
+        diff = (long)(__atomic_load_n(&(entry->seq), __ATOMIC_ACQUIRE) - pos);
+
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&ring_head, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            sem_post(&wakeup);
+            sched_yield();
+            pos = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+        } else {
+            pos = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+        }
+    }
+
+    entry->fp = fp;
+    entry->time = time(NULL);
+    entry->level = minloglvl;
     va_start(args, format);
-    vfprintf(fp, format, args);
+    ret = vsnprintf(entry->msg, LOGLINELENGTH, format, args);
     va_end(args);
 
-    /* trailing newline */
-    fputc('\n', fp);
+    /* a longer message is kept whole, or cut short if there is no memory */
+    if (ret >= LOGLINELENGTH) {
+        va_start(args, format);
 
-    /* fflush if in debug mode */
-    if (minloglvl > LOG_DEBUG) {
-        fflush(fp);
+        if (vasprintf(&(entry->big), format, args) < 0) {
+            entry->big = NULL;
+        }
+
+        va_end(args);
     }
+
+    __atomic_store_n(&(entry->seq), pos + 1, __ATOMIC_RELEASE);
+    sem_post(&wakeup);
 } /* }}} */
 
 // vim: et ts=4 sw=4 sts=4
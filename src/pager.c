@@ -7,25 +7,83 @@
 #define _GNU_SOURCE
 #define _XOPEN_SOURCE
 #include <curses.h>
+#include <errno.h>
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include "color.h"
+#include "colstats.h"
 #include "common.h"
 #include "config.h"
 #include "formats.h"
+#include "infocache.h"
+#include "jobs.h"
 #include "keys.h"
 #include "log.h"
 #include "pager.h"
 #include "statusbar.h"
+#include "tags.h"
 #include "tasklist.h"
 #include "tasknc.h"
+#include "timing.h"
+
+/**
+ * pager text struct - the lines shown in a pager, kept in one buffer
+ * buffer    - the text of every line, each null terminated
+ * length    - the number of characters in buffer
+ * size      - the size of buffer
+ * lines     - the offset in buffer of each line shown
+ * nlines    - the number of lines in lines
+ * capacity  - the number of offsets lines has room for
+ * scanned   - how much of buffer has been searched for line ends
+ * linestart - the offset of the line being read
+ * nread     - the number of lines read, including skipped lines
+ * head_skip - how many lines to skip at the beginning of the output
+ * tail_skip - how many lines to skip at the end of the output
+ * fd        - the pipe the command's output is read from (-1 once read)
+ * pid       - the process running the command
+ * ret       - the exit status of the command (-1 until it has finished)
+ * started   - when the command was started, for its timer
+ */
+struct pager_text {
+    char* buffer;
+    size_t length;
+    size_t size;
+    size_t* lines;
+    int nlines;
+    int capacity;
+    size_t scanned;
+    size_t linestart;
+    int nread;
+    int head_skip;
+    int tail_skip;
+    int fd;
+    pid_t pid;
+    int ret;
+    long long started;
+};
 
 /* local functions */
-static void pager_window(struct line* head,
+static int compare_tags(const void* a, const void* b);
+static void pager_add_line(struct pager_text* text, const char* format, ...)
+__attribute__((format(printf, 2, 3)));
+static void pager_end_line(struct pager_text* text, const size_t end);
+static bool pager_grow(struct pager_text* text, const size_t length);
+static void pager_init(struct pager_text* text);
+static void pager_load(struct pager_text* text, const char* output, const size_t length);
+static char* pager_output(const struct pager_text* text);
+static bool pager_read(struct pager_text* text);
+static void pager_release(struct pager_text* text);
+static void pager_split(struct pager_text* text);
+static bool pager_start(struct pager_text* text, const char* cmdstr);
+static int pager_visible(const struct pager_text* text);
+static void pager_window(struct pager_text* text,
                          const bool fullscreen,
-                         int nlines,
                          char* title);
 
 /* global variables */
@@ -34,30 +92,27 @@ int     height;
 int     linecount;
 bool    pager_done;
 
-void free_lines(struct line* head) { /* {{{ */
-    /* iterate through linked list of lines and free all elements */
-    struct line* cur;
-    struct line* last;
-
-    cur = head;
+int compare_tags(const void* a, const void* b) { /* {{{ */
+    /* order tags by the number of tasks with them, then by name */
+    const int ta = *(const int*)a;
+    const int tb = *(const int*)b;
+    const int ca = colstats_tag_count(ta);
+    const int cb = colstats_tag_count(tb);
 
-    while (cur != NULL) {
-        last = cur;
-        cur = cur->next;
-        free(last->str);
-        free(last);
+    if (ca != cb) {
+        return cb - ca;
     }
+
+    return strcmp(tag_name(ta), tag_name(tb));
 } /* }}} */
 
 void help_window(void) { /* {{{ */
     /* display a help window */
-    struct line*    head;
-    struct line*    cur;
-    struct line*    last;
-    struct keybind* this;
-    char*           modestr;
-    char*           keyname;
-    static bool     help_running = false;
+    struct pager_text   text;
+    struct keybind*     this;
+    char*               modestr;
+    char*               keyname;
+    static bool         help_running = false;
 
     /* check for existing help window */
     if (help_running) {
@@ -69,21 +124,14 @@ void help_window(void) { /* {{{ */
     help_running = true;
 
     /* list keybinds */
-    head = calloc(1, sizeof(struct line));
-    head->str = strdup("keybinds");
+    pager_init(&text);
+    pager_add_line(&text, "keybinds");
 
-    last = head;
-    this = keybinds;
-
-    while (this != NULL) {
+    for (this = keybinds; this != NULL; this = this->next) {
         if (this->key == ERR || this->key == KEY_RESIZE) {
-            this = this->next;
             continue;
         }
 
-        cur = calloc(1, sizeof(struct line));
-        last->next = cur;
-
         if (this->mode == MODE_TASKLIST) {
             modestr = "tasklist";
         } else if (this->mode == MODE_PAGER) {
@@ -95,20 +143,18 @@ void help_window(void) { /* {{{ */
         keyname = name_key(this->key);
 
         if (this->argstr == NULL) {
-            asprintf(&(cur->str), "%8s    %-8s    %s", keyname, modestr,
-                     name_function(this->function));
+            pager_add_line(&text, "%8s    %-8s    %s", keyname, modestr,
+                           name_function(this->function));
         } else {
-            asprintf(&(cur->str), "%8s    %-8s    %s %s", keyname, modestr,
-                     name_function(this->function), this->argstr);
+            pager_add_line(&text, "%8s    %-8s    %s %s", keyname, modestr,
+                           name_function(this->function), this->argstr);
         }
 
         free(keyname);
-        this = this->next;
-        last = cur;
     }
 
-    pager_window(head, 1, -1, " help");
-    free_lines(head);
+    pager_window(&text, 1, " help");
+    pager_release(&text);
     help_running = false;
 } /* }}} */
 
@@ -145,6 +191,33 @@ void key_pager_scroll_up(void) { /* {{{ */
     }
 } /* }}} */
 
+void pager_add_line(struct pager_text* text, const char* format, ...) { /* {{{ */
+    /**
+     * add a line to a pager's text
+     * text   - the text to add the line to
+     * format - printf format string for the line
+     */
+    va_list args;
+    int     len;
+
+    va_start(args, format);
+    len = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+
+    if (len < 0 || !pager_grow(text, len + 1)) {
+        return;
+    }
+
+    va_start(args, format);
+    vsnprintf(text->buffer + text->length, len + 1, format, args);
+    va_end(args);
+
+    text->length += len;
+    pager_end_line(text, text->length);
+    text->length++;
+    text->scanned = text->length;
+} /* }}} */
+
 void pager_command(const char* cmdstr,
                    const char* title,
                    const bool fullscreen,
@@ -152,128 +225,285 @@ void pager_command(const char* cmdstr,
                    const int tail_skip) { /* {{{ */
     /**
      * run a command and page through its results
+     * the pager is shown right away and lines are added as the command
+     * prints them
      * cmdstr     - the command to be run
      * title      - the title of the pager
      * fullscreen - whether the pager should be fullscreen
      * head_skip  - how many lines to skip at the beginning of output
      * tail_skip  - how many lines to skip at the end of output
      */
-    FILE*           cmd;
-    char*           str;
-    int             count = 0;
-    int             maxlen = 0;
-    int             len;
-    struct line*    head = NULL;
-    struct line*    last = NULL;
-    struct line*    cur;
-
-    /* run command, gathering strs into a buffer */
-    cmd = popen(cmdstr, "r");
-    str = calloc(TOTALLENGTH, sizeof(char));
-
-    while (fgets(str, TOTALLENGTH, cmd) != NULL) {
-        /* determine max width */
-        len = strlen(str);
-
-        if (len > maxlen) {
-            maxlen = len;
+    struct pager_text text;
+
+    pager_init(&text);
+    text.head_skip = head_skip;
+    text.tail_skip = tail_skip;
+
+    if (!pager_start(&text, cmdstr)) {
+        return;
+    }
+
+    pager_window(&text, fullscreen, (char*)title);
+    pager_release(&text);
+} /* }}} */
+
+void pager_end_line(struct pager_text* text, const size_t end) { /* {{{ */
+    /**
+     * terminate the line being read and add it to the lines shown
+     * text - the text being read
+     * end  - the offset of the end of the line
+     */
+    const size_t    start = text->linestart;
+    size_t*         lines;
+
+    text->buffer[end] = 0;
+    text->linestart = end + 1;
+
+    if (text->nread++ < text->head_skip) {
+        return;
+    }
+
+    if (text->nlines == text->capacity) {
+        lines = realloc(text->lines, 2 * (text->capacity + 16) * sizeof(size_t));
+
+        if (lines == NULL) {
+            tnc_fprintf(logfp, LOG_ERROR, "could not allocate pager lines (%d)", text->nlines);
+            return;
         }
 
-        /* create line */
-        cur = calloc(1, sizeof(struct line));
-        cur->str = str;
-
-        /* place line in list */
-        if (count == head_skip) {
-            head = cur;
-        } else if (count < head_skip) {
-            free(cur->str);
-            free(cur);
-        } else if (last != NULL) {
-            last->next = cur;
+        text->lines = lines;
+        text->capacity = 2 * (text->capacity + 16);
+    }
+
+    text->lines[text->nlines++] = start;
+} /* }}} */
+
+bool pager_grow(struct pager_text* text, const size_t length) { /* {{{ */
+    /**
+     * make room in a pager's buffer
+     * the lines are kept as offsets, so they survive the buffer moving
+     * text   - the text to grow
+     * length - the number of characters that must fit after the text
+     * return is whether the room was made
+     */
+    size_t  size = text->size > 0 ? text->size : EXPORTBLOCKLENGTH / 16;
+    char*   buffer;
+
+    while (size - text->length < length + 1) {
+        size *= 2;
+    }
+
+    if (size == text->size) {
+        return true;
+    }
+
+    buffer = realloc(text->buffer, size);
+
+    if (buffer == NULL) {
+        tnc_fprintf(logfp, LOG_ERROR, "could not allocate pager buffer (%zu bytes)", size);
+        return false;
+    }
+
+    text->buffer = buffer;
+    text->size = size;
+
+    return true;
+} /* }}} */
+
+void pager_init(struct pager_text* text) { /* {{{ */
+    /* start an empty pager text, with no command being read */
+    memset(text, 0, sizeof(struct pager_text));
+    text->fd = -1;
+    text->ret = -1;
+} /* }}} */
+
+void pager_load(struct pager_text* text, const char* output, const size_t length) { /* {{{ */
+    /**
+     * fill a pager's text with a command's output, as if it had been read
+     * text   - the text to fill
+     * output - everything the command printed
+     * length - the number of characters in output
+     */
+    if (!pager_grow(text, length)) {
+        return;
+    }
+
+    memcpy(text->buffer + text->length, output, length);
+    text->length += length;
+    text->ret = 0;
+    pager_split(text);
+} /* }}} */
+
+char* pager_output(const struct pager_text* text) { /* {{{ */
+    /**
+     * get the output a pager's command printed, once it has all been read
+     * return is the output, which must be freed, or NULL if it failed
+     */
+    char*   output;
+    size_t  i;
+
+    if (text->fd >= 0 || text->ret != 0 || (output = malloc(text->length + 1)) == NULL) {
+        return NULL;
+    }
+
+    /* every line was ended in place, the last may have ended with no newline */
+    for (i = 0; i < text->length; i++) {
+        output[i] = text->buffer[i] != 0 ? text->buffer[i] : '\n';
+    }
+
+    output[text->length] = 0;
+
+    return output;
+} /* }}} */
+
+bool pager_read(struct pager_text* text) { /* {{{ */
+    /**
+     * read whatever output a pager's command has available without blocking
+     * text   - the text being read
+     * return is whether any lines were added
+     */
+    const int   oldlines = text->nlines;
+    ssize_t     ret;
+    int         status;
+
+    while (text->fd >= 0) {
+        if (!pager_grow(text, EXPORTBLOCKLENGTH / 16)) {
+            break;
         }
 
-        /* move to next line */
-        str = calloc(256, sizeof(char));
-        count++;
-        last = cur;
+        ret = read(text->fd, text->buffer + text->length, text->size - text->length - 1);
+
+        if (ret > 0) {
+            text->length += ret;
+        } else if (ret < 0 && errno == EINTR) {
+            continue;
+        } else if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            /* end of output, the last line may not have ended */
+            close(text->fd);
+            text->fd = -1;
+            text->ret = waitpid(text->pid, &status, 0) == text->pid && WIFEXITED(status) ?
+                        WEXITSTATUS(status) : -1;
+            timer_stop(TIMER_PAGER_COMMAND, text->started);
+        }
+
+        pager_split(text);
     }
 
-    free(str);
-    pclose(cmd);
-    count -= tail_skip;
+    return text->nlines != oldlines;
+} /* }}} */
 
-    /* run pager */
-    pager_window(head, fullscreen, count, (char*)title);
+void pager_release(struct pager_text* text) { /* {{{ */
+    /* free a pager's text, a command still running is left to finish in the
+     * background rather than stopped, as it may be writing the task data
+     */
+    if (text->fd >= 0) {
+        jobs_discard(text->pid, text->fd);
+        text->fd = -1;
+    }
+
+    check_free(text->buffer);
+    check_free(text->lines);
+} /* }}} */
+
+void pager_split(struct pager_text* text) { /* {{{ */
+    /* split the output added to a pager's text into lines, the last line
+     * is ended once the command has finished
+     */
+    char* eol;
+
+    while (text->scanned < text->length &&
+           (eol = memchr(text->buffer + text->scanned, '\n',
+                         text->length - text->scanned)) != NULL) {
+        text->scanned = eol - text->buffer + 1;
+        pager_end_line(text, eol - text->buffer);
+    }
+
+    text->scanned = text->length;
+
+    if (text->fd < 0 && text->linestart < text->length) {
+        pager_end_line(text, text->length);
+        text->length++;
+        text->scanned = text->length;
+    }
+} /* }}} */
+
+bool pager_start(struct pager_text* text, const char* cmdstr) { /* {{{ */
+    /**
+     * start the command whose output a pager's text is read from
+     * text   - the text to read the output into
+     * cmdstr - the command to run
+     * return is whether the command was started
+     */
+    text->started = timer_start();
+
+    if (!jobs_spawn(cmdstr, &(text->pid), &(text->fd))) {
+        text->fd = -1;
+        statusbar_message(cfg.statusbar_timeout, "could not run command");
+        return false;
+    }
+
+    /* whatever the command printed right away is on the first screen */
+    pager_read(text);
+
+    return true;
+} /* }}} */
+
+int pager_visible(const struct pager_text* text) { /* {{{ */
+    /* count the lines of a pager's text that are shown
+     * tail_skip counts every line of the output, like head_skip does, and
+     * while the command runs the lines that may be skipped are held back
+     */
+    const int visible = text->nread - text->tail_skip;
 
-    /* free lines */
-    free_lines(head);
+    return visible < text->nlines ? (visible > 0 ? visible : 0) : text->nlines;
 } /* }}} */
 
-void pager_window(struct line* head,
+void pager_window(struct pager_text* text,
                   const bool fullscreen,
-                  int nlines,
                   char* title) { /* {{{ */
     /**
-     * page through a linked list of lines
-     * head       - the first line to print
+     * page through the lines of a text, reading more while its command runs
+     * text       - the lines to print
      * fullscreen - whether the pager should be fullscreen
-     * nlines     - the number of lines that will be printed
      * title      - the title of the pager
      */
-    int             startx;
-    int             starty;
     int             lineno;
     int             c;
     int             taskheight;
-    struct line* tmp;
-    offset = 0;
+    int             newheight;
     WINDOW*         last_pager      = NULL;
     const int       orig_offset     = offset;
     const int       orig_height     = height;
     const int       orig_linecount  = linecount;
 
+    offset = 0;
+
     /* store previous pager window if necessary */
     if (pager != NULL) {
         last_pager = pager;
     }
 
-    /* count lines if necessary */
-    if (nlines <= 0) {
-        tmp = head;
-        nlines = 0;
-
-        while (tmp != NULL) {
-            nlines++;
-            tmp = tmp->next;
-        }
-    }
-
     /* exit if there are no lines */
+    linecount = pager_visible(text);
     tnc_fprintf(logfp, LOG_DEBUG, "pager: linecount=%d", linecount);
 
-    if (nlines == 0) {
+    if (linecount == 0 && text->fd < 0) {
         return;
     }
 
-    linecount = nlines;
-
     /* determine screen dimensions and create window */
     taskheight = getmaxy(tasklist);
 
     if (fullscreen) {
         height = taskheight;
-        starty = 1;
-        startx = 0;
     } else {
         height = linecount + 1 < taskheight ? linecount + 1 : taskheight;
-        starty = rows - height - 1;
-        startx = 0;
     }
 
-    tnc_fprintf(logfp, LOG_DEBUG, "pager: h=%d w=%d y=%d x=%d", height, cols,
-                starty, startx);
-    pager = newwin(height, cols, starty, startx);
+    tnc_fprintf(logfp, LOG_DEBUG, "pager: h=%d w=%d", height, cols);
+    pager = newwin(height, cols, fullscreen ? 1 : rows - height - 1, 0);
 
     /* check if pager was created */
     if (pager == NULL) {
@@ -285,34 +515,49 @@ void pager_window(struct line* head,
     pager_done = false;
 
     while (1) {
+        /* add what the command has printed, growing a window fit to its lines */
+        if (text->fd >= 0 || linecount != pager_visible(text)) {
+            if (pager_read(text) || text->fd < 0) {
+                linecount = pager_visible(text);
+            }
+
+            if (linecount == 0 && text->fd < 0) {
+                break;
+            }
+
+            newheight = linecount + 1 < taskheight ? linecount + 1 : taskheight;
+
+            if (!fullscreen && newheight != height) {
+                height = newheight;
+                wresize(pager, height, cols);
+                mvwin(pager, rows - height - 1, 0);
+            }
+        }
+
         tnc_fprintf(logfp, LOG_DEBUG, "offset:%d height:%d lines:%d", offset, height,
                     linecount);
 
         /* print title */
         wattrset(pager, get_colors(OBJECT_HEADER, NULL, NULL));
-        mvwhline(pager, offset, 0, ' ', cols);
-        umvaddstr_align(pager, offset, title);
+        mvwhline(pager, 0, 0, ' ', cols);
+        umvaddstr_align(pager, 0, title);
 
-        /* print lines */
+        /* print the visible lines, each found directly by its offset */
         wattrset(pager, COLOR_PAIR(0));
-        tmp = head;
-        lineno = 1;
 
-        while (tmp != NULL && lineno <= linecount && lineno - offset <= height) {
-            if (lineno > offset) {
-                mvwhline(pager, lineno - offset, 0, ' ', cols);
-                umvaddstr(pager, lineno - offset, 0, tmp->str);
-            }
+        for (lineno = 1; lineno < height; lineno++) {
+            mvwhline(pager, lineno, 0, ' ', cols);
 
-            lineno++;
-            tmp = tmp->next;
+            if (offset + lineno <= linecount) {
+                umvaddstr(pager, lineno, 0, "%s", text->buffer + text->lines[offset + lineno - 1]);
+            }
         }
 
         touchwin(pager);
         wrefresh(pager);
 
-        /* accept keys */
-        c = wgetch(statusbar);
+        /* accept keys, or wake up for more of the command's output */
+        c = jobs_getch_fd(statusbar, text->fd);
         handle_keypress(c, MODE_PAGER);
 
         if (pager_done) {
@@ -365,21 +610,113 @@ void view_stats(void) { /* {{{ */
     free(cmdstr);
 } /* }}} */
 
+void view_tags(void) { /* {{{ */
+    /* page the tags of the loaded tasks, with the number of tasks with each */
+    struct pager_text   text;
+    const int           ntags = tag_count();
+    int*                tags = malloc(ntags * sizeof(int) + 1);
+    int                 ntasks;
+    int                 n = 0;
+    int                 width = 0;
+    int                 i;
+
+    if (tags == NULL) {
+        return;
+    }
+
+    /* the counts are kept by the task table, tags no task has are left out */
+    for (i = 0; i < ntags; i++) {
+        if (colstats_tag_count(i) > 0) {
+            tags[n++] = i;
+            width = (int)strlen(tag_name(i)) > width ? (int)strlen(tag_name(i)) : width;
+        }
+    }
+
+    qsort(tags, n, sizeof(int), compare_tags);
+    pager_init(&text);
+
+    if (n == 0) {
+        pager_add_line(&text, "no loaded task has a tag");
+    }
+
+    for (i = 0; i < n; i++) {
+        ntasks = colstats_tag_count(tags[i]);
+        pager_add_line(&text, "%-*s %d task%s", width, tag_name(tags[i]), ntasks,
+                       ntasks == 1 ? "" : "s");
+    }
+
+    free(tags);
+    pager_window(&text, 1, " tags");
+    pager_release(&text);
+} /* }}} */
+
+void view_timing(void) { /* {{{ */
+    /* page the timers of the hot code paths and the phases of startup */
+    struct pager_text   text;
+    char*               histogram;
+    int                 i;
+
+    timing_refresh();
+    pager_init(&text);
+    pager_add_line(&text, "%s", cfg.timing ? "timing is enabled" :
+                   "timing is disabled (set timing 1 to enable)");
+
+    for (i = 0; i < TIMER_COUNT; i++) {
+        histogram = timer_histogram(i);
+        pager_add_line(&text, "%-14s %s", timers[i].name, timers[i].value);
+        pager_add_line(&text, "%-14s %s", "", histogram != NULL ? histogram : "");
+        free(histogram);
+    }
+
+    /* startup is timed whether or not timing is enabled */
+    pager_add_line(&text, "%s", "");
+    pager_add_line(&text, "%s", "startup");
+
+    for (i = 0; i < PHASE_COUNT; i++) {
+        pager_add_line(&text, "%-14s %s", phases[i].name, phases[i].value);
+    }
+
+    pager_window(&text, 1, " timing");
+    pager_release(&text);
+} /* }}} */
+
 void view_task(struct task* this) { /* {{{ */
-    /* run `task info` and print it to a window */
-    char* cmdstr;
-    char* title;
+    /* run `task info` and print it to a window
+     * info fetched before is shown straight away, and info fetched here is
+     * kept for the next time the task is viewed
+     */
+    const int           width = cols - 4;
+    const struct info*  cached = infocache_find(this, width);
+    struct info         request;
+    struct pager_text   text;
+    char*               cmdstr = NULL;
+    char*               title;
+    char*               output;
+
+    pager_init(&text);
+    text.head_skip = 1;
+    text.tail_skip = 4;
+
+    if (cached != NULL) {
+        tnc_fprintf(logfp, LOG_DEBUG, "info cache: showing %zu bytes", cached->length);
+        pager_load(&text, cached->output, cached->length);
+    } else if (!pager_start(&text, (cmdstr = infocache_command(this, width)))) {
+        free(cmdstr);
+        return;
+    }
 
-    /* build command and title */
-    asprintf(&cmdstr, "task %s info rc._forcecolor=no rc.defaultwidth=%d 2>&1",
-             this->uuid, cols - 4);
+    /* build title and run pager, the task may be reloaded while it is open */
+    infocache_request(this, width, &request);
     title = (char*)eval_format(cfg.formats.view_compiled, this);
+    pager_window(&text, 0, title);
 
-    /* run pager */
-    pager_command(cmdstr, title, 0, 1, 4);
+    if (cached == NULL && (output = pager_output(&text)) != NULL) {
+        infocache_store(&request, output, text.length);
+    }
 
     /* clean up */
-    free(cmdstr);
+    pager_release(&text);
+    check_free(cmdstr);
     free(title);
 } /* }}} */
 
@@ -0,0 +1,517 @@
+/*
+ * searchindex.c - trigram index narrowing searches of the task list
+ * for tasknc
+ * by mjheagle
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "config.h"
+#include "log.h"
+#include "searchindex.h"
+#include "tasktable.h"
+
+/* local functions */
+static void add_field(const struct task* this, const char* field);
+static int compare_positions(const void* a, const void* b);
+static bool index_build(void);
+static struct posting* index_find(const uint32_t key, const bool create);
+static bool index_grow(void);
+static bool is_indexed(const unsigned char c);
+static void query_forget(void);
+static int pattern_trigrams(const char* pattern, uint32_t* keys);
+static int run_trigrams(const char* run, const int len, uint32_t* keys, int nkeys);
+static void remove_field(const struct task* this, const char* field);
+static uint32_t trigram_key(const char* str);
+
+/* the index, it is built by the first search after the task list is built
+ * and updated as single tasks are replaced or removed
+ */
+static struct posting*      slots = NULL;
+static size_t               nslots = 0;
+static size_t               nused = 0;
+static bool                 built = false;
+static bool                 failed = false;
+static const struct task**  results = NULL;
+static int                  nresults = 0;
+
+/* the last query, whose candidates are kept in results until the index or
+ * the order of the list changes
+ */
+static char*                query = NULL;
+static int                  nquery = 0;
+
+void add_field(const struct task* this, const char* field) { /* {{{ */
+    /**
+     * add a task to the postings of every trigram in one of its fields
+     * this  - the task to add
+     * field - the field's text (may be NULL)
+     * a task is added to a posting once, however often the trigram repeats,
+     * as its trigrams are added one after another
+     */
+    struct posting* posting;
+    const char*     pos;
+
+    if (field == NULL) {
+        return;
+    }
+
+    for (pos = field; pos[0] != 0 && pos[1] != 0 && pos[2] != 0; pos++) {
+        if (!is_indexed(pos[0]) || !is_indexed(pos[1]) || !is_indexed(pos[2])) {
+            continue;
+        }
+
+        posting = index_find(trigram_key(pos), true);
+
+        if (posting == NULL) {
+            failed = true;
+            return;
+        }
+
+        if (posting->count > 0 && posting->tasks[posting->count - 1] == this) {
+            continue;
+        }
+
+        if (posting->count == posting->capacity) {
+            posting->capacity = posting->capacity > 0 ? 2 * posting->capacity : 4;
+            posting->tasks = realloc(posting->tasks, posting->capacity * sizeof(struct task*));
+
+            if (posting->tasks == NULL) {
+                tnc_fprintf(logfp, LOG_ERROR, "could not grow search index posting");
+                posting->count = 0;
+                posting->capacity = 0;
+                failed = true;
+                return;
+            }
+        }
+
+        posting->tasks[posting->count++] = this;
+    }
+} /* }}} */
+
+int compare_positions(const void* a, const void* b) { /* {{{ */
+    /* order tasks by their position in the task list */
+    const struct task* ta = *(const struct task* const*)a;
+    const struct task* tb = *(const struct task* const*)b;
+
+    return ta->position - tb->position;
+} /* }}} */
+
+bool index_build(void) { /* {{{ */
+    /**
+     * index every task in the task table
+     * return is whether the index was built
+     */
+    const struct task*  this;
+    int                 i;
+
+    searchindex_clear();
+    built = true;
+
+    for (i = 0; (this = tasktable_get(i)) != NULL; i++) {
+        searchindex_add(this);
+    }
+
+    tnc_fprintf(logfp, LOG_DEBUG, "search index: %d tasks, %zu trigrams", i, nused);
+
+    return !failed;
+} /* }}} */
+
+struct posting* index_find(const uint32_t key, const bool create) { /* {{{ */
+    /**
+     * look up the posting of a trigram
+     * key    - the trigram
+     * create - whether to add an empty posting if there is none
+     * return is the posting, or NULL if there is none (or no memory for it)
+     */
+    size_t mask;
+    size_t i;
+
+    if (nslots == 0 || (create && 2 * (nused + 1) > nslots)) {
+        if (!create || !index_grow()) {
+            return NULL;
+        }
+    }
+
+    mask = nslots - 1;
+
+    /* multiplicative hash, trigrams of nearby characters differ in few bits */
+    for (i = (key * 2654435761u) & mask; slots[i].key != 0; i = (i + 1) & mask) {
+        if (slots[i].key == key) {
+            return &(slots[i]);
+        }
+    }
+
+    if (!create) {
+        return NULL;
+    }
+
+    slots[i].key = key;
+    nused++;
+
+    return &(slots[i]);
+} /* }}} */
+
+bool index_grow(void) { /* {{{ */
+    /**
+     * double the number of slots in the index, keeping it at most half full
+     * return is whether the index could be grown
+     */
+    struct posting* old = slots;
+    const size_t    oldslots = nslots;
+    size_t          mask;
+    size_t          i;
+    size_t          j;
+
+    nslots = nslots > 0 ? 2 * nslots : SEARCHINDEXSLOTS;
+    slots = calloc(nslots, sizeof(struct posting));
+
+    if (slots == NULL) {
+        tnc_fprintf(logfp, LOG_ERROR, "could not grow search index (%zu slots)", nslots);
+        slots = old;
+        nslots = oldslots;
+        return false;
+    }
+
+    mask = nslots - 1;
+
+    for (i = 0; i < oldslots; i++) {
+        if (old[i].key == 0) {
+            continue;
+        }
+
+        for (j = (old[i].key * 2654435761u) & mask; slots[j].key != 0; j = (j + 1) & mask);
+
+        slots[j] = old[i];
+    }
+
+    free(old);
+
+    return true;
+} /* }}} */
+
+bool is_indexed(const unsigned char c) { /* {{{ */
+    /* whether a character is part of indexed trigrams
+     * only ascii is indexed, where case folding is the same as the regex's
+     */
+    return c > 0 && c < 128;
+} /* }}} */
+
+void query_forget(void) { /* {{{ */
+    /* drop the candidates of the last query */
+    free(query);
+    query = NULL;
+    nquery = 0;
+} /* }}} */
+
+int pattern_trigrams(const char* pattern, uint32_t* keys) { /* {{{ */
+    /**
+     * find the trigrams that any text matching a pattern must contain
+     * these come from the runs of literal characters in the pattern, broken
+     * wherever the pattern allows other characters or leaves one out
+     * pattern - the extended regex
+     * keys    - filled with the trigrams, SEARCHINDEXMAXKEYS long
+     * return is the number of trigrams, or -1 if the pattern has alternatives
+     *        (so no trigram is certain)
+     */
+    const char* pos;
+    const char* end;
+    char        run[TOTALLENGTH];
+    int         len = 0;
+    int         nkeys = 0;
+
+    for (pos = pattern; *pos != 0; pos++) {
+        switch (*pos) {
+        case '|':
+        case '(':
+        case ')':
+            return -1;
+
+        case '\\':
+            /* an escaped special character is literal, anything else is a class */
+            if (pos[1] != 0 && strchr(".[]()|*+?{}^$\\/", pos[1]) != NULL) {
+                pos++;
+                break;
+            }
+
+            nkeys = run_trigrams(run, len, keys, nkeys);
+            len = 0;
+            pos += pos[1] != 0;
+            continue;
+
+        case '[':
+            /* a bracket expression may start with a literal ] */
+            nkeys = run_trigrams(run, len, keys, nkeys);
+            len = 0;
+            pos += pos[1] == '^';
+            pos += pos[1] == ']';
+
+            while (pos[1] != 0 && pos[1] != ']') {
+                /* skip classes such as [:alpha:], which hold a ] of their own */
+                if (pos[1] == '[' && pos[2] != 0 && strchr(":.=", pos[2]) != NULL) {
+                    end = strchr(pos + 3, pos[2]);
+
+                    while (end != NULL && end[1] != ']') {
+                        end = strchr(end + 1, pos[2]);
+                    }
+
+                    if (end == NULL) {
+                        return nkeys;
+                    }
+
+                    pos = end;
+                }
+
+                pos++;
+            }
+
+            pos += pos[1] != 0;
+            continue;
+
+        case '*':
+        case '?':
+        case '{':
+            /* the character before may be left out */
+            nkeys = run_trigrams(run, len - (len > 0), keys, nkeys);
+            len = 0;
+
+            if (*pos == '{') {
+                while (pos[1] != 0 && pos[1] != '}') {
+                    pos++;
+                }
+
+                if (pos[1] == 0) {
+                    return nkeys;
+                }
+
+                pos++;
+            }
+
+            continue;
+
+        case '+':
+            /* the character before may repeat, so it starts a new run */
+            nkeys = run_trigrams(run, len, keys, nkeys);
+            run[0] = len > 0 ? run[len - 1] : 0;
+            len = len > 0;
+            continue;
+
+        case '.':
+        case '^':
+        case '$':
+            nkeys = run_trigrams(run, len, keys, nkeys);
+            len = 0;
+            continue;
+
+        default:
+            break;
+        }
+
+        if (!is_indexed(*pos) || len >= TOTALLENGTH) {
+            nkeys = run_trigrams(run, len, keys, nkeys);
+            len = 0;
+            continue;
+        }
+
+        run[len++] = *pos;
+    }
+
+    return run_trigrams(run, len, keys, nkeys);
+} /* }}} */
+
+void remove_field(const struct task* this, const char* field) { /* {{{ */
+    /**
+     * remove a task from the postings of every trigram in one of its fields
+     * this  - the task to remove
+     * field - the field's text (may be NULL)
+     */
+    struct posting* posting;
+    const char*     pos;
+    int             i;
+
+    if (field == NULL) {
+        return;
+    }
+
+    for (pos = field; pos[0] != 0 && pos[1] != 0 && pos[2] != 0; pos++) {
+        if (!is_indexed(pos[0]) || !is_indexed(pos[1]) || !is_indexed(pos[2]) ||
+            (posting = index_find(trigram_key(pos), false)) == NULL) {
+            continue;
+        }
+
+        for (i = posting->count - 1; i >= 0 && posting->tasks[i] != this; i--);
+
+        if (i >= 0) {
+            posting->tasks[i] = posting->tasks[--posting->count];
+        }
+    }
+} /* }}} */
+
+int run_trigrams(const char* run, const int len, uint32_t* keys, int nkeys) { /* {{{ */
+    /**
+     * add the trigrams of a run of literal characters to a set
+     * run   - the characters
+     * len   - the number of characters
+     * keys  - the set of trigrams, SEARCHINDEXMAXKEYS long
+     * nkeys - the number of trigrams in the set
+     * return is the number of trigrams in the set
+     */
+    uint32_t    key;
+    int         i;
+    int         j;
+
+    for (i = 0; i + 3 <= len && nkeys < SEARCHINDEXMAXKEYS; i++) {
+        key = trigram_key(run + i);
+
+        for (j = 0; j < nkeys && keys[j] != key; j++);
+
+        if (j == nkeys) {
+            keys[nkeys++] = key;
+        }
+    }
+
+    return nkeys;
+} /* }}} */
+
+void searchindex_add(const struct task* this) { /* {{{ */
+    /**
+     * index a task, if the index has been built
+     * this - the task to add
+     */
+    if (!built) {
+        return;
+    }
+
+    query_forget();
+    add_field(this, this->description);
+    add_field(this, this->project);
+    add_field(this, this->tags);
+} /* }}} */
+
+void searchindex_clear(void) { /* {{{ */
+    /* release the index, it is built again by the next search */
+    size_t i;
+
+    for (i = 0; i < nslots; i++) {
+        free(slots[i].tasks);
+    }
+
+    query_forget();
+    free(slots);
+    free(results);
+    slots = NULL;
+    nslots = 0;
+    nused = 0;
+    built = false;
+    failed = false;
+    results = NULL;
+    nresults = 0;
+} /* }}} */
+
+int searchindex_query(const char* pattern, const struct task*** candidates) { /* {{{ */
+    /**
+     * find the tasks that may match a search
+     * pattern    - the extended regex searched for
+     * candidates - set to the tasks, in list order, which are owned by the
+     *              index and valid until it changes
+     * return is the number of candidates, or -1 if the index cannot narrow
+     *        the search and every task must be checked
+     * every task that matches is a candidate, but candidates must still be
+     * checked against the pattern
+     */
+    uint32_t        keys[SEARCHINDEXMAXKEYS];
+    struct posting* shortest = NULL;
+    struct posting* posting;
+    int             nkeys;
+    int             i;
+
+    if (query != NULL && pattern != NULL && str_eq(pattern, query)) {
+        *candidates = results;
+        return nquery;
+    }
+
+    nkeys = pattern != NULL ? pattern_trigrams(pattern, keys) : -1;
+
+    /* an index missing tasks for lack of memory is dropped, and tried again */
+    if (failed) {
+        searchindex_clear();
+    }
+
+    if (nkeys <= 0 || (!built && !index_build())) {
+        return -1;
+    }
+
+    /* the rarest trigram narrows the search the most */
+    for (i = 0; i < nkeys; i++) {
+        posting = index_find(keys[i], false);
+
+        if (posting == NULL || posting->count == 0) {
+            *candidates = NULL;
+            return 0;
+        }
+
+        if (shortest == NULL || posting->count < shortest->count) {
+            shortest = posting;
+        }
+    }
+
+    if (shortest->count > nresults) {
+        free(results);
+        nresults = shortest->count;
+        results = malloc(nresults * sizeof(struct task*));
+
+        if (results == NULL) {
+            nresults = 0;
+            return -1;
+        }
+    }
+
+    memcpy(results, shortest->tasks, shortest->count * sizeof(struct task*));
+    qsort(results, shortest->count, sizeof(struct task*), compare_positions);
+    *candidates = results;
+
+    /* searching again, as search next does, reuses the sorted candidates */
+    query = strdup(pattern);
+    nquery = query != NULL ? shortest->count : 0;
+
+    return shortest->count;
+} /* }}} */
+
+void searchindex_remove(const struct task* this) { /* {{{ */
+    /**
+     * remove a task from the index, if it has been built
+     * this - the task to remove, its fields must not have changed since it
+     *        was added
+     */
+    if (!built) {
+        return;
+    }
+
+    query_forget();
+    remove_field(this, this->description);
+    remove_field(this, this->project);
+    remove_field(this, this->tags);
+} /* }}} */
+
+void searchindex_reorder(void) { /* {{{ */
+    /* note that the tasks in the list have moved, so candidates must be sorted again */
+    query_forget();
+} /* }}} */
+
+uint32_t trigram_key(const char* str) { /* {{{ */
+    /* pack three characters into a trigram, ignoring ascii case */
+    uint32_t    key = 0;
+    int         i;
+    char        c;
+
+    for (i = 0; i < 3; i++) {
+        c = str[i] >= 'A' && str[i] <= 'Z' ? str[i] - 'A' + 'a' : str[i];
+        key = (key << 8) | (unsigned char)c;
+    }
+
+    return key;
+} /* }}} */
+
+// vim: et ts=4 sw=4 sts=4
@@ -0,0 +1,542 @@
+/*
+ * snapshot.c - save the task list to show right away on the next launch
+ * for tasknc
+ * by mjheagle
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "arena.h"
+#include "common.h"
+#include "config.h"
+#include "intern.h"
+#include "log.h"
+#include "snapshot.h"
+#include "tags.h"
+#include "tasks.h"
+
+/* identifies a snapshot file and the layout of its records */
+#define SNAPSHOT_MAGIC                  "tncsnap"
+#define SNAPSHOT_VERSION                2
+
+/* blob offset of a missing string */
+#define SNAPSHOT_NULL                   UINT32_MAX
+
+/**
+ * snapshot header struct - the start of a snapshot file
+ * magic      - SNAPSHOT_MAGIC
+ * version    - SNAPSHOT_VERSION
+ * recordsize - the size of a task record, rejects files from other builds
+ * ntasks     - the number of task records
+ * nextras    - the number of extra records
+ * bloblength - the size of the string blob
+ * modified   - the newest modification time in the saved list
+ * checksum   - hash of everything following the header
+ * the header is followed by the task records, the extra records and the
+ * string blob, which starts with the key the list was saved under
+ */
+struct snapshot_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordsize;
+    uint32_t ntasks;
+    uint32_t nextras;
+    uint64_t bloblength;
+    int64_t modified;
+    uint64_t checksum;
+};
+
+/**
+ * snapshot record struct - a task, records are in the order of the list
+ * times and the uuid are as in the task struct, strings are offsets into
+ * the blob
+ * annotations  - the first extra record holding an annotation of the task
+ * nannotations - the number of annotations
+ * udas         - the first extra record holding a uda of the task
+ * nudas        - the number of udas
+ */
+struct snapshot_record {
+    int64_t start;
+    int64_t end;
+    int64_t entry;
+    int64_t due;
+    int64_t modified;
+    unsigned char uuid[UUIDBYTES];
+    uint32_t tags;
+    uint32_t project;
+    uint32_t description;
+    uint32_t annotations;
+    uint32_t nannotations;
+    uint32_t udas;
+    uint32_t nudas;
+    uint32_t index;
+    char priority;
+    char pad[7];
+};
+
+/**
+ * snapshot extra struct - an annotation or uda of a task
+ * entry - when an annotation was added (0 for udas)
+ * name  - the name of a uda (SNAPSHOT_NULL for annotations)
+ * value - the text of an annotation or the value of a uda
+ */
+struct snapshot_extra {
+    int64_t entry;
+    uint32_t name;
+    uint32_t value;
+};
+
+/* local functions */
+static uint64_t snapshot_checksum(const char* data, const size_t length);
+static void snapshot_mkdir(const char* path);
+static bool snapshot_string(char* blob, const uint64_t length, const uint32_t offset,
+                            char** field);
+static uint32_t snapshot_store(char* blob, uint64_t* pos, const char* str);
+static uint64_t snapshot_strlen(const char* str);
+static bool snapshot_valid(const char* map, const size_t size, const char* key);
+
+uint64_t snapshot_checksum(const char* data, const size_t length) { /* {{{ */
+    /**
+     * hash a snapshot, fnv-1a over 8 byte words
+     * data   - the data to hash
+     * length - the number of bytes of data
+     */
+    uint64_t    hash = 14695981039346656037ULL;
+    uint64_t    word;
+    size_t      i;
+
+    for (i = 0; i + sizeof(word) <= length; i += sizeof(word)) {
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 1099511628211ULL;
+        hash ^= hash >> 32;
+    }
+
+    for (; i < length; i++) {
+        hash = (hash ^ (unsigned char)data[i]) * 1099511628211ULL;
+    }
+
+    return hash;
+} /* }}} */
+
+void snapshot_mkdir(const char* path) { /* {{{ */
+    /* create the directories leading to a file, ignoring ones that exist */
+    char* dir = strdup(path);
+    char* pos;
+
+    for (pos = strchr(dir + 1, '/'); pos != NULL; pos = strchr(pos + 1, '/')) {
+        *pos = 0;
+        mkdir(dir, 0700);
+        *pos = '/';
+    }
+
+    free(dir);
+} /* }}} */
+
+char* snapshot_path(void) { /* {{{ */
+    /* determine where the snapshot is kept
+     * return is the path, which must be free'd
+     */
+    char*   xdg_cache_home = getenv("XDG_CACHE_HOME");
+    char*   home = getenv("HOME");
+    char*   path = NULL;
+
+    if (xdg_cache_home != NULL) {
+        asprintf(&path, "%s/tasknc/snapshot", xdg_cache_home);
+    } else if (home != NULL) {
+        asprintf(&path, "%s/.cache/tasknc/snapshot", home);
+    }
+
+    return path;
+} /* }}} */
+
+struct task* snapshot_read(const char* path, const char* key, time_t* modified) { /* {{{ */
+    /**
+     * load the task list saved in a snapshot
+     * the file is mapped and checked, its strings are copied into the new
+     * list's arena in one piece
+     * path     - the snapshot file
+     * key      - the key the list must have been saved under
+     * modified - set to the newest modification time in the list
+     * return is the list, in the order it was saved, or NULL if the snapshot
+     *        is missing, stale or damaged
+     */
+    const struct snapshot_header*   header;
+    const struct snapshot_record*   records;
+    const struct snapshot_record*   record;
+    const struct snapshot_extra*    extras;
+    const struct snapshot_extra*    extra;
+    struct annotation**             anno;
+    struct uda**                    uda;
+    struct arena*                   arena = NULL;
+    struct task*                    first = NULL;
+    struct task*                    last = NULL;
+    struct task*                    tsk;
+    struct stat                     st;
+    char*                           strings;
+    char*                           project;
+    char*                           map;
+    bool                            valid = false;
+    uint32_t                        i;
+    uint32_t                        j;
+    int                             fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) {
+        return NULL;
+    }
+
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(struct snapshot_header)) {
+        close(fd);
+        return NULL;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    if (!snapshot_valid(map, st.st_size, key)) {
+        tnc_fprintf(logfp, LOG_DEBUG, "ignoring stale snapshot (%s)", path);
+        goto done;
+    }
+
+    header  = (const struct snapshot_header*)map;
+    records = (const struct snapshot_record*)(header + 1);
+    extras  = (const struct snapshot_extra*)(records + header->ntasks);
+    arena   = arena_create(TASKARENABLOCKLENGTH);
+    strings = arena != NULL ? arena_alloc(arena, header->bloblength) : NULL;
+
+    if (strings == NULL) {
+        tnc_fprintf(logfp, LOG_ERROR, "could not allocate memory to load snapshot");
+        goto done;
+    }
+
+    memcpy(strings, extras + header->nextras, header->bloblength);
+
+    for (i = 0; i < header->ntasks; i++) {
+        record = records + i;
+
+        if ((uint64_t)record->annotations + record->nannotations > header->nextras ||
+            (uint64_t)record->udas + record->nudas > header->nextras ||
+            (tsk = malloc_task(arena)) == NULL) {
+            goto done;
+        }
+
+        tsk->index      = record->index;
+        tsk->start      = record->start;
+        tsk->end        = record->end;
+        tsk->entry      = record->entry;
+        tsk->due        = record->due;
+        tsk->modified   = record->modified;
+        tsk->priority   = record->priority;
+        memcpy(tsk->uuid, record->uuid, UUIDBYTES);
+
+        if (!snapshot_string(strings, header->bloblength, record->tags, &(tsk->tags)) ||
+            !snapshot_string(strings, header->bloblength, record->project, &project) ||
+            !snapshot_string(strings, header->bloblength, record->description,
+                             &(tsk->description)) || uuid_empty(tsk->uuid)) {
+            goto done;
+        }
+
+        tsk->project = project != NULL ? intern_string(project, strlen(project)) : NULL;
+        tags_index(tsk);
+
+        /* annotations and udas keep their order */
+        anno = &(tsk->annotations);
+
+        for (j = 0; j < record->nannotations; j++) {
+            extra = extras + record->annotations + j;
+
+            if ((*anno = arena_calloc(arena, sizeof(struct annotation))) == NULL ||
+                !snapshot_string(strings, header->bloblength, extra->value, &((*anno)->description))) {
+                goto done;
+            }
+
+            (*anno)->entry = extra->entry;
+            anno = &((*anno)->next);
+        }
+
+        uda = &(tsk->udas);
+
+        for (j = 0; j < record->nudas; j++) {
+            extra = extras + record->udas + j;
+
+            if ((*uda = arena_calloc(arena, sizeof(struct uda))) == NULL ||
+                !snapshot_string(strings, header->bloblength, extra->name, &((*uda)->name)) ||
+                !snapshot_string(strings, header->bloblength, extra->value, &((*uda)->value))) {
+                goto done;
+            }
+
+            uda = &((*uda)->next);
+        }
+
+        tsk->prev = last;
+
+        if (last == NULL) {
+            first = tsk;
+        } else {
+            last->next = tsk;
+        }
+
+        last = tsk;
+    }
+
+    *modified = header->modified;
+    valid = first != NULL;
+    tnc_fprintf(logfp, LOG_DEBUG, "loaded %u tasks from snapshot (%s)", header->ntasks, path);
+
+done:
+    munmap(map, st.st_size);
+
+    if (!valid) {
+        arena_free(arena);
+        first = NULL;
+    }
+
+    return first;
+} /* }}} */
+
+bool snapshot_string(char* blob, const uint64_t length, const uint32_t offset,
+                     char** field) { /* {{{ */
+    /**
+     * point a string field at the blob
+     * blob   - the loaded blob, its last byte is a null
+     * length - the size of the blob
+     * offset - the offset of the string in the snapshot
+     * field  - the field to set
+     * return is whether the offset is valid
+     */
+    if (offset == SNAPSHOT_NULL) {
+        *field = NULL;
+        return true;
+    }
+
+    if (offset >= length) {
+        return false;
+    }
+
+    *field = blob + offset;
+
+    return true;
+} /* }}} */
+
+uint32_t snapshot_store(char* blob, uint64_t* pos, const char* str) { /* {{{ */
+    /**
+     * copy a string to the end of a blob
+     * blob - the blob being built (large enough for the string)
+     * pos  - the length of the blob so far (will be updated)
+     * str  - the string to copy (may be NULL)
+     * return is the offset of the string
+     */
+    const uint64_t  len = snapshot_strlen(str);
+    const uint64_t  offset = *pos;
+
+    if (str == NULL) {
+        return SNAPSHOT_NULL;
+    }
+
+    memcpy(blob + offset, str, len);
+    *pos += len;
+
+    return offset;
+} /* }}} */
+
+uint64_t snapshot_strlen(const char* str) { /* {{{ */
+    /* the space a string takes in the blob */
+    return str != NULL ? strlen(str) + 1 : 0;
+} /* }}} */
+
+bool snapshot_valid(const char* map, const size_t size, const char* key) { /* {{{ */
+    /**
+     * check that a mapped snapshot is complete, intact and current
+     * map  - the mapped file
+     * size - the size of the file
+     * key  - the key the list must have been saved under
+     */
+    const struct snapshot_header*   header = (const struct snapshot_header*)map;
+    const size_t                    keylength = strlen(key) + 1;
+    const char*                     blob;
+    uint64_t                        expected;
+
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != SNAPSHOT_VERSION ||
+        header->recordsize != sizeof(struct snapshot_record)) {
+        return false;
+    }
+
+    expected = sizeof(struct snapshot_header) +
+               (uint64_t)header->ntasks * sizeof(struct snapshot_record) +
+               (uint64_t)header->nextras * sizeof(struct snapshot_extra);
+
+    if (header->bloblength < keylength || header->bloblength > size ||
+        expected + header->bloblength != size) {
+        return false;
+    }
+
+    blob = map + expected;
+
+    if (blob[header->bloblength - 1] != 0 || memcmp(blob, key, keylength) != 0) {
+        return false;
+    }
+
+    return snapshot_checksum(map + sizeof(struct snapshot_header),
+                             size - sizeof(struct snapshot_header)) == header->checksum;
+} /* }}} */
+
+bool snapshot_write(const char* path, const char* key, const struct task* first,
+                    const time_t modified) { /* {{{ */
+    /**
+     * save a task list as a snapshot
+     * the snapshot is written beside the old one and renamed over it, so it
+     * is never seen half written
+     * path     - the snapshot file
+     * key      - the key to save the list under
+     * first    - the head of the list, in display order
+     * modified - the newest modification time in the list
+     * return is whether the snapshot was saved
+     */
+    struct snapshot_header*     header;
+    struct snapshot_record*     record;
+    struct snapshot_extra*      extra;
+    struct snapshot_extra*      extras;
+    const struct task*          cur;
+    const struct annotation*    anno;
+    const struct uda*           uda;
+    uint64_t                    ntasks = 0;
+    uint64_t                    nextras = 0;
+    uint64_t                    bloblength = snapshot_strlen(key);
+    uint64_t                    pos = 0;
+    size_t                      length;
+    ssize_t                     ret;
+    char*                       buffer;
+    char*                       blob;
+    char*                       tmppath;
+    bool                        saved = false;
+    int                         fd;
+
+    /* size the snapshot */
+    for (cur = first; cur != NULL; cur = cur->next) {
+        ntasks++;
+        bloblength += snapshot_strlen(cur->tags) +
+                      snapshot_strlen(cur->project) + snapshot_strlen(cur->description);
+
+        for (anno = cur->annotations; anno != NULL; anno = anno->next) {
+            nextras++;
+            bloblength += snapshot_strlen(anno->description);
+        }
+
+        for (uda = cur->udas; uda != NULL; uda = uda->next) {
+            nextras++;
+            bloblength += snapshot_strlen(uda->name) + snapshot_strlen(uda->value);
+        }
+    }
+
+    if (ntasks >= UINT32_MAX || nextras >= UINT32_MAX || bloblength >= SNAPSHOT_NULL) {
+        tnc_fprintf(logfp, LOG_DEBUG, "task list too large for a snapshot");
+        return false;
+    }
+
+    length = sizeof(struct snapshot_header) + ntasks * sizeof(struct snapshot_record) +
+             nextras * sizeof(struct snapshot_extra) + bloblength;
+    buffer = calloc(1, length);
+
+    if (buffer == NULL) {
+        tnc_fprintf(logfp, LOG_ERROR, "could not allocate memory to save snapshot");
+        return false;
+    }
+
+    header  = (struct snapshot_header*)buffer;
+    record  = (struct snapshot_record*)(header + 1);
+    extras  = (struct snapshot_extra*)(record + ntasks);
+    extra   = extras;
+    blob    = (char*)(extras + nextras);
+    snapshot_store(blob, &pos, key);
+
+    /* build the records */
+    for (cur = first; cur != NULL; cur = cur->next, record++) {
+        record->start       = cur->start;
+        record->end         = cur->end;
+        record->entry       = cur->entry;
+        record->due         = cur->due;
+        record->modified    = cur->modified;
+        record->index       = cur->index;
+        record->priority    = cur->priority;
+        memcpy(record->uuid, cur->uuid, UUIDBYTES);
+        record->tags        = snapshot_store(blob, &pos, cur->tags);
+        record->project     = snapshot_store(blob, &pos, cur->project);
+        record->description = snapshot_store(blob, &pos, cur->description);
+
+        record->annotations = extra - extras;
+
+        for (anno = cur->annotations; anno != NULL; anno = anno->next, extra++) {
+            record->nannotations++;
+            extra->entry = anno->entry;
+            extra->name  = SNAPSHOT_NULL;
+            extra->value = snapshot_store(blob, &pos, anno->description);
+        }
+
+        record->udas = extra - extras;
+
+        for (uda = cur->udas; uda != NULL; uda = uda->next, extra++) {
+            record->nudas++;
+            extra->name  = snapshot_store(blob, &pos, uda->name);
+            extra->value = snapshot_store(blob, &pos, uda->value);
+        }
+    }
+
+    memcpy(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic));
+    header->version     = SNAPSHOT_VERSION;
+    header->recordsize  = sizeof(struct snapshot_record);
+    header->ntasks      = ntasks;
+    header->nextras     = nextras;
+    header->bloblength  = bloblength;
+    header->modified    = modified;
+    header->checksum    = snapshot_checksum(buffer + sizeof(struct snapshot_header),
+                                            length - sizeof(struct snapshot_header));
+
+    /* write the snapshot */
+    snapshot_mkdir(path);
+    asprintf(&tmppath, "%s.%d", path, (int)getpid());
+    fd = open(tmppath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+
+    if (fd >= 0) {
+        for (pos = 0; pos < length; pos += ret) {
+            ret = write(fd, buffer + pos, length - pos);
+
+            if (ret < 0 && errno == EINTR) {
+                ret = 0;
+            } else if (ret <= 0) {
+                break;
+            }
+        }
+
+        saved = close(fd) == 0 && pos == length && rename(tmppath, path) == 0;
+    }
+
+    if (saved) {
+        tnc_fprintf(logfp, LOG_DEBUG, "saved %llu tasks to snapshot (%s)",
+                    (unsigned long long)ntasks, path);
+    } else {
+        tnc_fprintf(logfp, LOG_ERROR, "could not save snapshot (%s)", path);
+        unlink(tmppath);
+    }
+
+    free(tmppath);
+    free(buffer);
+
+    return saved;
+} /* }}} */
+
+// vim: et ts=4 sw=4 sts=4
@@ -4,118 +4,321 @@
  * by mjheagle
  */
 
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include "common.h"
+#include "log.h"
 #include "sort.h"
+#include "timing.h"
 
-/* local functions */
-static bool compare_tasks(const struct task* a,
-                          const struct task* b,
-                          const char* mode_queue);
+/* the most sort keys a sort mode can hold */
+#define SORT_MAX_KEYS                   16
+
+/* key value for tasks that always sort last (no due date) */
+#define SORT_KEY_LAST                   UINT64_MAX
+
+/**
+ * sort key struct - one compiled character of the sort mode
+ * field  - the sort mode character, in lowercase
+ * invert - whether the order of this key is reversed
+ */
+struct sort_key {
+    char field;
+    bool invert;
+};
+
+/**
+ * sort plan struct - a sort mode compiled for a list of tasks
+ * keys   - the keys to sort by, in order of precedence
+ * nkeys  - the number of keys
+ * tasks  - the tasks being sorted
+ * values - the precomputed value of each key for each task
+ *          (nkeys values per task, ordered so that a lower value sorts first)
+ */
+struct sort_plan {
+    struct sort_key keys[SORT_MAX_KEYS];
+    int nkeys;
+    struct task** tasks;
+    uint64_t* values;
+};
 
+/* local functions */
+static uint64_t bytes_prefix(const unsigned char* bytes);
+static int compare_entries(const struct sort_plan* plan, const size_t a, const size_t b);
+static int compare_key_strings(const struct sort_key* key, const struct task* a,
+                               const struct task* b);
+static int compare_keys(const struct sort_key* keys, const int nkeys,
+                        const struct task* a, const struct task* b);
+static int compare_strings(const char* a, const char* b, const bool invert);
+static int compile_sort_mode(struct sort_key* keys, const char* mode);
+static uint64_t key_value(const struct sort_key* key, const struct task* tsk);
+static void merge_sort(const struct sort_plan* plan, size_t* order,
+                       size_t* tmp, const size_t n);
 static int priority_to_int(const char pri);
-static void sort_tasks(struct task* first, struct task* last);
-static void swap_tasks(struct task* a, struct task* b);
+static uint64_t string_prefix(const char* str);
 
-bool compare_tasks(const struct task* a,
-                   const struct task* b,
-                   const char* mode_queue) { /* {{{ */
-    /**
-     * compare two tasks to determine order
-     * a return of 1 means that the tasks should be swapped (b comes before a)
-     * a          - the first task to be compared
-     * b          - the second task to be compared
-     * mode_queue - the remaining tests to be evaluated
+uint64_t bytes_prefix(const unsigned char* bytes) { /* {{{ */
+    /* pack the first 8 bytes of an array into an integer that orders the
+     * same way memcmp does
      */
-    bool    ret = false;
-    int     tmp;
-    int     pri0;
-    int     pri1;
-    char    sort_mode = *mode_queue;
-    bool    invert = false;
-
-    /* check for inverted order */
-    if (sort_mode >= 'A' && sort_mode <= 'Z') {
-        sort_mode += 32;
-        invert = true;
+    uint64_t    ret = 0;
+    int         i;
+
+    for (i = 0; i < 8; i++) {
+        ret = (ret << 8) | bytes[i];
     }
 
-    /* determine sort algorithm and apply it */
-    switch (sort_mode) {
-    case 'n':       // sort by index
-        if (XOR(invert, a->index < b->index)) {
-            ret = true;
-        }
+    return ret;
+} /* }}} */
 
-        break;
+int compare_entries(const struct sort_plan* plan, const size_t a,
+                    const size_t b) { /* {{{ */
+    /**
+     * compare two tasks using their precomputed keys
+     * plan - the compiled sort
+     * a    - the index of the first task
+     * b    - the index of the second task
+     * return is negative if a sorts first, positive if b does, 0 on a tie
+     */
+    const uint64_t* va = plan->values + a * plan->nkeys;
+    const uint64_t* vb = plan->values + b * plan->nkeys;
+    int             ret;
+    int             k;
+
+    for (k = 0; k < plan->nkeys; k++) {
+        if (va[k] != vb[k]) {
+            return va[k] < vb[k] ? -1 : 1;
+        }
 
-    case 'p':       // sort by project name
-        if (a->project == NULL) {
-            if (b->project != NULL) {
-                ret = true;
-            }
+        ret = compare_key_strings(&(plan->keys[k]), plan->tasks[a], plan->tasks[b]);
 
-            break;
+        if (ret != 0) {
+            return ret;
         }
+    }
 
-        if (b->project == NULL) {
-            break;
+    return 0;
+} /* }}} */
+
+int compare_key_strings(const struct sort_key* key, const struct task* a,
+                        const struct task* b) { /* {{{ */
+    /**
+     * compare two tasks whose key values tied
+     * string keys only hold a prefix, so tied prefixes need the full strings
+     * return is negative if a sorts first, positive if b does, 0 on a tie
+     */
+    int ret;
+
+    switch (key->field) {
+    case 'p':
+        /* projects are interned, so a shared project is one pointer */
+        if (a->project == b->project) {
+            return 0;
         }
 
-        tmp = strcmp(a->project, b->project);
+        return compare_strings(a->project, b->project, key->invert);
+
+    case 'u':
+        ret = memcmp(a->uuid, b->uuid, UUIDBYTES);
+        return key->invert ? -ret : ret;
+
+    default:
+        return 0;
+    }
+} /* }}} */
+
+int compare_keys(const struct sort_key* keys, const int nkeys,
+                 const struct task* a, const struct task* b) { /* {{{ */
+    /**
+     * compare two tasks without precomputed values
+     * keys  - the compiled sort mode
+     * nkeys - the number of keys
+     * a     - the first task
+     * b     - the second task
+     * return is negative if a sorts first, positive if b does, 0 on a tie
+     */
+    uint64_t    va;
+    uint64_t    vb;
+    int         ret;
+    int         k;
+
+    for (k = 0; k < nkeys; k++) {
+        va = key_value(&(keys[k]), a);
+        vb = key_value(&(keys[k]), b);
 
-        if (XOR(invert, tmp < 0)) {
-            ret = true;
+        if (va != vb) {
+            return va < vb ? -1 : 1;
         }
 
-        if (tmp == 0) {
-            ret = compare_tasks(a, b, mode_queue + 1);
+        ret = compare_key_strings(&(keys[k]), a, b);
+
+        if (ret != 0) {
+            return ret;
         }
+    }
 
-        break;
+    return 0;
+} /* }}} */
 
-    case 'd':       // sort by due date
-        if (a->due == 0) {
-            if (b->due == 0) {
-                ret = compare_tasks(a, b, mode_queue + 1);
-            }
+int compare_strings(const char* a, const char* b, const bool invert) { /* {{{ */
+    /**
+     * compare two strings for sorting, a missing string always comes first
+     * a      - the first string
+     * b      - the second string
+     * invert - whether to reverse the order of present strings
+     * return is negative if a sorts first, positive if b does, 0 on a tie
+     */
+    int ret;
 
+    if (a == NULL || b == NULL) {
+        return (a != NULL) - (b != NULL);
+    }
+
+    ret = strcmp(a, b);
+
+    return invert ? -ret : ret;
+} /* }}} */
+
+int compile_sort_mode(struct sort_key* keys, const char* mode) { /* {{{ */
+    /**
+     * translate a sort mode string into a list of keys
+     * keys - where the keys will be stored (SORT_MAX_KEYS long)
+     * mode - the sort mode, as described in the manual
+     * return is the number of keys compiled
+     * compiling stops at the first character that is not a sort key
+     */
+    int     n = 0;
+    char    c;
+
+    for (; mode != NULL && *mode != 0 && n < SORT_MAX_KEYS; mode++) {
+        c = *mode;
+        keys[n].invert = false;
+
+        /* check for inverted order */
+        if (c >= 'A' && c <= 'Z') {
+            c += 32;
+            keys[n].invert = true;
+        }
+
+        if (c != 'n' && c != 'p' && c != 'd' && c != 'r' && c != 'u') {
             break;
-        } else if (b->due == 0) {
-            ret = true;
-            break;
-        } else if (XOR(invert, a->due < b->due)) {
-            ret = true;
         }
 
-        break;
+        keys[n].field = c;
+        n++;
+    }
 
-    case 'r':       // sort by priority
-        pri0 = priority_to_int(a->priority);
-        pri1 = priority_to_int(b->priority);
+    return n;
+} /* }}} */
 
-        if (pri0 == pri1) {
-            ret = compare_tasks(a, b, mode_queue + 1);
-        } else {
-            ret = XOR(invert, pri0 > pri1);
+uint64_t key_value(const struct sort_key* key, const struct task* tsk) { /* {{{ */
+    /**
+     * compute the value of a sort key for a task
+     * values are ordered so the lower value sorts first
+     * key - the key to compute
+     * tsk - the task to compute it for
+     */
+    uint64_t value;
+
+    switch (key->field) {
+    case 'n':       // sort by index
+        value = tsk->index;
+        break;
+
+    case 'p':       // sort by project name, no project first
+        if (tsk->project == NULL) {
+            return 0;
         }
 
+        value = string_prefix(tsk->project);
         break;
 
-    case 'u':       // sort by uuid
-        if (XOR(invert, strcmp(a->uuid, b->uuid) < 0)) {
-            ret = true;
+    case 'd':       // sort by due date, no due date last
+        if (tsk->due == 0) {
+            return SORT_KEY_LAST;
         }
 
+        /* bias so negative times order correctly, leaving room for the
+         * no due date value in either direction
+         */
+        value = (uint64_t)((int64_t)tsk->due + ((int64_t)1 << 62));
+        return key->invert ? ((uint64_t)1 << 63) - value : value;
+
+    case 'r':       // sort by priority, highest first
+        value = 3 - priority_to_int(tsk->priority);
         break;
 
-    case 0:
-    default:
-        return false;
+    case 'u':       // sort by uuid, its first bytes order as its hex does
+        value = bytes_prefix(tsk->uuid);
         break;
+
+    default:
+        return 0;
     }
 
-    return ret;
+    return key->invert ? ~value : value;
+} /* }}} */
+
+void merge_sort(const struct sort_plan* plan, size_t* order,
+                size_t* tmp, const size_t n) { /* {{{ */
+    /**
+     * stable bottom up merge sort of task indexes
+     * plan  - the compiled sort to order by
+     * order - the indexes to sort
+     * tmp   - scratch space, n long
+     * n     - the number of indexes
+     */
+    size_t* src = order;
+    size_t* dst = tmp;
+    size_t* swap;
+    size_t  width;
+    size_t  lo;
+    size_t  mid;
+    size_t  hi;
+    size_t  i;
+    size_t  j;
+    size_t  k;
+
+    for (width = 1; width < n; width *= 2) {
+        for (lo = 0; lo < n; lo += 2 * width) {
+            mid = MIN(lo + width, n);
+            hi  = MIN(lo + 2 * width, n);
+            i   = lo;
+            j   = mid;
+            k   = lo;
+
+            /* an already ordered pair of runs is copied through */
+            if (mid < hi && compare_entries(plan, src[mid - 1], src[mid]) <= 0) {
+                memcpy(dst + lo, src + lo, (hi - lo) * sizeof(size_t));
+                continue;
+            }
+
+            while (i < mid && j < hi) {
+                if (compare_entries(plan, src[j], src[i]) < 0) {
+                    dst[k++] = src[j++];
+                } else {
+                    dst[k++] = src[i++];
+                }
+            }
+
+            while (i < mid) {
+                dst[k++] = src[i++];
+            }
+
+            while (j < hi) {
+                dst[k++] = src[j++];
+            }
+        }
+
+        swap = src;
+        src  = dst;
+        dst  = swap;
+    }
+
+    if (src != order) {
+        memcpy(order, src, n * sizeof(size_t));
+    }
 } /* }}} */
 
 int priority_to_int(const char pri) { /* {{{ */
@@ -140,125 +343,230 @@ int priority_to_int(const char pri) { /* {{{ */
     }
 } /* }}} */
 
-void sort_wrapper(struct task* first) { /* {{{ */
+int sort_compare(const struct task* a, const struct task* b) { /* {{{ */
     /**
-     * a wrapper around sort_tasks that finds the last element
-     * in the linked list to pass to the aforementioned function
+     * compare two tasks by the active sort mode
+     * a      - the first task
+     * b      - the second task
+     * return is negative if a sorts first, positive if b does, 0 on a tie
      */
-    struct task* last;
+    struct sort_key keys[SORT_MAX_KEYS];
+    const int       nkeys = compile_sort_mode(keys, cfg.sortmode);
 
-    /* loop through looking for last item */
-    last = first;
+    return compare_keys(keys, nkeys, a, b);
+} /* }}} */
 
-    while (last->next != NULL) {
-        last = last->next;
+int sort_compare_projects(const char* a, const char* b) { /* {{{ */
+    /**
+     * compare two projects the way the project key of the active sort mode
+     * orders them: no project first, the rest reversed if the key is P
+     * a - the first project
+     * b - the second project
+     * return is negative if a sorts first, positive if b does, 0 if they match
+     */
+    struct sort_key keys[SORT_MAX_KEYS];
+    bool            invert = false;
+    int             nkeys;
+    int             k;
+
+    if (a == b) {
+        return 0;
     }
 
-    /* run sort with last value */
-    sort_tasks(first, last);
+    nkeys = compile_sort_mode(keys, cfg.sortmode);
+
+    for (k = 0; k < nkeys; k++) {
+        if (keys[k].field == 'p') {
+            invert = keys[k].invert;
+            break;
+        }
+    }
+
+    return compare_strings(a, b, invert);
 } /* }}} */
 
-void sort_tasks(struct task* first,
-                struct task* last) { /* {{{ */
-    /* sort a list of tasks from first to last */
-    struct task* start;
-    struct task* cur;
-    struct task* oldcur;
+struct task* sort_merge(struct task* sorted, struct task* unsorted) { /* {{{ */
+    /**
+     * add tasks to a sorted list
+     * the new tasks are sorted, then merged in a single pass over the list,
+     * which is cheaper than sorting everything when few tasks are added
+     * sorted   - the head of a list sorted by the active sort mode
+     * unsorted - the head of the list of tasks to add
+     * return is the new head of the merged list
+     */
+    if (unsorted == NULL) {
+        return sorted;
+    }
 
-    /* check if we are done */
-    if (first == last) {
-        return;
+    /* existing tasks stay ahead of new tasks they tie with */
+    return sort_merge_lists(sorted, sort_wrapper(unsorted));
+} /* }}} */
+
+struct task* sort_merge_lists(struct task* first, struct task* second) { /* {{{ */
+    /**
+     * merge two lists sorted by the active sort mode into one
+     * first  - the head of a sorted list, its tasks stay ahead of tasks in
+     *          second they tie with
+     * second - the head of the other sorted list
+     * return is the new head of the merged list
+     * merging two halves of a list sorted on their own gives the same order
+     * as sorting the whole list
+     */
+    struct sort_key keys[SORT_MAX_KEYS];
+    struct task*    head = NULL;
+    struct task*    last = NULL;
+    struct task*    this;
+    int             nkeys;
+
+    if (first == NULL || second == NULL) {
+        return first != NULL ? first : second;
     }
 
-    /* set start and current */
-    start = first;
-    cur = start->next;
+    nkeys = compile_sort_mode(keys, cfg.sortmode);
 
-    /* iterate through to right end, sorting as we go */
-    while (1) {
-        if (compare_tasks(start, cur, cfg.sortmode)) {
-            swap_tasks(start, cur);
+    while (first != NULL || second != NULL) {
+        if (second == NULL || (first != NULL &&
+                               compare_keys(keys, nkeys, second, first) >= 0)) {
+            this = first;
+            first = first->next;
+        } else {
+            this = second;
+            second = second->next;
         }
 
-        if (cur == last) {
-            break;
+        this->prev = last;
+        this->next = NULL;
+
+        if (last == NULL) {
+            head = this;
+        } else {
+            last->next = this;
         }
 
-        cur = cur->next;
+        last = this;
     }
 
-    /* swap first and cur */
-    swap_tasks(first, cur);
+    return head;
+} /* }}} */
 
-    /* save this cur */
-    oldcur = cur;
+void sort_tasks(struct task** tasks, const size_t n) { /* {{{ */
+    /**
+     * sort an array of tasks by the active sort mode
+     * the sort is stable, every key is extracted once before comparing
+     * tasks - the tasks to sort, they are put in sorted order
+     * n     - the number of tasks
+     */
+    const long long     start = timer_start();
+    struct sort_plan    plan;
+    struct task**       sorted;
+    size_t*             order;
+    size_t              i;
+    int                 k;
+
+    if (n < 2) {
+        return;
+    }
 
-    /* sort left side */
-    cur = cur->prev;
+    plan.nkeys  = compile_sort_mode(plan.keys, cfg.sortmode);
+    plan.tasks  = tasks;
+    plan.values = malloc(n * (plan.nkeys > 0 ? plan.nkeys : 1) * sizeof(uint64_t));
+    order       = malloc(2 * n * sizeof(size_t));
+    sorted      = malloc(n * sizeof(struct task*));
+
+    if (plan.values == NULL || order == NULL || sorted == NULL) {
+        tnc_fprintf(logfp, LOG_ERROR, "could not allocate memory to sort %zu tasks", n);
+        free(plan.values);
+        free(order);
+        free(sorted);
+        return;
+    }
+
+    /* extract every key once */
+    for (i = 0; i < n; i++) {
+        order[i] = i;
 
-    if (cur != NULL) {
-        if ((first->prev != cur) && (cur->next != first)) {
-            sort_tasks(first, cur);
+        for (k = 0; k < plan.nkeys; k++) {
+            plan.values[i * plan.nkeys + k] = key_value(&(plan.keys[k]), tasks[i]);
         }
     }
 
-    /* sort right side */
-    cur = oldcur->next;
+    merge_sort(&plan, order, order + n, n);
 
-    if (cur != NULL) {
-        if ((cur->prev != last) && (last->next != cur)) {
-            sort_tasks(cur, last);
-        }
+    for (i = 0; i < n; i++) {
+        sorted[i] = tasks[order[i]];
+    }
+
+    memcpy(tasks, sorted, n * sizeof(struct task*));
+
+    free(plan.values);
+    free(order);
+    free(sorted);
+    timer_stop(TIMER_SORT, start);
+} /* }}} */
+
+struct task* sort_wrapper(struct task* first) { /* {{{ */
+    /**
+     * sort a linked list of tasks by the active sort mode
+     * the sort is stable and relinks the tasks, their contents are not moved
+     * first  - the head of the list to sort
+     * return is the new head of the list
+     */
+    struct task*    cur;
+    struct task**   tasks;
+    size_t          n = 0;
+    size_t          i;
+
+    if (first == NULL) {
+        return NULL;
+    }
+
+    for (cur = first; cur != NULL; cur = cur->next) {
+        n++;
     }
+
+    tasks = malloc(n * sizeof(struct task*));
+
+    if (tasks == NULL) {
+        tnc_fprintf(logfp, LOG_ERROR, "could not allocate memory to sort %zu tasks", n);
+        return first;
+    }
+
+    for (cur = first, i = 0; cur != NULL; cur = cur->next, i++) {
+        tasks[i] = cur;
+    }
+
+    sort_tasks(tasks, n);
+
+    /* relink the list in sorted order */
+    for (i = 0; i < n; i++) {
+        tasks[i]->prev = i > 0 ? tasks[i - 1] : NULL;
+        tasks[i]->next = i + 1 < n ? tasks[i + 1] : NULL;
+    }
+
+    first = tasks[0];
+    free(tasks);
+
+    return first;
 } /* }}} */
 
-void swap_tasks(struct task* a,
-                struct task* b) { /* {{{ */
-    /* swap the contents of two tasks */
-    unsigned short  ustmp;
-    unsigned int    uitmp;
-    char*           strtmp;
-    char            ctmp;
-
-    ustmp    = a->index;
-    a->index = b->index;
-    b->index = ustmp;
-
-    strtmp  = a->uuid;
-    a->uuid = b->uuid;
-    b->uuid = strtmp;
-
-    strtmp  = a->tags;
-    a->tags = b->tags;
-    b->tags = strtmp;
-
-    uitmp    = a->start;
-    a->start = b->start;
-    b->start = uitmp;
-
-    uitmp  = a->end;
-    a->end = b->end;
-    b->end = uitmp;
-
-    uitmp    = a->entry;
-    a->entry = b->entry;
-    b->entry = uitmp;
-
-    uitmp  = a->due;
-    a->due = b->due;
-    b->due = uitmp;
-
-    strtmp     = a->project;
-    a->project = b->project;
-    b->project = strtmp;
-
-    ctmp        = a->priority;
-    a->priority = b->priority;
-    b->priority = ctmp;
-
-    strtmp         = a->description;
-    a->description = b->description;
-    b->description = strtmp;
+uint64_t string_prefix(const char* str) { /* {{{ */
+    /**
+     * pack the first 8 characters of a string into an integer that
+     * orders the same way strcmp does
+     */
+    uint64_t    ret = 0;
+    int         i;
+
+    for (i = 0; i < 8; i++) {
+        ret <<= 8;
+
+        if (*str != 0) {
+            ret |= (unsigned char)*str;
+            str++;
+        }
+    }
+
+    return ret;
 } /* }}} */
 
 // vim: et ts=4 sw=4 sts=4
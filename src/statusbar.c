@@ -33,6 +33,8 @@ struct prompt_index {
 /* global variables */
 time_t               sb_timeout = 0;    /* when statusbar should be cleared */
 struct prompt_index* prompt_number = NULL;  /* prompt index mapping head */
+static int           sb_pending = 0;    /* number of background commands */
+static int           sb_pending_width = 0;  /* width of the drawn indicator */
 
 /* local functions */
 static void add_to_history(struct prompt_index* pindex,
@@ -43,6 +45,8 @@ static struct prompt_index* get_prompt_index(const char* prompt);
 static wchar_t* get_history(const struct prompt_index* pindex,
                             const int count);
 
+static void print_pending(void);
+
 static void remove_first_char(wchar_t* str);
 
 static int replace_entry(wchar_t* str,
@@ -144,6 +148,29 @@ struct prompt_index* get_prompt_index(const char* prompt) { /* {{{ */
     return cur;
 } /* }}} */
 
+void print_pending(void) { /* {{{ */
+    /* draw the count of background commands at the right of the statusbar */
+    char    indicator[32];
+    int     width = 0;
+
+    if (sb_pending > 0) {
+        width = snprintf(indicator, sizeof(indicator), "[%d pending]", sb_pending);
+    }
+
+    /* clear what is left of a wider indicator */
+    if (sb_pending_width > width && sb_pending_width <= cols) {
+        wattrset(statusbar, COLOR_PAIR(0));
+        mvwhline(statusbar, 0, cols - sb_pending_width, ' ', sb_pending_width - width);
+    }
+
+    if (width > 0 && width < cols) {
+        wattrset(statusbar, COLOR_PAIR(0));
+        mvwaddstr(statusbar, 0, cols - width, indicator);
+    }
+
+    sb_pending_width = width;
+} /* }}} */
+
 void remove_first_char(wchar_t* str) { /* {{{ */
     /* remove the first character from a string, shift the remainder back */
     while (*str != 0) {
@@ -245,12 +272,25 @@ int statusbar_getstr(char** str, const char* msg) { /* {{{ */
      * str - where the string to be stored
      * msg - the prompt message
      */
+    return statusbar_getstr_live(str, msg, NULL);
+} /* }}} */
+
+int statusbar_getstr_live(char** str, const char* msg, prompt_callback changed) { /* {{{ */
+    /**
+     * get a string from user input, reporting each change to it
+     * str     - where the string to be stored
+     * msg     - the prompt message
+     * changed - called with the string as it stands after each edit
+     *           (may be NULL)
+     */
     int                         position = 0;
     int                         histindex = -1;
     int                         str_len = 0;
     int                         charlen;
     int                         ret;
     bool                        done = false;
+    bool                        edited;
+    char*                       partial;
     const int                   msglen = strlen(msg);
     const struct prompt_index*  pindex = get_prompt_index(msg);
     wchar_t*                    tmp;
@@ -275,13 +315,17 @@ int statusbar_getstr(char** str, const char* msg) { /* {{{ */
             continue;
         }
 
+        edited = true;
+
         switch (c) {
         case ERR:
+            edited = false;
             break;
 
         case '\r':
         case '\n':
             done = true;
+            edited = false;
             break;
 
         case 21: /* C-u (discard line) */
@@ -334,10 +378,12 @@ int statusbar_getstr(char** str, const char* msg) { /* {{{ */
 
         case KEY_LEFT:
             position = position > 0 ? position - 1 : 0;
+            edited = false;
             break;
 
         case KEY_RIGHT:
             position = wstr[position] != 0 ? position + 1 : position;
+            edited = false;
             break;
 
         case KEY_UP:
@@ -361,10 +407,12 @@ int statusbar_getstr(char** str, const char* msg) { /* {{{ */
 
         case KEY_HOME:
             position = 0;
+            edited = false;
             break;
 
         case KEY_END:
             position = str_len;
+            edited = false;
             break;
 
         default:
@@ -373,6 +421,17 @@ int statusbar_getstr(char** str, const char* msg) { /* {{{ */
             str_len++;
             break;
         }
+
+        if (edited && changed != NULL) {
+            charlen = wcstombs(NULL, wstr, 0) + 1;
+            partial = calloc(charlen, sizeof(char));
+
+            if (partial != NULL) {
+                wcstombs(partial, wstr, charlen);
+                (*changed)(partial);
+                free(partial);
+            }
+        }
     }
 
     /* convert wchar_t to char */
@@ -419,6 +478,8 @@ void statusbar_message(const int dtmout, const char* format, ...) { /* {{{ */
     /* print message */
     umvaddstr(statusbar, 0, 0, message);
     free(message);
+    sb_pending_width = 0;
+    print_pending();
 
     /* set timeout */
     if (dtmout >= 0) {
@@ -433,11 +494,29 @@ void statusbar_message(const int dtmout, const char* format, ...) { /* {{{ */
     }
 } /* }}} */
 
+void statusbar_pending(const int pending) { /* {{{ */
+    /**
+     * set the number of commands running in the background, which is shown
+     * at the right of the statusbar while there are any
+     * pending - the number of commands queued or running
+     */
+    sb_pending = pending;
+
+    if (stdscr == NULL || statusbar == NULL) {
+        return;
+    }
+
+    print_pending();
+    wnoutrefresh(statusbar);
+} /* }}} */
+
 void statusbar_timeout(void) { /* {{{ */
     /* check for statusbar timeout */
     if (sb_timeout > 0 && sb_timeout < time(NULL)) {
         sb_timeout = 0;
         wipe_statusbar();
+        sb_pending_width = 0;
+        print_pending();
     }
 } /* }}} */
 
@@ -0,0 +1,279 @@
+/*
+ * tags.c - a dictionary of the tags used by tasks
+ * for tasknc
+ * by mjheagle
+ */
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+#include "common.h"
+#include "config.h"
+#include "log.h"
+#include "tags.h"
+
+/* local functions */
+static bool dictionary_grow(void);
+static size_t tag_hash(const char* name, const size_t length);
+static const char* tag_next(const char* pos, size_t* length);
+
+/* the dictionary, each tag is numbered in the order it was first seen and
+ * keeps its number until exit, so a task's tags can be held as a set of bits
+ * names is indexed by the numbers, slots is an open addressed hash of them
+ * tasks are parsed on several threads, which all look up their tags
+ */
+static char**           names = NULL;
+static int              ntags = 0;
+static int              capacity = 0;
+static int*             slots = NULL;
+static size_t           nslots = 0;
+static pthread_mutex_t  lock = PTHREAD_MUTEX_INITIALIZER;
+
+bool dictionary_grow(void) { /* {{{ */
+    /**
+     * double the number of slots in the dictionary's hash, the lock must be held
+     * return is whether the hash could be grown
+     */
+    int*            old = slots;
+    const size_t    oldslots = nslots;
+    size_t          mask;
+    size_t          j;
+    int             i;
+
+    nslots = nslots > 0 ? 2 * nslots : TAGSLOTS;
+    slots = malloc(nslots * sizeof(int));
+
+    if (slots == NULL) {
+        tnc_fprintf(logfp, LOG_ERROR, "could not grow tag dictionary (%zu slots)", nslots);
+        slots = old;
+        nslots = oldslots;
+        return false;
+    }
+
+    memset(slots, 0xff, nslots * sizeof(int));
+    mask = nslots - 1;
+
+    for (i = 0; i < ntags; i++) {
+        for (j = tag_hash(names[i], strlen(names[i])) & mask; slots[j] >= 0; j = (j + 1) & mask);
+
+        slots[j] = i;
+    }
+
+    free(old);
+
+    return true;
+} /* }}} */
+
+int tag_count(void) { /* {{{ */
+    /* get the number of tags in the dictionary, they are numbered from 0 */
+    int ret;
+
+    pthread_mutex_lock(&lock);
+    ret = ntags;
+    pthread_mutex_unlock(&lock);
+
+    return ret;
+} /* }}} */
+
+size_t tag_hash(const char* name, const size_t length) { /* {{{ */
+    /* fnv-1a hash of a tag */
+    size_t hash = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < length; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+} /* }}} */
+
+int tag_id(const char* name, const size_t length, const bool create) { /* {{{ */
+    /**
+     * find the number of a tag
+     * name   - the tag, it need not be terminated
+     * length - the length of the tag
+     * create - whether to add the tag to the dictionary if it is new
+     * return is the tag's number, or -1 if it could not be found or added
+     */
+    char**  grown;
+    size_t  mask;
+    size_t  i;
+    int     ret = -1;
+
+    pthread_mutex_lock(&lock);
+
+    /* keep the hash at most half full */
+    if (2 * ((size_t)ntags + 1) > nslots && !dictionary_grow()) {
+        goto done;
+    }
+
+    mask = nslots - 1;
+
+    for (i = tag_hash(name, length) & mask; slots[i] >= 0; i = (i + 1) & mask) {
+        if (strncmp(names[slots[i]], name, length) == 0 && names[slots[i]][length] == 0) {
+            ret = slots[i];
+            goto done;
+        }
+    }
+
+    if (!create) {
+        goto done;
+    }
+
+    if (ntags == capacity) {
+        grown = realloc(names, (capacity > 0 ? 2 * capacity : TAGSLOTS) * sizeof(char*));
+
+        if (grown == NULL) {
+            tnc_fprintf(logfp, LOG_ERROR, "could not grow tag dictionary (%d tags)", ntags);
+            goto done;
+        }
+
+        names = grown;
+        capacity = capacity > 0 ? 2 * capacity : TAGSLOTS;
+    }
+
+    names[ntags] = strndup(name, length);
+
+    if (names[ntags] != NULL) {
+        slots[i] = ntags;
+        ret = ntags++;
+    }
+
+done:
+    pthread_mutex_unlock(&lock);
+
+    return ret;
+} /* }}} */
+
+bool tag_literal(const char* pattern, const size_t length) { /* {{{ */
+    /**
+     * check whether a pattern is a single tag, with nothing regex would read
+     * as more than literal text
+     * pattern - the pattern, it need not be terminated
+     * length  - the length of the pattern
+     * return is whether the pattern can be looked up as a tag instead
+     */
+    size_t i;
+
+    for (i = 0; i < length; i++) {
+        if (strchr(".[]()|*+?{}^$\\\", \t", pattern[i]) != NULL || pattern[i] == 0) {
+            return false;
+        }
+    }
+
+    return length > 0;
+} /* }}} */
+
+const char* tag_name(const int id) { /* {{{ */
+    /* get the name of a numbered tag (NULL if there is no such tag) */
+    const char* ret = NULL;
+
+    pthread_mutex_lock(&lock);
+
+    if (id >= 0 && id < ntags) {
+        ret = names[id];
+    }
+
+    pthread_mutex_unlock(&lock);
+
+    return ret;
+} /* }}} */
+
+const char* tag_next(const char* pos, size_t* length) { /* {{{ */
+    /**
+     * find the next tag in a list of quoted, comma separated tags
+     * pos    - where to look from
+     * length - set to the length of the tag
+     * return is the first character of the tag, or NULL if there are no more
+     */
+    const char* end;
+
+    pos = strchr(pos, '"');
+
+    if (pos == NULL || (end = strchr(pos + 1, '"')) == NULL) {
+        return NULL;
+    }
+
+    *length = end - pos - 1;
+
+    return pos + 1;
+} /* }}} */
+
+bool tag_test(const struct task* tsk, const int id) { /* {{{ */
+    /* check whether a task has a numbered tag */
+    return id >= 0 && id / TAGWORDBITS < tsk->tagwords &&
+           ((tsk->tagbits[id / TAGWORDBITS] >> (id % TAGWORDBITS)) & 1) != 0;
+} /* }}} */
+
+void tags_free(void) { /* {{{ */
+    /* free the dictionary, no task's tag set may be tested after this */
+    int i;
+
+    pthread_mutex_lock(&lock);
+
+    for (i = 0; i < ntags; i++) {
+        free(names[i]);
+    }
+
+    free(names);
+    free(slots);
+    names = NULL;
+    slots = NULL;
+    ntags = 0;
+    capacity = 0;
+    nslots = 0;
+
+    pthread_mutex_unlock(&lock);
+} /* }}} */
+
+void tags_index(struct task* tsk) { /* {{{ */
+    /**
+     * build the set of a task's tags from its list of tags
+     * this must be run whenever the task's tags are set
+     * tsk - the task, the set is allocated from its arena
+     */
+    const char* pos;
+    size_t      length;
+    int         maxid = -1;
+    int         words;
+    int         id;
+
+    tsk->tagbits = NULL;
+    tsk->tagwords = 0;
+
+    /* number the tags first so the set fits one arena allocation */
+    for (pos = tsk->tags; pos != NULL && (pos = tag_next(pos, &length)) != NULL;
+         pos += length + 1) {
+        id = tag_id(pos, length, true);
+        maxid = id > maxid ? id : maxid;
+    }
+
+    words = maxid / TAGWORDBITS + 1;
+
+    if (maxid < 0 || words > UINT16_MAX) {
+        return;
+    }
+
+    tsk->tagbits = arena_calloc(tsk->arena, words * sizeof(uint64_t));
+
+    if (tsk->tagbits == NULL) {
+        return;
+    }
+
+    tsk->tagwords = words;
+
+    for (pos = tsk->tags; (pos = tag_next(pos, &length)) != NULL; pos += length + 1) {
+        id = tag_id(pos, length, true);
+
+        if (id >= 0) {
+            tsk->tagbits[id / TAGWORDBITS] |= (uint64_t)1 << (id % TAGWORDBITS);
+        }
+    }
+} /* }}} */
+
+// vim: et ts=4 sw=4 sts=4
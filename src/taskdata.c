@@ -0,0 +1,614 @@
+/*
+ * taskdata.c - read taskwarrior's data files without running task
+ * for tasknc
+ * by mjheagle
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "arena.h"
+#include "common.h"
+#include "config.h"
+#include "intern.h"
+#include "json.h"
+#include "log.h"
+#include "sort.h"
+#include "tags.h"
+#include "taskdata.h"
+#include "tasks.h"
+#include "timing.h"
+
+/* the statuses a filter selects, as a mask */
+#define STATUS_PENDING                  (1 << 0)
+#define STATUS_WAITING                  (1 << 1)
+#define STATUS_RECURRING                (1 << 2)
+#define STATUS_COMPLETED                (1 << 3)
+#define STATUS_DELETED                  (1 << 4)
+#define STATUS_ANY                      ((1 << 5) - 1)
+
+/* statuses that are kept in completed.data */
+#define STATUS_DONE                     (STATUS_COMPLETED | STATUS_DELETED)
+
+/* compare a length delimited name with a literal */
+#define NAME_IS(name, len, lit)         ((len) == sizeof(lit) - 1 && memcmp((name), (lit), (len)) == 0)
+
+/**
+ * data file struct - a mapped taskwarrior data file
+ * data - the contents of the file
+ * size - the size of the file
+ */
+struct data_file {
+    char* data;
+    size_t size;
+};
+
+/**
+ * data scan struct - the state of a load over the data files
+ * statuses - the statuses of the tasks to keep
+ * uuid     - the only task to keep (NULL to keep every task)
+ * id       - the id given to the last task that has one
+ * first    - the first task kept
+ * last     - the last task kept
+ * arena    - the arena the tasks are allocated from
+ */
+struct data_scan {
+    int statuses;
+    const char* uuid;
+    unsigned int id;
+    struct task* first;
+    struct task* last;
+    struct arena* arena;
+};
+
+/* the native reader, writes still go through the task command */
+const struct task_source taskdata_source = {
+    "native", taskdata_usable, NULL, taskdata_load
+};
+
+/* local functions */
+static bool data_file_map(struct data_file* file, const char* dir, const char* name);
+static void data_file_scan(const struct data_file* file, struct data_scan* scan,
+                           const bool ids);
+static int filter_statuses(const char* filter);
+static int line_status(const char* line, const char* end);
+static struct task* parse_line(const char* line, const char* end, struct arena* arena);
+static char* parse_value(struct arena* arena, const char* start, const size_t length,
+                         const bool escaped);
+static int status_flag(const char* str, const size_t len);
+static char* tags_from_list(struct arena* arena, const char* list);
+
+bool data_file_map(struct data_file* file, const char* dir, const char* name) { /* {{{ */
+    /**
+     * map a data file to read it in place
+     * file - set to the mapped file
+     * dir  - the data directory
+     * name - the name of the file in the directory
+     * return is whether the file was mapped (an empty file is not)
+     */
+    struct stat st;
+    char*       path;
+    int         fd;
+
+    file->data = NULL;
+    file->size = 0;
+
+    asprintf(&path, "%s/%s", dir, name);
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) {
+        tnc_fprintf(logfp, LOG_DEBUG, "could not open data file (%s)", path);
+        free(path);
+        return false;
+    }
+
+    tnc_fprintf(logfp, LOG_DEBUG, "reading tasks (%s)", path);
+    free(path);
+
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        file->data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (file->data == MAP_FAILED) {
+            file->data = NULL;
+        } else {
+            file->size = st.st_size;
+        }
+    }
+
+    close(fd);
+
+    return file->data != NULL;
+} /* }}} */
+
+void data_file_scan(const struct data_file* file, struct data_scan* scan,
+                    const bool ids) { /* {{{ */
+    /**
+     * collect the tasks of a data file that a scan keeps
+     * file - the mapped file, one task per line
+     * scan - the scan to add tasks to
+     * ids  - whether tasks in this file are given ids (pending.data)
+     */
+    const char*     line;
+    const char*     end;
+    const char*     eof = file->data + file->size;
+    char            needle[UUIDLENGTH + 8];
+    struct task*    tsk;
+    unsigned int    id;
+    long long       start;
+    int             status;
+
+    if (scan->uuid != NULL) {
+        snprintf(needle, sizeof(needle), "uuid:\"%s\"", scan->uuid);
+    }
+
+    for (line = file->data; line < eof; line = end + 1) {
+        end = memchr(line, '\n', eof - line);
+        end = end != NULL ? end : eof;
+
+        if (*line != '[') {
+            continue;
+        }
+
+        /* pending, waiting and recurring tasks are numbered in file order */
+        status = line_status(line, end);
+        id = 0;
+
+        if (ids && (status & STATUS_DONE) == 0) {
+            id = ++(scan->id);
+        }
+
+        if ((status & scan->statuses) == 0 ||
+            (scan->uuid != NULL && memmem(line, end - line, needle, strlen(needle)) == NULL)) {
+            continue;
+        }
+
+        start = timer_start();
+        tsk = parse_line(line, end, scan->arena);
+        timer_stop(TIMER_PARSE_TASK, start);
+
+        if (tsk == NULL) {
+            tnc_fprintf(logfp, LOG_ERROR, "error parsing task @ %.32s", line);
+            continue;
+        } else if (uuid_empty(tsk->uuid) || tsk->description == NULL) {
+            tnc_fprintf(logfp, LOG_ERROR, "task is missing uuid or description");
+            continue;
+        }
+
+        tsk->index = id;
+        tsk->prev = scan->last;
+
+        if (scan->last == NULL) {
+            scan->first = tsk;
+        } else {
+            scan->last->next = tsk;
+        }
+
+        scan->last = tsk;
+
+        if (scan->uuid != NULL) {
+            return;
+        }
+    }
+} /* }}} */
+
+int filter_statuses(const char* filter) { /* {{{ */
+    /**
+     * work out which statuses a filter selects
+     * only filters made of status:<status> terms are understood, the terms
+     * must all match, as in taskwarrior
+     * filter - the filter (NULL or empty selects every task)
+     * return is the mask of statuses, or -1 if the filter is not understood
+     */
+    const char* pos = filter;
+    const char* term;
+    int         statuses = STATUS_ANY;
+    int         flag;
+
+    while (pos != NULL && *pos != 0) {
+        for (; *pos == ' ' || *pos == '\t'; pos++);
+
+        if (*pos == 0) {
+            break;
+        }
+
+        for (term = pos; *pos != 0 && *pos != ' ' && *pos != '\t'; pos++);
+
+        if (!str_starts_with(term, "status:") ||
+            (flag = status_flag(term + 7, pos - term - 7)) == 0) {
+            return -1;
+        }
+
+        statuses &= flag;
+    }
+
+    return statuses;
+} /* }}} */
+
+int line_status(const char* line, const char* end) { /* {{{ */
+    /**
+     * find the status of the task on a line without parsing it
+     * a line without a known status is treated as pending
+     */
+    const char* pos = line;
+    const char* value;
+    const char* close;
+    int         flag;
+
+    while ((pos = memmem(pos, end - pos, "status:\"", 8)) != NULL) {
+        /* the attribute name must start there */
+        if (pos > line && pos[-1] != ' ' && pos[-1] != '[') {
+            pos += 8;
+            continue;
+        }
+
+        value = pos + 8;
+        close = memchr(value, '"', end - value);
+
+        if (close != NULL && (flag = status_flag(value, close - value)) != 0) {
+            return flag;
+        }
+
+        break;
+    }
+
+    return STATUS_PENDING;
+} /* }}} */
+
+struct task* parse_line(const char* line, const char* end, struct arena* arena) { /* {{{ */
+    /**
+     * parse a task in taskwarrior's data file format
+     * [name:"value" name:"value" ...]
+     * line  - the start of the line
+     * end   - the end of the line
+     * arena - the arena the task and its strings are allocated from
+     * return is the task, or NULL if the line is malformed
+     */
+    struct task*        tsk = malloc_task(arena);
+    struct annotation*  lastanno = NULL;
+    struct annotation*  anno;
+    struct uda*         lastuda = NULL;
+    struct uda*         uda;
+    const char*         pos = line + 1;
+    const char*         name;
+    const char*         value;
+    size_t              namelen;
+    size_t              len;
+    bool                escaped;
+    char*               str;
+
+    if (tsk == NULL) {
+        return NULL;
+    }
+
+    while (pos < end) {
+        for (; pos < end && *pos == ' '; pos++);
+
+        if (pos >= end || *pos == ']') {
+            return tsk;
+        }
+
+        /* read the attribute name */
+        name = pos;
+
+        for (; pos < end && *pos != ':'; pos++);
+
+        if (pos + 1 >= end || pos[1] != '"') {
+            return NULL;
+        }
+
+        namelen = pos - name;
+        value = pos + 2;
+        escaped = false;
+
+        /* find the closing quote, skipping escaped characters */
+        for (pos = value; pos < end && *pos != '"'; pos++) {
+            if (*pos == '\\') {
+                escaped = true;
+                pos++;
+            } else if (*pos == '&') {
+                escaped = true;
+            }
+        }
+
+        if (pos >= end) {
+            return NULL;
+        }
+
+        len = pos - value;
+        pos++;
+
+        /* store the attribute */
+        if (NAME_IS(name, namelen, "uuid")) {
+            uuid_parse(value, len, tsk->uuid);
+        } else if (NAME_IS(name, namelen, "description")) {
+            tsk->description = parse_value(arena, value, len, escaped);
+        } else if (NAME_IS(name, namelen, "project")) {
+            /* a project without escapes is pooled straight from the file */
+            str = escaped ? parse_value(arena, value, len, escaped) : NULL;
+            tsk->project = str != NULL ? intern_string(str, strlen(str)) :
+                           intern_string(value, len);
+        } else if (NAME_IS(name, namelen, "tags")) {
+            tsk->tags = tags_from_list(arena, parse_value(arena, value, len, escaped));
+            tags_index(tsk);
+        } else if (NAME_IS(name, namelen, "entry")) {
+            tsk->entry = strtoll(value, NULL, 10);
+        } else if (NAME_IS(name, namelen, "due")) {
+            tsk->due = strtoll(value, NULL, 10);
+        } else if (NAME_IS(name, namelen, "start")) {
+            tsk->start = strtoll(value, NULL, 10);
+        } else if (NAME_IS(name, namelen, "end")) {
+            tsk->end = strtoll(value, NULL, 10);
+        } else if (NAME_IS(name, namelen, "modified")) {
+            tsk->modified = strtoll(value, NULL, 10);
+        } else if (NAME_IS(name, namelen, "priority")) {
+            tsk->priority = len > 0 ? *value : 0;
+        } else if (namelen > 11 && memcmp(name, "annotation_", 11) == 0) {
+            anno = arena_calloc(arena, sizeof(struct annotation));
+            anno->entry = strtoll(name + 11, NULL, 10);
+            anno->description = parse_value(arena, value, len, escaped);
+
+            if (lastanno == NULL) {
+                tsk->annotations = anno;
+            } else {
+                lastanno->next = anno;
+            }
+
+            lastanno = anno;
+        } else {
+            /* everything else is kept by name, like the export's udas */
+            str = arena_strndup(arena, name, namelen);
+            uda = arena_calloc(arena, sizeof(struct uda));
+            uda->name = str;
+            uda->value = parse_value(arena, value, len, escaped);
+
+            if (lastuda == NULL) {
+                tsk->udas = uda;
+            } else {
+                lastuda->next = uda;
+            }
+
+            lastuda = uda;
+        }
+    }
+
+    return NULL;
+} /* }}} */
+
+char* parse_value(struct arena* arena, const char* start, const size_t length,
+                  const bool escaped) { /* {{{ */
+    /**
+     * copy an attribute value, decoding the escapes taskwarrior writes
+     * (json escapes, and the &open; &close; &dquot; of older versions)
+     * arena   - the arena to allocate the string from
+     * start   - the value, inside its quotes
+     * length  - the length of the value
+     * escaped - whether the value contains anything to decode
+     */
+    const struct json_token token = {JSON_STRING, start, length, escaped};
+    const char*             src;
+    char*                   dst;
+    char*                   str = arena_alloc(arena, length + 1);
+
+    json_unescape(&token, str);
+
+    if (!escaped || strchr(str, '&') == NULL) {
+        return str;
+    }
+
+    for (src = dst = str; *src != 0; dst++) {
+        if (str_starts_with(src, "&open;")) {
+            *dst = '[';
+            src += 6;
+        } else if (str_starts_with(src, "&close;")) {
+            *dst = ']';
+            src += 7;
+        } else if (str_starts_with(src, "&dquot;")) {
+            *dst = '"';
+            src += 7;
+        } else {
+            *dst = *(src++);
+        }
+    }
+
+    *dst = 0;
+
+    return str;
+} /* }}} */
+
+int status_flag(const char* str, const size_t len) { /* {{{ */
+    /* map a status name to its flag, 0 if it is not a status */
+    if (NAME_IS(str, len, "pending")) {
+        return STATUS_PENDING;
+    } else if (NAME_IS(str, len, "waiting")) {
+        return STATUS_WAITING;
+    } else if (NAME_IS(str, len, "recurring")) {
+        return STATUS_RECURRING;
+    } else if (NAME_IS(str, len, "completed")) {
+        return STATUS_COMPLETED;
+    } else if (NAME_IS(str, len, "deleted")) {
+        return STATUS_DELETED;
+    }
+
+    return 0;
+} /* }}} */
+
+char* tags_from_list(struct arena* arena, const char* list) { /* {{{ */
+    /**
+     * convert a comma separated list of tags into the quoted form tags are
+     * kept in ("a","b"), as parsed from the export
+     * arena - the arena to allocate the tags from
+     * list  - the tags as stored in the data file
+     */
+    const char* pos;
+    char*       tags;
+    char*       dst;
+    size_t      size = 3;
+
+    if (list == NULL || *list == 0) {
+        return NULL;
+    }
+
+    for (pos = list; *pos != 0; pos++) {
+        size += *pos == ',' ? 3 : 1;
+    }
+
+    tags = arena_alloc(arena, size);
+    dst = tags;
+    *(dst++) = '"';
+
+    for (pos = list; *pos != 0; pos++) {
+        if (*pos == ',') {
+            *(dst++) = '"';
+            *(dst++) = ',';
+            *(dst++) = '"';
+        } else {
+            *(dst++) = *pos;
+        }
+    }
+
+    *(dst++) = '"';
+    *dst = 0;
+
+    return tags;
+} /* }}} */
+
+struct task* taskdata_load(const char* filter, const char* uuid,
+                           struct arena* arena) { /* {{{ */
+    /**
+     * read the tasks matching a filter from taskwarrior's data files
+     * completed.data is only read if the filter selects completed or
+     * deleted tasks
+     * filter - the filter, which taskdata_usable must accept
+     * uuid   - the only task to read (NULL to read every matching task)
+     * arena  - the arena the tasks and their strings are allocated from
+     * return is the sorted list of tasks read, or NULL if there were none
+     */
+    struct data_scan    scan;
+    struct data_file    file;
+    char*               dir;
+
+    scan.statuses   = filter_statuses(filter);
+    scan.uuid       = uuid;
+    scan.id         = 0;
+    scan.first      = NULL;
+    scan.last       = NULL;
+    scan.arena      = arena;
+
+    if (scan.statuses <= 0) {
+        return NULL;
+    }
+
+    dir = taskdata_location();
+
+    /* completed tasks stay in pending.data until taskwarrior's garbage
+     * collection moves them, so it is read for any filter
+     */
+    if (data_file_map(&file, dir, "pending.data")) {
+        data_file_scan(&file, &scan, true);
+        munmap(file.data, file.size);
+    }
+
+    if ((scan.statuses & STATUS_DONE) != 0 && (uuid == NULL || scan.first == NULL) &&
+        data_file_map(&file, dir, "completed.data")) {
+        data_file_scan(&file, &scan, false);
+        munmap(file.data, file.size);
+    }
+
+    free(dir);
+
+    return sort_wrapper(scan.first);
+} /* }}} */
+
+char* taskdata_location(void) { /* {{{ */
+    /* find the directory taskwarrior keeps its data files in
+     * $TASKDATA overrides data.location in $TASKRC (or ~/.taskrc)
+     * return is the path, which must be free'd
+     */
+    const char* home = getenv("HOME");
+    char*       rcpath = NULL;
+    char*       location = NULL;
+    char*       value;
+    char*       line = NULL;
+    char*       path;
+    size_t      linelen = 0;
+    size_t      len;
+    FILE*       rc;
+
+    if (getenv("TASKDATA") != NULL) {
+        return strdup(getenv("TASKDATA"));
+    }
+
+    if (home == NULL) {
+        home = "";
+    }
+
+    if (getenv("TASKRC") != NULL) {
+        rcpath = strdup(getenv("TASKRC"));
+    } else {
+        asprintf(&rcpath, "%s/.taskrc", home);
+    }
+
+    /* the last setting in the rc file is the one taskwarrior uses */
+    if ((rc = fopen(rcpath, "r")) != NULL) {
+        while (getline(&line, &linelen, rc) >= 0) {
+            if (sscanf(line, " data.location = %m[^\n]", &value) == 1) {
+                for (len = strlen(value); len > 0 && (value[len - 1] == ' ' ||
+                                                      value[len - 1] == '\t'); len--) {
+                    value[len - 1] = 0;
+                }
+
+                check_free(location);
+                location = value;
+            }
+        }
+
+        free(line);
+        fclose(rc);
+    }
+
+    free(rcpath);
+
+    if (location == NULL) {
+        location = strdup("~/.task");
+    }
+
+    /* expand a leading ~ */
+    if (location[0] == '~' && (location[1] == '/' || location[1] == 0)) {
+        asprintf(&path, "%s%s", home, location + 1);
+        free(location);
+        location = path;
+    }
+
+    return location;
+} /* }}} */
+
+bool taskdata_usable(const char* filter) { /* {{{ */
+    /**
+     * check whether the data files can be read for a filter
+     * filter - the filter the tasks are loaded with
+     * return is whether the filter is understood and pending.data can be
+     *        read, taskwarrior 3 keeps its tasks in a database instead
+     */
+    char*   dir;
+    char*   path;
+    bool    usable;
+
+    if (filter_statuses(filter) < 0) {
+        return false;
+    }
+
+    dir = taskdata_location();
+    asprintf(&path, "%s/pending.data", dir);
+    usable = access(path, R_OK) == 0;
+    free(path);
+    free(dir);
+
+    return usable;
+} /* }}} */
+
+// vim: et ts=4 sw=4 sts=4
@@ -18,71 +18,121 @@
 #include "common.h"
 #include "config.h"
 #include "formats.h"
+#include "groups.h"
+#include "infocache.h"
+#include "jobs.h"
 #include "keys.h"
 #include "log.h"
+#include "searchindex.h"
 #include "sort.h"
 #include "statusbar.h"
 #include "tasklist.h"
 #include "tasknc.h"
 #include "tasks.h"
+#include "tasktable.h"
+#include "timing.h"
+#include "watch.h"
 #include "pager.h"
 
+/* uuid of the selected task while the list reloads (empty if none) */
+static char reload_uuid[UUIDLENGTH] = "";
+
+/* where the selection was when the search prompt opened */
+static int      search_selline = 0;
+static int      search_offset = 0;
+
 /* local functions */
 void tasklist_command_message(const int ret,
                               const char* fail,
                               const char* success);
+static void tasklist_batch_done(const struct job* job);
+static void tasklist_complete_done(const struct job* job);
+static void tasklist_delete_done(const struct job* job);
+static int tasklist_remove_marked(void);
+static void tasklist_reload(void);
+static void tasklist_reloaded(void);
+static void tasklist_search_preview(const char* str);
+static void tasklist_start_done(const struct job* job);
+static void tasklist_stop_done(const struct job* job);
+static void tasklist_task_add_done(const struct job* job);
+static void tasklist_undo_done(const struct job* job);
 
 void key_tasklist_add(void) { /* {{{ */
     /* handle a keyboard direction to add new task */
     tasklist_task_add();
-    reload = 1;
 } /* }}} */
 
 void key_tasklist_complete(void) { /* {{{ */
-    /* complete selected task */
+    /* complete the marked tasks, or the selected task if none are marked
+     * the tasks leave the list right away, the next task can be completed
+     * while taskwarrior is still running
+     */
     struct task* cur = get_task_by_position(selline);
-    int          ret;
+
+    if (task_batch_command("done", tasklist_batch_done) > 0) {
+        statusbar_message(cfg.statusbar_timeout, "completing %d tasks",
+                          tasklist_remove_marked());
+        return;
+    }
+
+    if (cur == NULL) {
+        statusbar_message(cfg.statusbar_timeout, "no task selected");
+        return;
+    }
 
     statusbar_message(cfg.statusbar_timeout, "completing task");
 
-    ret = task_background_command("task %s done");
+    task_background_command("task %s done", tasklist_complete_done);
     tasklist_remove_task(cur);
-
-    tasklist_command_message(ret, "complete failed (%d)", "complete successful");
 } /* }}} */
 
 void key_tasklist_delete(void) { /* {{{ */
-    /* complete selected task */
+    /* delete the marked tasks, or the selected task if none are marked
+     * pressing the key is the confirmation, taskwarrior can not prompt for it
+     * from the background
+     */
     struct task* cur = get_task_by_position(selline);
-    int          ret;
+
+    if (task_batch_command("delete", tasklist_batch_done) > 0) {
+        statusbar_message(cfg.statusbar_timeout, "deleting %d tasks",
+                          tasklist_remove_marked());
+        return;
+    }
+
+    if (cur == NULL) {
+        statusbar_message(cfg.statusbar_timeout, "no task selected");
+        return;
+    }
 
     statusbar_message(cfg.statusbar_timeout, "deleting task");
 
-    ret = task_background_command("task %s delete");
+    task_background_command("task rc.confirmation:no %s delete", tasklist_delete_done);
     tasklist_remove_task(cur);
-
-    tasklist_command_message(ret, "delete failed (%d)", "delete successful");
 } /* }}} */
 
 void key_tasklist_edit(void) { /* {{{ */
     /* edit selected task */
-    struct task* cur = get_task_by_position(selline);
+    struct task* cur;
     int          ret;
-    char*        uuid;
+
+    if (get_task_by_position(selline) == NULL) {
+        statusbar_message(cfg.statusbar_timeout, "no task selected");
+        return;
+    }
 
     statusbar_message(cfg.statusbar_timeout, "editing task");
 
+    /* finish queued commands first, they may change the selected task */
+    jobs_wait();
+    cur = get_task_by_position(selline);
+
     ret = task_interactive_command("task %s edit");
-    uuid = strdup(cur->uuid);
-    reload_task(cur);
+    cur = cur != NULL ? tasktable_find(cur->uuid) : NULL;
 
-    if (cfg.follow_task) {
-        set_position_by_uuid(uuid);
-        tasklist_check_curs_pos();
+    if (cur != NULL) {
+        reload_task(cur);
     }
 
-    check_free(uuid);
-
     tasklist_command_message(ret, "edit failed (%d)", "edit succesful");
 } /* }}} */
 
@@ -91,6 +141,9 @@ void key_tasklist_filter(const char* arg) { /* {{{ */
      * arg - string to filter by (pass NULL to prompt user)
      *       see the manual page for how filter strings are parsed
      */
+    struct task*    cur = get_task_by_position(selline);
+    int             pos;
+
     check_free(active_filter);
 
     if (arg == NULL) {
@@ -100,17 +153,120 @@ void key_tasklist_filter(const char* arg) { /* {{{ */
         active_filter = strdup(arg);
     }
 
-    /* force reload of task list */
     statusbar_message(cfg.statusbar_timeout, "filter applied");
-    reload = true;
+
+    /* narrowing the loaded tasks needs no export, anything else reloads */
+    if (!apply_filter()) {
+        reload = true;
+        return;
+    }
+
+    pos = cur != NULL ? get_task_position_by_uuid(cur->uuid) : -1;
+    selline = pos >= 0 ? pos : 0;
+    tasklist_check_curs_pos();
+    redraw = true;
+} /* }}} */
+
+void key_tasklist_fold(void) { /* {{{ */
+    /* collapse the group of the selected task, or expand the selected header */
+    if (!groups_active()) {
+        statusbar_message(cfg.statusbar_timeout, "task list is not grouped");
+        return;
+    }
+
+    selline = groups_toggle(selline);
+    tasklist_check_curs_pos();
+    redraw = true;
+} /* }}} */
+
+void key_tasklist_group(void) { /* {{{ */
+    /* switch between the task list grouped by project and the flat list,
+     * keeping the selected task
+     */
+    struct task*    cur = get_task_by_position(selline);
+    int             pos;
+
+    cfg.group_view = !cfg.group_view;
+    pos = cur != NULL ? get_task_position_by_uuid(cur->uuid) : -1;
+    selline = pos >= 0 ? pos : 0;
+    tasklist_check_curs_pos();
+    statusbar_message(cfg.statusbar_timeout, cfg.group_view ? "grouped by project" :
+                      "not grouped");
+    redraw = true;
+} /* }}} */
+
+void key_tasklist_mark(void) { /* {{{ */
+    /* toggle the mark on the selected task and move to the next task */
+    struct task* cur = get_task_by_position(selline);
+
+    if (cur == NULL) {
+        return;
+    }
+
+    cur->marked = !cur->marked;
+
+    /* reset cached colors */
+    cur->pair = -1;
+    cur->selpair = -1;
+
+    key_tasklist_scroll_down();
+    redraw = true;
+} /* }}} */
+
+void key_tasklist_mark_search(const char* arg) { /* {{{ */
+    /* mark every task matching a search
+     * arg - the string to match (pass NULL to prompt user)
+     *       tasks are matched as they are by search
+     */
+    const struct task** candidates;
+    struct task*        cur;
+    struct task*        this;
+    char*               str;
+    int                 ncandidates;
+    int                 i;
+    int                 n = 0;
+
+    if (arg == NULL) {
+        statusbar_getstr(&str, "mark: ");
+        wipe_statusbar();
+    } else {
+        str = strdup(arg);
+    }
+
+    /* only the candidates offered by the search index can match */
+    ncandidates = searchindex_query(str, &candidates);
+    cur = ncandidates < 0 ? head : NULL;
+
+    for (i = 0; i < ncandidates || cur != NULL; i++) {
+        this = ncandidates < 0 ? cur : (struct task*)candidates[i];
+
+        if (cur != NULL) {
+            cur = cur->next;
+        }
+
+        if (!this->marked && task_match(this, str)) {
+            this->marked = true;
+            this->pair = -1;
+            this->selpair = -1;
+            n++;
+        }
+    }
+
+    check_free(str);
+
+    statusbar_message(cfg.statusbar_timeout, "%d tasks marked", n);
+    redraw = true;
 } /* }}} */
 
 void key_tasklist_modify(const char* arg) { /* {{{ */
-    /* handle a keyboard direction to modify a task
+    /* handle a keyboard direction to modify the marked tasks, or the
+     * selected task if none are marked
      * arg - the modifications to apply (pass NULL to prompt user)
      *       this will be appended to `task UUID modify `
      */
-    char* argstr;
+    char*   argstr;
+    char*   action;
+    int     n;
 
     if (arg == NULL) {
         statusbar_getstr(&argstr, "modify: ");
@@ -119,6 +275,24 @@ void key_tasklist_modify(const char* arg) { /* {{{ */
         argstr = strdup(arg);
     }
 
+    /* the modified tasks are updated by a single reload once it finishes */
+    asprintf(&action, "modify %s", argstr != NULL ? argstr : "");
+    n = task_batch_command(action, tasklist_batch_done);
+    free(action);
+
+    if (n > 0) {
+        key_tasklist_unmark();
+        free(argstr);
+        statusbar_message(cfg.statusbar_timeout, "modifying %d tasks", n);
+        return;
+    }
+
+    if (get_task_by_position(selline) == NULL) {
+        free(argstr);
+        statusbar_message(cfg.statusbar_timeout, "no task selected");
+        return;
+    }
+
     task_modify(argstr);
     free(argstr);
 
@@ -140,8 +314,8 @@ void key_tasklist_scroll(const int direction) { /* {{{ */
      *             h = to first element in list
      *             e = to last element in list
      */
-    const char oldsel    = selline;
-    const char oldoffset = pageoffset;
+    const int oldsel    = selline;
+    const int oldoffset = pageoffset;
 
     switch (direction) {
     case 'u':
@@ -195,7 +369,14 @@ void key_tasklist_scroll(const int direction) { /* {{{ */
         break;
     }
 
-    if (pageoffset != oldoffset) {
+    if (pageoffset - oldoffset == 1 || oldoffset - pageoffset == 1) {
+        /* shift the page a line, only the new row and the selection change */
+        scrollok(tasklist, TRUE);
+        wscrl(tasklist, pageoffset - oldoffset);
+        scrollok(tasklist, FALSE);
+        tasklist_print_task(oldsel, NULL, 1);
+        tasklist_print_task(selline, NULL, 1);
+    } else if (pageoffset != oldoffset) {
         redraw = true;
     } else {
         if (oldsel - selline == 1) {
@@ -236,15 +417,22 @@ void key_tasklist_search(const char* arg) { /* {{{ */
     check_free(searchstring);
 
     if (arg == NULL) {
-        /* store search string  */
-        statusbar_getstr(&searchstring, "/");
+        /* store search string, previewing the first result as it is typed */
+        search_selline = selline;
+        search_offset = pageoffset;
+        statusbar_getstr_live(&searchstring, "/",
+                              cfg.incremental_search ? tasklist_search_preview : NULL);
         wipe_statusbar();
+
+        /* search from where the prompt was opened */
+        selline = search_selline;
+        pageoffset = search_offset;
     } else {
         searchstring = strdup(arg);
     }
 
     /* go to first result */
-    find_next_search_result(head, get_task_by_position(selline));
+    find_next_search_result(get_task_by_position(selline));
     tasklist_check_curs_pos();
     redraw = true;
 } /* }}} */
@@ -252,7 +440,7 @@ void key_tasklist_search(const char* arg) { /* {{{ */
 void key_tasklist_search_next(void) { /* {{{ */
     /* handle a keyboard direction to move to next search result */
     if (searchstring != NULL) {
-        find_next_search_result(head, get_task_by_position(selline));
+        find_next_search_result(get_task_by_position(selline));
         tasklist_check_curs_pos();
         redraw = true;
     } else {
@@ -265,13 +453,13 @@ void key_tasklist_sort(const char* arg) { /* {{{ */
      * arg - the mode to sort by (pass NULL to prompt user)
      *       see the manual page for how sort strings are parsed
      */
-    char*        uuid = NULL;
+    char         uuid[UUIDLENGTH] = "";
 
     /* store selected task */
     struct task* cur = get_task_by_position(selline);
 
     if (cur != NULL) {
-        uuid = strdup(cur->uuid);
+        uuid_format(cur->uuid, uuid);
     }
 
     tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "sort: initial task uuid=%s", uuid);
@@ -288,7 +476,8 @@ void key_tasklist_sort(const char* arg) { /* {{{ */
     }
 
     /* run sort */
-    sort_wrapper(head);
+    head = sort_wrapper(head);
+    tasktable_reorder(head);
 
     /* follow original task */
     if (cfg.follow_task) {
@@ -296,8 +485,6 @@ void key_tasklist_sort(const char* arg) { /* {{{ */
         tasklist_check_curs_pos();
     }
 
-    check_free(uuid);
-
     /* force redraw */
     redraw = true;
 } /* }}} */
@@ -319,69 +506,99 @@ void key_tasklist_sync(void) { /* {{{ */
 } /* }}} */
 
 void key_tasklist_toggle_started(void) { /* {{{ */
-    /* toggle whether a task is started */
-    time_t          now;
+    /* toggle whether a task is started
+     * the task is shown with its new state while the command runs, and
+     * reloaded if the command fails
+     */
     struct task*    cur = get_task_by_position(selline);
     char*           cmdstr;
-    char*           action;
-    char*           actionpast;
-    char*           reply;
-    FILE*           cmdout;
-    int             ret;
-    bool            started = cur->start > 0;/* check whether task is started */
+    char            uuid[UUIDLENGTH];
+    bool            started;
+
+    if (cur == NULL) {
+        statusbar_message(cfg.statusbar_timeout, "no task selected");
+        return;
+    }
+
+    /* check whether task is started */
+    started = cur->start > 0;
 
     /* generate command */
-    cmdstr = calloc(UUIDLENGTH + 16, sizeof(char));
-    strcpy(cmdstr, "task ");
-    strcat(cmdstr, cur->uuid);
-    action = started ? " stop" : " start";
-    strcat(cmdstr, action);
-
-    /* run command */
-    cmdout = popen(cmdstr, "r");
+    uuid_format(cur->uuid, uuid);
+    asprintf(&cmdstr, "task %s %s", uuid, started ? "stop" : "start");
+    jobs_submit(cmdstr, started ? tasklist_stop_done : tasklist_start_done,
+                strdup(uuid));
     free(cmdstr);
-    ret = pclose(cmdout);
-
-    /* check return value */
-    if (WEXITSTATUS(ret) == 0) {
-        time(&now);
-        cur->start = started ? 0 : now;
-        actionpast = started ? "stopped" : "started";
-        asprintf(&reply, "task %s", actionpast);
-        /* reset cached colors */
-        cur->pair = -1;
-        cur->selpair = -1;
-    } else {
-        asprintf(&reply, "task%s failed (%d)", action, WEXITSTATUS(ret));
-    }
 
-    statusbar_message(cfg.statusbar_timeout, reply);
-    free(reply);
+    cur->start = started ? 0 : time(NULL);
+
+    /* reset cached colors */
+    cur->pair = -1;
+    cur->selpair = -1;
+    redraw = true;
 } /* }}} */
 
 void key_tasklist_undo(void) { /* {{{ */
-    /* handle a keyboard direction to run an undo */
-    int ret = task_background_command("task undo");
+    /* handle a keyboard direction to run an undo
+     * pressing the key is the confirmation, taskwarrior can not prompt for it
+     * from the background
+     */
+    task_background_command("task rc.confirmation:no undo", tasklist_undo_done);
+} /* }}} */
 
-    if (ret == 0) {
-        statusbar_message(cfg.statusbar_timeout, "undo executed");
-        reload = true;
-    } else {
-        statusbar_message(cfg.statusbar_timeout, "undo execution failed (%d)", ret);
+void key_tasklist_unmark(void) { /* {{{ */
+    /* remove the mark from every task */
+    struct task* cur;
+
+    for (cur = head; cur != NULL; cur = cur->next) {
+        if (cur->marked) {
+            cur->marked = false;
+            cur->pair = -1;
+            cur->selpair = -1;
+        }
     }
 
-    tasklist_check_curs_pos();
+    redraw = true;
 } /* }}} */
 
 void key_tasklist_view(void) { /* {{{ */
-    /* run task info on a task and display in pager */
-    view_task(get_task_by_position(selline));
+    /* run task info on a task and display in pager, on a group's header
+     * the group is collapsed or expanded instead
+     */
+    struct task* cur = get_task_by_position(selline);
+
+    if (cur == NULL && groups_active()) {
+        key_tasklist_fold();
+        return;
+    }
+
+    view_task(cur);
+} /* }}} */
+
+void tasklist_batch_done(const struct job* job) { /* {{{ */
+    /* report a batch command, and reload the tasks it changed
+     * job - the batch command, its data is the number of tasks in the batch
+     */
+    const int n = *(const int*)job->data;
+
+    if (job->ret == 0) {
+        statusbar_message(cfg.statusbar_timeout, "%d tasks updated", n);
+    } else {
+        statusbar_message(cfg.statusbar_timeout, "command failed on %d tasks (%d)", n,
+                          job->ret);
+    }
+
+    reload = true;
 } /* }}} */
 
 void tasklist_check_curs_pos(void) { /* {{{ */
-    /* check if the cursor is in a valid position */
+    /* check if the cursor is in a valid position
+     * the list may have grown, if a group was expanded to show a task
+     */
     const int onscreentasks = getmaxy(tasklist);
 
+    task_count();
+
     /* log starting cursor position */
     tnc_fprintf(logfp, LOG_DEBUG_VERBOSE,
                 "cursor_check(init) - selline:%d offset:%d taskcount:%d perscreen:%d", selline,
@@ -433,11 +650,105 @@ void tasklist_command_message(const int ret,
     }
 } /* }}} */
 
+void tasklist_complete_done(const struct job* job) { /* {{{ */
+    /* report a completed task, restoring it to the list if it failed */
+    tasklist_command_message(job->ret, "complete failed (%d)", "complete successful");
+
+    if (job->ret != 0) {
+        reload = true;
+    }
+} /* }}} */
+
+void tasklist_delete_done(const struct job* job) { /* {{{ */
+    /* report a deleted task, restoring it to the list if it failed */
+    tasklist_command_message(job->ret, "delete failed (%d)", "delete successful");
+
+    if (job->ret != 0) {
+        reload = true;
+    }
+} /* }}} */
+
+void tasklist_reload(void) { /* {{{ */
+    /* reload the task list in the background, following the selected task */
+    struct task* cur = get_task_by_position(selline);
+
+    if (cur != NULL && reload_uuid[0] == 0) {
+        uuid_format(cur->uuid, reload_uuid);
+    }
+
+    reload_tasks_background(tasklist_reloaded);
+} /* }}} */
+
+void tasklist_reloaded(void) { /* {{{ */
+    /* show the task list once it has been reloaded */
+    const int oldsel = selline;
+    const int oldoffset = pageoffset;
+
+    if (cfg.follow_task) {
+        set_position_by_uuid(reload_uuid);
+    }
+
+    reload_uuid[0] = 0;
+    tasklist_update(oldsel, oldoffset);
+} /* }}} */
+
+void tasklist_search_preview(const char* str) { /* {{{ */
+    /**
+     * move the selection to the first result of a search as it is typed
+     * str - the search entered so far
+     */
+    struct task*    found;
+    bool            wrapped;
+
+    selline = search_selline;
+    pageoffset = search_offset;
+
+    if (str[0] != 0) {
+        found = task_search(get_task_by_position(search_selline), str, &wrapped);
+
+        if (found != NULL) {
+            selline = get_task_position_by_uuid(found->uuid);
+        }
+    }
+
+    tasklist_check_curs_pos();
+    tasklist_print_task_list();
+    wrefresh(tasklist);
+} /* }}} */
+
+void tasklist_start_done(const struct job* job) { /* {{{ */
+    /* report a started task, reloading it if it failed */
+    struct task* cur = tasktable_find(job->data);
+
+    if (job->ret == 0) {
+        statusbar_message(cfg.statusbar_timeout, "task started");
+    } else {
+        statusbar_message(cfg.statusbar_timeout, "task start failed (%d)", job->ret);
+
+        if (cur != NULL) {
+            reload_task(cur);
+        }
+    }
+} /* }}} */
+
+void tasklist_stop_done(const struct job* job) { /* {{{ */
+    /* report a stopped task, reloading it if it failed */
+    struct task* cur = tasktable_find(job->data);
+
+    if (job->ret == 0) {
+        statusbar_message(cfg.statusbar_timeout, "task stopped");
+    } else {
+        statusbar_message(cfg.statusbar_timeout, "task stop failed (%d)", job->ret);
+
+        if (cur != NULL) {
+            reload_task(cur);
+        }
+    }
+} /* }}} */
+
 void tasklist_window(void) { /* {{{ */
     /* ncurses main function */
     int             c;
-    struct task*    cur;
-    char*           uuid = NULL;
 
     /* get field lengths */
     cfg.fieldlengths.project = max_project_length();
@@ -460,17 +771,24 @@ void tasklist_window(void) { /* {{{ */
         ncurses_end(-1);
     }
 
+    /* let single line scrolls use the terminal's insert/delete line */
+    idlok(tasklist, TRUE);
+
     /* set curses settings */
     set_curses_mode(NCURSES_MODE_STD);
 
     /* print task list */
     check_screen_size();
-    cfg.fieldlengths.description = COLS - cfg.fieldlengths.project - 1 -
-                                   cfg.fieldlengths.date;
+    cfg.fieldlengths.description = max_description_length();
     task_count();
     print_header();
     tasklist_print_task_list();
 
+    /* a list loaded from the snapshot is refreshed once it is shown */
+    if (reload) {
+        tasklist_reload();
+    }
+
     /* main loop */
     while (1) {
         /* set variables for determining actions */
@@ -478,6 +796,11 @@ void tasklist_window(void) { /* {{{ */
         redraw  = false;
         reload  = false;
 
+        /* nothing can be selected until queued commands reload the list */
+        if (head == NULL) {
+            jobs_wait();
+        }
+
         /* check for an empty task list */
         if (head == NULL) {
             if (strcmp(active_filter, "") == 0) {
@@ -503,45 +826,41 @@ void tasklist_window(void) { /* {{{ */
 
         /* apply staged window updates */
         doupdate();
+        phase_stop(PHASE_FIRST_FRAME);
 
-        /* get a character */
-        c = wgetch(statusbar);
+        /* get a character, finished commands and changes to the task data
+         * are handled while waiting, and the info of nearby tasks fetched
+         */
+        infocache_prefetch();
+        c = jobs_getch_timeout(statusbar, watch_fd(), watch_timeout(cfg.nc_timeout));
+
+        /* reload once outside changes to the task data have settled */
+        if (watch_changed()) {
+            reload = true;
+        }
 
         /* handle the character */
         handle_keypress(c, MODE_TASKLIST);
 
-        /* exit */
+        /* exit once queued commands have run */
         if (done) {
+            if (jobs_pending() > 0) {
+                statusbar_message(-1, "waiting for %d commands", jobs_pending());
+            }
+
+            jobs_wait();
             break;
         }
 
-        /* reload task list */
+        /* reload task list, it is redrawn once the reload finishes */
         if (reload) {
-            cur = get_task_by_position(selline);
-
-            if (cur) {
-                uuid = strdup(cur->uuid);
-            }
-
-            wipe_tasklist();
-            reload_tasks();
-            task_count();
-            redraw = true;
-
-            if (cfg.follow_task) {
-                set_position_by_uuid(uuid);
-            }
-
-            check_free(uuid);
-            uuid = NULL;
-            tasklist_check_curs_pos();
+            tasklist_reload();
         }
 
         /* redraw all windows */
         if (redraw) {
             cfg.fieldlengths.project = max_project_length();
-            cfg.fieldlengths.description = cols - cfg.fieldlengths.project - 1 -
-                                           cfg.fieldlengths.date;
+            cfg.fieldlengths.description = max_description_length();
             print_header();
             tasklist_print_task_list();
             tasklist_check_curs_pos();
@@ -567,13 +886,15 @@ void tasklist_print_task(const int tasknum,
      * this    - a pointer to the task to be printed
      *           only one of either `tasknum` or `this` should be specified
      * count   - number of consecutive tasks to print
+     * a group's header is printed in place of a task with the group format
      */
-    bool  sel = false;
-    char* tmp;
-    int   x;
-    int   y = tasknum - pageoffset; /* determine position to print */
+    bool                sel = false;
+    const char*         line;
+    const struct task*  group = NULL;
+    char*               header;
+    int                 y = tasknum - pageoffset; /* determine position to print */
 
-    if (y < 0 || y >= rows - 1) {
+    if (y < 0 || y >= rows - 2) {
         return;
     }
 
@@ -582,8 +903,13 @@ void tasklist_print_task(const int tasknum,
         this = get_task_by_position(tasknum);
     }
 
+    /* a grouped list has no task on a group's header */
+    if (this == NULL && groups_active()) {
+        group = groups_header(tasknum);
+    }
+
     /* check if this is NULL */
-    if (this == NULL) {
+    if (this == NULL && group == NULL) {
         tnc_fprintf(logfp, LOG_ERROR, "task %d is null", tasknum);
         return;
     }
@@ -595,32 +921,55 @@ void tasklist_print_task(const int tasknum,
 
     /* wipe line */
     wattrset(tasklist, COLOR_PAIR(0));
-
-    for (x = 0; x < cols; x++) {
-        mvwaddch(tasklist, y, x, ' ');
-    }
+    mvwhline(tasklist, y, 0, ' ', cols);
 
     /* evaluate line */
     wmove(tasklist, 0, 0);
-    wattrset(tasklist, get_colors(OBJECT_TASK, (struct task*)this, sel));
-    tmp = (char*)eval_format(cfg.formats.task_compiled, (struct task*)this);
-    umvaddstr_align(tasklist, y, tmp);
-    free(tmp);
+
+    if (group != NULL) {
+        wattrset(tasklist, get_colors(OBJECT_HEADER, NULL, sel) | (sel ? A_REVERSE : 0));
+        header = eval_format(cfg.formats.group_compiled, (struct task*)group);
+
+        if (header != NULL) {
+            umvaddstr_align(tasklist, y, header);
+            free(header);
+        }
+    } else {
+        wattrset(tasklist, get_colors(OBJECT_TASK, (struct task*)this, sel));
+        line = eval_task_format((struct task*)this);
+
+        if (line != NULL) {
+            umvaddstr_align(tasklist, y, (char*)line);
+        }
+    }
 
     /* print next task if requested */
     if (count > 1) {
-        tasklist_print_task(tasknum + 1, this->next, count - 1);
+        tasklist_print_task(tasknum + 1, groups_active() ? NULL : this->next, count - 1);
     } else {
         wnoutrefresh(tasklist);
     }
 } /* }}} */
 
 void tasklist_print_task_list(void) { /* {{{ */
-    /* print every task in the task list */
-    struct task* cur     = head;
-    short        counter = 0;
+    /* print the tasks on the visible page of the task list */
+    const long long start   = timer_start();
+    struct task*    cur     = get_task_by_position(pageoffset);
+    int             counter = pageoffset;
+
+    /* dates printed this frame are relative to today */
+    refresh_today();
+
+    /* only the rows on the page of a grouped list are looked up */
+    if (groups_active()) {
+        for (; counter < pageoffset + rows - 2 && counter < groups_count(); counter++) {
+            tasklist_print_task(counter, NULL, 1);
+        }
+
+        cur = NULL;
+    }
 
-    while (cur != NULL) {
+    while (cur != NULL && counter < pageoffset + rows - 2) {
         tasklist_print_task(counter, cur, 1);
 
         /* move to next item */
@@ -628,9 +977,31 @@ void tasklist_print_task_list(void) { /* {{{ */
         cur = cur->next;
     }
 
-    if (counter < cols - 2) {
-        wipe_screen(tasklist, counter - pageoffset, rows - 2);
+    if (counter - pageoffset < rows - 2) {
+        wipe_screen(tasklist, counter - pageoffset, rows - 3);
+    }
+
+    timer_stop(TIMER_PRINT_LIST, start);
+} /* }}} */
+
+int tasklist_remove_marked(void) { /* {{{ */
+    /* remove every marked task from the task list without reloading
+     * return is the number of tasks removed
+     */
+    struct task*    cur;
+    struct task*    next;
+    int             n = 0;
+
+    for (cur = head; cur != NULL; cur = next) {
+        next = cur->next;
+
+        if (cur->marked) {
+            tasklist_remove_task(cur);
+            n++;
+        }
     }
+
+    return n;
 } /* }}} */
 
 void tasklist_remove_task(struct task* this) { /* {{{ */
@@ -645,58 +1016,96 @@ void tasklist_remove_task(struct task* this) { /* {{{ */
         this->next->prev = this->prev;
     }
 
-    free_task(this);
-    taskcount--;
+    tasktable_remove(this);
+    release_task(this);
+
+    /* the task's memory is reclaimed along with the list's arena,
+     * unless it was the last task loaded
+     */
+    if (head == NULL && hidden_task_count() == 0) {
+        free_tasks(this);
+    }
+
     tasklist_check_curs_pos();
     redraw = true;
 } /* }}} */
 
 void tasklist_task_add(void) { /* {{{ */
     /* create a new task by adding a generic task
-     * then letting the user edit it
+     * then letting the user edit it once it has been created
+     */
+    statusbar_message(cfg.statusbar_timeout, "adding task");
+    jobs_submit("task add new task", tasklist_task_add_done, NULL);
+} /* }}} */
+
+void tasklist_task_add_done(const struct job* job) { /* {{{ */
+    /* edit a newly added task
+     * job - the task add command, which prints the new task's number
      */
-    FILE*           cmdout;
+    const char*     line;
     char*           cmd;
-    char            line[TOTALLENGTH];
-    char*           failmsg;
-    unsigned short  tasknum;
-    int             ret = 0;
-    int             pret;
-
-    /* add new task */
-    cmd = strdup("task add new task");
-    tnc_fprintf(logfp, LOG_DEBUG, "running: %s", cmd);
-    cmdout = popen(cmd, "r");
-
-    while (fgets(line, sizeof(struct line) - 1, cmdout) != NULL) {
-        if (sscanf(line, "Created task %hu.", &tasknum)) {
-            break;
-        }
+    unsigned int    tasknum = 0;
+    int             ret;
+
+    if (job->ret != 0) {
+        tasklist_command_message(job->ret, "task add failed (%d)", "");
+        return;
     }
 
-    pret = pclose(cmdout);
-    free(cmd);
+    for (line = job->output; line != NULL && *line != 0; line = strchr(line, '\n')) {
+        line += *line == '\n';
 
-    if (WEXITSTATUS(pret) != 0) {
-        failmsg = strdup("task add failed (%d)");
-        goto done;
+        if (sscanf(line, "Created task %u.", &tasknum) == 1) {
+            break;
+        }
     }
 
     /* edit task */
     if (cfg.version[0] < '2') {
-        asprintf(&cmd, "task edit %d", tasknum);
+        asprintf(&cmd, "task edit %u", tasknum);
     } else {
-        asprintf(&cmd, "task %d edit", tasknum);
+        asprintf(&cmd, "task %u edit", tasknum);
     }
 
     ret = task_interactive_command(cmd);
     free(cmd);
-    failmsg = strdup("task edit failed (%s)");
-    goto done;
 
-done:
-    tasklist_command_message(ret, failmsg, "task add succeeded");
-    free(failmsg);
+    tasklist_command_message(ret, "task edit failed (%d)", "task add succeeded");
+    reload = true;
+} /* }}} */
+
+void tasklist_undo_done(const struct job* job) { /* {{{ */
+    /* report an undo, reloading every task if it succeeded */
+    if (job->ret == 0) {
+        statusbar_message(cfg.statusbar_timeout, "undo executed");
+        invalidate_task_list();
+        reload = true;
+    } else {
+        statusbar_message(cfg.statusbar_timeout, "undo execution failed (%d)", job->ret);
+    }
+
+    tasklist_check_curs_pos();
+} /* }}} */
+
+void tasklist_update(const int oldsel, const int oldoffset) { /* {{{ */
+    /**
+     * show changes made to the tasks on the list
+     * the list is only redrawn if the rows on the page may have changed
+     * oldsel    - the selected line before the change
+     * oldoffset - the page offset before the change
+     */
+    const int first = tasktable_changed();
+
+    tasklist_check_curs_pos();
+
+    if (groups_active() || first < pageoffset + rows - 2 || selline != oldsel ||
+        pageoffset != oldoffset || cfg.fieldlengths.project != max_project_length() ||
+        cfg.fieldlengths.description != max_description_length()) {
+        redraw = true;
+    } else {
+        /* the title may count the tasks */
+        print_header();
+    }
 } /* }}} */
 
 // vim: et ts=4 sw=4 sts=4
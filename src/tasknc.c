@@ -16,18 +16,28 @@
 #include <unistd.h>
 #include <wchar.h>
 #include "color.h"
+#include "colstats.h"
 #include "command.h"
 #include "common.h"
 #include "config.h"
 #include "formats.h"
+#include "groups.h"
+#include "infocache.h"
+#include "intern.h"
+#include "jobs.h"
 #include "tasknc.h"
 #include "tasklist.h"
 #include "tasks.h"
+#include "tasktable.h"
 #include "log.h"
 #include "keys.h"
 #include "pager.h"
 #include "statusbar.h"
+#include "tags.h"
 #include "test.h"
+#include "timing.h"
+#include "version.h"
+#include "watch.h"
 
 /* global variables {{{ */
 const char* progname = PROGNAME;
@@ -35,7 +45,7 @@ const char* progauthor = PROGAUTHOR;
 const char* progversion = PROGVERSION;
 
 struct config   cfg;                    /* runtime config struct */
-short           pageoffset = 0;         /* number of tasks page is offset */
+int             pageoffset = 0;         /* number of tasks page is offset */
 char*           searchstring = NULL;    /* currently active search string */
 int             selline = 0;            /* selected line number */
 int             rows;
@@ -58,25 +68,63 @@ WINDOW* statusbar   = NULL;
 WINDOW* pager       = NULL;
 /* }}} */
 
+/* local functions */
+static void background_command_done(const struct job* job);
+static void dispatch_index(void);
+static size_t name_hash(const char* name);
+
+/* open addressed hashes of the function maps and variables by name, each
+ * slot holds an index into funcmaps or vars plus one (0 for an empty slot)
+ * functions sharing a name are found in the order they are listed
+ */
+static short    funcslots[DISPATCHSLOTS];
+static short    varslots[DISPATCHSLOTS];
+static bool     dispatch_indexed = false;
+
 /* user-exposed variables & functions {{{ */
 struct var vars[] = {
-    {"curs_timeout",      VAR_INT,  VAR_RC, &(cfg.nc_timeout)},
-    {"filter_string",     VAR_STR,  VAR_RW, &active_filter},
-    {"follow_task",       VAR_INT,  VAR_RW, &(cfg.follow_task)},
-    {"history_max",       VAR_INT,  VAR_RC, &(cfg.history_max)},
-    {"log_level",         VAR_INT,  VAR_RW, &(cfg.loglvl)},
-    {"program_author",    VAR_STR,  VAR_RO, &progauthor},
-    {"program_name",      VAR_STR,  VAR_RO, &progname},
-    {"program_version",   VAR_STR,  VAR_RO, &progversion},
-    {"search_string",     VAR_STR,  VAR_RW, &searchstring},
-    {"selected_line",     VAR_INT,  VAR_RW, &selline},
-    {"sort_mode",         VAR_STR,  VAR_RW, &(cfg.sortmode)},
-    {"statusbar_timeout", VAR_INT,  VAR_RW, &(cfg.statusbar_timeout)},
-    {"task_count",        VAR_INT,  VAR_RO, &taskcount},
-    {"task_format",       VAR_STR,  VAR_RC, &(cfg.formats.task)},
-    {"task_version",      VAR_STR,  VAR_RW, &(cfg.version)},
-    {"title_format",      VAR_STR,  VAR_RC, &(cfg.formats.title)},
-    {"view_format",       VAR_STR,  VAR_RC, &(cfg.formats.view)},
+    {"curs_timeout",       VAR_INT,  VAR_RC, &(cfg.nc_timeout)},
+    {"filter_string",      VAR_STR,  VAR_RW, &active_filter},
+    {"follow_task",        VAR_INT,  VAR_RW, &(cfg.follow_task)},
+    {"group_count",        VAR_INT,  VAR_RO, &group_count},
+    {"group_format",       VAR_STR,  VAR_RC, &(cfg.formats.group)},
+    {"group_marker",       VAR_STR,  VAR_RO, &group_marker},
+    {"group_view",         VAR_INT,  VAR_RC, &(cfg.group_view)},
+    {"history_max",        VAR_INT,  VAR_RC, &(cfg.history_max)},
+    {"incremental_reload", VAR_INT,  VAR_RW, &(cfg.incremental_reload)},
+    {"incremental_search", VAR_INT,  VAR_RW, &(cfg.incremental_search)},
+    {"log_level",          VAR_INT,  VAR_RW, &(cfg.loglvl)},
+    {"parse_threads",      VAR_INT,  VAR_RW, &(cfg.parse_threads)},
+    {"program_author",     VAR_STR,  VAR_RO, &progauthor},
+    {"program_name",       VAR_STR,  VAR_RO, &progname},
+    {"program_version",    VAR_STR,  VAR_RO, &progversion},
+    {"search_string",      VAR_STR,  VAR_RW, &searchstring},
+    {"selected_line",      VAR_INT,  VAR_RW, &selline},
+    {"snapshot",           VAR_INT,  VAR_RC, &(cfg.snapshot)},
+    {"sort_mode",          VAR_STR,  VAR_RW, &(cfg.sortmode)},
+    {"startup_config",     VAR_STR,  VAR_RO, &(phases[PHASE_CONFIG].value)},
+    {"startup_first_frame", VAR_STR, VAR_RO, &(phases[PHASE_FIRST_FRAME].value)},
+    {"startup_tasks",      VAR_STR,  VAR_RO, &(phases[PHASE_TASKS].value)},
+    {"startup_version",    VAR_STR,  VAR_RO, &(phases[PHASE_VERSION].value)},
+    {"statusbar_timeout",  VAR_INT,  VAR_RW, &(cfg.statusbar_timeout)},
+    {"task_count",         VAR_INT,  VAR_RO, &taskcount},
+    {"task_format",        VAR_STR,  VAR_RC, &(cfg.formats.task)},
+    {"task_source",        VAR_STR,  VAR_RC, &(cfg.task_source)},
+    {"task_version",       VAR_STR,  VAR_RW, &(cfg.version)},
+    {"timing",             VAR_INT,  VAR_RW, &(cfg.timing)},
+    {"timing_command",     VAR_STR,  VAR_RO, &(timers[TIMER_COMMAND].value)},
+    {"timing_get_tasks",   VAR_STR,  VAR_RO, &(timers[TIMER_GET_TASKS].value)},
+    {"timing_pager_command", VAR_STR, VAR_RO, &(timers[TIMER_PAGER_COMMAND].value)},
+    {"timing_parse_task",  VAR_STR,  VAR_RO, &(timers[TIMER_PARSE_TASK].value)},
+    {"timing_print_list",  VAR_STR,  VAR_RO, &(timers[TIMER_PRINT_LIST].value)},
+    {"timing_sort",        VAR_STR,  VAR_RO, &(timers[TIMER_SORT].value)},
+    {"title_format",       VAR_STR,  VAR_RC, &(cfg.formats.title)},
+    {"version_cache",      VAR_INT,  VAR_RC, &(cfg.version_cache)},
+    {"view_format",        VAR_STR,  VAR_RC, &(cfg.formats.view)},
+    {"view_prefetch",      VAR_INT,  VAR_RW, &(cfg.view_prefetch)},
+    {"watch",              VAR_INT,  VAR_RC, &(cfg.watch)},
+    {"watch_debounce",     VAR_INT,  VAR_RW, &(cfg.watch_debounce)},
+    {NULL,                 VAR_UNDEF, VAR_RO, NULL},   /* end of the list */
 };
 
 struct funcmap funcmaps[] = {
@@ -89,7 +137,11 @@ struct funcmap funcmaps[] = {
     {"edit",        (void*) key_tasklist_edit,            0, MODE_ANY},
     {"filter",      (void*) key_tasklist_filter,          0, MODE_TASKLIST},
     {"f_redraw",    (void*) force_redraw,                 0, MODE_ANY},
+    {"fold",        (void*) key_tasklist_fold,            0, MODE_TASKLIST},
+    {"group",       (void*) key_tasklist_group,           0, MODE_TASKLIST},
     {"help",        (void*) help_window,                  0, MODE_ANY},
+    {"mark",        (void*) key_tasklist_mark,            0, MODE_TASKLIST},
+    {"mark_search", (void*) key_tasklist_mark_search,     0, MODE_TASKLIST},
     {"modify",      (void*) key_tasklist_modify,          0, MODE_TASKLIST},
     {"quit",        (void*) key_done,                     0, MODE_TASKLIST},
     {"quit",        (void*) key_pager_close,              0, MODE_PAGER},
@@ -113,13 +165,23 @@ struct funcmap funcmaps[] = {
     {"source_cmd",  (void*) run_command_source_cmd,       1, MODE_ANY},
     {"stats",       (void*) view_stats,                   0, MODE_ANY},
     {"sync",        (void*) key_tasklist_sync,            0, MODE_TASKLIST},
+    {"tags",        (void*) view_tags,                    0, MODE_ANY},
+    {"timing",      (void*) view_timing,                  0, MODE_ANY},
+    {"timing_reset",(void*) timing_reset,                 0, MODE_ANY},
     {"toggle_start",(void*) key_tasklist_toggle_started,  0, MODE_ANY},
     {"unbind",      (void*) run_command_unbind,           1, MODE_ANY},
     {"undo",        (void*) key_tasklist_undo,            0, MODE_TASKLIST},
+    {"unmark",      (void*) key_tasklist_unmark,          0, MODE_TASKLIST},
     {"view",        (void*) key_tasklist_view,            0, MODE_TASKLIST},
 };
 /* }}} */
 
+void background_command_done(const struct job* job) { /* {{{ */
+    /* reload the task list once a background command has finished */
+    (void)job;
+    reload = true;
+} /* }}} */
+
 void check_resize(void) { /* {{{ */
     /* check for a screen resize and handle it */
     if (is_term_resized(rows, cols)) {
@@ -153,68 +215,75 @@ void check_screen_size(void) { /* {{{ */
 
 void cleanup(void) { /* {{{ */
     /* function to run on termination */
-    struct keybind* lastbind;
-
     /* free memory allocated normally */
     check_free(searchstring);
-    free_tasks(head);
+    free_task_list();
+    tasktable_clear();
+    invalidate_task_list();
+    intern_free();
+    tags_free();
     check_free(cfg.sortmode);
     free(cfg.version);
+    free(cfg.task_source);
+    free(cfg.formats.group);
     free(cfg.formats.task);
     free(cfg.formats.title);
     free(cfg.formats.view);
     free(active_filter);
 
-    while (keybinds != NULL) {
-        lastbind = keybinds;
-        keybinds = keybinds->next;
-        check_free(lastbind->argstr);
-        free(lastbind);
-    }
-
+    watch_stop();
+    free_keybinds();
+    free_sourced();
     free_colors();
+    regex_cache_free();
+    infocache_clear();
     free_prompts();
     free_formats();
 
     /* close open files */
-    fflush(logfp);
-    fclose(logfp);
+    log_close();
 } /* }}} */
 
 void configure(void) { /* {{{ */
     /* parse config file to get runtime options */
-    FILE*   cmd;
     char*   filepath;
     char*   xdg_config_home;
     char*   home;
-    int     ret = 0;
 
     /* set default settings */
     cfg.nc_timeout  = NCURSES_WAIT;                     /* time getch will wait */
     cfg.statusbar_timeout = STATUSBAR_TIMEOUT_DEFAULT;  /* default time before resetting statusbar */
     cfg.sortmode    = strdup("drpu");                   /* determine sort order */
     cfg.follow_task = true;                             /* follow task after it is moved */
+    cfg.group_view  = 0;                                /* show the flat task list */
     cfg.history_max = 50;
+    cfg.incremental_reload = 1;                         /* only export changed tasks on reload */
+    cfg.incremental_search = 1;                         /* follow a search as it is typed */
+    cfg.snapshot    = 1;                                /* show the last task list while loading */
+    cfg.task_source = strdup("export");                 /* read tasks with task export */
+    cfg.timing      = 0;                                /* do not time the hot paths */
+    cfg.parse_threads = 0;                              /* parse large exports on every cpu */
+    cfg.version_cache = 1;                              /* remember the task version */
+    cfg.view_prefetch = 1;                              /* fetch the info of nearby tasks */
+    cfg.watch       = 1;                                /* reload on outside changes */
+    cfg.watch_debounce = 250;                           /* let a burst of changes settle */
 
     /* set default formats */
     cfg.formats.title = strdup(" $program_name ($selected_line/$task_count) $> $date");
     cfg.formats.task  = strdup(" $project $description $> ?$due?$due?$-6priority?");
     cfg.formats.view  = strdup(" task info");
+    cfg.formats.group = strdup(" $group_marker ?$project?$project?(none)? $> $group_count ");
 
     /* set initial filter */
     if (!active_filter) {
         active_filter = strdup("status:pending");
     }
 
-    /* get task version */
-    cmd = popen("task --version", "r");
-
-    while (ret != 1) {
-        ret = fscanf(cmd, "%m[0-9.-] ", &(cfg.version));
-    }
-
-    tnc_fprintf(logfp, LOG_DEBUG, "task version: %s", cfg.version);
-    pclose(cmd);
+    /* the version probe and the first export run while the config is read,
+     * the export is guessed from the filter and checked once the list is loaded
+     */
+    version_start();
+    prefetch_tasks();
 
     /* default keybinds */
     add_keybind(ERR,           NULL,                     NULL, MODE_TASKLIST);
@@ -248,8 +317,13 @@ void configure(void) { /* {{{ */
     add_keybind('s',           key_tasklist_sort,        NULL, MODE_TASKLIST);
     add_keybind('/',           key_tasklist_search,      NULL, MODE_TASKLIST);
     add_keybind('n',           key_tasklist_search_next, NULL, MODE_TASKLIST);
+    add_keybind('m',           key_tasklist_mark,        NULL, MODE_TASKLIST);
+    add_keybind('M',           key_tasklist_mark_search, NULL, MODE_TASKLIST);
+    add_keybind('U',           key_tasklist_unmark,      NULL, MODE_TASKLIST);
     add_keybind('f',           key_tasklist_filter,      NULL, MODE_TASKLIST);
     add_keybind('y',           key_tasklist_sync,        NULL, MODE_TASKLIST);
+    add_keybind('z',           key_tasklist_fold,        NULL, MODE_TASKLIST);
+    add_keybind('Z',           key_tasklist_group,       NULL, MODE_TASKLIST);
     add_keybind('q',           key_done,                 NULL, MODE_TASKLIST);
     add_keybind('q',           key_pager_close,          NULL, MODE_PAGER);
     add_keybind(';',           key_command,              NULL, MODE_TASKLIST);
@@ -270,13 +344,37 @@ void configure(void) { /* {{{ */
         sprintf(filepath, "%s/tasknc/config", xdg_config_home);
     }
 
+    phase_start(PHASE_CONFIG);
     run_command_source(filepath);
     free(filepath);
+    phase_stop(PHASE_CONFIG);
+    version_finish();
 
     /* compile format strings */
     compile_formats();
 } /* }}} */
 
+void dispatch_index(void) { /* {{{ */
+    /* hash the names of the function maps and variables, which never change */
+    const size_t    mask = DISPATCHSLOTS - 1;
+    size_t          j;
+    int             i;
+
+    for (i = 0; i < NFUNCS && 2 * (i + 1) <= DISPATCHSLOTS; i++) {
+        for (j = name_hash(funcmaps[i].name) & mask; funcslots[j] != 0; j = (j + 1) & mask);
+
+        funcslots[j] = i + 1;
+    }
+
+    for (i = 0; vars[i].name != NULL && 2 * (i + 1) <= DISPATCHSLOTS; i++) {
+        for (j = name_hash(vars[i].name) & mask; varslots[j] != 0; j = (j + 1) & mask);
+
+        varslots[j] = i + 1;
+    }
+
+    dispatch_indexed = true;
+} /* }}} */
+
 struct funcmap* find_function(const char* name, const enum prog_mode mode) { /* {{{ */
     /* search through the function maps to convert a string to a function pointer
      * name - the string naming the function
@@ -284,53 +382,46 @@ struct funcmap* find_function(const char* name, const enum prog_mode mode) { /*
      * the return is a pointer to the function that was mapped, or NULL
      * if no function is found
      */
-    for (int i = 0; i < NFUNCS; i++) {
-        if (str_eq(name, funcmaps[i].name) && (funcmaps[i].mode == MODE_ANY ||
-                                               mode == funcmaps[i].mode || mode == MODE_ANY)) {
-            return &(funcmaps[i]);
+    const size_t    mask = DISPATCHSLOTS - 1;
+    struct funcmap* fmap;
+    size_t          i;
+
+    if (!dispatch_indexed) {
+        dispatch_index();
+    }
+
+    for (i = name_hash(name) & mask; funcslots[i] != 0; i = (i + 1) & mask) {
+        fmap = &(funcmaps[funcslots[i] - 1]);
+
+        if (str_eq(name, fmap->name) && (fmap->mode == MODE_ANY ||
+                                         mode == fmap->mode || mode == MODE_ANY)) {
+            return fmap;
         }
     }
 
     return NULL;
 } /* }}} */
 
-void find_next_search_result(struct task* head, struct task* pos) { /* {{{ */
+void find_next_search_result(struct task* pos) { /* {{{ */
     /* find the next search result in the list of tasks
-     * head - the first task in the task list
      * pos  - the position in the task list to start searching from
      */
-    struct task* cur = pos;
-
-    while (1) {
-        /* move to next item */
-        cur = cur->next;
-
-        /* move to head if end of list is reached */
-        if (cur == NULL) {
-            cur = head;
-            selline = 0;
-            tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "search wrapped");
-            statusbar_message(cfg.statusbar_timeout, "search wrapped to top");
-        }
+    struct task*    found;
+    bool            wrapped;
 
-        else {
-            selline++;
-        }
+    found = task_search(pos, searchstring, &wrapped);
 
-        /* check for match */
-        if (task_match(cur, searchstring)) {
-            return;
-        }
-
-        /* stop if full loop was made */
-        if (cur == pos) {
-            break;
-        }
+    if (found == NULL) {
+        statusbar_message(cfg.statusbar_timeout, "no matches: %s", searchstring);
+        return;
     }
 
-    statusbar_message(cfg.statusbar_timeout, "no matches: %s", searchstring);
+    if (wrapped) {
+        tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "search wrapped");
+        statusbar_message(cfg.statusbar_timeout, "search wrapped to top");
+    }
 
-    return;
+    selline = get_task_position_by_uuid(found->uuid);
 } /* }}} */
 
 struct var* find_var(const char* name) { /* {{{ */
@@ -338,9 +429,16 @@ struct var* find_var(const char* name) { /* {{{ */
      * name - the name of the variable
      * return is a pointer to the variable found, or NULL on failure
      */
-    for (int i = 0; i < NVARS; i++) {
-        if (str_eq(name, vars[i].name)) {
-            return &(vars[i]);
+    const size_t    mask = DISPATCHSLOTS - 1;
+    size_t          i;
+
+    if (!dispatch_indexed) {
+        dispatch_index();
+    }
+
+    for (i = name_hash(name) & mask; varslots[i] != 0; i = (i + 1) & mask) {
+        if (str_eq(name, vars[varslots[i] - 1].name)) {
+            return &(vars[varslots[i] - 1]);
         }
     }
 
@@ -464,8 +562,7 @@ void key_task_background_command(const char* arg) { /* {{{ */
         return;
     }
 
-    task_background_command(arg);
-    reload = 1;
+    task_background_command(arg, background_command_done);
 } /* }}} */
 
 void key_task_interactive_command(const char* arg) { /* {{{ */
@@ -485,26 +582,37 @@ void key_done(void) { /* {{{ */
     done = true;
 } /* }}} */
 
-char max_project_length(void) { /* {{{ */
-    /* compute max project length
-     * return is the maximum project length
+int max_description_length(void) { /* {{{ */
+    /* get the width descriptions are printed at, that of the widest
+     * description on the task list unless it does not fit beside the project
+     * and the date
+     * return is the description width, in screen columns
      */
-    char            len = 0;
-    struct task*    cur = head;
+    const int room  = cols - cfg.fieldlengths.project - 1 - cfg.fieldlengths.date;
+    const int width = colstats_max(COLUMN_DESCRIPTION);
 
-    while (cur) {
-        if (cur->project) {
-            char l = strlen(cur->project);
+    /* wider descriptions are only counted as the widest tracked */
+    return width < room && width < COLSTATSMAXWIDTH ? width : room;
+} /* }}} */
 
-            if (l > len) {
-                len = l;
-            }
-        }
+int max_project_length(void) { /* {{{ */
+    /* get the width of the widest project on the task list
+     * return is the maximum project width, in screen columns
+     */
+    return colstats_max(COLUMN_PROJECT);
+} /* }}} */
 
-        cur = cur->next;
+size_t name_hash(const char* name) { /* {{{ */
+    /* fnv-1a hash of the name of a function or variable */
+    size_t hash = 2166136261u;
+
+    while (*name) {
+        hash ^= (unsigned char)*name;
+        name++;
+        hash *= 16777619u;
     }
 
-    return len;
+    return hash;
 } /* }}} */
 
 const char* name_function(void* function) { /* {{{ */
@@ -607,6 +715,9 @@ void print_header(void) { /* {{{ */
     /* print the window title bar */
     char* tmp0;
 
+    /* dates printed this frame are relative to today */
+    refresh_today();
+
     /* wipe bar and print bg color */
     wmove(header, 0, 0);
     wattrset(header, get_colors(OBJECT_HEADER, NULL, NULL));
@@ -804,14 +915,12 @@ void wipe_screen(WINDOW* win, const short startl, const short stopl) { /* {{{ */
      * stopl  - the number of the line to stop wiping at
      */
     int y;
-    int x;
 
     wattrset(win, COLOR_PAIR(0));
 
-    for (y = startl; y <= stopl; y++)
-        for (x = 0; x < cols; x++) {
-            mvwaddch(win, y, x, ' ');
-        }
+    for (y = startl; y <= stopl; y++) {
+        mvwhline(win, y, 0, ' ', cols);
+    }
 } /* }}} */
 
 void wipe_window(WINDOW* win) { /* {{{ */
@@ -835,7 +944,7 @@ void wipe_window(WINDOW* win) { /* {{{ */
 
 void sig_handler(int signo) {
     if (signo == SIGUSR1) {
-        reload = 1;
+        watch_poke();
     }
 }
 
@@ -846,13 +955,16 @@ int main(int argc, char** argv) { /* {{{ */
     char*   debugopts   = NULL;
     char*   logpath;
 
+    /* time to the first frame is counted from here */
+    phase_start(PHASE_FIRST_FRAME);
+
     if (signal(SIGUSR1, sig_handler) == SIG_ERR) {
         printf("\ncan't catch SIGUSR1, task list reload signal will be non-functional.\n");
     }
 
     /* open log */
     asprintf(&logpath, LOGFILE, getenv("USER"));
-    logfp = fopen(logpath, "a");
+    log_open(logpath);
     free(logpath);
     tnc_fprintf(logfp, LOG_DEBUG, "%s started", PROGNAME);
 
@@ -919,19 +1031,38 @@ int main(int argc, char** argv) { /* {{{ */
         umvaddstr(stdscr, 1, 0, "loading tasks...");
         wrefresh(stdscr);
         tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "loading tasks...");
-        head = get_tasks(NULL);
+
+        /* the last run's list is shown right away and reloaded in the background */
+        phase_start(PHASE_TASKS);
+
+        if (load_task_snapshot()) {
+            reload = true;
+        } else {
+            reload_tasks();
+        }
+
+        phase_stop(PHASE_TASKS);
+
         tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "%d tasks loaded", taskcount);
         mvwhline(stdscr, 0, 0, ' ', COLS);
         mvwhline(stdscr, 1, 0, ' ', COLS);
         wtimeout(stdscr, 1000);
+
+        if (cfg.watch) {
+            watch_start();
+        }
+
         tasklist_window();
+        save_task_snapshot();
         ncurses_end(0);
     }
 
     /* debug mode */
     else {
         configure();
-        head = get_tasks(NULL);
+        phase_start(PHASE_TASKS);
+        reload_tasks();
+        phase_stop(PHASE_TASKS);
         test(debugopts);
         free(debugopts);
     }
@@ -6,113 +6,277 @@
 
 #define _GNU_SOURCE
 #include <curses.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <time.h>
+#include <unistd.h>
+#include "arena.h"
 #include "common.h"
 #include "config.h"
+#include "filter.h"
+#include "groups.h"
+#include "infocache.h"
+#include "intern.h"
+#include "jobs.h"
+#include "json.h"
 #include "log.h"
+#include "searchindex.h"
+#include "snapshot.h"
 #include "sort.h"
+#include "tags.h"
+#include "taskdata.h"
 #include "tasklist.h"
 #include "tasks.h"
+#include "tasktable.h"
+#include "timing.h"
+#include "watch.h"
+
+/* task fields with special handling in the json export */
+enum task_field {
+    TASK_FIELD_UDA,
+    TASK_FIELD_ID,
+    TASK_FIELD_UUID,
+    TASK_FIELD_DESCRIPTION,
+    TASK_FIELD_PROJECT,
+    TASK_FIELD_TAGS,
+    TASK_FIELD_ENTRY,
+    TASK_FIELD_DUE,
+    TASK_FIELD_START,
+    TASK_FIELD_END,
+    TASK_FIELD_MODIFIED,
+    TASK_FIELD_PRIORITY,
+    TASK_FIELD_ANNOTATIONS
+};
+
+/**
+ * reload state struct - a reload of the task list running in the background
+ * running    - whether a reload has been started and not finished
+ * again      - whether another reload was requested while it was running
+ * generation - marks the loaded tasks that still match the filter
+ * missing    - uuids that match the filter but are not loaded
+ * nmissing   - the number of uuids in missing
+ * done       - run on the ui once the list has been updated (may be NULL)
+ */
+struct reload_state {
+    bool running;
+    bool again;
+    unsigned int generation;
+    char** missing;
+    int nmissing;
+    void (*done)(void);
+};
+
+/**
+ * parse chunk struct - a run of export lines parsed on a thread of its own
+ * buffer  - the first character of the chunk
+ * length  - the number of characters in the chunk
+ * arena   - the arena the tasks of the chunk are allocated from
+ * head    - the sorted list of tasks parsed from the chunk
+ * merge   - the chunk whose tasks are merged into this one's next
+ * thread  - the thread working on the chunk
+ * running - whether the thread was started, and must be joined
+ */
+struct parse_chunk {
+    const char* buffer;
+    size_t length;
+    struct arena* arena;
+    struct task* head;
+    struct parse_chunk* merge;
+    pthread_t thread;
+    bool running;
+};
+
+/* state of the loaded list, used for incremental reloads */
+static time_t   loaded_modified = 0;    /* newest modification time in the list */
+static char*    loaded_filter = NULL;   /* the filter the list was exported with */
+static struct reload_state reloading;   /* the reload in progress */
+static struct task* hidden = NULL;      /* loaded tasks the active filter leaves out */
+static struct filter* shown = NULL;     /* the active filter while it is applied locally */
 
 /* local function declarations */
+static char* export_command(const char* filter, const char* uuid);
+static bool export_usable(const char* filter);
+static struct task* find_loaded(const unsigned char* uuid);
+static void insert_task(struct task* this);
+static struct task* job_tasks(const struct job* job, const char* filter, const char* uuid,
+                              struct arena* arena);
+static const char* list_filter(void);
+static void list_unlink(struct task* this);
+static bool list_wasteful(void);
+static struct task* load_tasks(const char* cmdstr, struct arena* arena);
+static enum task_field lookup_field(const char* name, const size_t len);
+static void merge_tasks(struct task* merge);
+static time_t newest_modified(const struct task* first, time_t newest);
+static struct task* parse_export(const char* buffer, const size_t length,
+                                 struct arena* arena);
+static void* parse_merge_worker(void* arg);
+static int parse_split(const char* buffer, const size_t length,
+                       struct parse_chunk* chunks, const int nchunks);
+static int parse_thread_count(const size_t length);
+static void* parse_worker(void* arg);
+static bool parse_annotations(struct task* tsk,
+                              struct json_scanner* scanner,
+                              const struct json_token* value);
+static bool parse_tags(struct task* tsk,
+                       struct json_scanner* scanner,
+                       const struct json_token* value);
+static bool parse_uda(struct task* tsk,
+                      struct uda** last,
+                      struct json_scanner* scanner,
+                      const struct json_token* key,
+                      const struct json_token* value);
+static char* read_stream(FILE* fp, size_t* length);
+static struct task* read_tasks(const char* filter, const char* uuid, struct arena* arena);
+static void reload_added_done(const struct job* job);
+static void reload_changed_done(const struct job* job);
+static void reload_finish(void);
+static void reload_free_missing(void);
+static void reload_full(void);
+static void reload_full_done(const struct job* job);
+static void reload_task_done(const struct job* job);
+static void reload_uuids_done(const struct job* job);
+static void replace_task(struct task* old, struct task* new);
 static time_t strtotime(const char* timestr);
-static void set_char(char* field, char** line);
-static void set_date(time_t* field, char** line);
-static void set_int(unsigned short* field, char** line);
-static void set_string(char** field, char** line);
-
-char free_task(struct task* tsk) { /* {{{ */
-    /* free the memory allocated to a task
-     * tsk - the task to free
-     * return is always 0
+static void set_char(char* field, const struct json_token* value);
+static void set_date(time_t* field, const struct json_token* value);
+static void set_int(unsigned int* field, const struct json_token* value);
+static void set_interned(const char** field, const struct json_token* value);
+static char* snapshot_key(void);
+static bool submit_load(const char* filter, const char* uuid, job_callback callback,
+                        void* data);
+static const struct task_source* task_source(const char* filter);
+static void set_uuid(unsigned char* field, const struct json_token* value);
+static void set_string(struct arena* arena, char** field,
+                       const struct json_token* value);
+static void view_add(struct task* this);
+static void view_expand(void);
+static void view_filter(void);
+static void view_hide(struct task* this);
+static bool view_shows(const struct task* this);
+static void view_unhide(struct task* this);
+
+/* the sources tasks can be read with, the first is the default */
+static const struct task_source export_source = {
+    "export", export_usable, export_command, NULL
+};
+static const struct task_source* sources[] = {
+    &export_source,
+    &taskdata_source,
+    NULL
+};
+
+bool apply_filter(void) { /* {{{ */
+    /**
+     * show the loaded tasks matching the active filter, without exporting
+     * return is whether the loaded tasks include every task the filter
+     *        matches, if not the list must be reloaded
      */
-    char ret = 0;
+    if (loaded_filter == NULL || reloading.running || !str_eq(list_filter(), loaded_filter)) {
+        return false;
+    }
 
-    free(tsk->uuid);
+    view_filter();
+    task_count();
 
-    if (tsk->tags != NULL) {
-        free(tsk->tags);
-    }
+    return true;
+} /* }}} */
 
-    if (tsk->project != NULL) {
-        free(tsk->project);
+void set_uuid(unsigned char* field, const struct json_token* value) { /* {{{ */
+    /* set a uuid field from a string value
+     * field - the field set the uuid in, UUIDBYTES long
+     * value - the token to parse the uuid from
+     */
+    if (value->type != JSON_STRING || !uuid_parse(value->start, value->length, field)) {
+        tnc_fprintf(logfp, LOG_ERROR, "error parsing uuid @ %.32s", value->start);
     }
+} /* }}} */
 
-    if (tsk->description != NULL) {
-        free(tsk->description);
-    }
+char* export_command(const char* filter, const char* uuid) { /* {{{ */
+    /* build the command that exports the tasks on the list
+     * until the version of taskwarrior is known, it is taken to be 2 or newer
+     * filter - the filter to export the tasks matching (may be NULL)
+     * uuid   - specific task to export, pass NULL to export every task
+     * return is the command, which must be freed
+     */
+    char* cmdstr;
 
-    free(tsk);
+    asprintf(&cmdstr, "%s%s%s%s%s",
+             cfg.version != NULL && cfg.version[0] < '2' ? "task export.json" : "task export",
+             filter != NULL ? " " : "", filter != NULL ? filter : "",
+             uuid != NULL ? " " : "", uuid != NULL ? uuid : "");
 
-    return ret;
+    return cmdstr;
 } /* }}} */
 
-void free_tasks(struct task* head) { /* {{{ */
-    /* free the task stack
-     * head - the first task on the stack to free
+bool export_usable(const char* filter) { /* {{{ */
+    /* taskwarrior can export tasks for any filter */
+    (void) filter;
+
+    return true;
+} /* }}} */
+
+struct task* find_loaded(const unsigned char* uuid) { /* {{{ */
+    /**
+     * look up a loaded task, on the list or left out of it by the filter
+     * uuid - the uuid to find, in binary
+     * return is the task, or NULL if it is not loaded
      */
-    struct task* cur;
-    struct task* next;
+    struct task* this = tasktable_find(uuid);
 
-    cur = head;
+    return this != NULL ? this : tasktable_find_hidden(uuid);
+} /* }}} */
 
-    while (cur != NULL) {
-        next = cur->next;
-        free_task(cur);
-        cur = next;
+void free_tasks(struct task* head) { /* {{{ */
+    /* free the task stack
+     * every task and string on the stack lives in one arena (plus the
+     * arenas of individually reloaded tasks it adopted), so this is a
+     * single release regardless of the number of tasks
+     * head - any task of the stack to free
+     */
+    if (head != NULL) {
+        arena_free(arena_root(head->arena));
     }
 } /* }}} */
 
+void free_task_list(void) { /* {{{ */
+    /* free every loaded task, on the list or left out of it by the filter */
+    free_tasks(head != NULL ? head : hidden);
+    head = NULL;
+    hidden = NULL;
+    tasktable_unhide_all();
+} /* }}} */
+
 struct task* get_task_by_position(int n) { /* {{{ */
     /* get task at line #n
      * n - line number to retrieve task from
      * return is the pointer to the task found
-     * or null if n > # of tasks on the stack
+     * or null if n > # of tasks on the stack, or line #n is a group's header
      */
-    struct task* cur;
-    short        i = -1;
-
-    cur = head;
-
-    while (cur != NULL) {
-        i++;
-
-        if (i == n) {
-            break;
-        }
-
-        cur = cur->next;
+    if (groups_active()) {
+        return groups_get(n);
     }
 
-    return cur;
+    return tasktable_get(n);
 } /* }}} */
 
-int get_task_position_by_uuid(const char* uuid) { /* {{{ */
+int get_task_position_by_uuid(const unsigned char* uuid) { /* {{{ */
     /* find the task with the specified uuid
      * uuid - the uuid to match
      * return is the line number which matches the uuid
      * or -1 if no task on the stack matches this uuid
+     * in a grouped list, the task's group is expanded to show it
      */
-    struct task* cur;
-    int          pos = 0;
-
-    cur = head;
+    struct task* cur = tasktable_find(uuid);
 
-    while (cur != NULL && !str_eq(cur->uuid, uuid)) {
-        cur = cur->next;
-        pos++;
+    if (cur != NULL && groups_active()) {
+        return groups_position(cur);
     }
 
-    if (cur != NULL && str_eq(cur->uuid, uuid)) {
-        return pos;
-    } else {
-        return -1;
-    }
+    return cur != NULL ? cur->position : -1;
 } /* }}} */
 
 struct task* get_tasks(char* uuid) { /* {{{ */
@@ -121,176 +285,375 @@ struct task* get_tasks(char* uuid) { /* {{{ */
      *        pass NULL to get a full task list
      * return is the task data for a single task, if a uuid was passed
      * or all tasks, if uuid == NULL
+     * this waits for the export, the ui reloads with reload_tasks_background
+     */
+    const long long start = timer_start();
+    struct task*    new_head = NULL;
+    struct arena*   arena;
+
+    /* a single task reload only needs a small arena */
+    arena = arena_create(uuid == NULL ? TASKARENABLOCKLENGTH : TASKARENABLOCKLENGTH / 16);
+
+    if (arena == NULL) {
+        tnc_fprintf(logfp, LOG_ERROR, "could not allocate task arena");
+        return NULL;
+    }
+
+    if ((new_head = read_tasks(list_filter(), uuid, arena)) == NULL) {
+        arena_free(arena);
+    }
+
+    timer_stop(TIMER_GET_TASKS, start);
+
+    return new_head;
+} /* }}} */
+
+unsigned int get_task_id(char* uuid) { /* {{{ */
+    /* given a task uuid, find its id using a custom report
+     * necessary to do without uuid addressing in task v2
+     * uuid - the task to find the id of
+     * return is the id of the task specified
      */
     FILE*           cmd;
-    char*           line;
-    char*           tmp;
-    char*           cmdstr;
-    int             linelen = TOTALLENGTH;
-    unsigned short  counter = 0;
-    struct task*    last;
-    struct task*    new_head;
+    char            line[128];
+    char            format[128];
+    int             ret;
+    unsigned int    id = 0;
+
+    /* generate format to scan for */
+    sprintf(format, "%s %%u", uuid);
+
+    /* run command */
+    cmd = popen("task rc.report.all.columns:uuid,id rc.report.all.labels:UUID,id rc.report.all.sort:id- all status:pending rc._forcecolor=no",
+                "r");
+
+    while (fgets(line, sizeof(line) - 1, cmd) != NULL) {
+        ret = sscanf(line, format, &id);
+
+        if (ret > 0) {
+            break;
+        }
+    }
+
+    pclose(cmd);
+
+    return id;
+} /* }}} */
+
+int hidden_task_count(void) { /* {{{ */
+    /* count the loaded tasks the active filter leaves out of the list */
+    const struct task*  cur;
+    int                 n = 0;
+
+    for (cur = hidden; cur != NULL; cur = cur->next) {
+        n++;
+    }
+
+    return n;
+} /* }}} */
+
+void insert_task(struct task* this) { /* {{{ */
+    /* put a task in its place on the sorted list and index it
+     * the list is indexed again if there is no memory to add it alone
+     * this - the task to add
+     */
+    if (!tasktable_insert(this)) {
+        this->prev = NULL;
+        this->next = NULL;
+        head = sort_merge_lists(head, this);
+        tasktable_build(head);
+        return;
+    }
+
+    this->prev = tasktable_get(this->position - 1);
+    this->next = tasktable_get(this->position + 1);
+
+    if (this->prev != NULL) {
+        this->prev->next = this;
+    } else {
+        head = this;
+    }
+
+    if (this->next != NULL) {
+        this->next->prev = this;
+    }
+} /* }}} */
+
+void invalidate_task_list(void) { /* {{{ */
+    /* forget the state of the loaded list, forcing the next reload to export
+     * every task (needed after changes that do not update modification
+     * times, such as undo)
+     */
+    loaded_modified = 0;
+    check_free(loaded_filter);
+    loaded_filter = NULL;
+} /* }}} */
+
+const char* list_filter(void) { /* {{{ */
+    /**
+     * get the filter the list is exported with
+     * return is the filter the list was loaded with if the tasks it matches
+     *        include every task the active filter matches, and the active
+     *        filter can be applied to them locally, otherwise the active filter
+     */
+    struct filter* local;
+
+    if (loaded_filter == NULL || active_filter == NULL || str_eq(active_filter, loaded_filter) ||
+        !filter_covers(loaded_filter, active_filter) ||
+        (local = filter_compile(active_filter)) == NULL) {
+        return active_filter;
+    }
+
+    filter_free(local);
 
-    /* generate & run command */
-    cmdstr = calloc(128, sizeof(char));
+    return loaded_filter;
+} /* }}} */
 
-    if (cfg.version[0] < '2') {
-        strcat(cmdstr, "task export.json");
+void list_unlink(struct task* this) { /* {{{ */
+    /* take a task off the list, its place in the table is left to the caller */
+    if (this->prev != NULL) {
+        this->prev->next = this->next;
     } else {
-        strcat(cmdstr, "task export");
+        head = this->next;
+    }
+
+    if (this->next != NULL) {
+        this->next->prev = this->prev;
     }
+} /* }}} */
+
+bool list_wasteful(void) { /* {{{ */
+    /**
+     * check how much of the list's memory is held by tasks taken off it
+     * return is whether the list should be loaded in full to release it
+     * space left at the end of each reload's arena counts as wasted too
+     */
+    struct task*    first = head != NULL ? head : hidden;
+    struct arena*   root;
+    size_t          size;
+    size_t          waste;
 
-    if (active_filter != NULL) {
-        strcat(cmdstr, " ");
-        strcat(cmdstr, active_filter);
+    if (first == NULL) {
+        return false;
     }
 
-    if (uuid != NULL) {
-        strcat(cmdstr, " ");
-        strcat(cmdstr, uuid);
+    root = arena_root(first->arena);
+    size = arena_size(root);
+    waste = size - arena_used(root);
+
+    if (waste < RELOADMINWASTE || waste * 100 < size * RELOADMAXWASTE) {
+        return false;
     }
 
+    tnc_fprintf(logfp, LOG_DEBUG, "%zu of %zu bytes of the list are unused", waste, size);
+
+    return true;
+} /* }}} */
+
+struct task* load_tasks(const char* cmdstr, struct arena* arena) { /* {{{ */
+    /* run an export command and parse the tasks it prints
+     * cmdstr - the export command to run
+     * arena  - the arena the tasks and their strings are allocated from
+     * return is the sorted list of tasks parsed, or NULL if there were none
+     */
+    FILE*           cmd;
+    char*           buffer;
+    size_t          length;
+    struct task*    new_head;
+
     tnc_fprintf(logfp, LOG_DEBUG, "reloading tasks (%s)", cmdstr);
     cmd = popen(cmdstr, "r");
 
     if (cmd == NULL) {
         tnc_fprintf(logfp, LOG_ERROR, "could not execute command: (%s)", cmdstr);
         tnc_fprintf(stdout, LOG_ERROR, "could not execute command: (%s)", cmdstr);
-        free(cmdstr);
         return NULL;
     }
 
-    free(cmdstr);
+    /* read the whole export, it is parsed in place */
+    buffer = read_stream(cmd, &length);
+    pclose(cmd);
+
+    if (buffer == NULL) {
+        tnc_fprintf(logfp, LOG_ERROR, "could not read task export");
+        return NULL;
+    }
 
-    /* parse output */
-    last        = NULL;
-    new_head    = NULL;
-    line        = calloc(linelen, sizeof(char));
+    new_head = parse_tasks(buffer, length, arena);
+    free(buffer);
 
-    while (fgets(line, linelen - 1, cmd) != NULL || !feof(cmd)) {
-        struct task* this;
+    return new_head;
+} /* }}} */
 
-        /* check for longer lines */
-        while (strchr(line, '\n') == NULL) {
-            linelen += TOTALLENGTH;
-            line = realloc(line, linelen * sizeof(char));
-            tmp = calloc(TOTALLENGTH, sizeof(char));
+bool load_task_snapshot(void) { /* {{{ */
+    /* show the task list saved by the last run until it is reloaded
+     * return is whether a snapshot for the active filter and sort mode was
+     * found, the caller should then reload the list in the background
+     * the list is treated as loaded with the active filter, so the reload is
+     * incremental and only fetches what changed since it was saved
+     */
+    struct task*    first;
+    char*           path;
+    char*           key;
+    time_t          modified = 0;
 
-            if (fgets(tmp, TOTALLENGTH - 1, cmd) == NULL) {
-                break;
-            }
+    if (!cfg.snapshot || (path = snapshot_path()) == NULL) {
+        return false;
+    }
 
-            strcat(line, tmp);
-            free(tmp);
-        }
+    key = snapshot_key();
+    first = snapshot_read(path, key, &modified);
+    free(path);
+    free(key);
 
-        /* remove escapes */
-        remove_char(line, '\\');
+    if (first == NULL) {
+        return false;
+    }
 
-        /* log line */
-        tmp = strchr(line, '\n');
-        *tmp = 0;
-        tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, line);
+    free_tasks(head);
+    head = first;
+    tasktable_build(head);
 
-        /* parse line */
-        this = parse_task(line);
+    check_free(loaded_filter);
+    loaded_filter = strdup(active_filter);
+    loaded_modified = modified;
 
-        if (this == NULL) {
-            return NULL;
-        } else if (this == (struct task*) - 1) {
-            continue;
-        } else if (this->uuid == NULL ||
-                   this->description == NULL) {
-            return NULL;
-        }
+    return true;
+} /* }}} */
 
-        /* set pointers */
-        this->prev = last;
+struct task* job_tasks(const struct job* job, const char* filter, const char* uuid,
+                       struct arena* arena) { /* {{{ */
+    /* get the tasks read by a load queued with submit_load
+     * job    - the finished load
+     * filter - the filter the tasks were loaded with
+     * uuid   - the only task loaded (NULL if every task was)
+     * arena  - the arena the tasks and their strings are allocated from
+     * return is the sorted list of tasks, or NULL if there were none
+     */
+    const long long start = timer_start();
+    struct task*    tasks;
 
-        if (counter == 0) {
-            new_head = this;
+    /* a source that reads tasks itself does so once the job is reached */
+    if (job->cmdstr == NULL) {
+        tasks = read_tasks(filter, uuid, arena);
+    } else {
+        tasks = parse_tasks(job->output, job->length, arena);
+    }
+
+    timer_stop(TIMER_GET_TASKS, start);
+
+    return tasks;
+} /* }}} */
+
+enum task_field lookup_field(const char* name, const size_t len) { /* {{{ */
+    /* map a json field name to the task field it fills
+     * name - the field name (not null terminated)
+     * len  - the length of the field name
+     * return is the task field, or TASK_FIELD_UDA for anything unknown
+     */
+    switch (len) {
+    case 2:
+        if (memcmp(name, "id", 2) == 0) {
+            return TASK_FIELD_ID;
         }
 
-        if (counter > 0) {
-            last->next = this;
+        break;
+
+    case 3:
+        if (memcmp(name, "due", 3) == 0) {
+            return TASK_FIELD_DUE;
+        } else if (memcmp(name, "end", 3) == 0) {
+            return TASK_FIELD_END;
         }
 
-        last = this;
-        counter++;
-        tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "uuid:        %s", this->uuid);
-        tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "description: %s", this->description);
-        tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "project:     %s", this->project);
-        tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "tags:        %s", this->tags);
+        break;
 
-        /* prepare a new line */
-        free(line);
-        line = calloc(linelen, sizeof(char));
-    }
+    case 4:
+        if (memcmp(name, "uuid", 4) == 0) {
+            return TASK_FIELD_UUID;
+        } else if (memcmp(name, "tags", 4) == 0) {
+            return TASK_FIELD_TAGS;
+        }
 
-    free(line);
-    pclose(cmd);
+        break;
 
-    /* sort tasks */
-    if (new_head != NULL) {
-        sort_wrapper(new_head);
-    }
+    case 5:
+        if (memcmp(name, "entry", 5) == 0) {
+            return TASK_FIELD_ENTRY;
+        } else if (memcmp(name, "start", 5) == 0) {
+            return TASK_FIELD_START;
+        }
 
-    return new_head;
-} /* }}} */
+        break;
 
-unsigned short get_task_id(char* uuid) { /* {{{ */
-    /* given a task uuid, find its id using a custom report
-     * necessary to do without uuid addressing in task v2
-     * uuid - the task to find the id of
-     * return is the id of the task specified
-     */
-    FILE*           cmd;
-    char            line[128];
-    char            format[128];
-    int             ret;
-    unsigned short  id = 0;
+    case 7:
+        if (memcmp(name, "project", 7) == 0) {
+            return TASK_FIELD_PROJECT;
+        }
 
-    /* generate format to scan for */
-    sprintf(format, "%s %%hu", uuid);
+        break;
 
-    /* run command */
-    cmd = popen("task rc.report.all.columns:uuid,id rc.report.all.labels:UUID,id rc.report.all.sort:id- all status:pending rc._forcecolor=no",
-                "r");
+    case 8:
+        if (memcmp(name, "priority", 8) == 0) {
+            return TASK_FIELD_PRIORITY;
+        } else if (memcmp(name, "modified", 8) == 0) {
+            return TASK_FIELD_MODIFIED;
+        }
 
-    while (fgets(line, sizeof(line) - 1, cmd) != NULL) {
-        ret = sscanf(line, format, &id);
+        break;
 
-        if (ret > 0) {
-            break;
+    case 11:
+        if (memcmp(name, "description", 11) == 0) {
+            return TASK_FIELD_DESCRIPTION;
+        } else if (memcmp(name, "annotations", 11) == 0) {
+            return TASK_FIELD_ANNOTATIONS;
         }
-    }
 
-    pclose(cmd);
+        break;
 
-    return id;
+    default:
+        break;
+    }
+
+    return TASK_FIELD_UDA;
 } /* }}} */
 
-struct task* malloc_task(void) { /* {{{ */
+struct task* malloc_task(struct arena* arena) { /* {{{ */
     /* allocate memory for a new task
      * and initialize values where necessary
+     * arena - the arena the task and its fields will be allocated from
      * return is the newly allocated task
      */
-    struct task* tsk = calloc(1, sizeof(struct task));
+    struct task* tsk = arena_alloc(arena, sizeof(struct task));
 
     if (tsk == NULL) {
         return NULL;
     }
 
+    tsk->arena          = arena;
+    tsk->position       = -1;
+    tsk->generation     = 0;
+    tsk->marked         = false;
+    tsk->line           = NULL;
+    tsk->linesize       = 0;
+    tsk->linegen        = 0;
+    tsk->duestr         = NULL;
+    tsk->duegen         = 0;
     tsk->index          = 0;
-    tsk->uuid           = NULL;
+    memset(tsk->uuid, 0, UUIDBYTES);
     tsk->tags           = NULL;
+    tsk->tagbits        = NULL;
+    tsk->tagwords       = 0;
     tsk->start          = 0;
     tsk->end            = 0;
     tsk->entry          = 0;
     tsk->due            = 0;
+    tsk->modified       = 0;
     tsk->project        = NULL;
     tsk->priority       = 0;
     tsk->description    = NULL;
+    tsk->annotations    = NULL;
+    tsk->udas           = NULL;
     tsk->next           = NULL;
     tsk->prev           = NULL;
     tsk->pair           = -1;
@@ -299,314 +662,1335 @@ struct task* malloc_task(void) { /* {{{ */
     return tsk;
 } /* }}} */
 
-struct task* parse_task(char* line) { /* {{{ */
-    /* parse a line of output from `task export ...`
-     * line - the line to parse
-     * return is the task structure defined in the line,
-     * or -1 if this line is not a task or parsing failed
+void merge_tasks(struct task* merge) { /* {{{ */
+    /* add tasks to the sorted list and index them
+     * each task put in place moves the tasks after it, so many tasks are
+     * merged in a single pass and the list indexed again
+     * tasks the local filter does not match are left out of the list
+     * merge - the tasks to add (may be NULL), their arena must already
+     *         belong to the list's
+     */
+    struct task*    shows = NULL;
+    struct task*    cur;
+    struct task*    next;
+    int             n = 0;
+
+    if (merge == NULL) {
+        return;
+    }
+
+    loaded_modified = newest_modified(merge, loaded_modified);
+
+    for (cur = merge; cur != NULL; cur = next) {
+        next = cur->next;
+
+        if (!view_shows(cur)) {
+            view_hide(cur);
+            continue;
+        }
+
+        cur->prev = NULL;
+        cur->next = shows;
+        shows = cur;
+        n++;
+    }
+
+    if (n > INCREMENTALMAXMOVES) {
+        head = sort_merge(head, shows);
+        tasktable_build(head);
+        return;
+    }
+
+    for (cur = shows; cur != NULL; cur = next) {
+        next = cur->next;
+        insert_task(cur);
+    }
+} /* }}} */
+
+time_t newest_modified(const struct task* first, time_t newest) { /* {{{ */
+    /* find the newest modification time in a list of tasks
+     * first  - the head of the list
+     * newest - the newest time found so far
+     */
+    for (; first != NULL; first = first->next) {
+        if (first->modified > newest) {
+            newest = first->modified;
+        }
+    }
+
+    return newest;
+} /* }}} */
+
+bool parse_annotations(struct task* tsk,
+                       struct json_scanner* scanner,
+                       const struct json_token* value) { /* {{{ */
+    /* parse the annotations array of a task
+     * tsk     - the task to attach the annotations to
+     * scanner - the scanner positioned after the opening bracket
+     * value   - the first token of the annotations value
+     * return is whether the array was parsed successfully
+     */
+    struct annotation*  last = NULL;
+    struct annotation*  ann;
+    struct json_token   key;
+    struct json_token   field;
+
+    if (value->type != JSON_ARRAY_START) {
+        return json_skip_value(scanner, value);
+    }
+
+    while (json_next(scanner, &key) == JSON_OBJECT_START) {
+        ann = arena_calloc(tsk->arena, sizeof(struct annotation));
+
+        if (last == NULL) {
+            tsk->annotations = ann;
+        } else {
+            last->next = ann;
+        }
+
+        last = ann;
+
+        while (json_next(scanner, &key) == JSON_STRING) {
+            json_next(scanner, &field);
+
+            if (key.length == 5 && memcmp(key.start, "entry", 5) == 0) {
+                set_date(&(ann->entry), &field);
+            } else if (key.length == 11 && memcmp(key.start, "description", 11) == 0) {
+                set_string(tsk->arena, &(ann->description), &field);
+            } else if (!json_skip_value(scanner, &field)) {
+                return false;
+            }
+        }
+
+        if (key.type != JSON_OBJECT_END) {
+            return false;
+        }
+    }
+
+    return key.type == JSON_ARRAY_END;
+} /* }}} */
+
+bool parse_tags(struct task* tsk,
+                struct json_scanner* scanner,
+                const struct json_token* value) { /* {{{ */
+    /* parse the tags array of a task into a list of quoted, comma separated
+     * tags (the form every tag regex has always been matched against), and
+     * the set of tags tested by filters, color rules and tag searches
+     * tsk     - the task to store the tags in
+     * scanner - the scanner positioned after the opening bracket
+     * value   - the first token of the tags value
+     * return is whether the array was parsed successfully
+     */
+    struct json_scanner start = *scanner;
+    struct json_token   tag;
+    size_t              size = 0;
+    size_t              len = 0;
+
+    if (value->type != JSON_ARRAY_START) {
+        return json_skip_value(scanner, value);
+    }
+
+    /* measure the tags first so the list fits one arena allocation */
+    while (json_next(scanner, &tag) == JSON_STRING) {
+        size += tag.length + 3;
+    }
+
+    if (tag.type != JSON_ARRAY_END) {
+        return false;
+    }
+
+    if (size == 0) {
+        tsk->tags = NULL;
+        return true;
+    }
+
+    tsk->tags = arena_alloc(tsk->arena, size);
+    *scanner = start;
+
+    while (json_next(scanner, &tag) == JSON_STRING) {
+        if (len > 0) {
+            tsk->tags[len++] = ',';
+        }
+
+        tsk->tags[len++] = '"';
+        len += json_unescape(&tag, tsk->tags + len);
+        tsk->tags[len++] = '"';
+        tsk->tags[len] = 0;
+    }
+
+    tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "tags: %s", tsk->tags);
+    tags_index(tsk);
+
+    return tag.type == JSON_ARRAY_END;
+} /* }}} */
+
+struct task* parse_task(struct json_scanner* scanner, struct arena* arena) { /* {{{ */
+    /* parse a task object from the output of `task export ...`
+     * scanner - the scanner positioned just after the opening brace
+     * arena   - the arena to allocate the task from
+     * return is the task structure defined by the object,
+     * or NULL if parsing failed (its memory is reclaimed with the arena)
+     */
+    struct task*        tsk = malloc_task(arena);
+    struct uda*         lastuda = NULL;
+    struct json_token   key;
+    struct json_token   value;
+    bool                ok = true;
+
+    if (tsk == NULL) {
+        return NULL;
+    }
+
+    /* parse json */
+    while (ok) {
+        /* get field */
+        json_next(scanner, &key);
+
+        /* terminate at end of object */
+        if (key.type == JSON_OBJECT_END) {
+            return tsk;
+        }
+
+        if (key.type != JSON_STRING) {
+            break;
+        }
+
+        tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "field: %.*s", (int)key.length,
+                    key.start);
+        json_next(scanner, &value);
+
+        /* determine how to handle content */
+        switch (lookup_field(key.start, key.length)) {
+        case TASK_FIELD_ID:
+            set_int(&(tsk->index), &value);
+            break;
+
+        case TASK_FIELD_UUID:
+            set_uuid(tsk->uuid, &value);
+            break;
+
+        case TASK_FIELD_DESCRIPTION:
+            set_string(tsk->arena, &(tsk->description), &value);
+            break;
+
+        case TASK_FIELD_PROJECT:
+            set_interned(&(tsk->project), &value);
+            break;
+
+        case TASK_FIELD_TAGS:
+            ok = parse_tags(tsk, scanner, &value);
+            break;
+
+        case TASK_FIELD_ENTRY:
+            set_date(&(tsk->entry), &value);
+            break;
+
+        case TASK_FIELD_DUE:
+            set_date(&(tsk->due), &value);
+            break;
+
+        case TASK_FIELD_START:
+            set_date(&(tsk->start), &value);
+            break;
+
+        case TASK_FIELD_END:
+            set_date(&(tsk->end), &value);
+            break;
+
+        case TASK_FIELD_MODIFIED:
+            set_date(&(tsk->modified), &value);
+            break;
+
+        case TASK_FIELD_PRIORITY:
+            set_char(&(tsk->priority), &value);
+            break;
+
+        case TASK_FIELD_ANNOTATIONS:
+            ok = parse_annotations(tsk, scanner, &value);
+            break;
+
+        case TASK_FIELD_UDA:
+        default:
+            ok = parse_uda(tsk, &lastuda, scanner, &key, &value);
+            break;
+        }
+    }
+
+    tnc_fprintf(logfp, LOG_ERROR, "error parsing task @ %.32s", key.start);
+
+    return NULL;
+} /* }}} */
+
+struct task* parse_export(const char* buffer, const size_t length,
+                          struct arena* arena) { /* {{{ */
+    /* parse the tasks in (part of) the output of an export command
+     * buffer - the export
+     * length - the number of characters in the buffer
+     * arena  - the arena the tasks and their strings are allocated from
+     * return is the list of tasks parsed, in the order of the export
+     * this is run on the parse threads, so it must only touch the arena
+     * (and the string pool, which is locked)
+     */
+    struct json_scanner scanner;
+    struct json_token   token;
+    struct task*        last = NULL;
+    struct task*        new_head = NULL;
+    long long           start;
+    char                uuid[UUIDLENGTH];
+
+    json_init(&scanner, buffer, length);
+
+    while (json_next(&scanner, &token) != JSON_END) {
+        struct task* this;
+
+        /* the export may be wrapped in an array */
+        if (token.type == JSON_ARRAY_START || token.type == JSON_ARRAY_END) {
+            continue;
+        }
+
+        /* skip lines that are not json */
+        if (token.type != JSON_OBJECT_START) {
+            tnc_fprintf(logfp, LOG_DEBUG, "skipping non-json output @ %.32s",
+                        token.start);
+            json_skip_line(&scanner);
+            continue;
+        }
+
+        /* parse task */
+        start = timer_start();
+        this = parse_task(&scanner, arena);
+        timer_stop(TIMER_PARSE_TASK, start);
+
+        if (this == NULL) {
+            json_skip_line(&scanner);
+            continue;
+        } else if (uuid_empty(this->uuid) || this->description == NULL) {
+            tnc_fprintf(logfp, LOG_ERROR, "task is missing uuid or description");
+            continue;
+        }
+
+        /* set pointers */
+        this->prev = last;
+
+        if (last == NULL) {
+            new_head = this;
+        } else {
+            last->next = this;
+        }
+
+        last = this;
+        tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "uuid:        %s", uuid_format(this->uuid, uuid));
+        tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "description: %s", this->description);
+        tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "project:     %s", this->project);
+        tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "tags:        %s", this->tags);
+    }
+
+    return new_head;
+} /* }}} */
+
+void* parse_merge_worker(void* arg) { /* {{{ */
+    /* merge the tasks of the chunk paired with a chunk into it
+     * arg    - the chunk to merge into
+     * return is unused
+     */
+    struct parse_chunk* chunk = arg;
+
+    chunk->head = sort_merge_lists(chunk->head, chunk->merge->head);
+    chunk->merge->head = NULL;
+
+    return NULL;
+} /* }}} */
+
+int parse_split(const char* buffer, const size_t length,
+                struct parse_chunk* chunks, const int nchunks) { /* {{{ */
+    /**
+     * split an export into chunks of roughly equal length
+     * a chunk only starts at a line that opens an object right after a line
+     * that closed one, taskwarrior prints a task per line, so every chunk
+     * holds whole tasks
+     * buffer  - the export
+     * length  - the number of characters in the export
+     * chunks  - the chunks to fill, nchunks long
+     * nchunks - the most chunks to split into
+     * return is the number of chunks filled in
+     */
+    const char* end = buffer + length;
+    const char* pos;
+    const char* prev;
+    int         n = 1;
+    int         i;
+
+    chunks[0].buffer = buffer;
+
+    for (i = 1; i < nchunks; i++) {
+        pos = buffer + length / nchunks * i;
+
+        if (pos <= chunks[n - 1].buffer) {
+            pos = chunks[n - 1].buffer + 1;
+        }
+
+        while (pos < end && (pos = memchr(pos, '\n', end - pos)) != NULL) {
+            for (prev = pos; prev > buffer && (prev[-1] == '\r' || prev[-1] == ',' ||
+                                               prev[-1] == ' '); prev--);
+
+            if (pos + 1 < end && pos[1] == '{' && prev > buffer && prev[-1] == '}') {
+                break;
+            }
+
+            pos++;
+        }
+
+        if (pos == NULL || pos >= end) {
+            break;
+        }
+
+        chunks[n++].buffer = pos + 1;
+    }
+
+    for (i = 0; i < n; i++) {
+        chunks[i].length = (i + 1 < n ? chunks[i + 1].buffer : end) - chunks[i].buffer;
+    }
+
+    return n;
+} /* }}} */
+
+struct task* parse_tasks(const char* buffer, const size_t length,
+                         struct arena* arena) { /* {{{ */
+    /* parse the tasks in the output of an export command
+     * large exports are split into chunks, each parsed and sorted on a
+     * thread of its own into an arena of its own, then the sorted chunks
+     * are merged in pairs (again on threads) back into export order
+     * buffer - the export (may be NULL if nothing was read)
+     * length - the number of characters in the buffer
+     * arena  - the arena the tasks and their strings are allocated from,
+     *          the arenas of the chunks are adopted by it
+     * return is the sorted list of tasks parsed, or NULL if there were none
+     */
+    struct parse_chunk  chunks[PARSEMAXTHREADS];
+    int                 nchunks;
+    int                 step;
+    int                 i;
+
+    if (buffer == NULL) {
+        return NULL;
+    }
+
+    nchunks = parse_thread_count(length);
+    nchunks = nchunks > 1 ? parse_split(buffer, length, chunks, nchunks) : 1;
+
+    for (i = 1; i < nchunks; i++) {
+        if ((chunks[i].arena = arena_create(TASKARENABLOCKLENGTH)) == NULL) {
+            tnc_fprintf(logfp, LOG_ERROR, "could not allocate arena to parse tasks");
+
+            while (--i > 0) {
+                arena_free(chunks[i].arena);
+            }
+
+            nchunks = 1;
+            break;
+        }
+    }
+
+    if (nchunks <= 1) {
+        return sort_wrapper(parse_export(buffer, length, arena));
+    }
+
+    tnc_fprintf(logfp, LOG_DEBUG, "parsing %zu bytes on %d threads", length, nchunks);
+
+    /* the first chunk is parsed on this thread, as is any chunk whose
+     * thread cannot be started
+     */
+    chunks[0].arena = arena;
+
+    for (i = nchunks - 1; i >= 0; i--) {
+        chunks[i].running = i > 0 &&
+                            pthread_create(&(chunks[i].thread), NULL, parse_worker, &(chunks[i])) == 0;
+
+        if (!chunks[i].running) {
+            parse_worker(&(chunks[i]));
+        }
+    }
+
+    for (i = 1; i < nchunks; i++) {
+        if (chunks[i].running) {
+            pthread_join(chunks[i].thread, NULL);
+        }
+
+        arena_adopt(arena, chunks[i].arena);
+    }
+
+    /* merge neighbouring chunks, so ties keep the order of the export */
+    for (step = 1; step < nchunks; step *= 2) {
+        for (i = nchunks - 1 - (nchunks - 1) % (2 * step); i >= 0; i -= 2 * step) {
+            if (i + step >= nchunks) {
+                chunks[i].running = false;
+                continue;
+            }
+
+            chunks[i].merge = &(chunks[i + step]);
+            chunks[i].running = i > 0 &&
+                                pthread_create(&(chunks[i].thread), NULL, parse_merge_worker,
+                                               &(chunks[i])) == 0;
+
+            if (!chunks[i].running) {
+                parse_merge_worker(&(chunks[i]));
+            }
+        }
+
+        for (i = 2 * step; i < nchunks; i += 2 * step) {
+            if (chunks[i].running) {
+                pthread_join(chunks[i].thread, NULL);
+                chunks[i].running = false;
+            }
+        }
+    }
+
+    return chunks[0].head;
+} /* }}} */
+
+int parse_thread_count(const size_t length) { /* {{{ */
+    /**
+     * decide how many threads to parse an export on
+     * length - the number of characters in the export
+     * return is the number of threads, 1 to parse on the calling thread
+     */
+    long n = cfg.parse_threads > 0 ? cfg.parse_threads : sysconf(_SC_NPROCESSORS_ONLN);
+
+    n = MIN(n, PARSEMAXTHREADS);
+    n = MIN(n, (long)(length / PARSECHUNKLENGTH));
+
+    return n > 1 ? n : 1;
+} /* }}} */
+
+void* parse_worker(void* arg) { /* {{{ */
+    /* parse and sort the tasks of a chunk of an export
+     * arg    - the chunk to parse
+     * return is unused
+     */
+    struct parse_chunk* chunk = arg;
+
+    chunk->head = sort_wrapper(parse_export(chunk->buffer, chunk->length, chunk->arena));
+
+    return NULL;
+} /* }}} */
+
+bool parse_uda(struct task* tsk,
+               struct uda** last,
+               struct json_scanner* scanner,
+               const struct json_token* key,
+               const struct json_token* value) { /* {{{ */
+    /* store a field that has no dedicated member in the task struct
+     * tsk     - the task to attach the field to
+     * last    - the last uda stored on this task (will be updated)
+     * scanner - the scanner positioned after the first token of the value
+     * key     - the name of the field
+     * value   - the first token of the value
+     * return is whether the value was read successfully
+     */
+    struct uda* this;
+
+    if (!json_skip_value(scanner, value)) {
+        return false;
+    }
+
+    this = arena_calloc(tsk->arena, sizeof(struct uda));
+    this->name = arena_alloc(tsk->arena, key->length + 1);
+    json_unescape(key, this->name);
+
+    /* strings are decoded, anything else is kept as raw json */
+    if (value->type == JSON_STRING) {
+        set_string(tsk->arena, &(this->value), value);
+    } else if (value->type == JSON_OBJECT_START || value->type == JSON_ARRAY_START) {
+        this->value = arena_strndup(tsk->arena, value->start, scanner->pos - value->start);
+    } else {
+        this->value = arena_strndup(tsk->arena, value->start, value->length);
+    }
+
+    if (*last == NULL) {
+        tsk->udas = this;
+    } else {
+        (*last)->next = this;
+    }
+
+    *last = this;
+    tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "uda: %s=%s", this->name, this->value);
+
+    return true;
+} /* }}} */
+
+void prefetch_tasks(void) { /* {{{ */
+    /* start exporting the task list before it is loaded, so the export runs
+     * while the rest of startup does
+     * the export is only used if the list is then loaded with the same
+     * command, a list shown from its snapshot is reloaded incrementally instead
+     */
+    const struct task_source*   source = task_source(list_filter());
+    char*                       cmdstr;
+    char*                       path;
+    bool                        saved = false;
+
+    if (cfg.snapshot && (path = snapshot_path()) != NULL) {
+        saved = access(path, R_OK) == 0;
+        free(path);
+    }
+
+    if (saved || source->command == NULL) {
+        return;
+    }
+
+    cmdstr = source->command(list_filter(), NULL);
+    jobs_prefetch(cmdstr);
+    free(cmdstr);
+} /* }}} */
+
+char* read_stream(FILE* fp, size_t* length) { /* {{{ */
+    /* read everything from a stream into a single null terminated buffer
+     * fp     - the stream to read
+     * length - where the number of characters read will be stored
+     * return is the buffer, which must be freed
+     */
+    size_t  size = EXPORTBLOCKLENGTH;
+    size_t  used = 0;
+    size_t  ret;
+    char*   buffer = malloc(size);
+
+    if (buffer == NULL) {
+        return NULL;
+    }
+
+    while ((ret = fread(buffer + used, sizeof(char), size - used - 1, fp)) > 0) {
+        used += ret;
+
+        if (used + 1 == size) {
+            size *= 2;
+            buffer = realloc(buffer, size);
+        }
+    }
+
+    buffer[used] = 0;
+    *length = used;
+
+    return buffer;
+} /* }}} */
+
+struct task* read_tasks(const char* filter, const char* uuid, struct arena* arena) { /* {{{ */
+    /* read tasks with the source for a filter, waiting for them
+     * filter - the filter to read the tasks matching
+     * uuid   - the only task to read (NULL to read every task)
+     * arena  - the arena the tasks and their strings are allocated from
+     * return is the sorted list of tasks, or NULL if there were none
+     */
+    const struct task_source*   source = task_source(filter);
+    struct task*                tasks;
+    char*                       cmdstr;
+
+    if (source->load != NULL) {
+        return source->load(filter, uuid, arena);
+    }
+
+    cmdstr = source->command(filter, uuid);
+    tasks = load_tasks(cmdstr, arena);
+    free(cmdstr);
+
+    return tasks;
+} /* }}} */
+
+void release_task(struct task* this) { /* {{{ */
+    /* note that a task taken off the list no longer uses its memory
+     * it is only freed along with the list's arena, see list_wasteful
+     * this - the task taken off the list
+     */
+    const struct annotation*    anno;
+    const struct uda*           uda;
+    size_t                      size;
+
+    size = sizeof(struct task) + this->linesize + this->tagwords * sizeof(uint64_t);
+    size += this->description != NULL ? strlen(this->description) + 1 : 0;
+    size += this->tags != NULL ? strlen(this->tags) + 1 : 0;
+    size += this->duestr != NULL ? TIMELENGTH : 0;
+
+    for (anno = this->annotations; anno != NULL; anno = anno->next) {
+        size += sizeof(struct annotation);
+        size += anno->description != NULL ? strlen(anno->description) + 1 : 0;
+    }
+
+    for (uda = this->udas; uda != NULL; uda = uda->next) {
+        size += sizeof(struct uda);
+        size += uda->name != NULL ? strlen(uda->name) + 1 : 0;
+        size += uda->value != NULL ? strlen(uda->value) + 1 : 0;
+    }
+
+    arena_release(this->arena, size);
+} /* }}} */
+
+void reload_added_done(const struct job* job) { /* {{{ */
+    /* add the tasks new to the filter to the list (last step of an
+     * incremental reload)
+     * job - the export of the new tasks
+     */
+    const long long start = timer_start();
+    struct arena*   arena = arena_create(TASKARENABLOCKLENGTH / 16);
+    struct task*    first = head != NULL ? head : hidden;
+    struct task*    added = NULL;
+    struct task*    merge = NULL;
+    struct task*    cur;
+    struct task*    next;
+
+    if (arena != NULL) {
+        added = parse_tasks(job->output, job->length, arena);
+    }
+
+    timer_stop(TIMER_GET_TASKS, start);
+
+    /* the tasks live as long as the list they join */
+    if (first != NULL) {
+        arena_adopt(arena_root(first->arena), arena);
+    }
+
+    /* a task may have been loaded while the export ran */
+    for (cur = added; cur != NULL; cur = next) {
+        next = cur->next;
+
+        if (find_loaded(cur->uuid) == NULL) {
+            cur->prev = NULL;
+            cur->next = merge;
+            merge = cur;
+        } else {
+            release_task(cur);
+        }
+    }
+
+    if (first == NULL && merge == NULL) {
+        arena_free(arena);
+    }
+
+    merge_tasks(merge);
+    reload_finish();
+} /* }}} */
+
+void reload_changed_done(const struct job* job) { /* {{{ */
+    /* replace the tasks modified since the list was loaded, and drop tasks
+     * that no longer match the filter (second step of an incremental reload)
+     * job - the export of the modified tasks
+     */
+    const long long start = timer_start();
+    struct task*    first = head != NULL ? head : hidden;
+    struct arena*   root = first != NULL ? arena_root(first->arena) : NULL;
+    struct arena*   arena;
+    struct task*    changed;
+    struct task*    merge = NULL;
+    struct task*    cur;
+    struct task*    next;
+    struct task*    old;
+    char*           cmdstr;
+    char            uuid[UUIDLENGTH];
+    size_t          length;
+    int             i;
+
+    if (job->ret != 0 || root == NULL || loaded_filter == NULL ||
+        !str_eq(list_filter(), loaded_filter) ||
+        (arena = arena_create(TASKARENABLOCKLENGTH / 16)) == NULL) {
+        tnc_fprintf(logfp, LOG_DEBUG, "incremental reload failed, reloading all tasks");
+        reload_full();
+        return;
+    }
+
+    changed = parse_tasks(job->output, job->length, arena);
+    timer_stop(TIMER_GET_TASKS, start);
+
+    /* the modified tasks live as long as the list they join */
+    arena_adopt(root, arena);
+
+    /* replace modified tasks that are still in the list */
+    for (cur = changed; cur != NULL; cur = next) {
+        next = cur->next;
+        old = find_loaded(cur->uuid);
+        infocache_forget(cur->uuid);
+
+        if (old != NULL && old->generation == reloading.generation) {
+            replace_task(old, cur);
+            continue;
+        }
+
+        /* only tasks new to the filter are added, the rest are not needed */
+        uuid_format(cur->uuid, uuid);
+
+        for (i = 0; old == NULL && i < reloading.nmissing && (reloading.missing[i] == NULL ||
+                                                         !str_eq(reloading.missing[i], uuid)); i++);
+
+        if (old != NULL || i == reloading.nmissing) {
+            release_task(cur);
+            continue;
+        }
+
+        free(reloading.missing[i]);
+        reloading.missing[i] = NULL;
+        cur->prev = NULL;
+        cur->next = merge;
+        merge = cur;
+    }
+
+    /* drop tasks that no longer match, many are dropped in a single pass
+     * and the list indexed again
+     */
+    for (cur = head, i = 0; cur != NULL; cur = next) {
+        next = cur->next;
+
+        if (cur->generation == reloading.generation) {
+            continue;
+        }
+
+        list_unlink(cur);
+
+        if (++i <= INCREMENTALMAXMOVES) {
+            tasktable_remove(cur);
+        }
+
+        release_task(cur);
+    }
+
+    if (i > INCREMENTALMAXMOVES) {
+        tasktable_build(head);
+    }
+
+    for (cur = hidden; cur != NULL; cur = next) {
+        next = cur->next;
+
+        if (cur->generation != reloading.generation) {
+            view_unhide(cur);
+            release_task(cur);
+        }
+    }
+
+    /* nothing refers to the old list's arena once it is empty */
+    if (head == NULL && hidden == NULL && merge == NULL) {
+        arena_free(root);
+    }
+
+    merge_tasks(merge);
+
+    /* export the tasks new to the filter that were not modified recently
+     * the filter is repeated in case they changed since the uuids were listed
+     */
+    length = 64 + strlen(loaded_filter) + reloading.nmissing * UUIDLENGTH;
+    cmdstr = malloc(length);
+
+    if (*loaded_filter != 0) {
+        snprintf(cmdstr, length, "task export \\( %s \\)", loaded_filter);
+    } else {
+        strcpy(cmdstr, "task export");
+    }
+
+    length = strlen(cmdstr);
+
+    for (i = 0; i < reloading.nmissing; i++) {
+        if (reloading.missing[i] != NULL) {
+            strcat(cmdstr, " ");
+            strcat(cmdstr, reloading.missing[i]);
+        }
+    }
+
+    if (strlen(cmdstr) == length || !jobs_submit(cmdstr, reload_added_done, NULL)) {
+        reload_finish();
+    }
+
+    free(cmdstr);
+} /* }}} */
+
+void reload_finish(void) { /* {{{ */
+    /* finish a reload, starting the next one if another was requested */
+    void (*done)(void) = reloading.done;
+
+    reload_free_missing();
+    reloading.running = false;
+    tnc_fprintf(logfp, LOG_DEBUG, "reload complete: %d tasks", tasktable_count());
+
+    if (done != NULL) {
+        done();
+    }
+
+    if (reloading.again) {
+        reloading.again = false;
+        reload_tasks_background(done);
+    }
+} /* }}} */
+
+void reload_free_missing(void) { /* {{{ */
+    /* free the uuids an incremental reload found missing from the list */
+    int i;
+
+    for (i = 0; i < reloading.nmissing; i++) {
+        check_free(reloading.missing[i]);
+    }
+
+    check_free(reloading.missing);
+    reloading.missing = NULL;
+    reloading.nmissing = 0;
+} /* }}} */
+
+void reload_full(void) { /* {{{ */
+    /* load every task matching the filter, replacing the whole list */
+
+    /* the filter loaded with is remembered for the next incremental reload */
+    const char* filter = list_filter();
+
+    if (!submit_load(filter, NULL, reload_full_done, filter != NULL ? strdup(filter) : NULL)) {
+        reload_finish();
+    }
+} /* }}} */
+
+void reload_full_done(const struct job* job) { /* {{{ */
+    /* replace the task list with a full load
+     * job - the load, its data is the filter it was run with
      */
-    struct task* tsk = malloc_task();
+    struct arena*   arena = arena_create(TASKARENABLOCKLENGTH);
+    struct task*    new_head = NULL;
+    struct task*    cur;
+    struct task*    old;
+    char            uuid[UUIDLENGTH];
 
-    /* detect lines that are not json */
-    if (*line != '{') {
-        return (struct task*) - 1;
+    if (arena == NULL) {
+        tnc_fprintf(logfp, LOG_ERROR, "could not allocate task arena");
+    } else if ((new_head = job_tasks(job, job->data, NULL, arena)) == NULL) {
+        arena_free(arena);
     }
 
-    line++;
-
-    /* parse json */
-    while (*line != 0) {
-        /* local vars */
-        char* field = NULL;
-        int ret;
-
-        /* skip field delimiters */
-        if (*line == ',') {
-            line++;
-            continue;
-        }
-
-        /* terminate at end of line */
-        if (*line == '}') {
-            break;
-        }
+    /* marked tasks stay marked, the old list (with the tasks the filter left
+     * out) is still indexed
+     */
+    for (cur = head; cur != NULL && !cur->marked; cur = cur->next);
 
-        /* get field */
-        ret = sscanf(line, "\"%m[^\"]\":", &field);
+    for (old = hidden; cur == NULL && old != NULL; old = old->next) {
+        cur = old->marked ? old : NULL;
+    }
 
-        if (ret != 1) {
-            tnc_fprintf(logfp, LOG_ERROR, "error parsing task @ %s", line);
-            return (struct task*) - 1;
+    if (cur != NULL) {
+        for (cur = new_head; cur != NULL; cur = cur->next) {
+            old = find_loaded(cur->uuid);
+            cur->marked = old != NULL && old->marked;
         }
+    }
 
-        tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "field: %s", field);
-        line += strlen(field) + 3;
-
-        /* determine how to handle content */
-        if (str_eq(field, "id")) {
-            set_int(&(tsk->index), &line);
-        } else if (str_eq(field, "description")) {
-            set_string(&(tsk->description), &line);
-        } else if (str_eq(field, "project")) {
-            set_string(&(tsk->project), &line);
-        } else if (str_eq(field, "tags")) {
-            char* pos = line;
-
-            while (*pos != ']') {
-                pos++;
-            }
+    free_task_list();
+    head = new_head;
+    tasktable_build(head);
 
-            tsk->tags = strndup(line + 1, pos - line - 1);
-            line = pos + 1;
-            tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "string: %s", tsk->tags);
-        } else if (str_eq(field, "uuid")) {
-            set_string(&(tsk->uuid), &line);
-        } else if (str_eq(field, "entry")) {
-            set_date(&(tsk->entry), &line);
-        } else if (str_eq(field, "due")) {
-            set_date(&(tsk->due), &line);
-        } else if (str_eq(field, "priority")) {
-            set_char(&(tsk->priority), &line);
-        } else if (str_eq(field, "annotations")) {
-            while (*line != ']') {
-                line++;
-            }
+    check_free(loaded_filter);
+    loaded_filter = job->data != NULL ? strdup(job->data) : NULL;
+    loaded_modified = newest_modified(head, 0);
+    save_task_snapshot();
+    view_filter();
 
-            line++;
-        } else { /* unknown field */
-            while (*line != ',' && *line != '}') {
-                line++;
-            }
-        }
+    /* debug */
+    cur = head;
 
-        free(field);
+    while (cur != NULL) {
+        tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "%u,%s,%s,%llu,%llu,%llu,%llu,%s,%c,%s",
+                    cur->index, uuid_format(cur->uuid, uuid), cur->tags, (unsigned long long)cur->start,
+                    (unsigned long long)cur->end, (unsigned long long)cur->entry,
+                    (unsigned long long)cur->due, cur->project, cur->priority, cur->description);
+        cur = cur->next;
     }
 
-    return tsk;
+    reload_finish();
 } /* }}} */
 
 void reload_task(struct task* this) { /* {{{ */
-    /* reload an individual task's data
+    /* reload an individual task's data in the background
      * this - the task whose data needs reloading
+     * the load is queued behind any command already running on the task
+     */
+    char uuid[UUIDLENGTH];
+
+    infocache_forget(this->uuid);
+    uuid_format(this->uuid, uuid);
+    submit_load(list_filter(), uuid, reload_task_done, strdup(uuid));
+} /* }}} */
+
+void reload_task_done(const struct job* job) { /* {{{ */
+    /* replace a task with its reloaded data
+     * job - the export of the task, its data is the task's uuid
      * task data is modified by generating a new task struct, and replacing
      * the old task in the stack
+     * the old task's memory is reclaimed along with the list's arena
      */
-    struct task* new;
+    const char*     uuid = job->data;
+    const int       oldsel = selline;
+    const int       oldoffset = pageoffset;
+    unsigned char   bytes[UUIDBYTES];
+    struct task*    this;
+    struct task*    new = NULL;
+    struct arena*   arena;
+
+    /* the task may have left the list while it was exported */
+    if (!uuid_parse(uuid, strlen(uuid), bytes) || (this = find_loaded(bytes)) == NULL) {
+        return;
+    }
+
+    /* a single task reload only needs a small arena */
+    arena = arena_create(TASKARENABLOCKLENGTH / 16);
 
-    /* get new task */
-    new = get_tasks(this->uuid);
+    if (arena != NULL && (new = job_tasks(job, list_filter(), uuid, arena)) == NULL) {
+        arena_free(arena);
+    }
 
     /* check for NULL new task */
     if (new == NULL) {
-        tnc_fprintf(logfp, LOG_ERROR, "reload_task(%s): get_tasks returned NULL",
-                    this->uuid);
+        tnc_fprintf(logfp, LOG_ERROR, "reload_task(%s): export returned no task", uuid);
 
-        if (this->prev != NULL) {
-            this->prev->next = this->next;
+        if (this->position < 0) {
+            view_unhide(this);
         } else {
-            head = this->next;
+            list_unlink(this);
+            tasktable_remove(this);
         }
 
-        if (this->next != NULL) {
-            this->next->prev = this->prev;
-        }
+        release_task(this);
+        task_count();
 
-        taskcount--;
+        /* nothing refers to the old list's arena once it is empty */
+        if (head == NULL && hidden == NULL) {
+            free_tasks(this);
+        }
     } else {
-        /* transfer pointers */
-        new->prev = this->prev;
-        new->next = this->next;
+        /* the new task's arena lives as long as the list it joins */
+        arena_adopt(arena_root(this->arena), new->arena);
+        replace_task(this, new);
+    }
 
-        if (this->prev != NULL) {
-            this->prev->next = new;
-        } else {
-            tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "reload_task(%s): no previous task",
-                        this->uuid);
-        }
+    if (cfg.follow_task) {
+        set_position_by_uuid(uuid);
+    }
 
-        if (this->next != NULL) {
-            this->next->prev = new;
-        } else {
-            tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "reload_task(%s): no next task",
-                        this->uuid);
-        }
+    tasklist_update(oldsel, oldoffset);
 
-        /* move to head if necessary */
-        if (this == head) {
-            head = new;
-            tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "reload_task(%s): setting task as head",
-                        this->uuid);
-        }
+    /* the list is loaded again once reloads have left too much unused */
+    if (list_wasteful()) {
+        reload = true;
     }
+} /* }}} */
 
-    /* free old task */
-    free_task(this);
-
-    /* re-sort task list */
-    sort_wrapper(head);
+void reload_tasks(void) { /* {{{ */
+    /* reset head with a new list of tasks, waiting for it to be loaded */
+    reload_tasks_background(NULL);
+    jobs_wait();
 } /* }}} */
 
-void reload_tasks() { /* {{{ */
-    /* reset head with a new list of tasks */
-    struct task* cur;
+void reload_tasks_background(void (*done)(void)) { /* {{{ */
+    /* reload the task list without waiting for taskwarrior
+     * only the tasks that changed are fetched if the list is still current
+     * for the filter: tasks that no longer match the filter are found by
+     * comparing the list with the uuids taskwarrior reports, tasks modified
+     * since the newest modification in the list replace their old copies
+     * done - run on the ui once the list has been updated (may be NULL)
+     */
+    char* cmdstr;
 
-    tnc_fprintf(logfp, LOG_DEBUG, "reloading tasks");
+    /* a reload already running may have missed the change asked for */
+    if (reloading.running) {
+        reloading.again = true;
+        return;
+    }
 
-    free_tasks(head);
+    reloading.running = true;
+    reloading.done = done;
 
-    head = get_tasks(NULL);
+    /* a source that reads the data files itself reads every task */
+    if (cfg.incremental_reload && (head != NULL || hidden != NULL) && loaded_modified > 0 &&
+        !list_wasteful() &&
+        task_source(list_filter())->command != NULL &&
+        cfg.version[0] >= '2' && active_filter != NULL && loaded_filter != NULL &&
+        str_eq(list_filter(), loaded_filter)) {
+        reloading.generation++;
 
-    /* debug */
-    cur = head;
+        /* find every task that matches the filter */
+        asprintf(&cmdstr, "task %s _uuids", loaded_filter);
+        tnc_fprintf(logfp, LOG_DEBUG, "incremental reload (%s)", cmdstr);
 
-    while (cur != NULL) {
-        tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "%d,%s,%s,%llu,%llu,%llu,%llu,%s,%c,%s",
-                    cur->index, cur->uuid, cur->tags, (unsigned long long)cur->start,
-                    (unsigned long long)cur->end, (unsigned long long)cur->entry,
-                    (unsigned long long)cur->due, cur->project, cur->priority, cur->description);
-        cur = cur->next;
+        if (jobs_submit(cmdstr, reload_uuids_done, NULL)) {
+            free(cmdstr);
+            return;
+        }
+
+        free(cmdstr);
     }
+
+    reload_full();
 } /* }}} */
 
-void remove_char(char* str, char remove) { /* {{{ */
-    /* iterate through a string and remove escapes inline
-     * str    - the string to remove escapes from
-     * remove - the escape to remove
+void reload_uuids_done(const struct job* job) { /* {{{ */
+    /* mark the loaded tasks that still match the filter and note the ones
+     * that are missing, then export the modified tasks (first step of an
+     * incremental reload)
+     * job - the list of uuids matching the filter
      */
-    const int   len = strlen(str);
-    int         i;
-    int         offset = 0;
-
-    for (i = 0; i < len; i++) {
-        if (str[i + offset] == '\0') {
-            break;
-        }
+    struct task*    old;
+    const char*     pos;
+    char*           cmdstr;
+    unsigned char   uuid[UUIDBYTES];
+    size_t          len;
 
-        str[i] = str[i + offset];
+    if (job->ret != 0 || job->output == NULL || (head == NULL && hidden == NULL) ||
+        loaded_filter == NULL || !str_eq(list_filter(), loaded_filter)) {
+        tnc_fprintf(logfp, LOG_DEBUG, "incremental reload failed, reloading all tasks");
+        reload_full();
+        return;
+    }
 
-        while (str[i] == remove || str[i] == '\0') {
-            offset++;
+    reloading.missing = calloc(INCREMENTALMAXNEW, sizeof(char*));
+    reloading.nmissing = 0;
 
-            if (i + offset >= len) {
-                break;
-            }
+    for (pos = job->output; *(pos += strspn(pos, " \t\n")) != 0; pos += len) {
+        len = strcspn(pos, " \t\n");
 
-            str[i] = str[i + offset];
+        if (!uuid_parse(pos, len, uuid)) {
+            continue;
         }
 
-        if (str[i + offset] == '\0') {
-            break;
+        old = find_loaded(uuid);
+
+        if (old != NULL) {
+            old->generation = reloading.generation;
+        } else if (reloading.nmissing < INCREMENTALMAXNEW) {
+            reloading.missing[reloading.nmissing++] = strndup(pos, len);
+        } else {
+            /* too many new tasks, exporting them all is faster */
+            reload_free_missing();
+            reload_full();
+            return;
         }
     }
 
+    /* export the tasks modified since the list was loaded
+     * one second of overlap covers modifications made during the last load
+     */
+    if (*loaded_filter != 0) {
+        asprintf(&cmdstr, "task export \\( %s \\) modified.after:%lld", loaded_filter,
+                 (long long)loaded_modified - 1);
+    } else {
+        asprintf(&cmdstr, "task export modified.after:%lld", (long long)loaded_modified - 1);
+    }
+
+    if (!jobs_submit(cmdstr, reload_changed_done, NULL)) {
+        reload_free_missing();
+        reload_full();
+    }
+
+    free(cmdstr);
 } /* }}} */
 
-void set_char(char* field, char** line) { /* {{{ */
-    /* set a character field from the next contents of line
-     * field - the field set the character in
-     * line  - the line to parse the character from
+void replace_task(struct task* old, struct task* new) { /* {{{ */
+    /* put a reloaded task in the place of its old copy on the list
+     * it is only moved if it sorts elsewhere now
+     * old - the loaded task, which is released
+     * new - the task replacing it
      */
-    int ret = sscanf(*line, "\"%c\"", field);
 
-    if (ret != 1) {
-        tnc_fprintf(logfp, LOG_ERROR, "error parsing char @ %s", *line);
+    /* keep the mark of an incremental reload in progress */
+    new->generation = old->generation;
+    new->marked = old->marked;
+
+    /* the local filter may show the task now, or no longer show it */
+    if (old->position < 0 || !view_shows(new)) {
+        if (old->position < 0) {
+            view_unhide(old);
+        } else {
+            list_unlink(old);
+            tasktable_remove(old);
+        }
+
+        release_task(old);
+        view_add(new);
+        return;
+    }
+
+    new->prev = old->prev;
+    new->next = old->next;
+
+    if (old->prev != NULL) {
+        old->prev->next = new;
     } else {
-        tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "char: %c", *field);
+        head = new;
+    }
+
+    if (old->next != NULL) {
+        old->next->prev = new;
+    }
+
+    tasktable_replace(old, new);
+    release_task(old);
+
+    if ((new->prev == NULL || sort_compare(new->prev, new) <= 0) &&
+        (new->next == NULL || sort_compare(new, new->next) <= 0)) {
+        return;
+    }
+
+    list_unlink(new);
+    tasktable_remove(new);
+    insert_task(new);
+} /* }}} */
+
+void save_task_snapshot(void) { /* {{{ */
+    /* save the task list for the next run to show while it loads
+     * only a list loaded with the active filter is saved
+     */
+    char* path;
+    char* key;
+
+    if (!cfg.snapshot || head == NULL || loaded_filter == NULL ||
+        !str_eq(loaded_filter, active_filter) || (path = snapshot_path()) == NULL) {
+        return;
     }
 
-    while (**line != ',' &&** line != '}') {
-        (*line)++;
+    key = snapshot_key();
+    snapshot_write(path, key, head, loaded_modified);
+    free(path);
+    free(key);
+} /* }}} */
+
+void set_char(char* field, const struct json_token* value) { /* {{{ */
+    /* set a character field from the first character of a string value
+     * field - the field set the character in
+     * value - the token to take the character from
+     */
+    if (value->type != JSON_STRING || value->length == 0) {
+        tnc_fprintf(logfp, LOG_ERROR, "error parsing char @ %.32s", value->start);
+    } else {
+        *field = *(value->start);
+        tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "char: %c", *field);
     }
 } /* }}} */
 
-void set_date(time_t* field, char** line) { /* {{{ */
-    /* set a time field from the next contents of line
+void set_date(time_t* field, const struct json_token* value) { /* {{{ */
+    /* set a time field from a date string value
      * field - the field set the time in
-     * line  - the line to parse the time from
+     * value - the token to parse the time from
      */
-    char*   tmp;
-    int     ret = sscanf(*line, "\"%m[^\"]\"", &tmp);
+    char timestr[TIMELENGTH];
 
-    if (ret != 1) {
-        tnc_fprintf(logfp, LOG_ERROR, "error parsing time @ %s", *line);
-    } else {
-        *field = strtotime(tmp);
-        tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "time: %d", (int)*field);
-        free(tmp);
+    if (value->type != JSON_STRING || value->length >= TIMELENGTH) {
+        tnc_fprintf(logfp, LOG_ERROR, "error parsing time @ %.32s", value->start);
+        return;
     }
 
-    while (**line != ',' &&** line != '}') {
-        (*line)++;
+    /* taskwarrior always exports utc, anything else takes the slow path */
+    if (!parse_timestamp(value->start, value->length, field)) {
+        memcpy(timestr, value->start, value->length);
+        timestr[value->length] = 0;
+        *field = strtotime(timestr);
     }
+
+    tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "time: %d", (int)*field);
 } /* }}} */
 
-void set_int(unsigned short* field, char** line) { /* {{{ */
-    /* set an integer field from the next contents of line
+void set_int(unsigned int* field, const struct json_token* value) { /* {{{ */
+    /* set an integer field from a number value
      * field - the field set the integer in
-     * line  - the line to parse the integer from
+     * value - the token to parse the integer from
      */
-    int ret = sscanf(*line, "%hd", field);
+    const char*     pos;
+    unsigned long   num = 0;
 
-    if (ret != 1) {
-        tnc_fprintf(logfp, LOG_ERROR, "error parsing integer @ %s", *line);
-    } else {
-        tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "int: %d", *field);
+    if (value->type != JSON_NUMBER) {
+        tnc_fprintf(logfp, LOG_ERROR, "error parsing integer @ %.32s", value->start);
+        return;
     }
 
-    while (**line != ',' &&** line != '}') {
-        (*line)++;
+    for (pos = value->start; pos < value->start + value->length &&
+         *pos >= '0' && *pos <= '9'; pos++) {
+        num = 10 * num + (*pos - '0');
     }
+
+    *field = num;
+    tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "int: %u", *field);
 } /* }}} */
 
-void set_string(char** field, char** line) { /* {{{ */
-    /* set an string field from the next contents of line
-     * field - the field set the string in
-     * line  - the line to parse the string from
+void set_interned(const char** field, const struct json_token* value) { /* {{{ */
+    /* set a string field shared between tasks from a string value
+     * field - the field set the pooled string in
+     * value - the token to decode the string from
      */
-    char* tmp = *line;
-
-    do {
-        tmp = strstr(*line, "\",");
+    char    buffer[256];
+    char*   str = buffer;
 
-        if (tmp == NULL) {
-            tmp = strstr(*line, "\"}");
-        }
-    } while (tmp != NULL && *(tmp - 1) == '\\');
+    if (value->type != JSON_STRING) {
+        tnc_fprintf(logfp, LOG_ERROR, "error parsing string @ %.32s", value->start);
+        return;
+    }
 
-    *field = strndup((*line) + 1, tmp - (*line) - 1);
+    /* an unescaped string is pooled straight from the export */
+    if (!value->escaped) {
+        *field = intern_string(value->start, value->length);
+        return;
+    }
 
-    if (tmp == NULL || *field == NULL) {
-        tnc_fprintf(logfp, LOG_ERROR, "error parsing string @ %s", *line);
-    } else {
-        tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "string: %s", *field);
+    if (value->length >= sizeof(buffer) && (str = malloc(value->length + 1)) == NULL) {
+        return;
     }
 
-    *line += tmp - *line;
+    json_unescape(value, str);
+    *field = intern_string(str, strlen(str));
+    tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "string: %s", str);
+
+    if (str != buffer) {
+        free(str);
+    }
+} /* }}} */
 
-    while (**line != ',' &&** line != '}') {
-        (*line)++;
+void set_string(struct arena* arena, char** field,
+                const struct json_token* value) { /* {{{ */
+    /* set a string field from a string value, decoding escapes
+     * arena - the arena to allocate the string from
+     * field - the field set the string in
+     * value - the token to copy the string from
+     */
+    if (value->type != JSON_STRING) {
+        tnc_fprintf(logfp, LOG_ERROR, "error parsing string @ %.32s", value->start);
+        return;
     }
+
+    *field = arena_alloc(arena, value->length + 1);
+    json_unescape(value, *field);
+    tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "string: %s", *field);
 } /* }}} */
 
 void set_position_by_uuid(const char* uuid) { /* {{{ */
     /* set the cursor position to a uuid's position
      * uuid - the uuid of the task to select
      */
-    int pos;
+    unsigned char   bytes[UUIDBYTES];
+    int             pos;
 
     /* check for null uuid */
-    if (uuid == NULL) {
+    if (uuid == NULL || !uuid_parse(uuid, strlen(uuid), bytes)) {
         return;
     }
 
     /* get position & set it */
-    pos = get_task_position_by_uuid(uuid);
+    pos = get_task_position_by_uuid(bytes);
 
     if (pos > 0) {
         selline = pos;
     }
 } /* }}} */
 
+char* snapshot_key(void) { /* {{{ */
+    /* build the key a snapshot of the list is saved under
+     * a snapshot is only shown for the same filter, sort mode, version of
+     * taskwarrior and task data it was saved from
+     * return is the key, which must be free'd
+     */
+    char* key;
+    char* taskrc = getenv("TASKRC");
+    char* taskdata = getenv("TASKDATA");
+
+    asprintf(&key, "filter=%s\nsort=%s\nversion=%s\ntaskrc=%s\ntaskdata=%s",
+             active_filter, cfg.sortmode, cfg.version,
+             taskrc != NULL ? taskrc : "", taskdata != NULL ? taskdata : "");
+
+    return key;
+} /* }}} */
+
 time_t strtotime(const char* timestr) { /* {{{ */
     /* convert a string to a time_t
      * timestr - the string to parse
@@ -616,68 +2000,127 @@ time_t strtotime(const char* timestr) { /* {{{ */
 
     memset(&tmr, 0, sizeof(tmr));
     strptime(timestr, "%Y%m%dT%H%M%S%z", &tmr);
-    return mktime(&tmr);
+    return timegm(&tmr) - tmr.tm_gmtoff;
+} /* }}} */
+
+bool submit_load(const char* filter, const char* uuid, job_callback callback,
+                 void* data) { /* {{{ */
+    /* queue a load of tasks behind the commands already queued
+     * filter   - the filter to load the tasks matching
+     * uuid     - the only task to load (NULL to load every task)
+     * callback - run once the tasks can be read with job_tasks
+     * data     - passed to the callback (as for jobs_submit)
+     * return is whether the load was queued
+     */
+    const struct task_source*   source = task_source(filter);
+    char*                       cmdstr;
+    bool                        ret;
+
+    if (source->command == NULL) {
+        tnc_fprintf(logfp, LOG_DEBUG, "reloading tasks (%s source)", source->name);
+        return jobs_submit(NULL, callback, data);
+    }
+
+    cmdstr = source->command(filter, uuid);
+    tnc_fprintf(logfp, LOG_DEBUG, "reloading tasks (%s)", cmdstr);
+    ret = jobs_submit(cmdstr, callback, data);
+    free(cmdstr);
+
+    return ret;
 } /* }}} */
 
-int task_background_command(const char* cmdfmt) { /* {{{ */
+void task_background_command(const char* cmdfmt, job_callback callback) { /* {{{ */
     /* run a command on the current task in the background
-     * cmdfmt - the format string describing the command to run
-     *          a %s in the format string will be replaced with
-     *          the selected task's uuid
-     * return is the return of the command run
+     * cmdfmt   - the format string describing the command to run
+     *            a %s in the format string will be replaced with
+     *            the selected task's uuid
+     * callback - run on the ui once the command finishes (may be NULL)
+     *            the job's data is the uuid of the task
      */
     struct task*    cur;
     char*           cmdstr;
-    char*           line;
-    FILE*           cmd;
-    int             ret;
+    char            uuid[UUIDLENGTH] = "";
 
-    /* build command */
+    /* build command, the uuid is only formatted to go on the command line */
     cur = get_task_by_position(selline);
-    asprintf(&cmdstr, cmdfmt, cur->uuid);
+
+    if (cur != NULL) {
+        uuid_format(cur->uuid, uuid);
+    }
+
+    asprintf(&cmdstr, cmdfmt, uuid);
     cmdstr = realloc(cmdstr, (strlen(cmdstr) + 6) * sizeof(char));
     strcat(cmdstr, " 2>&1");
-    tnc_fprintf(logfp, LOG_DEBUG, "running command: %s", cmdstr);
 
-    /* run command in background */
-    cmd = popen(cmdstr, "r");
+    /* queue command, its output and return are logged when it finishes */
+    jobs_submit(cmdstr, callback, cur != NULL ? strdup(uuid) : NULL);
     free(cmdstr);
+} /* }}} */
 
-    while (!feof(cmd)) {
-        ret = fscanf(cmd, "%m[^\n]*", &line);
-
-        if (ret == 1) {
-            tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, line);
-            free(line);
-        } else {
-            break;
+int task_batch_command(const char* action, job_callback callback) { /* {{{ */
+    /* run a command on every marked task in the background
+     * the marked tasks are passed to as few task processes as possible
+     * action   - the command to run, appended after the uuids (such as "done")
+     * callback - run on the ui once each batch finishes (may be NULL)
+     *            the job's data is the number of tasks in the batch
+     * return is the number of marked tasks
+     */
+    struct task*    cur;
+    char*           cmdstr;
+    char*           pos;
+    int*            count;
+    int             n = 0;
+    int             total = 0;
+    const char*     prefix = "task rc.bulk:0 rc.confirmation:no";
+    const size_t    length = strlen(prefix) + BATCHMAXTASKS * UUIDLENGTH + strlen(action) + 8;
+
+    cmdstr = malloc(length);
+    pos = cmdstr + sprintf(cmdstr, "%s", prefix);
+
+    for (cur = head; cur != NULL; cur = cur->next) {
+        if (cur->marked) {
+            *(pos++) = ' ';
+            uuid_format(cur->uuid, pos);
+            pos += strlen(pos);
+            n++;
         }
-    }
-
-    ret = pclose(cmd);
 
-    /* log command return value */
-    if (WEXITSTATUS(ret) == 0 || WEXITSTATUS(ret) == 128 + SIGPIPE) {
-        ret = 0;
-    } else {
-        ret = WEXITSTATUS(ret);
+        /* queue a batch once it is full, or at the end of the list */
+        if (n > 0 && (n == BATCHMAXTASKS || cur->next == NULL)) {
+            sprintf(pos, " %s 2>&1", action);
+            count = malloc(sizeof(int));
+            *count = n;
+            jobs_submit(cmdstr, callback, count);
+            total += n;
+            n = 0;
+            pos = cmdstr + strlen(prefix);
+        }
     }
 
-    tnc_fprintf(logfp, LOG_DEBUG, "command returned: %d", ret);
+    free(cmdstr);
 
-    return ret;
+    return total;
 } /* }}} */
 
 void task_count() { /* {{{ */
-    taskcount = 0;
-    struct task* cur;
+    /* update the count of lines on the list, a grouped list counts its headers */
+    taskcount = groups_active() ? groups_count() : tasktable_count();
+} /* }}} */
 
-    cur = head;
+const struct task_source* task_source(const char* filter) { /* {{{ */
+    /* find the source tasks are read with
+     * the export is used when the chosen source cannot handle the filter
+     * filter - the filter tasks will be read for
+     */
+    int i;
 
-    while (cur != NULL) {
-        taskcount++;
-        cur = cur->next;
+    for (i = 0; sources[i] != NULL; i++) {
+        if (cfg.task_source != NULL && str_eq(cfg.task_source, sources[i]->name)) {
+            return sources[i]->usable(filter) ? sources[i] : &export_source;
+        }
     }
+
+    return &export_source;
 } /* }}} */
 
 int task_interactive_command(const char* cmdfmt) { /* {{{ */
@@ -689,19 +2132,29 @@ int task_interactive_command(const char* cmdfmt) { /* {{{ */
      */
     struct task* cur;
     char*        cmdstr;
+    char         uuid[UUIDLENGTH] = "";
     int          ret;
 
+    /* the command sees the result of every command queued before it */
+    jobs_wait();
+
     /* build command */
     cur = get_task_by_position(selline);
-    asprintf(&cmdstr, cmdfmt, cur->uuid);
+
+    if (cur != NULL) {
+        uuid_format(cur->uuid, uuid);
+    }
+
+    asprintf(&cmdstr, cmdfmt, uuid);
     tnc_fprintf(logfp, LOG_DEBUG, "running command: %s", cmdstr);
 
     /* exit window */
     def_prog_mode();
     endwin();
 
-    /* run command */
+    /* run command, what it changes in the task data is reloaded by the caller */
     ret = system(cmdstr);
+    watch_ignore();
 
     /* log command return value */
     tnc_fprintf(logfp, LOG_DEBUG, "command returned: %d", WEXITSTATUS(ret));
@@ -720,6 +2173,11 @@ bool task_match(const struct task* cur, const char* str) { /* {{{ */
      *       refer to the manual for how conditions are specified
      * return is whether the task matches
      */
+    /* a search for +tag only matches tasks with exactly that tag */
+    if (str != NULL && str[0] == '+' && tag_literal(str + 1, strlen(str + 1))) {
+        return tag_test(cur, tag_id(str + 1, strlen(str + 1), false));
+    }
+
     if (match_string(cur->project, str) ||
         match_string(cur->description, str) ||
         match_string(cur->tags, str)) {
@@ -729,6 +2187,64 @@ bool task_match(const struct task* cur, const char* str) { /* {{{ */
     }
 } /* }}} */
 
+struct task* task_search(const struct task* pos, const char* str, bool* wrapped) { /* {{{ */
+    /**
+     * find the next task in the list matching a search
+     * pos     - the task to search after (NULL to search from the top)
+     * str     - the search, as matched by task_match
+     * wrapped - set to whether the search wrapped past the end of the list
+     * return is the task found, or NULL if no task matches
+     * pos itself is checked last, once the search has wrapped around to it
+     * only tasks the search index offers as candidates are checked
+     */
+    const struct task** candidates;
+    const int           start = pos != NULL ? pos->position : -1;
+    const int           count = tasktable_count();
+    int                 n;
+    int                 first;
+    int                 last;
+    int                 i;
+
+    *wrapped = false;
+
+    if (str == NULL || count == 0) {
+        return NULL;
+    }
+
+    n = searchindex_query(str, &candidates);
+
+    if (n < 0) {
+        for (i = 1; i <= count; i++) {
+            if (task_match(tasktable_get((start + i) % count), str)) {
+                *wrapped = start + i >= count;
+                return tasktable_get((start + i) % count);
+            }
+        }
+
+        return NULL;
+    }
+
+    /* candidates are in list order, so begin at the first one after pos */
+    for (first = 0, last = n; first < last;) {
+        i = first + (last - first) / 2;
+
+        if (candidates[i]->position <= start) {
+            first = i + 1;
+        } else {
+            last = i;
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        if (task_match(candidates[(first + i) % n], str)) {
+            *wrapped = first + i >= n;
+            return (struct task*)candidates[(first + i) % n];
+        }
+    }
+
+    return NULL;
+} /* }}} */
+
 void task_modify(const char* argstr) { /* {{{ */
     /* run a modify command on the selected task
      * argstr - the command to run on the selected task
@@ -736,7 +2252,6 @@ void task_modify(const char* argstr) { /* {{{ */
      */
     struct task*    cur;
     char*           cmd;
-    char*           uuid;
     int             arglen;
 
     if (argstr != NULL) {
@@ -754,19 +2269,108 @@ void task_modify(const char* argstr) { /* {{{ */
         strcat(cmd, argstr);
     }
 
-    task_background_command(cmd);
-
-    uuid = strdup(cur->uuid);
+    /* the task is reloaded once the modification has been made */
+    task_background_command(cmd, NULL);
     reload_task(cur);
 
-    if (cfg.follow_task) {
-        set_position_by_uuid(uuid);
-        tasklist_check_curs_pos();
+    free(cmd);
+} /* }}} */
+
+void view_add(struct task* this) { /* {{{ */
+    /* add a loaded task to the list, or leave it out if the filter does not match it */
+    if (view_shows(this)) {
+        insert_task(this);
+    } else {
+        view_hide(this);
     }
+} /* }}} */
 
-    check_free(uuid);
+void view_expand(void) { /* {{{ */
+    /* put the tasks the filter left out back on the list, in order
+     * the list may have been sorted again since they were left out
+     */
+    if (shown != NULL) {
+        filter_free(shown);
+        shown = NULL;
+    }
 
-    free(cmd);
+    if (hidden == NULL) {
+        return;
+    }
+
+    tasktable_unhide_all();
+    head = sort_merge_lists(head, sort_wrapper(hidden));
+    hidden = NULL;
+    tasktable_build(head);
+} /* }}} */
+
+void view_filter(void) { /* {{{ */
+    /* take the tasks the active filter does not match off the list
+     * this is only done while the list holds the tasks of a wider filter, see
+     * list_filter, they are kept to be shown again when the filter changes
+     * the filter is kept to check the tasks reloads add or replace
+     */
+    struct task*    cur;
+    struct task*    next;
+
+    view_expand();
+
+    if (str_eq(list_filter(), active_filter) || (shown = filter_compile(active_filter)) == NULL) {
+        return;
+    }
+
+    for (cur = head; cur != NULL; cur = next) {
+        next = cur->next;
+
+        if (!filter_match(shown, cur)) {
+            list_unlink(cur);
+            view_hide(cur);
+        }
+    }
+
+    tasktable_build(head);
+    tnc_fprintf(logfp, LOG_DEBUG, "filtered locally (%s): %d tasks shown",
+                active_filter, tasktable_count());
+} /* }}} */
+
+void view_hide(struct task* this) { /* {{{ */
+    /* leave a loaded task out of the list until the filter changes
+     * this - the task, which is not on the list
+     */
+    this->prev = NULL;
+    this->next = hidden;
+
+    if (hidden != NULL) {
+        hidden->prev = this;
+    }
+
+    hidden = this;
+
+    /* a task that cannot be found again needs the next reload to be a full one */
+    if (!tasktable_hide(this)) {
+        tnc_fprintf(logfp, LOG_ERROR, "could not index hidden task");
+        loaded_modified = 0;
+    }
+} /* }}} */
+
+bool view_shows(const struct task* this) { /* {{{ */
+    /* check whether the local filter, if any, keeps a task on the list */
+    return shown == NULL || filter_match(shown, this);
+} /* }}} */
+
+void view_unhide(struct task* this) { /* {{{ */
+    /* take a task off the tasks left out of the list, it is not put back on it */
+    if (this->prev != NULL) {
+        this->prev->next = this->next;
+    } else {
+        hidden = this->next;
+    }
+
+    if (this->next != NULL) {
+        this->next->prev = this->prev;
+    }
+
+    tasktable_unhide(this);
 } /* }}} */
 
 // vim: et ts=4 sw=4 sts=4
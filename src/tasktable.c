@@ -0,0 +1,488 @@
+/*
+ * tasktable.c - positional and uuid indexes on the task list
+ * for tasknc
+ * by mjheagle
+ */
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "colstats.h"
+#include "common.h"
+#include "groups.h"
+#include "log.h"
+#include "searchindex.h"
+#include "sort.h"
+#include "tasktable.h"
+
+/* local functions */
+static bool index_delete(struct task_table* index, const struct task* this);
+static struct task* index_find(const struct task_table* index, const unsigned char* uuid);
+static bool index_grow(struct task_table* index);
+static void index_insert(struct task_table* index, struct task* this);
+static bool index_resize(struct task_table* index, const size_t nslots);
+static size_t uuid_hash(const unsigned char* uuid);
+
+/* the table for the task list displayed */
+static struct task_table table = {NULL, 0, 0, NULL, 0, 0};
+
+/* the uuid index of loaded tasks a filter leaves out of the table
+ * only its slots, nslots and count are used
+ */
+static struct task_table hidden = {NULL, 0, 0, NULL, 0, 0};
+
+bool index_delete(struct task_table* index, const struct task* this) { /* {{{ */
+    /**
+     * remove a task from a uuid index
+     * later entries of the probe sequence are shifted back so no
+     * tombstones are needed
+     * index  - the index to remove the task from
+     * this   - the task to remove
+     * return is whether the task was in the index
+     */
+    const size_t    mask = index->nslots - 1;
+    size_t          hole;
+    size_t          i;
+    size_t          home;
+
+    if (index->nslots == 0) {
+        return false;
+    }
+
+    for (hole = uuid_hash(this->uuid) & mask; index->slots[hole] != NULL;
+         hole = (hole + 1) & mask) {
+        if (index->slots[hole] == this) {
+            break;
+        }
+    }
+
+    if (index->slots[hole] == NULL) {
+        return false;
+    }
+
+    index->slots[hole] = NULL;
+
+    for (i = (hole + 1) & mask; index->slots[i] != NULL; i = (i + 1) & mask) {
+        home = uuid_hash(index->slots[i]->uuid) & mask;
+
+        /* move the entry if the hole lies between its home slot and it */
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            index->slots[hole] = index->slots[i];
+            index->slots[i] = NULL;
+            hole = i;
+        }
+    }
+
+    return true;
+} /* }}} */
+
+struct task* index_find(const struct task_table* index, const unsigned char* uuid) { /* {{{ */
+    /**
+     * look up a task in a uuid index
+     * index  - the index to search
+     * uuid   - the uuid to find, in binary
+     * return is the task, or NULL if it is not in the index
+     */
+    const size_t    mask = index->nslots - 1;
+    size_t          i;
+
+    if (uuid == NULL || index->nslots == 0) {
+        return NULL;
+    }
+
+    for (i = uuid_hash(uuid) & mask; index->slots[i] != NULL; i = (i + 1) & mask) {
+        if (memcmp(index->slots[i]->uuid, uuid, UUIDBYTES) == 0) {
+            return index->slots[i];
+        }
+    }
+
+    return NULL;
+} /* }}} */
+
+bool index_grow(struct task_table* index) { /* {{{ */
+    /**
+     * double the size of a uuid index, keeping the tasks in it
+     * index  - the index to grow
+     * return is whether the index could be allocated, it is unchanged if not
+     */
+    const size_t    oldslots = index->nslots;
+    const size_t    nslots = oldslots > 0 ? 2 * oldslots : 16;
+    struct task**   old = index->slots;
+    struct task**   slots = calloc(nslots, sizeof(struct task*));
+    size_t          i;
+
+    if (slots == NULL) {
+        tnc_fprintf(logfp, LOG_ERROR, "could not allocate uuid index (%d tasks)", index->count);
+        return false;
+    }
+
+    index->slots = slots;
+    index->nslots = nslots;
+
+    for (i = 0; i < oldslots; i++) {
+        if (old[i] != NULL) {
+            index_insert(index, old[i]);
+        }
+    }
+
+    free(old);
+
+    return true;
+} /* }}} */
+
+void index_insert(struct task_table* index, struct task* this) { /* {{{ */
+    /* add a task to a uuid index (which must have room) */
+    const size_t    mask = index->nslots - 1;
+    size_t          i;
+
+    for (i = uuid_hash(this->uuid) & mask; index->slots[i] != NULL; i = (i + 1) & mask);
+
+    index->slots[i] = this;
+} /* }}} */
+
+bool index_resize(struct task_table* index, const size_t nslots) { /* {{{ */
+    /**
+     * reallocate a uuid index, it is left empty
+     * index  - the index to reallocate
+     * nslots - the number of slots needed, a power of two
+     * return is whether the index could be allocated
+     */
+    if (nslots != index->nslots) {
+        free(index->slots);
+        index->slots = malloc(nslots * sizeof(struct task*));
+
+        if (index->slots == NULL) {
+            index->nslots = 0;
+            return false;
+        }
+
+        index->nslots = nslots;
+    }
+
+    memset(index->slots, 0, nslots * sizeof(struct task*));
+
+    return true;
+} /* }}} */
+
+void tasktable_build(struct task* first) { /* {{{ */
+    /**
+     * index a task list, replacing whatever was indexed before
+     * this must be run whenever tasks are added to the list, unless each
+     * one is added with tasktable_insert
+     * first - the head of the task list
+     */
+    struct task*    cur;
+    size_t          nslots = 16;
+    int             n = 0;
+
+    for (cur = first; cur != NULL; cur = cur->next) {
+        n++;
+    }
+
+    /* the search index and the groups are built again when they are next used */
+    searchindex_clear();
+    colstats_clear();
+    groups_reset();
+
+    /* grow the position array */
+    if (n > table.capacity) {
+        table.capacity = n + n / 2;
+        free(table.tasks);
+        table.tasks = malloc(table.capacity * sizeof(struct task*));
+
+        if (table.tasks == NULL) {
+            tnc_fprintf(logfp, LOG_ERROR, "could not allocate task table (%d tasks)", n);
+            table.capacity = 0;
+            table.count = 0;
+            return;
+        }
+    }
+
+    /* keep the uuid index at most half full */
+    while (nslots < 2 * (size_t)n) {
+        nslots *= 2;
+    }
+
+    if (!index_resize(&table, nslots)) {
+        tnc_fprintf(logfp, LOG_ERROR, "could not allocate uuid index (%d tasks)", n);
+    }
+
+    table.count = 0;
+    table.changed = 0;
+
+    for (cur = first; cur != NULL; cur = cur->next) {
+        cur->position = table.count;
+        table.tasks[table.count++] = cur;
+        colstats_add(cur);
+
+        if (table.nslots > 0) {
+            index_insert(&table, cur);
+        }
+    }
+
+    tnc_fprintf(logfp, LOG_DEBUG_VERBOSE, "task table: %d tasks, %zu slots",
+                table.count, table.nslots);
+} /* }}} */
+
+int tasktable_changed(void) { /* {{{ */
+    /**
+     * find the first position changed since this was last called
+     * the tasks after it may have moved too
+     * return is the position, or INT_MAX if no task changed
+     */
+    const int ret = table.changed;
+
+    table.changed = INT_MAX;
+
+    return ret;
+} /* }}} */
+
+void tasktable_clear(void) { /* {{{ */
+    /* release the table's memory */
+    searchindex_clear();
+    colstats_clear();
+    groups_clear();
+    free(table.tasks);
+    free(table.slots);
+    free(hidden.slots);
+    table.tasks = NULL;
+    table.slots = NULL;
+    hidden.slots = NULL;
+    hidden.nslots = 0;
+    hidden.count = 0;
+    table.count = 0;
+    table.capacity = 0;
+    table.nslots = 0;
+    table.changed = 0;
+} /* }}} */
+
+int tasktable_count(void) { /* {{{ */
+    /* get the number of tasks in the table */
+    return table.count;
+} /* }}} */
+
+struct task* tasktable_find(const unsigned char* uuid) { /* {{{ */
+    /**
+     * look up a task by its uuid
+     * uuid - the uuid to find, in binary
+     * return is the task, or NULL if it is not in the table
+     */
+    return index_find(&table, uuid);
+} /* }}} */
+
+struct task* tasktable_find_hidden(const unsigned char* uuid) { /* {{{ */
+    /**
+     * look up a task left out of the table by its uuid
+     * uuid - the uuid to find, in binary
+     * return is the task, or NULL if it is not hidden
+     */
+    return index_find(&hidden, uuid);
+} /* }}} */
+
+struct task* tasktable_get(const int position) { /* {{{ */
+    /* get the task at a display position, or NULL if it is out of range */
+    if (position < 0 || position >= table.count) {
+        return NULL;
+    }
+
+    return table.tasks[position];
+} /* }}} */
+
+bool tasktable_hide(struct task* this) { /* {{{ */
+    /**
+     * note a loaded task that a filter leaves out of the table
+     * it is found by tasktable_find_hidden until it is unhidden
+     * this - the task left out, which must not be in the table
+     * return is whether there was memory to index it
+     */
+    this->position = -1;
+
+    /* keep the index at most half full */
+    if (2 * (size_t)(hidden.count + 1) > hidden.nslots && !index_grow(&hidden)) {
+        return false;
+    }
+
+    index_insert(&hidden, this);
+    hidden.count++;
+
+    return true;
+} /* }}} */
+
+bool tasktable_insert(struct task* this) { /* {{{ */
+    /**
+     * add a single task to the table, in its place in the active sort mode
+     * it goes after the tasks it ties with, tasks after it move down one position
+     * this   - the task to add, it is not linked into the task list
+     * return is whether there was memory to add it, the table is unchanged if not
+     */
+    struct task**   tasks;
+    int             lo = 0;
+    int             hi = table.count;
+    int             mid;
+    int             i;
+
+    if (table.count == table.capacity) {
+        tasks = realloc(table.tasks, (table.capacity + table.capacity / 2 + 16) *
+                        sizeof(struct task*));
+
+        if (tasks == NULL) {
+            tnc_fprintf(logfp, LOG_ERROR, "could not allocate task table (%d tasks)",
+                        table.count + 1);
+            return false;
+        }
+
+        table.tasks = tasks;
+        table.capacity += table.capacity / 2 + 16;
+    }
+
+    /* keep the uuid index at most half full */
+    if (2 * (size_t)(table.count + 1) > table.nslots && !index_grow(&table)) {
+        return false;
+    }
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+
+        if (sort_compare(table.tasks[mid], this) <= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    memmove(table.tasks + lo + 1, table.tasks + lo, (table.count - lo) * sizeof(struct task*));
+    table.tasks[lo] = this;
+    table.count++;
+
+    for (i = lo; i < table.count; i++) {
+        table.tasks[i]->position = i;
+    }
+
+    if (lo < table.changed) {
+        table.changed = lo;
+    }
+
+    index_insert(&table, this);
+    searchindex_add(this);
+    colstats_add(this);
+    groups_add(this);
+
+    return true;
+} /* }}} */
+
+void tasktable_remove(struct task* this) { /* {{{ */
+    /**
+     * remove a single task from the table
+     * tasks after it move up one position
+     * this - the task to remove
+     */
+    int i;
+
+    if (this->position < 0 || this->position >= table.count ||
+        table.tasks[this->position] != this) {
+        return;
+    }
+
+    index_delete(&table, this);
+    searchindex_remove(this);
+    colstats_remove(this);
+    groups_remove(this);
+    table.count--;
+
+    if (this->position < table.changed) {
+        table.changed = this->position;
+    }
+
+    for (i = this->position; i < table.count; i++) {
+        table.tasks[i] = table.tasks[i + 1];
+        table.tasks[i]->position = i;
+    }
+
+    this->position = -1;
+} /* }}} */
+
+void tasktable_reorder(struct task* first) { /* {{{ */
+    /**
+     * update positions after the task list has been re-sorted
+     * the list must hold the same tasks that were indexed
+     * first - the head of the task list
+     */
+    struct task*    cur;
+    int             n = 0;
+
+    for (cur = first; cur != NULL && n < table.count; cur = cur->next) {
+        cur->position = n;
+        table.tasks[n++] = cur;
+    }
+
+    table.changed = 0;
+    searchindex_reorder();
+    groups_reorder();
+
+    if (cur != NULL || n != table.count) {
+        tnc_fprintf(logfp, LOG_ERROR, "task table out of date, rebuilding");
+        tasktable_build(first);
+    }
+} /* }}} */
+
+void tasktable_replace(struct task* old, struct task* new) { /* {{{ */
+    /**
+     * put a task in the slot held by another task
+     * old - the task being replaced
+     * new - the task taking its position
+     */
+    if (old->position < 0 || old->position >= table.count ||
+        table.tasks[old->position] != old) {
+        return;
+    }
+
+    index_delete(&table, old);
+    searchindex_remove(old);
+    searchindex_add(new);
+    colstats_remove(old);
+    colstats_add(new);
+    groups_replace(old, new);
+    new->position = old->position;
+
+    if (new->position < table.changed) {
+        table.changed = new->position;
+    }
+
+    table.tasks[new->position] = new;
+    old->position = -1;
+
+    if (table.nslots > 0) {
+        index_insert(&table, new);
+    }
+} /* }}} */
+
+void tasktable_unhide(const struct task* this) { /* {{{ */
+    /* forget a task left out of the table, once it is shown or dropped */
+    if (index_delete(&hidden, this)) {
+        hidden.count--;
+    }
+} /* }}} */
+
+void tasktable_unhide_all(void) { /* {{{ */
+    /* forget every task left out of the table */
+    if (hidden.nslots > 0) {
+        memset(hidden.slots, 0, hidden.nslots * sizeof(struct task*));
+    }
+
+    hidden.count = 0;
+} /* }}} */
+
+size_t uuid_hash(const unsigned char* uuid) { /* {{{ */
+    /* fnv-1a hash of a binary uuid */
+    size_t  hash = 2166136261u;
+    int     i;
+
+    for (i = 0; i < UUIDBYTES; i++) {
+        hash ^= uuid[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+} /* }}} */
+
+// vim: et ts=4 sw=4 sts=4
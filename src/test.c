@@ -6,27 +6,96 @@
 
 #define _GNU_SOURCE
 #include <curses.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "arena.h"
+#include "bench.h"
+#include "colstats.h"
 #include "command.h"
 #include "common.h"
 #include "config.h"
+#include "filter.h"
 #include "formats.h"
+#include "groups.h"
+#include "infocache.h"
+#include "jobs.h"
+#include "json.h"
+#include "keys.h"
 #include "log.h"
+#include "pager.h"
+#include "searchindex.h"
+#include "snapshot.h"
+#include "sort.h"
+#include "tags.h"
+#include "taskdata.h"
 #include "tasks.h"
+#include "tasktable.h"
 #include "tasknc.h"
 #include "test.h"
+#include "timing.h"
+#include "watch.h"
 
 #ifdef TASKNC_INCLUDE_TESTS
+/**
+ * test fields struct - the fields of a task made by test_list
+ * project     - the task's project (NULL for none)
+ * description - the task's description (NULL for none)
+ * tags        - the task's tags, as exported (NULL for none)
+ * priority    - the task's priority (0 for none)
+ */
+struct test_fields {
+    const char* project;
+    const char* description;
+    const char* tags;
+    char priority;
+};
+
 /* local functions {{{ */
+static void test_batch_done(const struct job* job);
+void test_batch(void);
+void test_casefind(void);
+void test_colstats(void);
 void test_compile_fmt(void);
+void test_dispatch(void);
+static void test_dispatch_key(const char* arg);
+void test_filter(void);
+void test_groups(void);
+void test_infocache(void);
+static void test_job_done(const struct job* job);
+void test_jobs(void);
+static struct task* test_list(struct arena* arena, const struct test_fields* fields,
+                              const int ntasks, struct task** tasks);
+static void test_list_free(struct arena* arena);
+void test_log(void);
+void test_match_string(void);
+void test_parse_task(void);
+void test_parse_threads(void);
+void test_reload(void);
+void test_render(void);
 void test_result(const char* testname, const bool passed);
 void test_search(void);
+static bool test_same_string(const char* a, const char* b);
 void test_set_var(void);
+void test_snapshot(void);
+void test_sort(void);
+static int test_sort_priority(const char pri);
+void test_tagset(void);
 void test_task_count(void);
+void test_task_table(void);
+void test_taskdata(void);
+void test_timestamp(void);
+void test_timing(void);
+void test_trigram(void);
 void test_trim(void);
+void test_watch(void);
+static void test_watch_write(const char* dir, const char* name);
 /* }}} */
 
 FILE* devnull;
@@ -39,11 +108,34 @@ void test(const char* args) { /* {{{ */
         void (*function)();
     };
     struct test tests[] = {
+        {"batch", test_batch},
+        {"casefind", test_casefind},
+        {"colstats", test_colstats},
         {"compile_fmt", test_compile_fmt},
+        {"dispatch", test_dispatch},
+        {"filter", test_filter},
+        {"groups", test_groups},
+        {"infocache", test_infocache},
+        {"jobs", test_jobs},
+        {"log", test_log},
+        {"match_string", test_match_string},
+        {"parse_task", test_parse_task},
+        {"parse_threads", test_parse_threads},
+        {"reload", test_reload},
+        {"render", test_render},
         {"task_count", test_task_count},
+        {"task_table", test_task_table},
+        {"taskdata", test_taskdata},
+        {"timestamp", test_timestamp},
+        {"timing", test_timing},
+        {"trigram", test_trigram},
         {"trim", test_trim},
         {"search", test_search},
         {"set_var", test_set_var},
+        {"snapshot", test_snapshot},
+        {"sort", test_sort},
+        {"tagset", test_tagset},
+        {"watch", test_watch},
     };
     const int ntests = sizeof(tests) / sizeof(struct test);
     int i;
@@ -52,6 +144,11 @@ void test(const char* args) { /* {{{ */
     devnull = fopen("/dev/null", "w");
     out = stdout;
 
+    /* benchmarks only run when asked for, they are not part of all */
+    if (strstr(args, "bench") != NULL) {
+        bench(args);
+    }
+
     /* determine which tests to run */
     if (str_eq(args, "all")) {
         for (i = 0; i < ntests; i++) {
@@ -70,6 +167,166 @@ void test(const char* args) { /* {{{ */
     cleanup();
 } /* }}} */
 
+/* uuids reported by the batch command run by test_batch */
+static char* test_batch_output = NULL;
+static int test_batch_jobs = 0;
+
+void test_batch_done(const struct job* job) { /* {{{ */
+    /* record the output of a batch and the number of tasks in it */
+    test_batch_jobs++;
+
+    if (job->ret == 0 && *(const int*)job->data == 3 && job->output != NULL) {
+        test_batch_output = strdup(job->output);
+    }
+} /* }}} */
+
+void test_batch(void) { /* {{{ */
+    /* test that the marked tasks are passed to a single command
+     * the batch lists the uuids it was given, so no task is changed
+     */
+    struct task*    marked[3];
+    struct task*    cur;
+    char            uuid[UUIDLENGTH];
+    bool            pass;
+    int             n = 0;
+    int             i;
+
+    for (cur = head; cur != NULL && n < 3; cur = cur->next, n++) {
+        marked[n] = cur;
+        cur->marked = true;
+    }
+
+    if (n < 3) {
+        test_result("batch", false);
+        puts("batch: fewer than 3 tasks");
+        return;
+    }
+
+    pass = task_batch_command("_uuids", test_batch_done) == 3;
+    jobs_wait();
+    pass = pass && test_batch_jobs == 1 && test_batch_output != NULL;
+
+    for (i = 0; i < 3; i++) {
+        pass = pass && strstr(test_batch_output, uuid_format(marked[i]->uuid, uuid)) != NULL;
+        marked[i]->marked = false;
+    }
+
+    test_result("batch", pass);
+    check_free(test_batch_output);
+    test_batch_output = NULL;
+} /* }}} */
+
+void test_casefind(void) { /* {{{ */
+    /* test that plain words are found as the regex for them would find them,
+     * wherever they fall in haystacks shorter and longer than a vector
+     */
+    const char*     needles[] = {"b", "Ab", "abc", "plumber", "ABCDEFGHIJKLMNOPQRSTU", "a b"};
+    const int       nneedles = sizeof(needles) / sizeof(char*);
+    char            haystack[64];
+    const regex_t*  regex;
+    bool            pass;
+    bool            found;
+    int             length;
+    int             at;
+    int             n;
+
+    pass = pattern_literal("plain words, 2-3") && !pattern_literal("^task") &&
+           !pattern_literal("a.b") && !pattern_literal("a\\b") &&
+           !pattern_literal("caf\xc3\xa9") && str_casefind("tasknc", "", 0) &&
+           str_casefind("TaskNC", "kn", 2) && !str_casefind("tas", "task", 4) &&
+           !str_casefind("\xc3\xa9", "\xc3\x89", 2);
+
+    for (n = 0; n < nneedles && pass; n++) {
+        for (length = 0; length < 48 && pass; length++) {
+            for (at = -1; at < length && pass; at++) {
+                /* letters off by case, and bytes that fold to them if done wrong */
+                memset(haystack, at % 2 == 0 ? 'a' : '\xc1', length);
+                haystack[length] = 0;
+
+                if (at >= 0 && at + (int)strlen(needles[n]) <= length) {
+                    memcpy(haystack + at, needles[n], strlen(needles[n]));
+                    haystack[at] ^= 'a' - 'A';
+                }
+
+                found = str_casefind(haystack, needles[n], strlen(needles[n]));
+                regex = regex_cached(needles[n], REGEX_OPTS);
+                pass = regex != NULL && found == (regexec(regex, haystack, 0, 0, 0) != REG_NOMATCH) &&
+                       found == match_string(haystack, needles[n]);
+            }
+        }
+    }
+
+    if (!pass) {
+        printf("needle: %s, haystack: %s\n", needles[n - 1], haystack);
+    }
+
+    test_result("casefind", pass);
+} /* }}} */
+
+void test_colstats(void) { /* {{{ */
+    /* check that column widths follow the task table, and that descriptions
+     * are printed at the widest one while it fits
+     */
+    const struct test_fields fields[] = {
+        {"home", "task", NULL, 0},
+        {"Caf\xc3\xa9", "a task", NULL, 0},
+        {"a.very.long", "task", NULL, 0},
+        {"home", "task", NULL, 0},
+        {NULL, "task", NULL, 0},
+    };
+    const int           ntasks = sizeof(fields) / sizeof(struct test_fields);
+    const int           cafe = MB_CUR_MAX > 1 ? 4 : 5;
+    const int           oldcols = cols;
+    const int           oldproject = cfg.fieldlengths.project;
+    const int           olddate = cfg.fieldlengths.date;
+    const int           olddescription = cfg.fieldlengths.description;
+    struct arena*       arena = arena_create(4096);
+    struct fmt_field*   fmts = compile_format_string("$description|");
+    struct task*        tasks[ntasks];
+    struct task*        replacement;
+    char*               line;
+    bool                pass;
+
+    test_list(arena, fields, ntasks, tasks);
+    pass = colstats_max(COLUMN_PROJECT) == 11 && colstats_max(COLUMN_DESCRIPTION) == 6;
+
+    /* removing the widest project must find the next widest */
+    tasktable_remove(tasks[2]);
+    pass = pass && colstats_max(COLUMN_PROJECT) == cafe;
+
+    replacement = malloc_task(arena);
+    replacement->project = arena_strdup(arena, "tasknc");
+    replacement->description = arena_strdup(arena, "another task");
+    tasktable_replace(tasks[0], replacement);
+    pass = pass && colstats_max(COLUMN_PROJECT) == 6 && colstats_max(COLUMN_DESCRIPTION) == 12;
+
+    /* short descriptions are padded to the widest */
+    cols = 80;
+    cfg.fieldlengths.project = max_project_length();
+    cfg.fieldlengths.date = DATELENGTH;
+    cfg.fieldlengths.description = max_description_length();
+    line = eval_format(fmts, tasks[3]);
+    pass = pass && cfg.fieldlengths.description == 12 && line != NULL &&
+           str_eq(line, "task        |");
+    check_free(line);
+
+    /* and cut where they would run into the date */
+    cols = 6 + 1 + DATELENGTH + 8;
+    cfg.fieldlengths.description = max_description_length();
+    line = eval_format(fmts, replacement);
+    pass = pass && cfg.fieldlengths.description == 8 && line != NULL &&
+           str_eq(line, "another |");
+    check_free(line);
+
+    test_result("colstats", pass);
+
+    cols = oldcols;
+    cfg.fieldlengths.project = oldproject;
+    cfg.fieldlengths.date = olddate;
+    cfg.fieldlengths.description = olddescription;
+    test_list_free(arena);
+} /* }}} */
+
 void test_compile_fmt() { /* {{{ */
     /* test compiling a format to a series of fields */
     struct fmt_field*   fmts;
@@ -97,6 +354,692 @@ void test_compile_fmt() { /* {{{ */
     }
 } /* }}} */
 
+/* the sum of the arguments of the binds run by test_dispatch */
+static int test_dispatch_calls = 0;
+
+void test_dispatch(void) { /* {{{ */
+    /* check that functions, variables and keys are found through their
+     * tables as they were found by walking the lists, and that a sourced file
+     * is only read again once it has changed
+     */
+    extern struct var   vars[];
+    const char*         path = "/tmp/.tasknc_test_source";
+    const int           oldtimeout = cfg.statusbar_timeout;
+    struct funcmap*     fmap;
+    struct timespec     times[2];
+    struct stat         st;
+    FILE*               fp;
+    bool                pass;
+    int                 i;
+
+    /* functions sharing a name are told apart by mode */
+    pass = (fmap = find_function("quit", MODE_PAGER)) != NULL &&
+           fmap->function == (void*)key_pager_close &&
+           (fmap = find_function("quit", MODE_TASKLIST)) != NULL &&
+           fmap->function == (void*)key_done && find_function("stats", MODE_PAGER) != NULL &&
+           find_function("nothing", MODE_ANY) == NULL && find_var("nothing") == NULL;
+
+    for (i = 0; vars[i].name != NULL && pass; i++) {
+        pass = find_var(vars[i].name) == &(vars[i]);
+    }
+
+    /* the first bind of a key in the mode runs, past the table or not */
+    test_dispatch_calls = 0;
+    add_keybind(KEY_F(5), test_dispatch_key, "1", MODE_ANY);
+    add_keybind(KEY_F(5), test_dispatch_key, "10", MODE_PAGER);
+    add_keybind(KEY_MAX + 5, test_dispatch_key, "100", MODE_TASKLIST);
+    handle_keypress(KEY_F(5), MODE_TASKLIST);
+    handle_keypress(KEY_F(5), MODE_PAGER);
+    handle_keypress(KEY_MAX + 5, MODE_TASKLIST);
+    remove_keybinds(KEY_F(5), MODE_ANY);
+    handle_keypress(KEY_F(5), MODE_PAGER);
+    remove_keybinds(KEY_F(5), MODE_PAGER);
+    remove_keybinds(KEY_MAX + 5, MODE_TASKLIST);
+#ifdef ENABLE_MACROS
+    pass = pass && test_dispatch_calls == 122;
+#else
+    pass = pass && test_dispatch_calls == 112;
+#endif
+
+    /* a file changed without its size or time changing is not read again */
+    fp = fopen(path, "w");
+
+    if (fp == NULL) {
+        test_result("dispatch", false);
+        return;
+    }
+
+    fputs("set statusbar_timeout 7\n", fp);
+    fclose(fp);
+    run_command_source(path);
+    pass = pass && cfg.statusbar_timeout == 7 && stat(path, &st) == 0;
+
+    fp = fopen(path, "w");
+    fputs("set statusbar_timeout 8\n", fp);
+    fclose(fp);
+    times[0] = st.st_atim;
+    times[1] = st.st_mtim;
+    utimensat(AT_FDCWD, path, times, 0);
+    run_command_source(path);
+    pass = pass && cfg.statusbar_timeout == 7;
+
+    times[1].tv_sec++;
+    utimensat(AT_FDCWD, path, times, 0);
+    run_command_source(path);
+    pass = pass && cfg.statusbar_timeout == 8;
+
+    test_result("dispatch", pass);
+
+    cfg.statusbar_timeout = oldtimeout;
+    unlink(path);
+} /* }}} */
+
+void test_dispatch_key(const char* arg) { /* {{{ */
+    /* count a bind run by test_dispatch */
+    test_dispatch_calls += atoi(arg);
+} /* }}} */
+
+void test_filter(void) { /* {{{ */
+    /* test that filters compiled locally select the tasks task would, and
+     * that filters only run locally on tasks loaded with a wider filter
+     */
+    const char*         projects[] = {"home", "home.garden", "homework", NULL};
+    const char*         tags[] = {"\"next\"", "\"work\",\"next\"", "\"homework\"", "\"nextweek\""};
+    const char*         statuses[] = {"pending", "completed", "pending", "waiting"};
+    const char          priorities[] = {'H', 0, 'L', 'H'};
+    const char*         unsupported[] = {"some words", "+PENDING", "project:'a b'",
+                                         "due:tomorrow", "+a xor +b", "(project:a",
+                                         "project:a)", "pri:X", "status:done", "or +a"
+                                        };
+    struct arena*       arena = arena_create(4096);
+    struct filter*      filter;
+    struct tm           due;
+    struct task         tasks[4];
+    struct uda          udas[4];
+    bool                pass = true;
+    int                 i;
+
+    /* the expected matches of each filter, one bit per task */
+    const struct {
+        const char* str;
+        int matches;
+    } filters[] = {
+        {"", 0xf},
+        {"project:home", 0x3},
+        {"pro:", 0x8},
+        {"+next", 0x3},
+        {"-next", 0xc},
+        {"+work", 0x2},
+        {"priority:H", 0x9},
+        {"pri:", 0x2},
+        {"status:pending", 0x5},
+        {"due.before:2012-01-02", 0x1},
+        {"due.after:20120101", 0x3},
+        {"due.after:2012-01-02T00:00", 0x2},
+        {"status:pending +next or priority:H", 0x9},
+        {"status:pending \\( +next or priority:L \\)", 0x5},
+        {"(project:home and -next) or (status:waiting pri:H)", 0x8},
+    };
+    const int           nfilters = sizeof(filters) / sizeof(filters[0]);
+
+    memset(tasks, 0, sizeof(tasks));
+    memset(udas, 0, sizeof(udas));
+    memset(&due, 0, sizeof(due));
+
+    for (i = 0; i < 4; i++) {
+        tasks[i].project = (char*)projects[i];
+        tasks[i].tags = (char*)tags[i];
+        tasks[i].arena = arena;
+        tags_index(&(tasks[i]));
+        tasks[i].priority = priorities[i];
+        udas[i].name = "status";
+        udas[i].value = (char*)statuses[i];
+        tasks[i].udas = &(udas[i]);
+    }
+
+    /* noon on the first of january and of march 2012, local time */
+    due.tm_year = 112;
+    due.tm_mday = 1;
+    due.tm_hour = 12;
+    due.tm_isdst = -1;
+    tasks[0].due = mktime(&due);
+    due.tm_mon = 2;
+    due.tm_isdst = -1;
+    tasks[1].due = mktime(&due);
+
+    for (i = 0; i < nfilters && pass; i++) {
+        filter = filter_compile(filters[i].str);
+        pass = filter != NULL && filter_match(filter, &(tasks[0])) == (filters[i].matches & 1) &&
+               filter_match(filter, &(tasks[1])) == ((filters[i].matches & 2) != 0) &&
+               filter_match(filter, &(tasks[2])) == ((filters[i].matches & 4) != 0) &&
+               filter_match(filter, &(tasks[3])) == ((filters[i].matches & 8) != 0);
+        filter_free(filter);
+
+        if (!pass) {
+            printf("filter %s\n", filters[i].str);
+        }
+    }
+
+    for (i = 0; i < (int)(sizeof(unsupported) / sizeof(char*)) && pass; i++) {
+        filter = filter_compile(unsupported[i]);
+        pass = filter == NULL;
+        filter_free(filter);
+
+        if (!pass) {
+            printf("filter %s should not compile\n", unsupported[i]);
+        }
+    }
+
+    pass = pass && filter_covers("status:pending", "status:pending project:home") &&
+           filter_covers("status:pending +a", "+a and project:b status:pending") &&
+           filter_covers("", "project:home") &&
+           filter_covers("status:pending (+a or +b)", "(+a or +b) status:pending") &&
+           !filter_covers("status:pending", "project:home") &&
+           !filter_covers("status:pending", "status:pending project:a or +b") &&
+           !filter_covers("status:pending project:home", "status:pending");
+    test_result("filter", pass);
+
+    arena_free(arena);
+} /* }}} */
+
+/* results recorded by test_job_done, in the order the jobs finished */
+static char test_job_results[64];
+
+void test_groups(void) { /* {{{ */
+    /* check the grouped list's rows as groups are expanded and tasks change */
+    const struct test_fields fields[] = {
+        {"b", NULL, NULL, 'L'},
+        {NULL, NULL, NULL, 'H'},
+        {"a", NULL, NULL, 'M'},
+        {"b", NULL, NULL, 'H'},
+        {"a", NULL, NULL, 0},
+        {"a", NULL, NULL, 'H'},
+    };
+    const int       ntasks = sizeof(fields) / sizeof(struct test_fields);
+    char*           oldmode = cfg.sortmode;
+    struct arena*   arena = arena_create(4096);
+    struct task*    tasks[ntasks];
+    struct task*    first;
+    struct task*    replacement;
+    bool            pass;
+
+    /* every group starts collapsed, the tasks without a project first */
+    cfg.sortmode = "r";
+    cfg.group_view = 1;
+    first = sort_wrapper(test_list(arena, fields, ntasks, tasks));
+    tasktable_build(first);
+    pass = groups_active() && groups_count() == 3 && groups_get(1) == NULL &&
+           groups_header(0)->project == NULL && group_count == 1 &&
+           str_eq(groups_header(1)->project, "a") && group_count == 3 &&
+           str_eq(group_marker, "+") && groups_header(3) == NULL;
+
+    /* expanding a group lays out only its tasks, in sort order */
+    pass = pass && groups_toggle(2) == 2 && groups_count() == 5 &&
+           groups_get(3) == tasks[3] && groups_get(4) == tasks[0] &&
+           groups_header(2) != NULL && str_eq(group_marker, "-");
+
+    /* finding a task expands its group */
+    pass = pass && groups_position(tasks[4]) == 4 && groups_count() == 8 &&
+           groups_get(2) == tasks[5] && groups_get(3) == tasks[2] &&
+           str_eq(groups_header(5)->project, "b");
+
+    /* a group goes once its last task does, and one is made for a new project */
+    tasktable_remove(tasks[1]);
+    replacement = malloc_task(arena);
+    replacement->project = arena_strdup(arena, "c");
+    tasktable_replace(tasks[5], replacement);
+    pass = pass && groups_count() == 7 && str_eq(groups_header(0)->project, "a") &&
+           group_count == 2 && str_eq(groups_header(6)->project, "c") && group_count == 1;
+
+    /* the project key of the sort mode orders the groups */
+    cfg.sortmode = "Pr";
+    groups_reorder();
+    pass = pass && str_eq(groups_header(0)->project, "c") &&
+           str_eq(groups_header(1)->project, "b") && groups_get(6) == tasks[4];
+
+    cfg.group_view = 0;
+    pass = pass && !groups_active();
+    test_result("groups", pass);
+
+    cfg.sortmode = oldmode;
+    test_list_free(arena);
+} /* }}} */
+
+void test_infocache(void) { /* {{{ */
+    /* test that task info is found for the task as it was printed, at the
+     * width it was printed at, until the task changes or is reloaded
+     */
+    const struct test_fields fields[] = {{NULL, NULL, NULL, 0}, {NULL, NULL, NULL, 0}};
+    struct arena*       arena = arena_create(4096);
+    struct task*        tasks[2];
+    struct info         request;
+    const struct info*  found;
+    bool                pass;
+
+    test_list(arena, fields, 2, tasks);
+
+    infocache_request(tasks[0], 80, &request);
+    infocache_store(&request, strdup("info 0\n"), 7);
+    found = infocache_find(tasks[0], 80);
+    pass = found != NULL && found->length == 7 && str_eq(found->output, "info 0\n") &&
+           infocache_find(tasks[0], 60) == NULL && infocache_find(tasks[1], 80) == NULL;
+
+    /* info printed before a change is not kept, nor found once it changes */
+    infocache_request(tasks[1], 80, &request);
+    tasks[1]->modified++;
+    infocache_store(&request, strdup("info 1\n"), 7);
+    tasks[0]->modified++;
+    pass = pass && infocache_find(tasks[1], 80) == NULL && infocache_find(tasks[0], 80) == NULL;
+
+    /* a reloaded task's info is forgotten */
+    infocache_request(tasks[0], 80, &request);
+    infocache_store(&request, strdup("info 0\n"), 7);
+    pass = pass && infocache_find(tasks[0], 80) != NULL;
+    infocache_forget(tasks[0]->uuid);
+    pass = pass && infocache_find(tasks[0], 80) == NULL;
+    test_result("infocache", pass);
+
+    infocache_clear();
+    test_list_free(arena);
+} /* }}} */
+
+void test_job_done(const struct job* job) { /* {{{ */
+    /* record a job's tag (its data), return and first character of output */
+    char result[16];
+
+    snprintf(result, sizeof(result), "%s%d%c ", (const char*)job->data, job->ret,
+             job->length > 0 ? job->output[0] : '-');
+    strcat(test_job_results, result);
+
+    /* a job queued by a callback runs after those already queued */
+    if (str_eq(job->data, "a")) {
+        jobs_submit("echo d", test_job_done, strdup("d"));
+    }
+
+    /* a callback can wait for the jobs queued behind it */
+    if (str_eq(job->data, "w")) {
+        jobs_wait();
+    }
+} /* }}} */
+
+void test_jobs(void) { /* {{{ */
+    /* test that background commands run in order and report their results,
+     * that a prefetched command is only taken over by the same command,
+     * that commands no longer wanted still run to the end, and that a
+     * callback can wait for the commands queued after its own
+     */
+    const char* runs = "/tmp/.tasknc_test_prefetch";
+    const char* cmdstr = "echo p >> /tmp/.tasknc_test_prefetch; echo p";
+    struct stat st;
+    pid_t       pid;
+    int         fd;
+    bool        pass;
+
+    test_job_results[0] = 0;
+    pass = jobs_submit("echo a", test_job_done, strdup("a")) &&
+           jobs_submit("exit 3", test_job_done, strdup("b")) &&
+           jobs_submit("seq 100000 | tail -n 1", test_job_done, strdup("c"));
+    pass = pass && jobs_pending() == 3;
+    jobs_wait();
+
+    /* the prefetched command runs once, the one not submitted finishes first */
+    unlink(runs);
+    jobs_prefetch(cmdstr);
+    pass = pass && jobs_submit(cmdstr, test_job_done, strdup("p"));
+    jobs_prefetch("sleep 0.2; echo q >> /tmp/.tasknc_test_prefetch");
+    pass = pass && jobs_submit("echo r", test_job_done, strdup("r"));
+    jobs_wait();
+    pass = pass && stat(runs, &st) == 0 && st.st_size == 4;
+
+    /* an idle job is not pending, and the next job drops its result */
+    pass = pass && jobs_submit_idle("sleep 0.2; echo i >> /tmp/.tasknc_test_prefetch",
+                                    test_job_done, strdup("i")) &&
+           jobs_pending() == 0 && !jobs_submit_idle("echo j", test_job_done, strdup("j")) &&
+           jobs_submit("echo s", test_job_done, strdup("s"));
+    jobs_wait();
+    pass = pass && stat(runs, &st) == 0 && st.st_size == 6;
+
+    /* a command handed over to be discarded is read to the end */
+    pass = pass && jobs_spawn("sleep 0.2; echo t >> /tmp/.tasknc_test_prefetch", &pid, &fd);
+    jobs_discard(pid, fd);
+    jobs_wait();
+    pass = pass && stat(runs, &st) == 0 && st.st_size == 8;
+    unlink(runs);
+
+    pass = pass && jobs_submit("sleep 0.2", test_job_done, strdup("w")) &&
+           jobs_submit("echo x", test_job_done, strdup("x"));
+    jobs_wait();
+
+    pass = pass && jobs_pending() == 0 &&
+           str_eq(test_job_results, "a0a b3- c01 d0d p0p r0r s0s w0- x0x ");
+    test_result("jobs", pass);
+
+    if (!pass) {
+        printf("results: %s\n", test_job_results);
+    }
+} /* }}} */
+
+struct task* test_list(struct arena* arena, const struct test_fields* fields,
+                       const int ntasks, struct task** tasks) { /* {{{ */
+    /**
+     * make a task list from a table of fields and index it in place of the
+     * loaded one, test_list_free puts the loaded one back
+     * arena  - the arena the tasks are allocated from
+     * fields - the fields of each task
+     * ntasks - the number of tasks
+     * tasks  - set to the tasks, in list order
+     * return is the first task
+     */
+    int i;
+
+    for (i = 0; i < ntasks; i++) {
+        tasks[i] = malloc_task(arena);
+        tasks[i]->uuid[UUIDBYTES - 1] = i + 1;
+        tasks[i]->project = fields[i].project != NULL ?
+                            arena_strdup(arena, fields[i].project) : NULL;
+        tasks[i]->description = fields[i].description != NULL ?
+                                arena_strdup(arena, fields[i].description) : NULL;
+        tasks[i]->tags = fields[i].tags != NULL ? arena_strdup(arena, fields[i].tags) : NULL;
+        tasks[i]->priority = fields[i].priority;
+        tasks[i]->prev = i > 0 ? tasks[i - 1] : NULL;
+        tags_index(tasks[i]);
+
+        if (i > 0) {
+            tasks[i - 1]->next = tasks[i];
+        }
+    }
+
+    tasktable_build(tasks[0]);
+
+    return tasks[0];
+} /* }}} */
+
+void test_list_free(struct arena* arena) { /* {{{ */
+    /* free a test's tasks and index the loaded task list again */
+    arena_free(arena);
+    tasktable_build(head);
+} /* }}} */
+
+void test_log(void) { /* {{{ */
+    /* test that queued log messages are all written, in order and whole even
+     * when longer than a ring entry, and that the arguments of a message
+     * below the log level are not evaluated
+     */
+    const enum log_mode oldlvl = cfg.loglvl;
+    FILE*               fp = tmpfile();
+    char                line[2 * TOTALLENGTH];
+    char                pad[LOGLINELENGTH + 1];
+    bool                pass = fp != NULL;
+    int                 evaluated = 0;
+    int                 n = 0;
+    int                 i;
+
+    cfg.loglvl = LOG_INFO;
+    memset(pad, 'x', LOGLINELENGTH);
+    pad[LOGLINELENGTH] = 0;
+
+    /* more messages than the ring holds, so the writer must keep up */
+    for (i = 0; i < 3 * LOGRINGSIZE && pass; i++) {
+        tnc_fprintf(fp, LOG_INFO, "message %d %s", i, i % 100 == 0 ? pad : "");
+    }
+
+    tnc_fprintf(fp, LOG_DEBUG, "evaluated %d", evaluated++);
+    log_flush();
+    cfg.loglvl = oldlvl;
+
+    if (pass) {
+        rewind(fp);
+
+        while (pass && fgets(line, sizeof(line), fp) != NULL) {
+            pass = line[0] == '[' && strstr(line, "] message ") != NULL &&
+                   atoi(strstr(line, "] message ") + 10) == n &&
+                   (n % 100 != 0 || strstr(line, pad) != NULL);
+            n++;
+        }
+
+        fclose(fp);
+    }
+
+    pass = pass && n == 3 * LOGRINGSIZE && evaluated == 0;
+    test_result("log", pass);
+
+    if (!pass) {
+        printf("lines: %d, evaluated: %d\n", n, evaluated);
+    }
+} /* }}} */
+
+void test_match_string(void) { /* {{{ */
+    /* test regex matching through the compiled pattern cache */
+    char    pattern[16];
+    char    number[16];
+    bool    pass;
+    int     i;
+
+    pass = match_string("tasknc", "^task") && !match_string("tasknc", "^nc") &&
+           match_string("TaskNC", "tasknc") && !match_string("tasknc", "(") &&
+           !match_string(NULL, "task") && !match_string("tasknc", NULL);
+
+    /* fill the cache past its size, earlier patterns must still work */
+    for (i = 0; i < 2 * REGEXCACHESIZE && pass; i++) {
+        sprintf(number, "%d", i);
+        sprintf(pattern, "^%d$", i);
+        pass = match_string(number, pattern) && !match_string("x", pattern);
+    }
+
+    pass = pass && match_string("tasknc", "^task") && !match_string("tasknc", "(");
+    test_result("match_string", pass);
+} /* }}} */
+
+void test_parse_task(void) { /* {{{ */
+    /* test parsing a task from json, including escapes and extra fields */
+    struct json_scanner scanner;
+    struct json_token   token;
+    struct arena*       arena = arena_create(1024);
+    struct task*        this;
+    char                uuid[UUIDLENGTH];
+    bool                pass;
+    const char*         json = "{\"id\":12,\"description\":\"say \\\"hi\\\" \\u00e9\\ud83d\\ude00\\\\\","
+                               "\"annotations\":[{\"entry\":\"20120101T000000Z\",\"description\":\"a, b]\"}],"
+                               "\"project\":\"tasknc\",\"priority\":\"H\",\"tags\":[\"one\",\"two\"],"
+                               "\"estimate\":3,\"extra\":{\"a\":[1,2]},"
+                               "\"uuid\":\"12345678-1234-1234-1234-123456789012\"}";
+
+    json_init(&scanner, json, strlen(json));
+    json_next(&scanner, &token);
+    this = parse_task(&scanner, arena);
+
+    pass = this != NULL && this->index == 12 &&
+           str_eq(this->description, "say \"hi\" \xc3\xa9\xf0\x9f\x98\x80\\") &&
+           str_eq(this->project, "tasknc") && this->priority == 'H' &&
+           str_eq(this->tags, "\"one\",\"two\"") &&
+           this->annotations != NULL && str_eq(this->annotations->description, "a, b]") &&
+           this->udas != NULL && str_eq(this->udas->name, "estimate") &&
+           str_eq(this->udas->value, "3") && this->udas->next != NULL &&
+           str_eq(this->udas->next->value, "{\"a\":[1,2]}") &&
+           str_eq(uuid_format(this->uuid, uuid), "12345678-1234-1234-1234-123456789012");
+    test_result("parse_task", pass);
+
+    if (!pass && this != NULL) {
+        printf("description: %s\n", this->description);
+        printf("tags: %s\n", this->tags);
+    }
+
+    arena_free(arena);
+} /* }}} */
+
+void test_parse_threads(void) { /* {{{ */
+    /* test that an export parsed on several threads gives the same list,
+     * in the same order, as one parsed on a single thread
+     * the export repeats few due dates and projects, so the merge must keep
+     * the order of tasks that tie
+     */
+    const int       oldthreads = cfg.parse_threads;
+    char*           oldsortmode = cfg.sortmode;
+    const int       ntasks = 8 * PARSECHUNKLENGTH / 128;
+    struct arena*   single = arena_create(TASKARENABLOCKLENGTH);
+    struct arena*   threaded = arena_create(TASKARENABLOCKLENGTH);
+    struct task*    a;
+    struct task*    b;
+    char*           export = malloc(ntasks * 160 + 8);
+    size_t          length = 0;
+    bool            pass;
+    int             n = 0;
+    int             i;
+
+    length += sprintf(export, "[\n");
+
+    for (i = 0; i < ntasks; i++) {
+        length += sprintf(export + length, "{\"id\":%d,\"description\":\"task %d\","
+                          "\"due\":\"201201%02dT000000Z\",\"project\":\"p%d\","
+                          "\"uuid\":\"%08d-0000-0000-0000-000000000000\"}%s\n",
+                          i + 1, i, i % 7 + 1, i % 3, i + 1, i + 1 < ntasks ? "," : "");
+    }
+
+    length += sprintf(export + length, "]\n");
+
+    cfg.sortmode = "dp";
+    cfg.parse_threads = 1;
+    a = parse_tasks(export, length, single);
+    cfg.parse_threads = 4;
+    b = parse_tasks(export, length, threaded);
+    cfg.parse_threads = oldthreads;
+    cfg.sortmode = oldsortmode;
+
+    pass = threaded->children != NULL;
+
+    for (; pass && a != NULL && b != NULL; a = a->next, b = b->next, n++) {
+        pass = memcmp(a->uuid, b->uuid, UUIDBYTES) == 0 &&
+               str_eq(a->description, b->description) &&
+               a->due == b->due && (b->next == NULL || b->next->prev == b);
+    }
+
+    pass = pass && a == NULL && b == NULL && n == ntasks;
+    test_result("parse_threads", pass);
+
+    if (!pass) {
+        printf("matched %d of %d tasks\n", n, ntasks);
+    }
+
+    free(export);
+    arena_free(single);
+    arena_free(threaded);
+} /* }}} */
+
+void test_reload(void) { /* {{{ */
+    /* test that an incremental reload gives the same list as a full one,
+     * with and without a local filter, and that reloading a task in place
+     * counts its old copy as unused
+     */
+    char**          uuids;
+    struct task*    cur;
+    struct arena*   root;
+    char            uuid[UUIDLENGTH];
+    char*           oldfilter;
+    size_t          used;
+    int             ntasks;
+    int             nshown;
+    int             nhidden;
+    int             i = 0;
+    int             oldmode = cfg.incremental_reload;
+    bool            pass;
+
+    cfg.incremental_reload = 0;
+    reload_tasks();
+    task_count();
+    ntasks = taskcount;
+    uuids = calloc(ntasks + 1, sizeof(char*));
+
+    for (cur = head; cur != NULL && i < ntasks; cur = cur->next) {
+        uuids[i++] = strdup(uuid_format(cur->uuid, uuid));
+    }
+
+    cfg.incremental_reload = 1;
+    reload_tasks();
+    task_count();
+    pass = taskcount == ntasks;
+
+    for (cur = head, i = 0; cur != NULL && pass; cur = cur->next, i++) {
+        pass = i < ntasks && str_eq(uuid_format(cur->uuid, uuid), uuids[i]) &&
+               get_task_by_position(i) == cur;
+    }
+
+    if (pass && ntasks > 1) {
+        root = arena_root(head->arena);
+        used = arena_used(root);
+        reload_task(head->next);
+        jobs_wait();
+        pass = head->next != NULL && str_eq(uuid_format(head->next->uuid, uuid), uuids[1]) &&
+               get_task_by_position(1) == head->next && head->next->prev == head &&
+               head->next->arena != root &&
+               arena_used(root) < used + head->next->arena->allocated;
+    }
+
+    /* a local filter stays applied, the reload only checks the tasks it changes */
+    oldfilter = active_filter;
+    asprintf(&active_filter, "%s priority:H", oldfilter);
+
+    if (pass && apply_filter()) {
+        for (cur = head, nshown = 0; cur != NULL && nshown < ntasks; cur = cur->next) {
+            check_free(uuids[nshown]);
+            uuids[nshown++] = strdup(uuid_format(cur->uuid, uuid));
+        }
+
+        nhidden = hidden_task_count();
+        reload_tasks();
+        pass = hidden_task_count() == nhidden;
+
+        for (cur = head, i = 0; cur != NULL && pass; cur = cur->next, i++) {
+            pass = i < nshown && str_eq(uuid_format(cur->uuid, uuid), uuids[i]) &&
+                   get_task_by_position(i) == cur;
+        }
+
+        pass = pass && i == nshown;
+    }
+
+    free(active_filter);
+    active_filter = oldfilter;
+    apply_filter();
+    test_result("reload", pass);
+
+    for (i = 0; i < ntasks; i++) {
+        free(uuids[i]);
+    }
+
+    free(uuids);
+    cfg.incremental_reload = oldmode;
+} /* }}} */
+
+void test_render(void) { /* {{{ */
+    /* test caching the evaluated task format of a task */
+    struct task*    tsk = head;
+    const char*     first;
+    const char*     again;
+    char*           expected;
+    bool            pass;
+    int             oldcols = cols;
+    unsigned int    gen;
+
+    if (tsk == NULL) {
+        test_result("render", false);
+        return;
+    }
+
+    expected = eval_format(cfg.formats.task_compiled, tsk);
+    first = eval_task_format(tsk);
+    again = eval_task_format(tsk);
+    pass = first != NULL && first == again && str_eq(first, expected);
+    gen = tsk->linegen;
+
+    /* a new screen width invalidates the line, the buffer is reused */
+    cols = oldcols + 1;
+    again = eval_task_format(tsk);
+    pass = pass && again == first && tsk->linegen != gen;
+    cols = oldcols;
+
+    test_result("render", pass && str_eq(eval_task_format(tsk), expected));
+    free(expected);
+} /* }}} */
+
 void test_result(const char* testname, const bool passed) { /* {{{ */
     /* print a colored result for a test */
     char* color;
@@ -123,6 +1066,7 @@ void test_search() { /* {{{ */
     const char*     proj    = "test123";
     const char      pri     = 'H';
     const char*     unique  = "simple";
+    char            uuid[UUIDLENGTH];
     FILE*           cmdout;
     struct task*    this;
     bool            pass;
@@ -130,12 +1074,11 @@ void test_search() { /* {{{ */
     asprintf(&addcmdstr, "task add pro:%s pri:%c %s", proj, pri, unique);
     cmdout = popen(addcmdstr, "r");
     pclose(cmdout);
-    free_tasks(head);
-    head = get_tasks(NULL);
+    reload_tasks();
 
     stdout = devnull;
     searchstring = strdup(unique);
-    find_next_search_result(head, head);
+    find_next_search_result(head);
     stdout = out;
     this = get_task_by_position(selline);
     pass = strcmp(this->project, proj) == 0 && this->priority == pri;
@@ -147,7 +1090,7 @@ void test_search() { /* {{{ */
         puts(tmp);
         free(tmp);
         puts("selected:");
-        printf("uuid: %s\n", this->uuid);
+        printf("uuid: %s\n", uuid_format(this->uuid, uuid));
         printf("description: %s\n", this->description);
         printf("project: %s\n", this->project);
         printf("tags: %s\n", this->tags);
@@ -175,6 +1118,221 @@ void test_set_var(void) { /* {{{ */
     test_result("set int var", cfg.nc_timeout == 6969);
 } /* }}} */
 
+bool test_same_string(const char* a, const char* b) { /* {{{ */
+    /* compare two strings that may be NULL */
+    return a == b || (a != NULL && b != NULL && str_eq(a, b));
+} /* }}} */
+
+void test_snapshot(void) { /* {{{ */
+    /* save the task list to a snapshot and check it loads back unchanged */
+    const char*         path = "/tmp/.tasknc_test_snapshot";
+    struct task*        loaded;
+    struct task*        a;
+    struct task*        b;
+    struct annotation*  anno_a;
+    struct annotation*  anno_b;
+    struct uda*         uda_a;
+    struct uda*         uda_b;
+    time_t              modified = 0;
+    bool                pass;
+    FILE*               fp;
+    int                 size;
+    int                 c;
+
+    pass = snapshot_write(path, "key", head, 1234);
+    loaded = snapshot_read(path, "key", &modified);
+    pass = pass && loaded != NULL && modified == 1234;
+
+    for (a = head, b = loaded; pass && a != NULL && b != NULL; a = a->next, b = b->next) {
+        pass = a->index == b->index && a->start == b->start && a->end == b->end &&
+               a->entry == b->entry && a->due == b->due && a->modified == b->modified &&
+               a->priority == b->priority && memcmp(a->uuid, b->uuid, UUIDBYTES) == 0 &&
+               test_same_string(a->tags, b->tags) && test_same_string(a->project, b->project) &&
+               test_same_string(a->description, b->description) &&
+               (b->prev == NULL || b->prev->next == b);
+
+        for (anno_a = a->annotations, anno_b = b->annotations; pass && anno_a != NULL &&
+             anno_b != NULL; anno_a = anno_a->next, anno_b = anno_b->next) {
+            pass = anno_a->entry == anno_b->entry &&
+                   test_same_string(anno_a->description, anno_b->description);
+        }
+
+        for (uda_a = a->udas, uda_b = b->udas; pass && uda_a != NULL && uda_b != NULL;
+             uda_a = uda_a->next, uda_b = uda_b->next) {
+            pass = test_same_string(uda_a->name, uda_b->name) &&
+                   test_same_string(uda_a->value, uda_b->value);
+        }
+
+        pass = pass && anno_a == NULL && anno_b == NULL && uda_a == NULL && uda_b == NULL;
+    }
+
+    pass = pass && a == NULL && b == NULL;
+    free_tasks(loaded);
+    test_result("snapshot load", pass);
+
+    /* a snapshot saved under another key, or damaged, is ignored */
+    pass = snapshot_read(path, "other key", &modified) == NULL;
+
+    fp = fopen(path, "r+");
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, size / 2, SEEK_SET);
+    c = fgetc(fp);
+    fseek(fp, size / 2, SEEK_SET);
+    fputc(c ^ 1, fp);
+    fclose(fp);
+
+    pass = pass && snapshot_read(path, "key", &modified) == NULL;
+    test_result("snapshot reject", pass);
+    remove(path);
+} /* }}} */
+
+void test_sort(void) { /* {{{ */
+    /* sort a large synthetic task list and check the order is correct */
+    struct arena*   arena = arena_create(1 << 20);
+    struct task*    first = NULL;
+    struct task*    last = NULL;
+    struct task*    this;
+    char*           oldmode = cfg.sortmode;
+    char            uuid[UUIDLENGTH];
+    const char*     projects[] = {NULL, "tasknc", "home", "work", "a.very.long.project", "a.very.long.project.too"};
+    const char      priorities[] = {0, 'L', 'M', 'H'};
+    const int       ntasks = 100000;
+    clock_t         start;
+    double          elapsed;
+    bool            pass = true;
+    int             i;
+    int             n = 0;
+    int             cmp;
+
+    srand(1);
+
+    for (i = 0; i < ntasks; i++) {
+        this = malloc_task(arena);
+        this->index = i % 65536;
+        this->project = (char*)projects[rand() % 6];
+        this->priority = priorities[rand() % 4];
+        this->due = rand() % 3 == 0 ? 0 : 1000000000 + rand() % 1000;
+        sprintf(uuid, "%08x-0000-0000-0000-%012d", rand(), i);
+        uuid_parse(uuid, strlen(uuid), this->uuid);
+        this->prev = last;
+
+        if (last == NULL) {
+            first = this;
+        } else {
+            last->next = this;
+        }
+
+        last = this;
+    }
+
+    /* due, priority, project (descending), uuid */
+    cfg.sortmode = "drPu";
+    start = clock();
+    first = sort_wrapper(first);
+    elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    for (this = first; this != NULL && pass; this = this->next) {
+        n++;
+
+        if (this->next == NULL) {
+            break;
+        }
+
+        pass = this->next->prev == this;
+        last = this->next;
+
+        if (this->due != last->due) {
+            pass = pass && this->due != 0 && (last->due == 0 || this->due < last->due);
+            continue;
+        }
+
+        cmp = test_sort_priority(this->priority) - test_sort_priority(last->priority);
+
+        if (cmp != 0) {
+            pass = pass && cmp > 0;
+            continue;
+        }
+
+        if (this->project == NULL || last->project == NULL) {
+            cmp = (this->project != NULL) - (last->project != NULL);
+        } else {
+            cmp = -strcmp(this->project, last->project);
+        }
+
+        if (cmp != 0) {
+            pass = pass && cmp < 0;
+            continue;
+        }
+
+        pass = pass && memcmp(this->uuid, last->uuid, UUIDBYTES) < 0;
+    }
+
+    pass = pass && n == ntasks;
+
+    /* sorting on a single key must keep the original order of ties */
+    cfg.sortmode = "u";
+    first = sort_wrapper(first);
+    cfg.sortmode = "p";
+    first = sort_wrapper(first);
+
+    for (this = first; this != NULL && this->next != NULL && pass; this = this->next) {
+        if (this->project == this->next->project) {
+            pass = memcmp(this->uuid, this->next->uuid, UUIDBYTES) < 0;
+        }
+    }
+
+    test_result("sort", pass);
+    printf("sorted %d tasks in %.3fs\n", ntasks, elapsed);
+
+    cfg.sortmode = oldmode;
+    arena_free(arena);
+} /* }}} */
+
+int test_sort_priority(const char pri) { /* {{{ */
+    /* rank a priority for checking sort order */
+    return pri == 'H' ? 3 : pri == 'M' ? 2 : pri == 'L' ? 1 : 0;
+} /* }}} */
+
+void test_tagset(void) { /* {{{ */
+    /* check that tags are matched by name, not as text, and that the number
+     * of tasks with each tag follows the task table
+     */
+    const struct test_fields fields[] = {
+        {NULL, "a task", "\"work\",\"next\"", 0},
+        {NULL, "a task", "\"homework\"", 0},
+        {NULL, "a task", NULL, 0},
+        {NULL, "a task", "\"work\"", 0},
+    };
+    const int       ntasks = sizeof(fields) / sizeof(struct test_fields);
+    struct arena*   arena = arena_create(4096);
+    struct task*    tasks[ntasks];
+    int             work;
+    int             next;
+    bool            pass;
+
+    test_list(arena, fields, ntasks, tasks);
+
+    work = tag_id("work", 4, false);
+    next = tag_id("next", 4, false);
+    pass = work >= 0 && next >= 0 && str_eq(tag_name(work), "work") &&
+           tag_test(tasks[0], work) && tag_test(tasks[0], next) && !tag_test(tasks[1], work) &&
+           !tag_test(tasks[2], work) && tag_id("nothing", 7, false) < 0;
+
+    /* +tag searches by name, a plain word still searches the text */
+    pass = pass && task_match(tasks[3], "+work") && !task_match(tasks[1], "+work") &&
+           task_match(tasks[1], "work") && !task_match(tasks[1], "+nothing") &&
+           tag_literal("work", 4) && !tag_literal("wo.k", 4) && !tag_literal("", 0);
+    pass = pass && colstats_tag_count(work) == 2 && colstats_tag_count(next) == 1 &&
+           colstats_tag_count(tag_id("homework", 8, false)) == 1;
+
+    tasktable_remove(tasks[0]);
+    pass = pass && colstats_tag_count(work) == 1 && colstats_tag_count(next) == 0;
+
+    test_result("tagset", pass);
+    test_list_free(arena);
+} /* }}} */
+
 void test_task_count(void) { /* {{{ */
     /* check that the tasks are counted correctly */
     int     tcnt;
@@ -196,6 +1354,340 @@ void test_task_count(void) { /* {{{ */
     free(line);
 } /* }}} */
 
+void test_task_table(void) { /* {{{ */
+    /* test looking up tasks by position and uuid, removing them and adding
+     * them back in order
+     */
+    struct arena*   arena = arena_create(4096);
+    struct task*    first = NULL;
+    struct task*    last = NULL;
+    struct task*    this;
+    struct task*    removed[50];
+    char*           oldmode = cfg.sortmode;
+    char            uuid[UUIDLENGTH];
+    unsigned char   bytes[UUIDBYTES];
+    const int       ntasks = 100;
+    bool            pass = true;
+    int             i;
+
+    for (i = 0; i < ntasks; i++) {
+        this = malloc_task(arena);
+        sprintf(uuid, "%08d-0000-0000-0000-000000000000", i);
+        uuid_parse(uuid, strlen(uuid), this->uuid);
+        this->prev = last;
+
+        if (last == NULL) {
+            first = this;
+        } else {
+            last->next = this;
+        }
+
+        last = this;
+    }
+
+    tasktable_build(first);
+    pass = tasktable_count() == ntasks && tasktable_get(ntasks) == NULL &&
+           tasktable_get(-1) == NULL;
+
+    for (i = 0; i < ntasks && pass; i++) {
+        sprintf(uuid, "%08d-0000-0000-0000-000000000000", i);
+        uuid_parse(uuid, strlen(uuid), bytes);
+        this = tasktable_find(bytes);
+        pass = this != NULL && this->position == i && tasktable_get(i) == this;
+    }
+
+    /* remove every other task, the rest must move up and stay findable */
+    for (i = 0; i < ntasks && pass; i += 2) {
+        sprintf(uuid, "%08d-0000-0000-0000-000000000000", i);
+        uuid_parse(uuid, strlen(uuid), bytes);
+        removed[i / 2] = tasktable_find(bytes);
+        tasktable_remove(removed[i / 2]);
+    }
+
+    for (i = 0; i < ntasks && pass; i++) {
+        sprintf(uuid, "%08d-0000-0000-0000-000000000000", i);
+        uuid_parse(uuid, strlen(uuid), bytes);
+        this = tasktable_find(bytes);
+        pass = i % 2 == 0 ? this == NULL : this != NULL && this->position == i / 2 &&
+               tasktable_get(i / 2) == this;
+    }
+
+    pass = pass && tasktable_count() == ntasks / 2 && tasktable_changed() == 0;
+
+    /* the last task removed goes after the 49 tasks before it */
+    cfg.sortmode = "u";
+    pass = pass && tasktable_insert(removed[ntasks / 2 - 1]) && tasktable_changed() == 49;
+
+    for (i = ntasks / 2 - 2; i >= 0 && pass; i--) {
+        pass = tasktable_insert(removed[i]);
+    }
+
+    for (i = 0; i < ntasks && pass; i++) {
+        sprintf(uuid, "%08d-0000-0000-0000-000000000000", i);
+        uuid_parse(uuid, strlen(uuid), bytes);
+        this = tasktable_find(bytes);
+        pass = this != NULL && this->position == i && tasktable_get(i) == this;
+    }
+
+    cfg.sortmode = oldmode;
+    pass = pass && tasktable_count() == ntasks && tasktable_changed() == 0 &&
+           tasktable_changed() == INT_MAX;
+    test_result("task_table", pass);
+    test_list_free(arena);
+} /* }}} */
+
+void test_taskdata(void) { /* {{{ */
+    /* read a small set of data files and check the tasks and their ids */
+    const char*         dir = "/tmp/.tasknc_test_taskdata";
+    const char*         pending =
+        "[description:\"say \\\"hi\\\" &open;x&close;\" entry:\"100\" project:\"home\" "
+        "status:\"pending\" tags:\"a,b\" annotation_200:\"note\" "
+        "uuid:\"00000000-0000-0000-0000-000000000001\"]\n"
+        "[description:\"finished\" end:\"300\" entry:\"100\" status:\"completed\" "
+        "uuid:\"00000000-0000-0000-0000-000000000002\"]\n"
+        "[description:\"later\" entry:\"100\" status:\"waiting\" wait:\"900\" "
+        "uuid:\"00000000-0000-0000-0000-000000000003\"]\n";
+    const char*         completed =
+        "[description:\"gone\" end:\"400\" entry:\"100\" status:\"deleted\" "
+        "uuid:\"00000000-0000-0000-0000-000000000004\"]\n";
+    char                path[64];
+    char                uuid[UUIDLENGTH];
+    char*               olddata = getenv("TASKDATA");
+    struct arena*       arena;
+    struct task*        tasks;
+    struct task*        cur;
+    bool                pass;
+    FILE*               fp;
+    int                 n;
+
+    olddata = olddata != NULL ? strdup(olddata) : NULL;
+    mkdir(dir, 0700);
+    setenv("TASKDATA", dir, 1);
+
+    snprintf(path, sizeof(path), "%s/pending.data", dir);
+    fp = fopen(path, "w");
+    fputs(pending, fp);
+    fclose(fp);
+    snprintf(path, sizeof(path), "%s/completed.data", dir);
+    fp = fopen(path, "w");
+    fputs(completed, fp);
+    fclose(fp);
+
+    /* only the pending task, with its fields decoded */
+    arena = arena_create(TASKARENABLOCKLENGTH);
+    tasks = taskdata_load("status:pending", NULL, arena);
+    pass = tasks != NULL && tasks->next == NULL && tasks->index == 1 &&
+           test_same_string(tasks->description, "say \"hi\" [x]") &&
+           test_same_string(tasks->project, "home") &&
+           test_same_string(tasks->tags, "\"a\",\"b\"") && tasks->entry == 100 &&
+           tasks->annotations != NULL && tasks->annotations->entry == 200 &&
+           test_same_string(tasks->annotations->description, "note") &&
+           tasks->udas != NULL && test_same_string(tasks->udas->name, "status");
+    test_result("taskdata pending", pass);
+
+    /* every task, completed.data included, and the ids of unfinished tasks */
+    tasks = taskdata_load("", NULL, arena);
+
+    for (cur = tasks, n = 0, pass = true; cur != NULL; cur = cur->next, n++) {
+        if (str_eq(uuid_format(cur->uuid, uuid), "00000000-0000-0000-0000-000000000003")) {
+            pass = pass && cur->index == 2;
+        } else if (cur->end != 0) {
+            pass = pass && cur->index == 0;
+        }
+    }
+
+    pass = pass && n == 4;
+    tasks = taskdata_load("", "00000000-0000-0000-0000-000000000004", arena);
+    pass = pass && tasks != NULL && tasks->next == NULL && tasks->end == 400;
+    test_result("taskdata all", pass);
+    arena_free(arena);
+
+    /* filters the reader does not understand are left to task export */
+    pass = taskdata_usable("status:pending") && taskdata_usable("") &&
+           !taskdata_usable("project:home") && !taskdata_usable("status:pending +a");
+
+    /* as is a directory without pending.data, such as taskwarrior 3's */
+    remove(path);
+    snprintf(path, sizeof(path), "%s/pending.data", dir);
+    remove(path);
+    pass = pass && !taskdata_usable("status:pending");
+    test_result("taskdata usable", pass);
+    remove(dir);
+
+    if (olddata != NULL) {
+        setenv("TASKDATA", olddata, 1);
+        free(olddata);
+    } else {
+        unsetenv("TASKDATA");
+    }
+} /* }}} */
+
+void test_timestamp(void) { /* {{{ */
+    /* check that timestamps are parsed as utc, matching the libc parser */
+    const char*     valid[] = {"19700101T000000Z", "19691231T235959Z", "20120229T235959Z",
+                               "20120301T000000Z", "20380119T031408Z", "21000301T120000Z",
+                               "19000228T060000Z", NULL
+                              };
+    const char*     invalid[] = {"2012-01-01", "20121301T000000Z", "20120100T000000Z",
+                                 "20120101T000000", "2012010AT000000Z", "20120101T240000Z",
+                                 "20120101 000000Z", NULL
+                                };
+    struct tm       tmr;
+    time_t          parsed, expected;
+    bool            pass = true;
+    int             i;
+
+    for (i = 0; valid[i] != NULL; i++) {
+        memset(&tmr, 0, sizeof(tmr));
+        strptime(valid[i], "%Y%m%dT%H%M%SZ", &tmr);
+        expected = timegm(&tmr);
+
+        if (!parse_timestamp(valid[i], strlen(valid[i]), &parsed) || parsed != expected) {
+            printf("timestamp %s: %ld (expected %ld)\n", valid[i], (long)parsed,
+                   (long)expected);
+            pass = false;
+        }
+    }
+
+    for (i = 0; invalid[i] != NULL; i++) {
+        if (parse_timestamp(invalid[i], strlen(invalid[i]), &parsed)) {
+            printf("timestamp %s should not parse\n", invalid[i]);
+            pass = false;
+        }
+    }
+
+    test_result("timestamp", pass);
+} /* }}} */
+
+void test_timing(void) { /* {{{ */
+    /* check that timed paths are counted only while timing is enabled */
+    const int       oldtiming = cfg.timing;
+    unsigned long   sum = 0;
+    bool            pass;
+    int             i;
+
+    cfg.timing = 1;
+    timing_reset();
+    timer_stop(TIMER_SORT, timer_start());
+    head = sort_wrapper(head);
+
+    cfg.timing = 0;
+    timer_stop(TIMER_SORT, timer_start());
+    head = sort_wrapper(head);
+
+    for (i = 0; i < TIMER_BUCKETS; i++) {
+        sum += timers[TIMER_SORT].histogram[i];
+    }
+
+    timing_refresh();
+    pass = timers[TIMER_SORT].count == 2 && sum == 2 &&
+           timers[TIMER_SORT].max <= timers[TIMER_SORT].total &&
+           str_starts_with(timers[TIMER_SORT].value, "2 calls");
+    test_result("timing", pass);
+
+    cfg.timing = oldtiming;
+    timing_reset();
+} /* }}} */
+
+void test_trigram(void) { /* {{{ */
+    /* test that the search index offers every task a search matches, and
+     * that searching through it finds the same tasks as checking them all
+     */
+    const char*         words[] = {"review docs", "aab test", "file.txt", "alphaxyz",
+                                   "colour", "color", "Zoo visit", "\xc3\xa9t\xc3\xa9 plans"
+                                  };
+    const char*         patterns[] = {"review", "REVIEW", "colou?r", "col(ou|o)r", "aa+b",
+                                      "[[:alpha:]]xyz", "\\.txt", "fi.e", "^rev", "x{2}yz",
+                                      "doc|file", "[]x]yz", "zoo", "plans", "nomatch"
+                                     };
+    const int           nwords = sizeof(words) / sizeof(char*);
+    const int           npatterns = sizeof(patterns) / sizeof(char*);
+    const int           ntasks = 200;
+    struct arena*       arena = arena_create(4096);
+    const struct task** candidates;
+    struct task*        first = NULL;
+    struct task*        last = NULL;
+    struct task*        this;
+    struct task*        found;
+    char                field[64];
+    bool                wrapped;
+    bool                pass = true;
+    int                 ncandidates;
+    int                 i;
+    int                 j;
+    int                 k;
+
+    for (i = 0; i < ntasks; i++) {
+        this = malloc_task(arena);
+        sprintf(field, "%08d-0000-0000-0000-000000000000", i);
+        uuid_parse(field, strlen(field), this->uuid);
+        sprintf(field, "%s %d", words[i % nwords], i);
+        this->description = arena_strdup(arena, field);
+        this->project = i % 3 == 0 ? arena_strdup(arena, "home") : NULL;
+        this->prev = last;
+
+        if (last == NULL) {
+            first = this;
+        } else {
+            last->next = this;
+        }
+
+        last = this;
+    }
+
+    tasktable_build(first);
+
+    for (i = 0; i < npatterns && pass; i++) {
+        ncandidates = searchindex_query(patterns[i], &candidates);
+
+        /* every match must be a candidate, and candidates are in list order */
+        for (j = 0, k = 0; j < ntasks && pass && ncandidates >= 0; j++) {
+            this = tasktable_get(j);
+
+            while (k < ncandidates && candidates[k]->position < j) {
+                k++;
+            }
+
+            pass = !task_match(this, patterns[i]) ||
+                   (k < ncandidates && candidates[k] == this);
+        }
+
+        /* searching from each task finds the next match in the list */
+        for (j = 0; j < ntasks && pass; j += 7) {
+            found = task_search(tasktable_get(j), patterns[i], &wrapped);
+
+            for (k = 1; k <= ntasks && !task_match(tasktable_get((j + k) % ntasks),
+                                                    patterns[i]); k++);
+
+            pass = k > ntasks ? found == NULL : found == tasktable_get((j + k) % ntasks) &&
+                   wrapped == (j + k >= ntasks);
+        }
+
+        if (!pass) {
+            printf("pattern %s: %d candidates\n", patterns[i], ncandidates);
+        }
+    }
+
+    /* the index narrows literal searches, and cannot narrow alternatives */
+    pass = pass && searchindex_query("review", &candidates) == ntasks / nwords &&
+           searchindex_query("doc|file", &candidates) < 0 &&
+           searchindex_query("nomatch", &candidates) == 0;
+
+    /* the index follows tasks as they are replaced and removed */
+    this = malloc_task(arena);
+    memcpy(this->uuid, tasktable_get(5)->uuid, UUIDBYTES);
+    this->description = arena_strdup(arena, "zebra crossing");
+    tasktable_replace(tasktable_get(5), this);
+    found = task_search(NULL, "zebra", &wrapped);
+    pass = pass && found == this && searchindex_query("zebra", &candidates) == 1;
+    tasktable_remove(this);
+    pass = pass && searchindex_query("zebra", &candidates) == 0 &&
+           task_search(NULL, "zebra", &wrapped) == NULL;
+
+    test_result("trigram", pass);
+    test_list_free(arena);
+} /* }}} */
+
 void test_trim(void) { /* {{{ */
     /* test the functionality of str_trim */
     bool        pass;
@@ -215,6 +1707,76 @@ void test_trim(void) { /* {{{ */
     free(teststr);
 } /* }}} */
 
+void test_watch(void) { /* {{{ */
+    /* test that a burst of changes to the task data is reported once it
+     * settles, and that lock files and tasknc's own changes are not reported
+     */
+    const char* dir = "/tmp/.tasknc_test_watch";
+    const int   olddebounce = cfg.watch_debounce;
+    char*       olddata = getenv("TASKDATA");
+    bool        pass;
+    int         i;
+
+    olddata = olddata != NULL ? strdup(olddata) : NULL;
+    mkdir(dir, 0700);
+    setenv("TASKDATA", dir, 1);
+    cfg.watch_debounce = 50;
+    pass = watch_start();
+
+    for (i = 0; i < 3; i++) {
+        test_watch_write(dir, "pending.data");
+    }
+
+    pass = pass && !watch_changed() && watch_timeout(-1) > 0;
+    usleep(60000);
+    pass = pass && watch_changed() && !watch_changed();
+
+    test_watch_write(dir, "pending.data.lock");
+    usleep(60000);
+    pass = pass && !watch_changed();
+
+    test_watch_write(dir, "pending.data");
+    watch_ignore();
+    usleep(60000);
+    pass = pass && !watch_changed();
+
+    /* a reload signal settles as a change does */
+    watch_poke();
+    pass = pass && !watch_changed();
+    usleep(60000);
+    pass = pass && watch_changed();
+    test_result("watch", pass);
+
+    watch_stop();
+    unlink("/tmp/.tasknc_test_watch/pending.data");
+    unlink("/tmp/.tasknc_test_watch/pending.data.lock");
+    rmdir(dir);
+    cfg.watch_debounce = olddebounce;
+
+    if (olddata != NULL) {
+        setenv("TASKDATA", olddata, 1);
+        free(olddata);
+    } else {
+        unsetenv("TASKDATA");
+    }
+} /* }}} */
+
+void test_watch_write(const char* dir, const char* name) { /* {{{ */
+    /* append a line to a file, as taskwarrior changing its data would */
+    FILE* fp;
+    char* path;
+
+    asprintf(&path, "%s/%s", dir, name);
+    fp = fopen(path, "a");
+
+    if (fp != NULL) {
+        fputs("x\n", fp);
+        fclose(fp);
+    }
+
+    free(path);
+} /* }}} */
+
 #else
 void test(const char* args) { /* {{{ */
     strcmp(args, "all");
@@ -0,0 +1,185 @@
+/*
+ * timing.c - count and time the hot code paths
+ * for tasknc
+ * by mjheagle
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "common.h"
+#include "timing.h"
+
+/* the timers, in the order of enum timer_id */
+struct timer timers[] = {
+    {"get_tasks",       0, 0, 0, {0}, "", ""},
+    {"parse_task",      0, 0, 0, {0}, "", ""},
+    {"sort",            0, 0, 0, {0}, "", ""},
+    {"print_list",      0, 0, 0, {0}, "", ""},
+    {"command",         0, 0, 0, {0}, "", ""},
+    {"pager_command",   0, 0, 0, {0}, "", ""},
+};
+
+/* the phases of startup, in the order of enum phase_id
+ * first_frame starts with tasknc, so every phase can be placed against it
+ */
+struct phase phases[] = {
+    {"version",         0, 0, "", ""},
+    {"config",          0, 0, "", ""},
+    {"tasks",           0, 0, "", ""},
+    {"first_frame",     0, 0, "", ""},
+};
+
+/* local functions */
+static long long timing_now(void);
+
+void phase_start(const enum phase_id id) { /* {{{ */
+    /* note that a phase of startup has started, only its first start counts */
+    if (phases[id].start == 0) {
+        phases[id].start = timing_now();
+    }
+} /* }}} */
+
+void phase_stop(const enum phase_id id) { /* {{{ */
+    /* note that a phase of startup has finished, only its first finish counts */
+    if (phases[id].start != 0 && phases[id].stop == 0) {
+        phases[id].stop = timing_now();
+    }
+} /* }}} */
+
+char* timer_histogram(const enum timer_id id) { /* {{{ */
+    /**
+     * describe the histogram of a timer
+     * id     - the timer to describe
+     * return is the description, which must be freed
+     */
+    const char*     labels[TIMER_BUCKETS] = {
+        "<1us", "<10us", "<100us", "<1ms", "<10ms", "<100ms", "<1s", ">=1s"
+    };
+    char*           str = calloc(TIMER_BUCKETS * 24, sizeof(char));
+    int             len = 0;
+    int             i;
+
+    if (str == NULL) {
+        return NULL;
+    }
+
+    for (i = 0; i < TIMER_BUCKETS; i++) {
+        len += sprintf(str + len, "%s%s:%lu", i > 0 ? " " : "", labels[i],
+                       timers[id].histogram[i]);
+    }
+
+    return str;
+} /* }}} */
+
+long long timer_start(void) { /* {{{ */
+    /* start timing a code path
+     * return is the time it started (ns), or 0 if timing is disabled
+     */
+    if (!cfg.timing) {
+        return 0;
+    }
+
+    return timing_now();
+} /* }}} */
+
+void timer_stop(const enum timer_id id, const long long start) { /* {{{ */
+    /**
+     * record the time a code path took
+     * id    - the timer to add the time to
+     * start - the return of timer_start when the path began
+     */
+    struct timespec now;
+    struct timer*   timer = &(timers[id]);
+    long long       elapsed;
+    long long       bound;
+    long long       max;
+    int             bucket;
+
+    if (start == 0) {
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed = now.tv_sec * 1000000000LL + now.tv_nsec - (start - 1);
+
+    /* paths may be timed on the parse threads, so the updates are atomic */
+    __atomic_add_fetch(&(timer->count), 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&(timer->total), elapsed, __ATOMIC_RELAXED);
+    max = __atomic_load_n(&(timer->max), __ATOMIC_RELAXED);
+
+    while (elapsed > max && !__atomic_compare_exchange_n(&(timer->max), &max, elapsed, true,
+            __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    for (bucket = 0, bound = 1000; bucket < TIMER_BUCKETS - 1 && elapsed >= bound;
+         bucket++, bound *= 10);
+
+    __atomic_add_fetch(&(timer->histogram[bucket]), 1, __ATOMIC_RELAXED);
+} /* }}} */
+
+long long timing_now(void) { /* {{{ */
+    /* read the clock the timers use
+     * return is the time (ns), offset by one so it is never mistaken for
+     * disabled timing or a phase that has not run
+     */
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * 1000000000LL + now.tv_nsec + 1;
+} /* }}} */
+
+void timing_refresh(void) { /* {{{ */
+    /* update the summaries shown by the timers' variables
+     * this is only done when they are shown, so the timed paths stay cheap
+     */
+    const long long origin = phases[PHASE_FIRST_FRAME].start;
+    struct timer*   timer;
+    struct phase*   phase;
+    int             i;
+
+    for (i = 0; i < TIMER_COUNT; i++) {
+        timer = &(timers[i]);
+        snprintf(timer->summary, TIMER_SUMMARYLENGTH,
+                 "%lu calls, %.3fms total, %.3fms avg, %.3fms max", timer->count,
+                 timer->total / 1e6, timer->count > 0 ? timer->total / 1e6 / timer->count : 0,
+                 timer->max / 1e6);
+        timer->value = timer->summary;
+    }
+
+    /* phases are placed against the start of tasknc */
+    for (i = 0; i < PHASE_COUNT; i++) {
+        phase = &(phases[i]);
+
+        if (phase->start == 0) {
+            snprintf(phase->summary, TIMER_SUMMARYLENGTH, "not run");
+        } else if (phase->stop == 0) {
+            snprintf(phase->summary, TIMER_SUMMARYLENGTH, "running since %.3fms",
+                     (phase->start - origin) / 1e6);
+        } else {
+            snprintf(phase->summary, TIMER_SUMMARYLENGTH, "%.3fms (%.3fms to %.3fms)",
+                     (phase->stop - phase->start) / 1e6, (phase->start - origin) / 1e6,
+                     (phase->stop - origin) / 1e6);
+        }
+
+        phase->value = phase->summary;
+    }
+} /* }}} */
+
+void timing_reset(void) { /* {{{ */
+    /* clear every timer, the startup phases are kept */
+    int i;
+
+    for (i = 0; i < TIMER_COUNT; i++) {
+        timers[i].count = 0;
+        timers[i].total = 0;
+        timers[i].max = 0;
+        memset(timers[i].histogram, 0, sizeof(timers[i].histogram));
+    }
+
+    timing_refresh();
+} /* }}} */
+
+// vim: et ts=4 sw=4 sts=4
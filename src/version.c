@@ -0,0 +1,284 @@
+/*
+ * version.c - find the version of taskwarrior being wrapped
+ * for tasknc
+ * by mjheagle
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "common.h"
+#include "config.h"
+#include "jobs.h"
+#include "log.h"
+#include "timing.h"
+#include "version.h"
+
+/* local functions */
+static char* version_cache_path(void);
+static char* version_cache_read(void);
+static void version_cache_write(void);
+static char* version_probe_read(void);
+static void version_probe_start(void);
+static void version_probe_stop(void);
+static bool version_program(void);
+
+/* the running task --version, its pid is 0 when there is none */
+static pid_t        probe_pid = 0;
+static int          probe_fd = -1;
+
+/* the task program on the path and the version remembered for it, the
+ * version is kept until it is known whether the config replaced it
+ */
+static char*        program_path = NULL;
+static struct stat  program;
+static char*        cached = NULL;
+
+char* version_cache_path(void) { /* {{{ */
+    /* determine where the version is remembered
+     * return is the path, which must be free'd
+     */
+    char*   xdg_cache_home = getenv("XDG_CACHE_HOME");
+    char*   home = getenv("HOME");
+    char*   path = NULL;
+
+    if (xdg_cache_home != NULL) {
+        asprintf(&path, "%s/tasknc/version", xdg_cache_home);
+    } else if (home != NULL) {
+        asprintf(&path, "%s/.cache/tasknc/version", home);
+    }
+
+    return path;
+} /* }}} */
+
+char* version_cache_read(void) { /* {{{ */
+    /* read the version remembered by an earlier run
+     * it is only used if the task program has not changed since
+     * return is the version, which must be freed, or NULL if there is none
+     */
+    FILE*               fp;
+    char*               path = version_cache_path();
+    char*               file = NULL;
+    char*               version = NULL;
+    unsigned long long  dev;
+    unsigned long long  ino;
+    long long           size;
+    long long           sec;
+    long                nsec;
+    bool                valid;
+
+    if (path == NULL || (fp = fopen(path, "r")) == NULL) {
+        check_free(path);
+        return NULL;
+    }
+
+    valid = fscanf(fp, "%m[^\n]\n%llu %llu %lld %lld %ld\n%m[0-9.-]", &file, &dev, &ino,
+                   &size, &sec, &nsec, &version) == 7 &&
+            str_eq(file, program_path) && dev == (unsigned long long)program.st_dev &&
+            ino == (unsigned long long)program.st_ino && size == (long long)program.st_size &&
+            sec == (long long)program.st_mtim.tv_sec && nsec == program.st_mtim.tv_nsec;
+    fclose(fp);
+    free(path);
+    check_free(file);
+
+    if (!valid) {
+        check_free(version);
+        return NULL;
+    }
+
+    return version;
+} /* }}} */
+
+void version_cache_write(void) { /* {{{ */
+    /* remember the version for the task program for the next run
+     * it is written beside the old one and renamed over it, so another
+     * tasknc starting never reads half of it
+     */
+    FILE*   fp;
+    char*   path = version_cache_path();
+    char*   tmppath;
+    char*   pos;
+    bool    saved;
+
+    if (path == NULL) {
+        return;
+    }
+
+    /* create the directories leading to the file, ignoring ones that exist */
+    for (pos = strchr(path + 1, '/'); pos != NULL; pos = strchr(pos + 1, '/')) {
+        *pos = 0;
+        mkdir(path, 0700);
+        *pos = '/';
+    }
+
+    asprintf(&tmppath, "%s.%d", path, (int)getpid());
+    fp = fopen(tmppath, "w");
+
+    if (fp != NULL) {
+        fprintf(fp, "%s\n%llu %llu %lld %lld %ld\n%s\n", program_path,
+                (unsigned long long)program.st_dev, (unsigned long long)program.st_ino,
+                (long long)program.st_size, (long long)program.st_mtim.tv_sec,
+                program.st_mtim.tv_nsec, cfg.version);
+        saved = fclose(fp) == 0 && rename(tmppath, path) == 0;
+
+        if (!saved) {
+            unlink(tmppath);
+        }
+    }
+
+    free(tmppath);
+    free(path);
+} /* }}} */
+
+void version_finish(void) { /* {{{ */
+    /* wait for the version of taskwarrior to be found
+     * a version set in the config is used as it is, a remembered version is
+     * used unless remembering it was turned off there
+     */
+    const bool  configured = cfg.version != NULL &&
+                             (cached == NULL || !str_eq(cfg.version, cached));
+
+    if (configured || (cached != NULL && cfg.version_cache)) {
+        version_probe_stop();
+        tnc_fprintf(logfp, LOG_DEBUG, "task version (%s): %s",
+                    configured ? "config" : "cached", cfg.version);
+        goto done;
+    }
+
+    /* the remembered version may not be used, so it is probed after all */
+    if (cached != NULL) {
+        free(cfg.version);
+        version_probe_start();
+    }
+
+    cfg.version = version_probe_read();
+
+    if (cfg.version == NULL) {
+        tnc_fprintf(logfp, LOG_ERROR, "could not find task version");
+        cfg.version = strdup("");
+    } else if (cfg.version_cache && program_path != NULL) {
+        version_cache_write();
+    }
+
+    tnc_fprintf(logfp, LOG_DEBUG, "task version: %s", cfg.version);
+
+done:
+    phase_stop(PHASE_VERSION);
+    check_free(cached);
+    check_free(program_path);
+    cached = NULL;
+    program_path = NULL;
+} /* }}} */
+
+char* version_probe_read(void) { /* {{{ */
+    /* wait for task --version to finish and read the version it printed
+     * return is the version, which must be freed, or NULL if none was printed
+     */
+    char    buffer[VERSIONLENGTH];
+    char*   version = NULL;
+    size_t  length = 0;
+    ssize_t ret;
+
+    if (probe_pid == 0) {
+        return NULL;
+    }
+
+    fcntl(probe_fd, F_SETFL, fcntl(probe_fd, F_GETFL) & ~O_NONBLOCK);
+
+    while (length < sizeof(buffer) - 1 &&
+           ((ret = read(probe_fd, buffer + length, sizeof(buffer) - 1 - length)) > 0 ||
+            (ret < 0 && errno == EINTR))) {
+        length += ret > 0 ? ret : 0;
+    }
+
+    buffer[length] = 0;
+    close(probe_fd);
+
+    while (waitpid(probe_pid, NULL, 0) < 0 && errno == EINTR);
+
+    probe_pid = 0;
+    probe_fd = -1;
+
+    if (sscanf(buffer, " %m[0-9.-]", &version) != 1) {
+        return NULL;
+    }
+
+    return version;
+} /* }}} */
+
+void version_probe_start(void) { /* {{{ */
+    /* start running task --version without waiting for it */
+    phase_start(PHASE_VERSION);
+
+    if (!jobs_spawn("task --version", &probe_pid, &probe_fd)) {
+        probe_pid = 0;
+    }
+} /* }}} */
+
+void version_probe_stop(void) { /* {{{ */
+    /* stop a task --version that is no longer needed */
+    if (probe_pid == 0) {
+        return;
+    }
+
+    close(probe_fd);
+    kill(probe_pid, SIGTERM);
+
+    while (waitpid(probe_pid, NULL, 0) < 0 && errno == EINTR);
+
+    probe_pid = 0;
+    probe_fd = -1;
+} /* }}} */
+
+bool version_program(void) { /* {{{ */
+    /* find the task program that will be run, the version is remembered
+     * for its file
+     * return is whether it was found, program_path and program are set
+     */
+    const char* dir = getenv("PATH");
+    const char* end;
+
+    for (; dir != NULL; dir = *end != 0 ? end + 1 : NULL) {
+        end = strchrnul(dir, ':');
+
+        /* an empty entry is the working directory */
+        asprintf(&program_path, "%.*s/task", end > dir ? (int)(end - dir) : 1,
+                 end > dir ? dir : ".");
+
+        if (stat(program_path, &program) == 0 && S_ISREG(program.st_mode) &&
+            access(program_path, X_OK) == 0) {
+            return true;
+        }
+
+        free(program_path);
+        program_path = NULL;
+    }
+
+    return false;
+} /* }}} */
+
+void version_start(void) { /* {{{ */
+    /* start finding the version of taskwarrior, the rest of startup runs
+     * while task --version does
+     * the version is remembered across runs for the task program on the
+     * path, in which case nothing is run and cfg.version is set right away,
+     * otherwise it stays NULL until version_finish
+     */
+    if (version_program() && (cached = version_cache_read()) != NULL) {
+        cfg.version = strdup(cached);
+        return;
+    }
+
+    version_probe_start();
+} /* }}} */
+
+// vim: et ts=4 sw=4 sts=4
@@ -0,0 +1,275 @@
+/*
+ * watch.c - notice changes made to the task data outside of tasknc
+ * for tasknc
+ * by mjheagle
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "common.h"
+#include "jobs.h"
+#include "log.h"
+#include "taskdata.h"
+#include "watch.h"
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#define WATCH_INOTIFY
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || \
+      defined(__OpenBSD__) || defined(__DragonFly__)
+#include <sys/event.h>
+#define WATCH_KQUEUE
+#endif
+
+/* the changes watched for in the data directory */
+#define WATCH_INOTIFY_MASK              (IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_DELETE)
+#define WATCH_KQUEUE_MASK               (NOTE_WRITE | NOTE_EXTEND | NOTE_DELETE | NOTE_RENAME)
+
+/* local functions */
+#ifdef WATCH_KQUEUE
+static void watch_arm(void);
+#endif
+static long long watch_now(void);
+static bool watch_read(void);
+
+/* the inotify instance or kqueue changes are read from (-1 if not watching)
+ * and the directory watched
+ */
+static int          watchfd = -1;
+static char*        watchdir = NULL;
+
+#ifdef WATCH_KQUEUE
+/* kqueue watches files rather than names, so each data file is opened and
+ * opened again once it has been replaced
+ */
+static const char*  watchfiles[] = {"pending.data", "completed.data", "taskchampion.sqlite3",
+                                    NULL
+                                   };
+static int          filefds[sizeof(watchfiles) / sizeof(char*)];
+#endif
+
+/* when the changes seen will have settled (ms), 0 if none have been seen */
+static long long    deadline = 0;
+
+/* set by a signal asking for a reload */
+static volatile sig_atomic_t poked = 0;
+
+#ifdef WATCH_KQUEUE
+void watch_arm(void) { /* {{{ */
+    /* open the data files to watch, replacing the ones opened before */
+    struct kevent   change;
+    char*           path;
+    int             i;
+
+    for (i = 0; watchfiles[i] != NULL; i++) {
+        if (filefds[i] >= 0) {
+            close(filefds[i]);
+        }
+
+        asprintf(&path, "%s/%s", watchdir, watchfiles[i]);
+        filefds[i] = open(path, O_RDONLY | O_CLOEXEC);
+        free(path);
+
+        if (filefds[i] >= 0) {
+            EV_SET(&change, filefds[i], EVFILT_VNODE, EV_ADD | EV_CLEAR, WATCH_KQUEUE_MASK, 0,
+                   NULL);
+            kevent(watchfd, &change, 1, NULL, 0, NULL);
+        }
+    }
+} /* }}} */
+#endif
+
+bool watch_changed(void) { /* {{{ */
+    /**
+     * check whether the task data was changed outside of tasknc
+     * changes are reported once they settle: everything seen within
+     * watch_debounce ms of the first change is reported once, as is a
+     * reload asked for with a signal
+     * changes seen while one of tasknc's commands runs are its own, and
+     * are ignored
+     * return is whether the task list should be reloaded
+     */
+    const bool      changed = watchfd >= 0 && watch_read() && jobs_pending() == 0;
+    const long long now = watch_now();
+
+    if ((changed || poked) && deadline == 0) {
+        deadline = now + (cfg.watch_debounce > 0 ? cfg.watch_debounce : 0);
+    }
+
+    poked = 0;
+
+    if (deadline == 0 || now < deadline) {
+        return false;
+    }
+
+    deadline = 0;
+    tnc_fprintf(logfp, LOG_DEBUG, "task data changed");
+
+    return true;
+} /* }}} */
+
+int watch_fd(void) { /* {{{ */
+    /* get the descriptor that can be read once the task data changes (-1 if
+     * it is not watched)
+     */
+    return watchfd;
+} /* }}} */
+
+void watch_ignore(void) { /* {{{ */
+    /* drop the changes seen so far, run once a command of tasknc's is done */
+    if (watchfd >= 0) {
+        watch_read();
+    }
+} /* }}} */
+
+long long watch_now(void) { /* {{{ */
+    /* get the time changes are settled against (ms) */
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec * 1000LL + now.tv_nsec / 1000000;
+} /* }}} */
+
+void watch_poke(void) { /* {{{ */
+    /* ask for a reload, as for a change to the task data
+     * this may be run from a signal handler
+     */
+    poked = 1;
+} /* }}} */
+
+bool watch_read(void) { /* {{{ */
+    /**
+     * read every change waiting without blocking
+     * lock files come and go whenever taskwarrior runs, even to read, and
+     * are not changes
+     * return is whether any change was read
+     */
+    bool changed = false;
+#if defined(WATCH_INOTIFY)
+    char                        buffer[4096] __attribute__((aligned(__alignof__(int))));
+    const struct inotify_event* event;
+    const char*                 pos;
+    ssize_t                     length;
+    size_t                      namelen;
+    bool                        lock;
+
+    while ((length = read(watchfd, buffer, sizeof(buffer))) > 0 ||
+           (length < 0 && errno == EINTR)) {
+        for (pos = buffer; pos < buffer + (length > 0 ? length : 0);
+             pos += sizeof(struct inotify_event) + event->len) {
+            event = (const struct inotify_event*)pos;
+            namelen = event->len > 0 ? strlen(event->name) : 0;
+            lock = namelen >= 5 && strcmp(event->name + namelen - 5, ".lock") == 0;
+
+            if ((event->mask & IN_Q_OVERFLOW) != 0 || (namelen > 0 && !lock)) {
+                changed = true;
+            }
+        }
+    }
+#elif defined(WATCH_KQUEUE)
+    const struct timespec   zero = {0, 0};
+    struct kevent           events[8];
+
+    while (kevent(watchfd, NULL, 0, events, 8, &zero) > 0) {
+        changed = true;
+    }
+
+    /* taskwarrior replaces files it rewrites, and creates missing ones */
+    if (changed) {
+        watch_arm();
+    }
+#endif
+
+    return changed;
+} /* }}} */
+
+bool watch_start(void) { /* {{{ */
+    /* start watching the directory taskwarrior keeps its data in
+     * return is whether changes to the task data will be noticed
+     */
+#if defined(WATCH_KQUEUE)
+    int i;
+#endif
+
+    watchdir = taskdata_location();
+#if defined(WATCH_INOTIFY)
+    watchfd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (watchfd >= 0 && inotify_add_watch(watchfd, watchdir, WATCH_INOTIFY_MASK) < 0) {
+        close(watchfd);
+        watchfd = -1;
+    }
+#elif defined(WATCH_KQUEUE)
+    watchfd = kqueue();
+
+    if (watchfd >= 0) {
+        fcntl(watchfd, F_SETFD, FD_CLOEXEC);
+
+        for (i = 0; watchfiles[i] != NULL; i++) {
+            filefds[i] = -1;
+        }
+
+        watch_arm();
+    }
+#endif
+
+    if (watchfd < 0) {
+        tnc_fprintf(logfp, LOG_ERROR, "could not watch task data: %s", watchdir);
+        watch_stop();
+        return false;
+    }
+
+    tnc_fprintf(logfp, LOG_DEBUG, "watching task data: %s", watchdir);
+
+    return true;
+} /* }}} */
+
+void watch_stop(void) { /* {{{ */
+    /* stop watching the task data */
+#if defined(WATCH_KQUEUE)
+    int i;
+
+    for (i = 0; watchfd >= 0 && watchfiles[i] != NULL; i++) {
+        if (filefds[i] >= 0) {
+            close(filefds[i]);
+        }
+    }
+#endif
+
+    if (watchfd >= 0) {
+        close(watchfd);
+    }
+
+    check_free(watchdir);
+    watchfd = -1;
+    watchdir = NULL;
+    deadline = 0;
+} /* }}} */
+
+int watch_timeout(const int timeout) { /* {{{ */
+    /**
+     * find how long the ui may wait for a key before changes settle
+     * timeout - the longest the ui would wait otherwise (ms, -1 for ever)
+     * return is the time to wait (ms)
+     */
+    long long remaining;
+
+    if (deadline == 0) {
+        return timeout;
+    }
+
+    remaining = deadline - watch_now();
+    remaining = remaining > 0 ? remaining : 0;
+
+    return timeout >= 0 && timeout < remaining ? timeout : (int)remaining;
+} /* }}} */
+
+// vim: et ts=4 sw=4 sts=4
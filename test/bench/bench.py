@@ -0,0 +1,262 @@
+#!/usr/bin/env python3
+#
+# bench.py - end to end latency benchmark for tasknc
+# for tasknc
+#
+# runs tasknc on a pseudo terminal against the task stub in this directory,
+# types scripted key sequences and reports the wall clock latency of each
+# interaction and the peak resident set size
+#
+# an interaction ends once tasknc answers a `show` command typed after it,
+# keys are read one at a time, so the answer only comes once the keys before
+# it have been handled and the screen drawn
+#
+
+import argparse
+import fcntl
+import json
+import os
+import pty
+import re
+import select
+import shutil
+import signal
+import statistics
+import struct
+import sys
+import tempfile
+import termios
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+ROWS = 40
+COLS = 120
+
+# the longest an interaction may take before the benchmark gives up (s)
+TIMEOUT = 120
+
+
+def record(data, ntasks):
+    """scale the recorded export to ntasks tasks, writing the files the stub
+    replays to data"""
+    with open(os.path.join(HERE, "export.json")) as fp:
+        recorded = json.load(fp)
+
+    lines = []
+    uuids = []
+
+    for i in range(ntasks):
+        task = dict(recorded[i % len(recorded)])
+        task["id"] = i + 1
+        task["uuid"] = "%08x-%s" % (i, task["uuid"][9:])
+        task["description"] = "%s %d" % (task["description"], i)
+        task.pop("parent", None)
+        lines.append(json.dumps(task, ensure_ascii=False, separators=(",", ":")))
+        uuids.append(task["uuid"])
+
+    with open(os.path.join(data, "export.json"), "w") as fp:
+        fp.write("[\n" + ",\n".join(lines) + "\n]\n")
+
+    with open(os.path.join(data, "uuids"), "w") as fp:
+        fp.write("\n".join(uuids) + "\n")
+
+    for name in ("info.txt", "stat.txt", "version"):
+        shutil.copy(os.path.join(HERE, name), data)
+
+
+class Session:
+    """tasknc running on a pseudo terminal"""
+
+    def __init__(self, tasknc, env):
+        self.output = b""
+        self.pid, self.fd = pty.fork()
+
+        if self.pid == 0:
+            os.execve(tasknc, [tasknc], env)
+
+        fcntl.ioctl(self.fd, termios.TIOCSWINSZ, struct.pack("HHHH", ROWS, COLS, 0, 0))
+
+    def read(self, timeout):
+        """read what tasknc has drawn, waiting up to timeout seconds"""
+        ready, _, _ = select.select([self.fd], [], [], timeout)
+
+        if not ready:
+            return False
+
+        try:
+            self.output += os.read(self.fd, 1 << 16)
+        except OSError:
+            return False
+
+        return True
+
+    def wait_for(self, pattern, start):
+        """wait for pattern to be drawn after offset start of the output
+        return is the match"""
+        regex = re.compile(pattern)
+        deadline = time.monotonic() + TIMEOUT
+
+        while time.monotonic() < deadline:
+            match = regex.search(self.output, start)
+
+            if match:
+                return match
+
+            self.read(0.05)
+
+        raise RuntimeError("tasknc did not draw %r" % pattern)
+
+    def answer(self, keys, variable="task_count"):
+        """type keys, then show a variable that starts with a number
+        return is the number, once tasknc has answered"""
+        start = len(self.output)
+        os.write(self.fd, keys.encode() + b":show " + variable.encode() + b"\r")
+        pattern = re.escape(variable.encode()) + rb": (\d+)"
+
+        return int(self.wait_for(pattern, start).group(1))
+
+    def peak_rss(self):
+        """get the peak resident set size of tasknc (kB)"""
+        try:
+            with open("/proc/%d/status" % self.pid) as fp:
+                for line in fp:
+                    if line.startswith("VmHWM:"):
+                        return int(line.split()[1])
+        except OSError:
+            pass
+
+        return None
+
+    def quit(self):
+        """quit tasknc and wait for it to exit
+        return is its peak resident set size (kB), from the kernel if /proc
+        has none"""
+        peak = self.peak_rss()
+        os.write(self.fd, b"q")
+
+        # tasknc finishes its queued commands before it exits
+        while self.read(1):
+            pass
+
+        usage = os.wait4(self.pid, 0)[2]
+        os.close(self.fd)
+
+        return peak if peak is not None else usage.ru_maxrss
+
+
+def run(args, env, ntasks):
+    """run every interaction once
+    return is the latency of each (s), in order, and the peak rss (kB)"""
+    times = []
+    session = Session(args.tasknc, env)
+
+    def timed(name, keys, done=None):
+        start = time.monotonic()
+        session.answer(keys)
+
+        # reloads finish in the background, ask until they have
+        while done is not None and not done():
+            pass
+
+        times.append((name, time.monotonic() - start))
+
+    def whole():
+        return session.answer("") == ntasks
+
+    def reloaded(calls):
+        return lambda: session.answer("", "timing_get_tasks") > calls
+
+    # startup ends once the title shows every task
+    start = time.monotonic()
+    session.wait_for(rb"\(1/%d\)" % ntasks, 0)
+    times.append(("startup", time.monotonic() - start))
+
+    timed("scroll_end", "G")
+    timed("scroll_home", "g")
+    timed("search", "/%s\r" % args.search)
+    timed("search_next", "n")
+    timed("filter", "f%s\r" % args.filter)
+    timed("filter_clear", "fstatus:pending\r", whole)
+    timed("view", "v")
+    timed("view_close", "q")
+    timed("stats", ":stats\r")
+    timed("stats_close", "q")
+    timed("mark_search", "M%s\r" % args.complete)
+    timed("complete", "c")
+    timed("complete_reload", "", whole)
+    timed("sort", "sRdpu\r")
+    timed("reload", "r", reloaded(session.answer("", "timing_get_tasks")))
+
+    return times, session.quit()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="time tasknc interactions end to end")
+    parser.add_argument("--tasknc", default=os.path.join(HERE, "..", "..", "tasknc"),
+                        help="the tasknc to run (default: the one built)")
+    parser.add_argument("--tasks", default="1000,10000",
+                        help="comma separated numbers of tasks to export (default: 1000,10000)")
+    parser.add_argument("--runs", type=int, default=3,
+                        help="the number of times each interaction is run (default: 3)")
+    parser.add_argument("--latency", type=float, default=0,
+                        help="how long every task command takes (s, default: 0)")
+    parser.add_argument("--export-latency", type=float, default=0,
+                        help="how much longer exports take (s, default: 0)")
+    parser.add_argument("--search", default="chapter 2",
+                        help="the search to time (default: chapter 2)")
+    parser.add_argument("--filter", default="status:pending project:work",
+                        help="the narrowing filter to time (default: status:pending project:work)")
+    parser.add_argument("--complete", default="plumber",
+                        help="the search marking the tasks to complete (default: plumber)")
+    args = parser.parse_args()
+    args.tasknc = os.path.abspath(args.tasknc)
+
+    for ntasks in [int(n) for n in args.tasks.split(",")]:
+        root = tempfile.mkdtemp(prefix="tasknc-bench.")
+        data = os.path.join(root, "data")
+        os.makedirs(data)
+        os.makedirs(os.path.join(root, "config", "tasknc"))
+        record(data, ntasks)
+
+        # a fresh home every run, so nothing is remembered between runs
+        with open(os.path.join(root, "config", "tasknc", "config"), "w") as fp:
+            fp.write("set watch 0\nset timing 1\n")
+
+        env = dict(os.environ, TERM="xterm", LINES=str(ROWS), COLUMNS=str(COLS),
+                   PATH=HERE + os.pathsep + os.environ.get("PATH", ""),
+                   XDG_CONFIG_HOME=os.path.join(root, "config"),
+                   TASKNC_BENCH_DATA=data,
+                   TASKNC_BENCH_LATENCY=str(args.latency),
+                   TASKNC_BENCH_EXPORT_LATENCY=str(args.export_latency))
+        env.pop("XDG_CACHE_HOME", None)
+        results = {}
+        peaks = []
+
+        for i in range(args.runs):
+            home = os.path.join(root, "home%d" % i)
+            os.makedirs(home)
+            env["HOME"] = home
+            times, peak = run(args, env, ntasks)
+
+            for name, elapsed in times:
+                results.setdefault(name, []).append(elapsed)
+
+            if peak is not None:
+                peaks.append(peak)
+
+        print("%d tasks, %d runs, task latency %gs (+%gs for exports)" %
+              (ntasks, args.runs, args.latency, args.export_latency))
+        print("%-16s %10s %10s %10s" % ("interaction", "median", "min", "max"))
+
+        for name, elapsed in results.items():
+            print("%-16s %8.1fms %8.1fms %8.1fms" % (name, 1000 * statistics.median(elapsed),
+                                                   1000 * min(elapsed), 1000 * max(elapsed)))
+
+        print("%-16s %8d kB" % ("peak rss", max(peaks)) if peaks else "peak rss unknown")
+        print()
+        shutil.rmtree(root)
+
+
+if __name__ == "__main__":
+    signal.signal(signal.SIGINT, signal.SIG_DFL)
+    main()